@@ -0,0 +1,457 @@
+#include "AccessLogBatch.h"
+#include "JsonEscape.h"
+#include <functional>              // Used for std::hash
+#include <cmath>                   // Used for std::llround
+
+namespace {
+
+const char* const COLUMN_NAMES[] = {"client", "ident", "user", "method", "path", "protocol", "referer", "userAgent"};
+
+/// Number of columns in the columnar format: the text columns plus time, status and bytes.
+const uint64_t COLUMN_COUNT = AccessLogBatch::TEXT_COLUMNS + 3;
+
+/**
+ * @brief Appends an unsigned LEB128 varint.
+ *
+ * @param out The buffer.
+ * @param value The value.
+ */
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+/**
+ * @brief Appends a length-prefixed string.
+ *
+ * @param out The buffer.
+ * @param text The string.
+ */
+void putString(std::string& out, std::string_view text) {
+    putVarint(out, text.size());
+    out.append(text.data(), text.size());
+}
+
+/**
+ * @brief Cursor over an encoded batch.
+ */
+struct Reader {
+    const char* position; ///< Next byte.
+    const char* end; ///< End of the data.
+
+    /**
+     * @brief Reads an unsigned LEB128 varint.
+     *
+     * @param value Receives the value.
+     * @return False if the data ends or the varint is longer than 10 bytes.
+     */
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 70 && position < end; shift += 7) {
+            uint8_t byte = static_cast<uint8_t>(*position++);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Reads bytes.
+     *
+     * @param length How many.
+     * @param bytes Receives a view of them.
+     * @return False if the data ends first.
+     */
+    bool take(uint64_t length, std::string_view& bytes) {
+        if (length > static_cast<uint64_t>(end - position)) {
+            return false;
+        }
+        bytes = std::string_view(position, static_cast<size_t>(length));
+        position += length;
+        return true;
+    }
+
+    /**
+     * @brief Reads a length-prefixed string.
+     *
+     * @param text Receives a view of it.
+     * @return False if the data ends first.
+     */
+    bool string(std::string_view& text) {
+        uint64_t length;
+        return varint(length) && take(length, text);
+    }
+};
+
+/**
+ * @brief Reads the lengths and bytes of a TEXT column or of a dictionary's entries.
+ *
+ * @param reader The reader.
+ * @param count How many values.
+ * @param bytes Receives the values back to back.
+ * @param ends Receives the end of each value.
+ * @return False if the data is malformed.
+ */
+bool readValues(Reader& reader, uint64_t count, std::string& bytes, std::vector<uint32_t>& ends) {
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t length;
+        if (!reader.varint(length) || length > UINT32_MAX - total) {
+            return false;
+        }
+        total += length;
+        ends.push_back(static_cast<uint32_t>(total));
+    }
+    std::string_view data;
+    if (!reader.take(total, data)) {
+        return false;
+    }
+    bytes.assign(data.data(), data.size());
+    return true;
+}
+
+} // namespace
+
+AccessLogBatch::AccessLogBatch() {
+    for (int column = 0; column < TEXT_COLUMNS; ++column) {
+        texts[column].dictionary = column != PATH;
+    }
+}
+
+/**
+ * @brief Adds a row.
+ *
+ * @param record The parsed line.
+ */
+void AccessLogBatch::add(const AccessLogParser::Record& record) {
+    texts[CLIENT].add(record.client);
+    texts[IDENT].add(record.ident);
+    texts[USER].add(record.user);
+    texts[METHOD].add(record.method);
+    texts[PATH].add(record.path);
+    texts[PROTOCOL].add(record.protocol);
+    texts[REFERER].add(record.referer);
+    texts[USER_AGENT].add(record.userAgent);
+    times.push_back(record.timeUs);
+    statuses.push_back(static_cast<uint16_t>(record.status));
+    sizes.push_back(record.bytes);
+}
+
+/**
+ * @brief Removes every row.
+ */
+void AccessLogBatch::clear() {
+    for (Column& column : texts) {
+        column.clear();
+    }
+    times.clear();
+    statuses.clear();
+    sizes.clear();
+}
+
+/**
+ * @brief Appends a row's fields as JSON members.
+ *
+ * @param row The row.
+ * @param out The object being built.
+ */
+void AccessLogBatch::appendJson(size_t row, std::string& out) const {
+    static const TextColumn BEFORE[] = {CLIENT, IDENT, USER, METHOD, PATH, PROTOCOL};
+    static const TextColumn AFTER[] = {REFERER, USER_AGENT};
+    bool first = true;
+    auto appendText = [&](TextColumn column) {
+        std::string_view value = text(column, row);
+        if (value.empty()) {
+            return;
+        }
+        out += first ? "\"" : ", \"";
+        first = false;
+        out += COLUMN_NAMES[column];
+        out += "\": \"";
+        appendEscapedJson(out, value);
+        out += '"';
+    };
+    for (TextColumn column : BEFORE) {
+        appendText(column);
+    }
+    out += first ? "\"status\": " : ", \"status\": ";
+    first = false;
+    out += std::to_string(statuses[row]);
+    out += ", \"bytes\": ";
+    out += std::to_string(sizes[row]);
+    for (TextColumn column : AFTER) {
+        appendText(column);
+    }
+}
+
+/**
+ * @brief Writes the batch in the columnar format.
+ *
+ * The sample rate travels in the header, as `sampleRate` does in JSON
+ * envelopes, so consumers can scale counts by its inverse. It is rounded to
+ * parts per billion, and a rate that is not 0 never rounds to 0.
+ *
+ * @param source The file the rows came from.
+ * @param sampleRate Fraction of lines the rows were sampled from.
+ * @param out Receives the encoded batch.
+ */
+void AccessLogBatch::encode(const std::string& source, double sampleRate, std::string& out) const {
+    long long rate = std::llround(sampleRate * SAMPLE_RATE_SCALE);
+    if (rate < 1) {
+        rate = 1;
+    } else if (rate > static_cast<long long>(SAMPLE_RATE_SCALE)) {
+        rate = static_cast<long long>(SAMPLE_RATE_SCALE);
+    }
+    out.assign(ACCESS_BATCH_MAGIC, sizeof(ACCESS_BATCH_MAGIC) - 1);
+    putString(out, source);
+    putVarint(out, static_cast<uint64_t>(rate));
+    putVarint(out, size());
+    putVarint(out, COLUMN_COUNT);
+    for (int index = 0; index < TEXT_COLUMNS; ++index) {
+        const Column& column = texts[index];
+        putString(out, COLUMN_NAMES[index]);
+        out += static_cast<char>(column.dictionary ? DICTIONARY : TEXT);
+        if (column.dictionary) {
+            putVarint(out, column.entries());
+        }
+        uint32_t start = 0;
+        for (uint32_t end : column.ends) {
+            putVarint(out, end - start);
+            start = end;
+        }
+        out += column.bytes;
+        if (column.dictionary) {
+            for (uint32_t entry : column.rows) {
+                putVarint(out, entry);
+            }
+        }
+    }
+    putString(out, "time");
+    out += static_cast<char>(DELTA);
+    int64_t previous = 0;
+    for (int64_t time : times) {
+        uint64_t delta = static_cast<uint64_t>(time) - static_cast<uint64_t>(previous);
+        // Zigzag: small negative differences stay small
+        putVarint(out, (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63));
+        previous = time;
+    }
+    putString(out, "status");
+    out += static_cast<char>(NUMBER);
+    for (uint16_t status : statuses) {
+        putVarint(out, status);
+    }
+    putString(out, "bytes");
+    out += static_cast<char>(NUMBER);
+    for (int64_t size : sizes) {
+        putVarint(out, static_cast<uint64_t>(size));
+    }
+}
+
+/**
+ * @brief Reads a batch written by encode().
+ *
+ * Columns are found by name, so they may come in any order, and unknown
+ * columns are skipped. A text column may be TEXT or DICTIONARY.
+ *
+ * @param data The encoded batch.
+ * @param source Receives the file the rows came from.
+ * @param sampleRate Receives the fraction of lines the rows were sampled from.
+ * @param batch Receives the rows.
+ * @return False if the data is malformed or a column is missing.
+ */
+bool AccessLogBatch::decode(std::string_view data, std::string& source, double& sampleRate, AccessLogBatch& batch) {
+    batch.clear();
+    Reader reader{data.data(), data.data() + data.size()};
+    std::string_view magic;
+    std::string_view sourceView;
+    uint64_t rate;
+    uint64_t rows;
+    uint64_t columns;
+    if (!reader.take(sizeof(ACCESS_BATCH_MAGIC) - 1, magic) || magic != ACCESS_BATCH_MAGIC || !reader.string(sourceView) ||
+        !reader.varint(rate) || rate == 0 || rate > SAMPLE_RATE_SCALE ||
+        !reader.varint(rows) || !reader.varint(columns) || rows > static_cast<uint64_t>(reader.end - reader.position)) {
+        return false;
+    }
+    source.assign(sourceView.data(), sourceView.size());
+    sampleRate = static_cast<double>(rate) / SAMPLE_RATE_SCALE;
+    bool found[COLUMN_COUNT] = {};
+    for (uint64_t c = 0; c < columns; ++c) {
+        std::string_view name;
+        std::string_view kindByte;
+        if (!reader.string(name) || !reader.take(1, kindByte)) {
+            return false;
+        }
+        int kind = static_cast<unsigned char>(kindByte[0]);
+        int index = 0;
+        while (index < static_cast<int>(COLUMN_COUNT) &&
+               name != (index < TEXT_COLUMNS ? COLUMN_NAMES[index] : index == TEXT_COLUMNS ? "time" : index == TEXT_COLUMNS + 1 ? "status" : "bytes")) {
+            index++;
+        }
+        bool known = index < static_cast<int>(COLUMN_COUNT);
+        if (known && found[index]) {
+            return false;
+        }
+        if (kind == TEXT || kind == DICTIONARY) {
+            Column scratch;
+            Column& column = known && index < TEXT_COLUMNS ? batch.texts[index] : scratch;
+            column.dictionary = kind == DICTIONARY;
+            uint64_t entries = rows;
+            if (column.dictionary && (!reader.varint(entries) || entries > static_cast<uint64_t>(reader.end - reader.position))) {
+                return false;
+            }
+            if (!readValues(reader, entries, column.bytes, column.ends)) {
+                return false;
+            }
+            for (uint64_t row = 0; column.dictionary && row < rows; ++row) {
+                uint64_t entry;
+                if (!reader.varint(entry) || entry >= entries) {
+                    return false;
+                }
+                column.rows.push_back(static_cast<uint32_t>(entry));
+            }
+            if (column.dictionary) {
+                column.rehash();
+            }
+            if (known && index >= TEXT_COLUMNS) {
+                return false;
+            }
+        } else if (kind == DELTA || kind == NUMBER) {
+            if (known && index < TEXT_COLUMNS) {
+                return false;
+            }
+            int64_t previous = 0;
+            for (uint64_t row = 0; row < rows; ++row) {
+                uint64_t value;
+                if (!reader.varint(value)) {
+                    return false;
+                }
+                if (kind == DELTA) {
+                    uint64_t delta = (value >> 1) ^ (0 - (value & 1));
+                    previous = static_cast<int64_t>(static_cast<uint64_t>(previous) + delta);
+                    value = static_cast<uint64_t>(previous);
+                }
+                if (index == TEXT_COLUMNS) {
+                    batch.times.push_back(static_cast<int64_t>(value));
+                } else if (index == TEXT_COLUMNS + 1) {
+                    batch.statuses.push_back(static_cast<uint16_t>(value));
+                } else if (index == TEXT_COLUMNS + 2) {
+                    batch.sizes.push_back(static_cast<int64_t>(value));
+                }
+            }
+        } else {
+            return false;
+        }
+        if (known) {
+            found[index] = true;
+        }
+    }
+    for (bool present : found) {
+        if (!present) {
+            batch.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Retrieves the name of a text column.
+ *
+ * @param column The column.
+ * @return The name.
+ */
+const char* AccessLogBatch::columnName(TextColumn column) {
+    return column < TEXT_COLUMNS ? COLUMN_NAMES[column] : "";
+}
+
+/**
+ * @brief Retrieves a value or dictionary entry.
+ *
+ * @param index The value's row, or the entry.
+ * @return The text.
+ */
+std::string_view AccessLogBatch::Column::entry(size_t index) const {
+    uint32_t start = index == 0 ? 0 : ends[index - 1];
+    return std::string_view(bytes.data() + start, ends[index] - start);
+}
+
+/**
+ * @brief Adds a row's value, reusing the dictionary entry for text seen before.
+ *
+ * @param value The text.
+ */
+void AccessLogBatch::Column::add(std::string_view value) {
+    if (!dictionary) {
+        append(value);
+        return;
+    }
+    if (!rows.empty() && entry(rows.back()) == value) {
+        // Runs of one value (method, protocol, nil user) skip the hash
+        rows.push_back(rows.back());
+        return;
+    }
+    if ((entries() + 1) * 2 > table.size()) {
+        table.assign(table.empty() ? 64 : table.size() * 2, 0);
+        rehash();
+    }
+    size_t mask = table.size() - 1;
+    size_t slot = std::hash<std::string_view>()(value) & mask;
+    while (table[slot] != 0) {
+        if (entry(table[slot] - 1) == value) {
+            rows.push_back(table[slot] - 1);
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    append(value);
+    table[slot] = static_cast<uint32_t>(entries());
+    rows.push_back(static_cast<uint32_t>(entries() - 1));
+}
+
+/**
+ * @brief Appends a value or entry to the buffer.
+ *
+ * @param value The text.
+ */
+void AccessLogBatch::Column::append(std::string_view value) {
+    bytes.append(value.data(), value.size());
+    ends.push_back(static_cast<uint32_t>(bytes.size()));
+}
+
+/**
+ * @brief Rebuilds the dictionary's hash table from its entries.
+ *
+ * The table keeps its size unless it is too small for the entries.
+ */
+void AccessLogBatch::Column::rehash() {
+    size_t size = table.empty() ? 64 : table.size();
+    while (entries() * 2 > size) {
+        size *= 2;
+    }
+    table.assign(size, 0);
+    size_t mask = size - 1;
+    for (size_t index = 0; index < entries(); ++index) {
+        size_t slot = std::hash<std::string_view>()(entry(index)) & mask;
+        while (table[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        table[slot] = static_cast<uint32_t>(index + 1);
+    }
+}
+
+/**
+ * @brief Removes every value, keeping the buffers' capacity.
+ */
+void AccessLogBatch::Column::clear() {
+    bytes.clear();
+    ends.clear();
+    rows.clear();
+    if (!table.empty()) {
+        table.assign(table.size(), 0);
+    }
+}
@@ -0,0 +1,189 @@
+#ifndef ACCESSLOGBATCH_H
+#define ACCESSLOGBATCH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "AccessLogParser.h"
+
+
+/**
+ * @brief Magic bytes at the start of an encoded access log batch.
+ */
+const char ACCESS_BATCH_MAGIC[] = "SPKYALB1";
+
+/**
+ * @class AccessLogBatch
+ * @brief Access log records stored column by column.
+ *
+ * Each field of AccessLogParser::Record is a column. Text columns keep their
+ * values back to back in one buffer; the columns with few distinct values
+ * (client, ident, user, method, protocol, referer, user agent) are
+ * dictionary-encoded per batch, so a repeated user agent is stored once.
+ * Adding a row copies its text, so the lines need not outlive the batch.
+ *
+ * A batch can be written as JSON, one object per row, or in the columnar
+ * batch format: the magic followed by varints,
+ * - the source length and source, the sample rate in parts per billion
+ *   (SAMPLE_RATE_SCALE when every line was kept), the row count and the column count
+ * - per column: name length, name, kind, then the data:
+ *   - TEXT: the rows' lengths, then their bytes
+ *   - DICTIONARY: the entry count, the entries' lengths, their bytes, then each row's entry
+ *   - DELTA: each row's difference from the previous row (the first from 0), zigzag-encoded
+ *   - NUMBER: each row's value
+ *
+ * Lengths before bytes and sorted-ish timestamps as deltas keep the batch
+ * small and compressible.
+ */
+class AccessLogBatch {
+public:
+    /**
+     * @brief Output encodings.
+     */
+    enum Encoding {
+        JSON,    ///< One JSON object per row
+        COLUMNAR ///< One columnar batch
+    };
+
+    /**
+     * @brief Text columns, in encoding order.
+     */
+    enum TextColumn {
+        CLIENT,
+        IDENT,
+        USER,
+        METHOD,
+        PATH,
+        PROTOCOL,
+        REFERER,
+        USER_AGENT,
+        TEXT_COLUMNS
+    };
+
+    /**
+     * @brief Column kinds of the columnar format.
+     */
+    enum Kind {
+        TEXT = 0,       ///< Lengths, then bytes
+        DICTIONARY = 1, ///< Entries, then an entry index per row
+        DELTA = 2,      ///< Zigzag differences between rows
+        NUMBER = 3      ///< Unsigned values
+    };
+
+    /// Sample rate of a batch of every line, in the parts per billion the columnar format stores.
+    static const uint64_t SAMPLE_RATE_SCALE = 1000000000;
+
+    AccessLogBatch();
+
+    /**
+     * @brief Adds a row.
+     * @param record The parsed line.
+     */
+    void add(const AccessLogParser::Record& record);
+
+    /**
+     * @brief Removes every row, keeping the buffers' capacity.
+     */
+    void clear();
+
+    /**
+     * @brief Retrieves the number of rows.
+     * @return The count.
+     */
+    size_t size() const { return times.size(); }
+
+    /**
+     * @brief Retrieves a text value.
+     * @param column The column.
+     * @param row The row.
+     * @return The value; valid until the batch changes.
+     */
+    std::string_view text(TextColumn column, size_t row) const { return texts[column].value(row); }
+
+    /**
+     * @brief Retrieves a row's request time.
+     * @param row The row.
+     * @return Microseconds since the epoch.
+     */
+    int64_t timeUs(size_t row) const { return times[row]; }
+
+    /**
+     * @brief Retrieves a row's status code.
+     * @param row The row.
+     * @return The status.
+     */
+    int status(size_t row) const { return statuses[row]; }
+
+    /**
+     * @brief Retrieves a row's response size.
+     * @param row The row.
+     * @return The size in bytes.
+     */
+    int64_t bytes(size_t row) const { return sizes[row]; }
+
+    /**
+     * @brief Appends a row's fields as JSON members.
+     *
+     * Empty text values (nil ident, user, referer and user agent, a `-`
+     * request) are left out; status and bytes are numbers. The time is not
+     * included.
+     *
+     * @param row The row.
+     * @param out The object being built.
+     */
+    void appendJson(size_t row, std::string& out) const;
+
+    /**
+     * @brief Writes the batch in the columnar format.
+     * @param source The file the rows came from.
+     * @param sampleRate Fraction of lines the rows were sampled from, 1 if none were dropped.
+     * @param out Receives the encoded batch, replacing its contents.
+     */
+    void encode(const std::string& source, double sampleRate, std::string& out) const;
+
+    /**
+     * @brief Reads a batch written by encode().
+     * @param data The encoded batch.
+     * @param source Receives the file the rows came from.
+     * @param sampleRate Receives the fraction of lines the rows were sampled from.
+     * @param batch Receives the rows, replacing its contents.
+     * @return False if the data is not a well-formed batch.
+     */
+    static bool decode(std::string_view data, std::string& source, double& sampleRate, AccessLogBatch& batch);
+
+    /**
+     * @brief Retrieves the name of a text column as written in JSON and the columnar format.
+     * @param column The column.
+     * @return The name, e.g. "userAgent".
+     */
+    static const char* columnName(TextColumn column);
+
+private:
+    /**
+     * @brief A text column, optionally dictionary-encoded.
+     */
+    struct Column {
+        bool dictionary; ///< Whether rows refer to distinct entries.
+        std::string bytes; ///< Values, or entries, back to back.
+        std::vector<uint32_t> ends; ///< End of each value or entry in bytes.
+        std::vector<uint32_t> rows; ///< Entry of each row, for a dictionary.
+        std::vector<uint32_t> table; ///< Entry + 1 by hash of its text, linear probing; 0 if empty.
+
+        std::string_view entry(size_t index) const;
+        std::string_view value(size_t row) const { return entry(dictionary ? rows[row] : row); }
+        size_t entries() const { return ends.size(); }
+        void add(std::string_view value);
+        void append(std::string_view value);
+        void rehash();
+        void clear();
+    };
+
+    Column texts[TEXT_COLUMNS]; ///< Text columns, by TextColumn.
+    std::vector<int64_t> times; ///< Request times in microseconds.
+    std::vector<uint16_t> statuses; ///< Status codes.
+    std::vector<int64_t> sizes; ///< Response sizes.
+};
+
+#endif
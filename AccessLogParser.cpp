@@ -0,0 +1,174 @@
+#include "AccessLogParser.h"
+#include <cstring>                 // Used for memchr()
+
+/**
+ * @brief Parses a line.
+ *
+ * @param line The line.
+ * @param record Receives the fields.
+ * @return False if the line is not in the common or combined format.
+ */
+bool AccessLogParser::parse(std::string_view line, Record& record) {
+    record = Record();
+    Cursor cursor{line.data(), line.data() + line.size()};
+    std::string_view request;
+    int64_t status;
+    if (!word(cursor, record.client) || !word(cursor, record.ident) || !word(cursor, record.user) || cursor.position >= cursor.end ||
+        *cursor.position != '[') {
+        return false;
+    }
+    cursor.position++;
+    size_t used = times.parse(TimestampParser::APACHE, std::string_view(cursor.position, static_cast<size_t>(cursor.end - cursor.position)), record.timeUs);
+    cursor.position += used;
+    if (used == 0 || cursor.end - cursor.position < 2 || cursor.position[0] != ']' || cursor.position[1] != ' ') {
+        return false;
+    }
+    cursor.position += 2;
+    if (!quoted(cursor, request) || !space(cursor) || !number(cursor, status) || status < 100 || status > 999 || !space(cursor)) {
+        return false;
+    }
+    record.status = static_cast<int>(status);
+    if (cursor.position < cursor.end && *cursor.position == '-') {
+        cursor.position++;
+    } else if (!number(cursor, record.bytes)) {
+        return false;
+    }
+    // Combined adds ` "referer" "user-agent"`, possibly followed by more fields
+    if (cursor.position < cursor.end &&
+        (!space(cursor) || !quoted(cursor, record.referer) || !space(cursor) || !quoted(cursor, record.userAgent))) {
+        return false;
+    }
+    record.ident = nil(record.ident);
+    record.user = nil(record.user);
+    record.referer = nil(record.referer);
+    record.userAgent = nil(record.userAgent);
+    splitRequest(request, record);
+    return true;
+}
+
+/**
+ * @brief Reads a word and the space after it.
+ *
+ * @param cursor The cursor, at the word; left after the space.
+ * @param value Receives the word.
+ * @return False if the word is empty or not followed by a space.
+ */
+bool AccessLogParser::word(Cursor& cursor, std::string_view& value) {
+    const char* start = cursor.position;
+    const void* space = std::memchr(start, ' ', static_cast<size_t>(cursor.end - start));
+    if (space == nullptr || space == start) {
+        return false;
+    }
+    cursor.position = static_cast<const char*>(space) + 1;
+    value = std::string_view(start, static_cast<size_t>(cursor.position - 1 - start));
+    return true;
+}
+
+/**
+ * @brief Reads a double-quoted field, in which a backslash escapes the next byte.
+ *
+ * @param cursor The cursor, at the opening quote; left after the closing quote.
+ * @param value Receives the text between the quotes, escapes included.
+ * @return False if the field is not quoted or not closed.
+ */
+bool AccessLogParser::quoted(Cursor& cursor, std::string_view& value) {
+    const char* p = cursor.position;
+    if (p >= cursor.end || *p != '"') {
+        return false;
+    }
+    const char* start = ++p;
+    while (true) {
+        const void* stop = std::memchr(p, '"', static_cast<size_t>(cursor.end - p));
+        if (stop == nullptr) {
+            return false;
+        }
+        const char* quote = static_cast<const char*>(stop);
+        // The quote is escaped if an odd number of backslashes precede it
+        const char* q = quote;
+        while (q > start && q[-1] == '\\') {
+            q--;
+        }
+        p = quote + 1;
+        if ((quote - q) % 2 == 0) {
+            break;
+        }
+    }
+    value = std::string_view(start, static_cast<size_t>(p - 1 - start));
+    cursor.position = p;
+    return true;
+}
+
+/**
+ * @brief Reads a decimal number.
+ *
+ * @param cursor The cursor, at the first digit; left after the last one.
+ * @param value Receives the number.
+ * @return False if there are no digits, more than 18, or the number is followed by something other than a space or the end.
+ */
+bool AccessLogParser::number(Cursor& cursor, int64_t& value) {
+    const char* p = cursor.position;
+    value = 0;
+    while (p < cursor.end && *p >= '0' && *p <= '9' && p - cursor.position < 18) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    if (p == cursor.position || (p < cursor.end && *p != ' ')) {
+        return false;
+    }
+    cursor.position = p;
+    return true;
+}
+
+/**
+ * @brief Skips a space.
+ *
+ * @param cursor The cursor; advanced past the space.
+ * @return False if the next byte is not a space.
+ */
+bool AccessLogParser::space(Cursor& cursor) {
+    if (cursor.position >= cursor.end || *cursor.position != ' ') {
+        return false;
+    }
+    cursor.position++;
+    return true;
+}
+
+/**
+ * @brief Splits a request line into method, path and protocol.
+ *
+ * `METHOD PATH PROTOCOL` and HTTP/0.9's `METHOD PATH` are split when the
+ * method is upper-case letters; anything else, including `-`, is all path.
+ *
+ * @param request The request line.
+ * @param record Receives method, path and protocol.
+ */
+void AccessLogParser::splitRequest(std::string_view request, Record& record) {
+    size_t first = request.find(' ');
+    bool method = first != std::string_view::npos && first > 0;
+    for (size_t i = 0; method && i < first; ++i) {
+        method = request[i] >= 'A' && request[i] <= 'Z';
+    }
+    if (!method) {
+        record.path = request == "-" ? std::string_view() : request;
+        return;
+    }
+    record.method = request.substr(0, first);
+    std::string_view rest = request.substr(first + 1);
+    size_t last = rest.rfind(' ');
+    if (last != std::string_view::npos && rest.compare(last + 1, 5, "HTTP/") == 0) {
+        record.path = rest.substr(0, last);
+        record.protocol = rest.substr(last + 1);
+    } else {
+        record.path = rest;
+    }
+}
+
+/**
+ * @brief Maps the nil value `-` to empty.
+ *
+ * @param value The value.
+ * @return The value, or empty if it is `-`.
+ */
+std::string_view AccessLogParser::nil(std::string_view value) {
+    return value == "-" ? std::string_view() : value;
+}
@@ -0,0 +1,72 @@
+#ifndef ACCESSLOGPARSER_H
+#define ACCESSLOGPARSER_H
+
+#include <string_view>
+#include <cstdint>
+#include "TimestampParser.h"
+
+
+/**
+ * @class AccessLogParser
+ * @brief Splits Apache and nginx access log lines into typed fields without allocating.
+ *
+ * Accepts the common and combined formats, which Apache and nginx write alike:
+ *
+ *     client ident user [dd/Mmm/yyyy:hh:mm:ss +zzzz] "request" status bytes ["referer" "user-agent"]
+ *
+ * Anything after the user agent (nginx's extra variables, Apache's %D) is
+ * ignored. The request is split into method, path and protocol when it has
+ * that shape; otherwise, e.g. for a TLS handshake sent to a plain HTTP port,
+ * all of it is the path. Quoted fields are kept as written, escapes
+ * included (Apache writes `\"`, nginx `\x22`). The nil value `-` of ident,
+ * user, referer and user agent becomes empty, and `-` bytes become 0.
+ *
+ * Each monitor has its own parser, since the timestamp caches are per parser.
+ */
+class AccessLogParser {
+public:
+    /**
+     * @brief The fields of one line; views point into the line.
+     */
+    struct Record {
+        std::string_view client; ///< Client address (%h).
+        std::string_view ident; ///< identd user (%l), empty if nil.
+        std::string_view user; ///< Authenticated user (%u), empty if nil.
+        int64_t timeUs; ///< Request time in microseconds since the epoch (%t).
+        std::string_view method; ///< Request method, empty if the request is malformed.
+        std::string_view path; ///< Request target, or the whole request if it is malformed.
+        std::string_view protocol; ///< Protocol, e.g. "HTTP/1.1", empty for HTTP/0.9 or a malformed request.
+        int status; ///< Status code (%>s).
+        int64_t bytes; ///< Response bytes (%b), 0 if nil.
+        std::string_view referer; ///< Referer, empty if nil or in the common format.
+        std::string_view userAgent; ///< User agent, empty if nil or in the common format.
+    };
+
+    /**
+     * @brief Parses a line.
+     * @param line The line.
+     * @param record Receives the fields; valid until the line changes.
+     * @return False if the line is not in the common or combined format.
+     */
+    bool parse(std::string_view line, Record& record);
+
+private:
+    /**
+     * @brief Cursor over the line being parsed.
+     */
+    struct Cursor {
+        const char* position; ///< Next byte.
+        const char* end; ///< End of the line.
+    };
+
+    static bool word(Cursor& cursor, std::string_view& value);
+    static bool quoted(Cursor& cursor, std::string_view& value);
+    static bool number(Cursor& cursor, int64_t& value);
+    static bool space(Cursor& cursor);
+    static void splitRequest(std::string_view request, Record& record);
+    static std::string_view nil(std::string_view value);
+
+    TimestampParser times; ///< Decodes `[dd/Mmm/yyyy:hh:mm:ss +zzzz]`.
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "AllocationAccounting.h"
+#include <atomic>                  // Used for the per-stage counters
+#include <new>                     // Used for std::bad_alloc and std::nothrow_t
+#include <cstdlib>                 // Used for malloc() and free()
+
+namespace {
+
+/**
+ * @brief Counters of one stage, on their own cache line.
+ */
+struct alignas(64) StageCounters {
+    std::atomic<uint64_t> allocations{0}; ///< Allocations charged to the stage.
+    std::atomic<uint64_t> bytes{0}; ///< Bytes charged to the stage.
+};
+
+/// Constant-initialized, so allocations during static initialization are counted safely.
+StageCounters counters[AllocationAccounting::STAGE_COUNT];
+
+/// Stage the current thread's allocations are charged to.
+thread_local AllocationAccounting::Stage currentStage = AllocationAccounting::OTHER;
+
+} // namespace
+
+/**
+ * @brief Tags the current thread with a stage.
+ *
+ * @param stage The stage; nested scopes take precedence until they end.
+ */
+AllocationAccounting::Scope::Scope(Stage stage) : previous(currentStage) {
+    currentStage = stage;
+}
+
+/**
+ * @brief Restores the stage that was current when the scope began.
+ */
+AllocationAccounting::Scope::~Scope() {
+    currentStage = previous;
+}
+
+/**
+ * @brief Tells whether the global allocator is interposed.
+ *
+ * @return True if built with SPARKY_ALLOC_ACCOUNTING.
+ */
+bool AllocationAccounting::enabled() {
+#ifdef SPARKY_ALLOC_ACCOUNTING
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Reads every stage's counters.
+ *
+ * @return The totals; all zero unless enabled().
+ */
+AllocationAccounting::Totals AllocationAccounting::totals() {
+    Totals totals;
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        totals.allocations[i] = counters[i].allocations.load(std::memory_order_relaxed);
+        totals.bytes[i] = counters[i].bytes.load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+
+/**
+ * @brief Retrieves the name of a stage.
+ *
+ * @param stage The stage.
+ * @return The stage's lower-case name.
+ */
+const char* AllocationAccounting::stageName(Stage stage) {
+    switch (stage) {
+        case READ:     return "read";
+        case FORMAT:   return "format";
+        case PRODUCE:  return "produce";
+        case DELIVERY: return "delivery";
+        default:       return "other";
+    }
+}
+
+/**
+ * @brief Charges one allocation to the current thread's stage.
+ *
+ * @param bytes The size requested.
+ */
+void AllocationAccounting::record(size_t bytes) {
+    StageCounters& stage = counters[currentStage];
+    stage.allocations.fetch_add(1, std::memory_order_relaxed);
+    stage.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Computes the per-stage allocations made between two snapshots.
+ *
+ * @param earlier The earlier snapshot.
+ * @return This snapshot minus the earlier one.
+ */
+AllocationAccounting::Totals AllocationAccounting::Totals::since(const Totals& earlier) const {
+    Totals difference;
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        difference.allocations[i] = allocations[i] - earlier.allocations[i];
+        difference.bytes[i] = bytes[i] - earlier.bytes[i];
+    }
+    return difference;
+}
+
+/**
+ * @brief Sums the allocations of all stages.
+ *
+ * @return The total number of allocations.
+ */
+uint64_t AllocationAccounting::Totals::allAllocations() const {
+    uint64_t sum = 0;
+    for (uint64_t count : allocations) {
+        sum += count;
+    }
+    return sum;
+}
+
+/**
+ * @brief Sums the bytes of all stages.
+ *
+ * @return The total number of bytes requested.
+ */
+uint64_t AllocationAccounting::Totals::allBytes() const {
+    uint64_t sum = 0;
+    for (uint64_t count : bytes) {
+        sum += count;
+    }
+    return sum;
+}
+
+#ifdef SPARKY_ALLOC_ACCOUNTING
+
+// Replacements for the global allocation functions. The array, nothrow and
+// sized forms of the standard library forward to these; the aligned forms
+// keep their own allocator and are not counted.
+
+void* operator new(size_t size) {
+    AllocationAccounting::record(size);
+    void* memory = std::malloc(size ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    AllocationAccounting::record(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+#endif
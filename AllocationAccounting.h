@@ -0,0 +1,123 @@
+#ifndef ALLOCATIONACCOUNTING_H
+#define ALLOCATIONACCOUNTING_H
+
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @class AllocationAccounting
+ * @brief Counts heap allocations per pipeline stage in builds with `-DSPARKY_ALLOC_ACCOUNTING`.
+ *
+ * In such builds AllocationAccounting.cpp replaces the global operator new
+ * and delete. Each allocation is charged to the stage tagged on the
+ * allocating thread by the innermost SPARKY_ALLOC_STAGE() scope, or to OTHER.
+ * Only C++ allocations are seen; librdkafka's own mallocs are not.
+ *
+ * In normal builds the operators are not replaced, SPARKY_ALLOC_STAGE()
+ * expands to nothing and totals() stays zero, so the hot path pays nothing.
+ */
+class AllocationAccounting {
+public:
+    /**
+     * @brief Pipeline stages allocations are charged to.
+     */
+    enum Stage {
+        OTHER = 0,    ///< Untagged code.
+        READ = 1,     ///< Reading chunks and splitting them into lines.
+        FORMAT = 2,   ///< Templating and formatting messages.
+        PRODUCE = 3,  ///< Queueing and handing messages to librdkafka.
+        DELIVERY = 4  ///< Serving delivery reports and statistics.
+    };
+
+    /// Number of stages.
+    static const size_t STAGE_COUNT = 5;
+
+    /**
+     * @brief Allocation counts and bytes per stage.
+     */
+    struct Totals {
+        uint64_t allocations[STAGE_COUNT] = {}; ///< Allocations per stage.
+        uint64_t bytes[STAGE_COUNT] = {}; ///< Bytes requested per stage.
+
+        /**
+         * @brief Computes the allocations made after an earlier snapshot.
+         * @param earlier A snapshot taken before this one.
+         * @return The per-stage differences.
+         */
+        Totals since(const Totals& earlier) const;
+
+        /**
+         * @brief Sums the allocations of all stages.
+         * @return The total number of allocations.
+         */
+        uint64_t allAllocations() const;
+
+        /**
+         * @brief Sums the bytes of all stages.
+         * @return The total number of bytes requested.
+         */
+        uint64_t allBytes() const;
+    };
+
+    /**
+     * @brief Tags the current thread with a stage for the lifetime of the scope.
+     */
+    class Scope {
+    public:
+        /**
+         * @brief Charges the thread's allocations to a stage until destroyed.
+         * @param stage The stage.
+         */
+        explicit Scope(Stage stage);
+
+        /**
+         * @brief Restores the thread's previous stage.
+         */
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Stage previous; ///< The stage to restore.
+    };
+
+    /**
+     * @brief Tells whether allocations are being counted.
+     * @return True if built with SPARKY_ALLOC_ACCOUNTING.
+     */
+    static bool enabled();
+
+    /**
+     * @brief Retrieves the allocations counted so far, summed over all threads.
+     * @return The per-stage totals.
+     */
+    static Totals totals();
+
+    /**
+     * @brief Retrieves the name of a stage.
+     * @param stage The stage.
+     * @return "other", "read", "format", "produce" or "delivery".
+     */
+    static const char* stageName(Stage stage);
+
+    /**
+     * @brief Charges one allocation to the current thread's stage. Called by operator new.
+     * @param bytes The size requested.
+     */
+    static void record(size_t bytes);
+};
+
+/**
+ * @brief Charges allocations in the enclosing block to an AllocationAccounting::Stage.
+ *
+ * Compiles to nothing unless SPARKY_ALLOC_ACCOUNTING is defined.
+ */
+#ifdef SPARKY_ALLOC_ACCOUNTING
+#define SPARKY_ALLOC_STAGE(stage) AllocationAccounting::Scope allocationStage(AllocationAccounting::stage)
+#else
+#define SPARKY_ALLOC_STAGE(stage) ((void)0)
+#endif
+
+#endif
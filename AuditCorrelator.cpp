@@ -0,0 +1,471 @@
+#include "AuditCorrelator.h"
+#include <stdexcept>               // Used for std::invalid_argument
+#include <algorithm>               // Used for std::min
+
+namespace {
+
+const char AUDIT_ID[] = "msg=audit(";
+
+/// Marks an empty table position or the end of a bucket or free list.
+const uint32_t NONE = UINT32_MAX;
+
+/// Fields whose untrusted string values auditd writes as hex when they contain special characters.
+const char* const HEX_FIELDS[] = {"proctitle", "name", "cwd", "exe", "comm", "path", "data", "cmd", "key"};
+
+/**
+ * @brief Converts a hex digit as written by auditd.
+ *
+ * @param c The character.
+ * @return Its value, or -1 if it is not an uppercase hex digit.
+ */
+inline int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Checks whether a field is one auditd may hex-encode.
+ *
+ * @param key The field name.
+ * @return True for the fields in HEX_FIELDS and EXECVE arguments (`a0`, `a1[2]`, ...).
+ */
+bool isHexField(std::string_view key) {
+    if (key.size() >= 2 && key[0] == 'a' && key[1] >= '0' && key[1] <= '9') {
+        return key.find_first_not_of("0123456789[]", 1) == std::string_view::npos;
+    }
+    for (const char* field : HEX_FIELDS) {
+        if (key == field) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks whether a value is a non-empty, even-length run of hex digits.
+ *
+ * @param value The value.
+ * @return True if it can be hex-decoded.
+ */
+bool isHex(std::string_view value) {
+    if (value.empty() || value.size() % 2 != 0) {
+        return false;
+    }
+    for (char c : value) {
+        if (hexDigit(c) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Rounds a capacity up to a power of two.
+ *
+ * @param n The capacity.
+ * @return The smallest power of two not below it.
+ */
+size_t powerOfTwo(size_t n) {
+    size_t size = 1;
+    while (size < n) {
+        size <<= 1;
+    }
+    return size;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a correlator.
+ *
+ * The hash table is kept at most half full, and the wheel has one bucket
+ * per tick of the window plus one, so no bucket holds events of two
+ * different deadlines.
+ *
+ * @param file Name of the file, used as the `file` metric label.
+ * @param windowMs How long an event waits for more records, in milliseconds.
+ * @param maxEvents Most events open at once.
+ * @throws std::invalid_argument If the window or the capacity is not positive.
+ */
+AuditCorrelator::AuditCorrelator(const std::string& file, int64_t windowMs, size_t maxEvents)
+    : windowTicks((windowMs + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS), freeSlots(0), currentTick(-1), openEvents(0),
+      records(Metrics::instance().counter("sparky_audit_records_total", Metrics::label("file", file))),
+      events(Metrics::instance().counter("sparky_audit_events_total", Metrics::label("file", file))),
+      evicted(Metrics::instance().counter("sparky_audit_evicted_total", Metrics::label("file", file))) {
+    if (windowMs <= 0 || maxEvents == 0 || maxEvents >= NONE) {
+        throw std::invalid_argument("Audit correlation needs a positive window and capacity");
+    }
+    slots.resize(maxEvents);
+    for (size_t i = 0; i < maxEvents; ++i) {
+        slots[i].next = i + 1 < maxEvents ? static_cast<uint32_t>(i + 1) : NONE;
+    }
+    table.assign(powerOfTwo(maxEvents * 2), NONE);
+    wheel.assign(static_cast<size_t>(windowTicks) + 1, NONE);
+}
+
+/**
+ * @brief Adds a line if it is an audit record.
+ *
+ * An EOE record completes its event and is not kept. An EOE whose event was
+ * already completed yields an event without records, which only carries the
+ * EOE's origin so the caller can acknowledge it.
+ *
+ * @param line The line.
+ * @param origin Where the line came from.
+ * @param now The current time, from LatencyTracker::now().
+ * @param done Receives completed events.
+ * @return False if the line is not an audit record.
+ */
+bool AuditCorrelator::add(std::string_view line, const Origin& origin, int64_t now, std::vector<Event>& done) {
+    std::string_view time;
+    std::string_view type;
+    uint64_t serial;
+    if (!parseId(line, time, serial, type)) {
+        return false;
+    }
+    expire(now, done);
+    records.add();
+    size_t position = find(serial);
+    uint32_t slot = position == SIZE_MAX ? NONE : table[position];
+    if (type == "EOE") {
+        if (slot == NONE) {
+            done.push_back(Event{serial, std::string(time), std::string(), {origin}});
+            return true;
+        }
+        slots[slot].event.origins.push_back(origin);
+        complete(slot, done);
+        return true;
+    }
+    if (slot == NONE) {
+        slot = start(serial, time, now, done);
+    }
+    Event& event = slots[slot].event;
+    event.records.append(line.data(), line.size());
+    event.records += '\n';
+    event.origins.push_back(origin);
+    return true;
+}
+
+/**
+ * @brief Completes the events whose deadline tick has passed.
+ *
+ * Each bucket between the last expired tick and now is visited once; when
+ * more time than the whole wheel has passed, every bucket is visited once.
+ *
+ * @param now The current time, from LatencyTracker::now().
+ * @param done Receives the completed events.
+ */
+void AuditCorrelator::expire(int64_t now, std::vector<Event>& done) {
+    int64_t target = tick(now);
+    if (currentTick < 0) {
+        currentTick = target;
+        return;
+    }
+    int64_t steps = std::min<int64_t>(target - currentTick, static_cast<int64_t>(wheel.size()));
+    for (int64_t step = 1; step <= steps && openEvents > 0; ++step) {
+        size_t bucket = static_cast<size_t>((currentTick + step) % static_cast<int64_t>(wheel.size()));
+        uint32_t slot = wheel[bucket];
+        while (slot != NONE) {
+            uint32_t next = slots[slot].next;
+            if (slots[slot].deadline <= target) {
+                complete(slot, done);
+            }
+            slot = next;
+        }
+    }
+    if (target > currentTick) {
+        currentTick = target;
+    }
+}
+
+/**
+ * @brief Completes every open event, in order of expiry.
+ *
+ * @param done Receives the events.
+ */
+void AuditCorrelator::flush(std::vector<Event>& done) {
+    for (size_t step = 1; step <= wheel.size() && openEvents > 0; ++step) {
+        size_t bucket = static_cast<size_t>((currentTick + static_cast<int64_t>(step)) % static_cast<int64_t>(wheel.size()));
+        while (wheel[bucket] != NONE) {
+            complete(wheel[bucket], done);
+        }
+    }
+}
+
+/**
+ * @brief Splits a record into its type and fields.
+ *
+ * @param record The record's line.
+ * @param type Receives the record type.
+ * @param fields Receives the fields after the audit id.
+ * @return False if the line is not an audit record.
+ */
+bool AuditCorrelator::fields(std::string_view record, std::string_view& type, std::vector<Field>& fields) {
+    fields.clear();
+    std::string_view time;
+    uint64_t serial;
+    if (!parseId(record, time, serial, type)) {
+        return false;
+    }
+    size_t p = record.find("): ", record.find(AUDIT_ID));
+    p = p == std::string_view::npos ? record.size() : p + 3;
+    while (p < record.size()) {
+        while (p < record.size() && record[p] == ' ') {
+            p++;
+        }
+        size_t keyStart = p;
+        while (p < record.size() && record[p] != '=' && record[p] != ' ') {
+            p++;
+        }
+        if (p >= record.size() || record[p] != '=') {
+            continue;
+        }
+        std::string_view key = record.substr(keyStart, p - keyStart);
+        p++;
+        if (p < record.size() && (record[p] == '"' || record[p] == '\'')) {
+            char quote = record[p];
+            size_t end = record.find(quote, p + 1);
+            if (end == std::string_view::npos) {
+                end = record.size();
+            }
+            fields.push_back(Field{key, record.substr(p + 1, end - p - 1), false});
+            p = end + 1;
+            continue;
+        }
+        size_t valueStart = p;
+        while (p < record.size() && record[p] != ' ') {
+            p++;
+        }
+        std::string_view value = record.substr(valueStart, p - valueStart);
+        fields.push_back(Field{key, value, isHexField(key) && isHex(value)});
+    }
+    return true;
+}
+
+/**
+ * @brief Decodes a hex-encoded value.
+ *
+ * @param hex The hex digits; an even number of uppercase digits.
+ * @param out Receives the decoded text.
+ */
+void AuditCorrelator::decodeHex(std::string_view hex, std::string& out) {
+    out.clear();
+    out.reserve(hex.size() / 2);
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        char c = static_cast<char>(hexDigit(hex[i]) * 16 + hexDigit(hex[i + 1]));
+        out += c == '\0' ? ' ' : c;
+    }
+    while (!out.empty() && out.back() == ' ') {
+        out.pop_back();
+    }
+}
+
+/**
+ * @brief Tells whether a line is an audit record.
+ *
+ * @param line The line.
+ * @return True if the line has a record type and an audit id.
+ */
+bool AuditCorrelator::isRecord(std::string_view line) {
+    std::string_view time;
+    uint64_t serial;
+    std::string_view type;
+    return parseId(line, time, serial, type);
+}
+
+/**
+ * @brief Parses the record type and the `msg=audit(TIME:SERIAL):` id of a line.
+ *
+ * @param line The line, e.g. `type=SYSCALL msg=audit(1364481363.243:24287): arch=c000003e ...`,
+ *        possibly starting with `node=HOST `.
+ * @param time Receives TIME.
+ * @param serial Receives SERIAL.
+ * @param type Receives the record type.
+ * @return False if the line has no type or no audit id.
+ */
+bool AuditCorrelator::parseId(std::string_view line, std::string_view& time, uint64_t& serial, std::string_view& type) {
+    size_t id = line.find(AUDIT_ID);
+    if (id == std::string_view::npos) {
+        return false;
+    }
+    size_t typeStart = line.rfind("type=", id);
+    if (typeStart == std::string_view::npos) {
+        return false;
+    }
+    typeStart += 5;
+    size_t typeEnd = line.find(' ', typeStart);
+    if (typeEnd == std::string_view::npos || typeEnd > id) {
+        return false;
+    }
+    type = line.substr(typeStart, typeEnd - typeStart);
+    size_t timeStart = id + sizeof(AUDIT_ID) - 1;
+    size_t colon = line.find(':', timeStart);
+    if (colon == std::string_view::npos) {
+        return false;
+    }
+    time = line.substr(timeStart, colon - timeStart);
+    size_t p = colon + 1;
+    serial = 0;
+    size_t digits = 0;
+    while (p < line.size() && line[p] >= '0' && line[p] <= '9') {
+        serial = serial * 10 + static_cast<uint64_t>(line[p] - '0');
+        p++;
+        digits++;
+    }
+    return digits > 0 && p < line.size() && line[p] == ')';
+}
+
+/**
+ * @brief Finds the table position holding a serial.
+ *
+ * @param serial The serial.
+ * @return The position, or SIZE_MAX if the serial has no open event.
+ */
+size_t AuditCorrelator::find(uint64_t serial) const {
+    size_t mask = table.size() - 1;
+    for (size_t position = home(serial);; position = (position + 1) & mask) {
+        uint32_t slot = table[position];
+        if (slot == NONE) {
+            return SIZE_MAX;
+        }
+        if (slots[slot].event.serial == serial) {
+            return position;
+        }
+    }
+}
+
+/**
+ * @brief Opens an event, completing the oldest one if the pool is full.
+ *
+ * @param serial The event's serial.
+ * @param time The event's time.
+ * @param now The current time.
+ * @param done Receives an evicted event.
+ * @return The event's slot.
+ */
+uint32_t AuditCorrelator::start(uint64_t serial, std::string_view time, int64_t now, std::vector<Event>& done) {
+    if (freeSlots == NONE) {
+        for (size_t step = 1; step <= wheel.size(); ++step) {
+            size_t bucket = static_cast<size_t>((currentTick + static_cast<int64_t>(step)) % static_cast<int64_t>(wheel.size()));
+            if (wheel[bucket] != NONE) {
+                // Buckets are pushed at the head, so the oldest event is at the tail
+                uint32_t oldest = wheel[bucket];
+                while (slots[oldest].next != NONE) {
+                    oldest = slots[oldest].next;
+                }
+                evicted.add();
+                complete(oldest, done);
+                break;
+            }
+        }
+    }
+    uint32_t slot = freeSlots;
+    Slot& entry = slots[slot];
+    freeSlots = entry.next;
+    entry.event.serial = serial;
+    entry.event.time.assign(time.data(), time.size());
+    entry.event.records.clear();
+    entry.event.origins.clear();
+    entry.deadline = tick(now) + windowTicks;
+    entry.bucket = static_cast<uint32_t>(entry.deadline % static_cast<int64_t>(wheel.size()));
+    entry.previous = NONE;
+    entry.next = wheel[entry.bucket];
+    if (entry.next != NONE) {
+        slots[entry.next].previous = slot;
+    }
+    wheel[entry.bucket] = slot;
+    size_t mask = table.size() - 1;
+    size_t position = home(serial);
+    while (table[position] != NONE) {
+        position = (position + 1) & mask;
+    }
+    table[position] = slot;
+    openEvents++;
+    return slot;
+}
+
+/**
+ * @brief Moves an open event to the completed events and frees its slot.
+ *
+ * @param slot The slot.
+ * @param done Receives the event.
+ */
+void AuditCorrelator::complete(uint32_t slot, std::vector<Event>& done) {
+    Slot& entry = slots[slot];
+    erase(entry.event.serial);
+    unlink(slot);
+    events.add();
+    done.push_back(std::move(entry.event));
+    entry.event = Event();
+    entry.next = freeSlots;
+    freeSlots = slot;
+    openEvents--;
+}
+
+/**
+ * @brief Removes a slot from its wheel bucket.
+ *
+ * @param slot The slot.
+ */
+void AuditCorrelator::unlink(uint32_t slot) {
+    Slot& entry = slots[slot];
+    if (entry.previous != NONE) {
+        slots[entry.previous].next = entry.next;
+    } else {
+        wheel[entry.bucket] = entry.next;
+    }
+    if (entry.next != NONE) {
+        slots[entry.next].previous = entry.previous;
+    }
+}
+
+/**
+ * @brief Removes a serial from the hash table, shifting later entries of its probe run back.
+ *
+ * @param serial The serial; must be in the table.
+ */
+void AuditCorrelator::erase(uint64_t serial) {
+    size_t mask = table.size() - 1;
+    size_t hole = find(serial);
+    size_t position = hole;
+    while (true) {
+        position = (position + 1) & mask;
+        uint32_t slot = table[position];
+        if (slot == NONE) {
+            break;
+        }
+        // Move the entry into the hole unless its home lies cyclically in (hole, position]
+        if (((position - home(slots[slot].event.serial)) & mask) >= ((position - hole) & mask)) {
+            table[hole] = slot;
+            hole = position;
+        }
+    }
+    table[hole] = NONE;
+}
+
+/**
+ * @brief Computes a serial's home position in the hash table.
+ *
+ * Serials are sequential, so they are scattered with a Fibonacci hash.
+ *
+ * @param serial The serial.
+ * @return The first position probed.
+ */
+size_t AuditCorrelator::home(uint64_t serial) const {
+    return static_cast<size_t>((serial * 0x9e3779b97f4a7c15ULL) >> 20) & (table.size() - 1);
+}
+
+/**
+ * @brief Converts a time to a wheel tick.
+ *
+ * @param now Steady-clock nanoseconds.
+ * @return The tick.
+ */
+int64_t AuditCorrelator::tick(int64_t now) const {
+    return now / (WHEEL_TICK_MS * 1000000);
+}
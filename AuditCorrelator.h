@@ -0,0 +1,172 @@
+#ifndef AUDITCORRELATOR_H
+#define AUDITCORRELATOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Metrics.h"
+
+
+/**
+ * @class AuditCorrelator
+ * @brief Groups the records of Linux audit events into one event each.
+ *
+ * auditd writes one event as several lines (SYSCALL, EXECVE, CWD, PATH,
+ * PROCTITLE, ...) that share a `msg=audit(SECONDS.MILLIS:SERIAL)` id and may
+ * interleave with the records of other events. Records are collected by
+ * serial until the event's EOE record arrives or its window expires,
+ * whichever comes first; single-record events have no EOE and always wait
+ * for the window.
+ *
+ * Open events live in a fixed pool indexed by an open-addressed hash table
+ * keyed on serial. Expiry uses a timer wheel of WHEEL_TICK_MS buckets, so
+ * advancing time costs one bucket per tick regardless of how many events are
+ * open. When the pool is full the oldest open event is completed early.
+ *
+ * Exported per file:
+ * - sparky_audit_records_total
+ * - sparky_audit_events_total
+ * - sparky_audit_evicted_total: events completed early because the table was full
+ *
+ * Not thread-safe; each monitor has its own correlator.
+ */
+class AuditCorrelator {
+public:
+    /// Width of a timer wheel bucket, in milliseconds.
+    static const int64_t WHEEL_TICK_MS = 50;
+
+    /**
+     * @brief Where a record came from, so its event can be traced and acknowledged.
+     */
+    struct Origin {
+        uint64_t endOffset; ///< Offset just past the record's line.
+        uint32_t lagGeneration; ///< Generation returned by LagTracker::track().
+        int64_t notified; ///< When the write was noticed, from LatencyTracker::now().
+        int64_t read; ///< When the record's chunk was read.
+    };
+
+    /**
+     * @brief A completed event.
+     */
+    struct Event {
+        uint64_t serial; ///< The audit serial number.
+        std::string time; ///< The event time as written, `SECONDS.MILLIS`.
+        std::string records; ///< The records' lines, each followed by '\n'.
+        std::vector<Origin> origins; ///< One per record, in file order.
+    };
+
+    /**
+     * @brief A field of a record.
+     */
+    struct Field {
+        std::string_view key; ///< The key.
+        std::string_view value; ///< The value, without quotes.
+        bool hex; ///< Whether the value is hex-encoded and needs decodeHex().
+    };
+
+    /**
+     * @brief Constructs a correlator.
+     * @param file Name of the file, used as the `file` metric label.
+     * @param windowMs How long an event waits for more records, in milliseconds.
+     * @param maxEvents Most events open at once.
+     * @throws std::invalid_argument If the window or the capacity is not positive.
+     */
+    AuditCorrelator(const std::string& file, int64_t windowMs, size_t maxEvents);
+
+    AuditCorrelator(const AuditCorrelator&) = delete;
+    AuditCorrelator& operator=(const AuditCorrelator&) = delete;
+
+    /**
+     * @brief Adds a line if it is an audit record.
+     * @param line The line.
+     * @param origin Where the line came from.
+     * @param now The current time, from LatencyTracker::now().
+     * @param done Receives events completed by this record or by the table being full.
+     * @return False if the line is not an audit record; it was not consumed.
+     */
+    bool add(std::string_view line, const Origin& origin, int64_t now, std::vector<Event>& done);
+
+    /**
+     * @brief Completes the events whose window has passed.
+     * @param now The current time, from LatencyTracker::now().
+     * @param done Receives the completed events, by expiry tick.
+     */
+    void expire(int64_t now, std::vector<Event>& done);
+
+    /**
+     * @brief Completes every open event.
+     * @param done Receives the events.
+     */
+    void flush(std::vector<Event>& done);
+
+    /**
+     * @brief Retrieves the number of open events.
+     * @return The count.
+     */
+    size_t open() const { return openEvents; }
+
+    /**
+     * @brief Tells whether a line is an audit record, which add() would consume.
+     * @param line The line.
+     * @return True if the line has a record type and an audit id.
+     */
+    static bool isRecord(std::string_view line);
+
+    /**
+     * @brief Splits a record into its type and fields.
+     *
+     * Values are bare, double-quoted or single-quoted. Unquoted values of
+     * fields auditd hex-encodes (proctitle, aN, name, cwd, exe, comm, path,
+     * data, cmd, key) are marked `hex` when they are hex digits.
+     *
+     * @param record The record's line.
+     * @param type Receives the record type, e.g. "SYSCALL".
+     * @param fields Receives the fields after the audit id.
+     * @return False if the line is not an audit record.
+     */
+    static bool fields(std::string_view record, std::string_view& type, std::vector<Field>& fields);
+
+    /**
+     * @brief Decodes a hex-encoded value. NUL bytes, which separate arguments, become spaces.
+     * @param hex The hex digits.
+     * @param out Receives the decoded text.
+     */
+    static void decodeHex(std::string_view hex, std::string& out);
+
+private:
+    /**
+     * @brief An open event.
+     */
+    struct Slot {
+        Event event; ///< The event collected so far.
+        int64_t deadline; ///< Wheel tick at which the event expires.
+        uint32_t next; ///< Next slot in the same wheel bucket or the free list.
+        uint32_t previous; ///< Previous slot in the same wheel bucket.
+        uint32_t bucket; ///< The wheel bucket holding the slot.
+    };
+
+    static bool parseId(std::string_view line, std::string_view& time, uint64_t& serial, std::string_view& type);
+
+    size_t find(uint64_t serial) const;
+    size_t home(uint64_t serial) const;
+    uint32_t start(uint64_t serial, std::string_view time, int64_t now, std::vector<Event>& done);
+    void complete(uint32_t slot, std::vector<Event>& done);
+    void unlink(uint32_t slot);
+    void erase(uint64_t serial);
+    int64_t tick(int64_t now) const;
+
+    int64_t windowTicks; ///< Window in wheel ticks.
+    std::vector<Slot> slots; ///< Event pool.
+    uint32_t freeSlots; ///< Head of the free list.
+    std::vector<uint32_t> table; ///< Slot index by hash of the serial, linear probing; UINT32_MAX if empty.
+    std::vector<uint32_t> wheel; ///< Head slot of each bucket; UINT32_MAX if empty.
+    int64_t currentTick; ///< Last tick expired.
+    size_t openEvents; ///< Slots in use.
+    Metrics::Counter& records; ///< sparky_audit_records_total
+    Metrics::Counter& events; ///< sparky_audit_events_total
+    Metrics::Counter& evicted; ///< sparky_audit_evicted_total
+};
+
+#endif
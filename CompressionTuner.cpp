@@ -0,0 +1,174 @@
+#include "CompressionTuner.h"
+
+namespace {
+
+/// Weight of the newest window in the smoothed estimates.
+const double SMOOTHING = 0.5;
+
+/// Throughputs within this fraction of the best are considered equal.
+const double THROUGHPUT_TOLERANCE = 0.05;
+
+/// A round trip time this many times the baseline means the network is congested.
+const double CONGESTED_RTT_FACTOR = 2.0;
+
+double smooth(double previous, double latest, bool first) {
+    return first ? latest : previous + SMOOTHING * (latest - previous);
+}
+
+} // namespace
+
+/**
+ * @brief Renders the codec as a metric label set.
+ *
+ * @return A label set such as `codec="zstd",level="3"`; the level is "default" when unset.
+ */
+std::string CompressionTuner::Codec::labels() const {
+    return "codec=\"" + name + "\",level=\"" + (level < 0 ? std::string("default") : std::to_string(level)) + "\"";
+}
+
+/**
+ * @brief Constructs a CompressionTuner.
+ *
+ * The tuner starts on the second-cheapest codec (lz4 with the defaults), which
+ * is rarely a bad choice, and explores from there.
+ *
+ * @param codecs Candidate codecs, ordered from cheapest to most expensive.
+ * @param cpuBudget CPU budget in cores.
+ * @param exploreEvery Number of windows spent on the chosen codec between explorations.
+ */
+CompressionTuner::CompressionTuner(const std::vector<Codec>& codecs, double cpuBudget, int exploreEvery)
+    : codecs(codecs), estimates(codecs.size()), cpuBudget(cpuBudget), exploreEvery(exploreEvery),
+      maxCodec(codecs.empty() ? 0 : codecs.size() - 1), currentIndex(codecs.size() > 1 ? 1 : 0) {}
+
+/**
+ * @brief The default candidate codecs, cheapest first.
+ *
+ * @return none, lz4, zstd level 1, zstd level 3 and zstd level 9.
+ */
+std::vector<CompressionTuner::Codec> CompressionTuner::defaultCodecs() {
+    return {{"none", -1}, {"lz4", -1}, {"zstd", 1}, {"zstd", 3}, {"zstd", 9}};
+}
+
+/**
+ * @brief Sets the CPU budget.
+ *
+ * @param cores CPU budget in cores (1.0 is one full core).
+ */
+void CompressionTuner::setCpuBudget(double cores) {
+    cpuBudget = cores;
+}
+
+/**
+ * @brief Limits the candidates to the cheapest maxIndex + 1 codecs.
+ *
+ * If the current codec is above the new limit the next record() call moves
+ * down to the best codec within it.
+ *
+ * @param maxIndex Index of the most expensive codec that may be chosen.
+ */
+void CompressionTuner::setMaxCodec(size_t maxIndex) {
+    maxCodec = maxIndex;
+}
+
+/**
+ * @brief The most expensive codec index that may currently be chosen.
+ */
+size_t CompressionTuner::limit() const {
+    return maxCodec < codecs.size() ? maxCodec : codecs.size() - 1;
+}
+
+/**
+ * @brief Picks the best codec from the current estimates.
+ *
+ * @return The index of the feasible codec with the highest throughput, with
+ *         near-ties broken by network congestion; the cheapest codec if none is feasible.
+ */
+size_t CompressionTuner::best() const {
+    double bestThroughput = -1;
+    for (size_t i = 0; i <= limit(); ++i) {
+        const Estimate& e = estimates[i];
+        if (e.measured && e.cpuFraction <= cpuBudget && e.eventsPerSecond > bestThroughput) {
+            bestThroughput = e.eventsPerSecond;
+        }
+    }
+    if (bestThroughput < 0) {
+        return 0;
+    }
+
+    bool congested = minRttMicros > 0 && estimates[currentIndex].rttMicros > CONGESTED_RTT_FACTOR * minRttMicros;
+    size_t chosen = 0;
+    bool found = false;
+    for (size_t i = 0; i <= limit(); ++i) {
+        const Estimate& e = estimates[i];
+        if (!e.measured || e.cpuFraction > cpuBudget || e.eventsPerSecond < (1.0 - THROUGHPUT_TOLERANCE) * bestThroughput) {
+            continue;
+        }
+        if (!found) {
+            chosen = i;
+            found = true;
+        } else if (congested ? e.compressionRatio > estimates[chosen].compressionRatio
+                             : e.cpuPerEvent < estimates[chosen].cpuPerEvent) {
+            chosen = i;
+        }
+    }
+    return chosen;
+}
+
+/**
+ * @brief Records a window measured with the current codec and picks the next codec.
+ *
+ * Windows without deliveries carry no information and leave the estimates
+ * untouched. A codec exceeding the CPU budget is abandoned immediately for the
+ * next cheaper one; otherwise the tuner stays on the best codec and every
+ * exploreEvery windows tries a neighbour, preferring neighbours that have not
+ * been measured yet.
+ *
+ * @param sample The measurements for the window that just ended.
+ * @return The index of the codec to use for the next window.
+ */
+size_t CompressionTuner::record(const Sample& sample) {
+    if (codecs.empty()) {
+        return 0;
+    }
+    if (sample.seconds > 0 && sample.eventsDelivered > 0) {
+        Estimate& e = estimates[currentIndex];
+        bool first = !e.measured;
+        e.eventsPerSecond = smooth(e.eventsPerSecond, sample.eventsDelivered / sample.seconds, first);
+        e.cpuFraction = smooth(e.cpuFraction, sample.cpuSeconds / sample.seconds, first);
+        e.cpuPerEvent = smooth(e.cpuPerEvent, sample.cpuSeconds / sample.eventsDelivered, first);
+        if (sample.wireBytes > 0) {
+            e.compressionRatio = smooth(e.compressionRatio, static_cast<double>(sample.messageBytes) / sample.wireBytes, first);
+        }
+        if (sample.rttMicros > 0) {
+            e.rttMicros = smooth(e.rttMicros, sample.rttMicros, first || e.rttMicros == 0);
+            if (minRttMicros == 0 || sample.rttMicros < minRttMicros) {
+                minRttMicros = sample.rttMicros;
+            }
+        }
+        e.measured = true;
+    }
+
+    if (exploring) {
+        exploring = false;
+        currentIndex = best();
+        windowsSinceExplore = 0;
+    } else if (currentIndex > limit() || (estimates[currentIndex].measured && estimates[currentIndex].cpuFraction > cpuBudget)) {
+        currentIndex = currentIndex > limit() ? limit() : (currentIndex > 0 ? currentIndex - 1 : 0);
+        windowsSinceExplore = 0;
+    } else if (++windowsSinceExplore >= exploreEvery) {
+        size_t down = currentIndex > 0 ? currentIndex - 1 : currentIndex;
+        size_t up = currentIndex < limit() ? currentIndex + 1 : currentIndex;
+        size_t next = exploreUp ? up : down;
+        if (!estimates[up].measured && up != currentIndex) {
+            next = up;
+        } else if (!estimates[down].measured && down != currentIndex) {
+            next = down;
+        }
+        exploreUp = !exploreUp;
+        if (next != currentIndex && estimates[currentIndex].measured) {
+            currentIndex = next;
+            exploring = true;
+        }
+    }
+    return currentIndex;
+}
@@ -0,0 +1,127 @@
+#ifndef COMPRESSIONTUNER_H
+#define COMPRESSIONTUNER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @class CompressionTuner
+ * @brief Chooses a Kafka compression codec from measured throughput, CPU and network cost.
+ *
+ * The tuner is fed one Sample per measurement window for the codec that was
+ * active during that window and answers which codec to use for the next one.
+ * It keeps a smoothed estimate per codec and mostly stays on the best feasible
+ * codec, periodically spending a window on a neighbouring codec to keep the
+ * estimates fresh as load and network conditions change.
+ *
+ * A codec is feasible when its CPU use stays within the budget. Among feasible
+ * codecs the one delivering the most events per second wins. Codecs within 5%
+ * of each other are treated as equal; ties are broken towards stronger
+ * compression when the broker round trip time shows the network is congested,
+ * and towards cheaper compression otherwise.
+ */
+class CompressionTuner {
+public:
+    /**
+     * @brief A librdkafka codec and compression level.
+     */
+    struct Codec {
+        std::string name; ///< Value for `compression.codec`.
+        int level;        ///< Value for `compression.level`, or -1 for the codec default.
+
+        /**
+         * @brief Renders the codec as a metric label set.
+         * @return A label set such as `codec="zstd",level="3"`.
+         */
+        std::string labels() const;
+    };
+
+    /**
+     * @brief Measurements taken over one window with a single codec active.
+     */
+    struct Sample {
+        double seconds = 0;          ///< Length of the window.
+        uint64_t eventsDelivered = 0; ///< Events acknowledged by the broker.
+        uint64_t messageBytes = 0;   ///< Uncompressed bytes handed to the producer.
+        uint64_t wireBytes = 0;      ///< Bytes actually sent to the brokers.
+        double cpuSeconds = 0;       ///< Producer CPU time (compression and I/O) spent during the window.
+        double rttMicros = 0;        ///< Average broker round trip time, or 0 if unknown.
+    };
+
+    /**
+     * @brief Smoothed measurements for one codec.
+     */
+    struct Estimate {
+        bool measured = false;       ///< Whether the codec has been measured at all.
+        double eventsPerSecond = 0;  ///< Delivered events per second.
+        double cpuFraction = 0;      ///< CPU seconds per wall second.
+        double cpuPerEvent = 0;      ///< CPU seconds per delivered event.
+        double compressionRatio = 1; ///< Uncompressed bytes per wire byte.
+        double rttMicros = 0;        ///< Broker round trip time.
+    };
+
+    /**
+     * @brief Constructs a CompressionTuner.
+     * @param codecs Candidate codecs, ordered from cheapest to most expensive.
+     * @param cpuBudget CPU budget in cores (1.0 is one full core).
+     * @param exploreEvery Number of windows spent on the chosen codec between explorations.
+     */
+    CompressionTuner(const std::vector<Codec>& codecs = defaultCodecs(), double cpuBudget = 1.0, int exploreEvery = 6);
+
+    /**
+     * @brief The default candidates: none, lz4, and zstd at levels 1, 3 and 9.
+     * @return The default codec list, cheapest first.
+     */
+    static std::vector<Codec> defaultCodecs();
+
+    /**
+     * @brief Records a window measured with the current codec and picks the next codec.
+     * @param sample The measurements for the window.
+     * @return The index of the codec to use for the next window.
+     */
+    size_t record(const Sample& sample);
+
+    /**
+     * @brief Sets the CPU budget.
+     * @param cores CPU budget in cores.
+     */
+    void setCpuBudget(double cores);
+
+    /**
+     * @brief Limits the candidates to the first maxIndex + 1 codecs.
+     * @param maxIndex Index of the most expensive codec that may be chosen.
+     */
+    void setMaxCodec(size_t maxIndex);
+
+    /// @return The index of the codec currently in use.
+    size_t current() const { return currentIndex; }
+
+    /// @return The number of candidate codecs.
+    size_t size() const { return codecs.size(); }
+
+    /// @return The candidate codec at the given index.
+    const Codec& codec(size_t index) const { return codecs[index]; }
+
+    /// @return The smoothed measurements of the codec at the given index.
+    const Estimate& estimate(size_t index) const { return estimates[index]; }
+
+private:
+    size_t best() const;
+    size_t limit() const;
+
+    std::vector<Codec> codecs; ///< Candidate codecs, cheapest first.
+    std::vector<Estimate> estimates; ///< Smoothed measurements per codec.
+    double cpuBudget; ///< CPU budget in cores.
+    int exploreEvery; ///< Windows between explorations.
+    size_t maxCodec; ///< Most expensive codec that may be chosen.
+    size_t currentIndex; ///< Codec in use for the current window.
+    bool exploring = false; ///< Whether the current window is an exploration.
+    bool exploreUp = true; ///< Direction of the next exploration.
+    int windowsSinceExplore = 0; ///< Windows on the chosen codec since the last exploration.
+    double minRttMicros = 0; ///< Lowest round trip time seen, the uncongested baseline.
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "CpuGovernor.h"
+#include "CompressionTuner.h"
+#include <sys/resource.h>          // Used for getrusage()
+#include <fstream>                 // Used for reading cgroup accounting files
+#include <sstream>                 // Used for splitting /proc/self/mountinfo lines
+#include <thread>                  // Used for std::this_thread::sleep_for
+#include <algorithm>               // Used for std::min and std::max
+
+namespace {
+
+/// Minimum time between CPU samples.
+const std::chrono::milliseconds SAMPLE_INTERVAL(1000);
+
+/// Below this utilization the governor relaxes its limits.
+const double RELAX_UTILIZATION = 0.7;
+
+/// Pacing delay used when first backing off.
+const int64_t MIN_PACING_DELAY_US = 1000;
+
+/// Longest pacing delay per chunk.
+const int64_t MAX_PACING_DELAY_US = 1000000;
+
+/// Largest number of messages between delivery report polls.
+const size_t MAX_BATCH_SIZE = 256;
+
+int64_t steadyNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Finds where a cgroup hierarchy is mounted, from /proc/self/mountinfo.
+ *
+ * @param fsType "cgroup2", or "cgroup" for a v1 hierarchy.
+ * @param controller For v1, a controller the hierarchy must have (e.g. "cpuacct"); empty for v2.
+ * @param root Receives the cgroup mounted there; not "/" when the mount shows only part of the hierarchy.
+ * @return The mount point, or empty if the hierarchy is not mounted.
+ */
+std::string cgroupMount(const std::string& fsType, const std::string& controller, std::string& root) {
+    std::ifstream mounts("/proc/self/mountinfo");
+    std::string line;
+    while (std::getline(mounts, line)) {
+        // ID parent major:minor root mount-point options [optional...] - type source super-options
+        size_t separator = line.find(" - ");
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::istringstream before(line.substr(0, separator));
+        std::istringstream after(line.substr(separator + 3));
+        std::string id, parent, device, mountRoot, mountPoint, type, source, options;
+        if (!(before >> id >> parent >> device >> mountRoot >> mountPoint) || !(after >> type >> source >> options) || type != fsType) {
+            continue;
+        }
+        if (!controller.empty() && ("," + options + ",").find("," + controller + ",") == std::string::npos) {
+            continue;
+        }
+        root = mountRoot;
+        return mountPoint;
+    }
+    return std::string();
+}
+
+/**
+ * @brief Resolves the directory of this process's own cgroup.
+ *
+ * The cgroup is the v2 `0::<path>` line of /proc/self/cgroup, or the v1 line
+ * whose controllers include the given one; its path is relative to the root
+ * of the hierarchy, which is mounted somewhere below it.
+ *
+ * @param controller Empty for cgroup v2, otherwise the v1 controller (e.g. "cpuacct").
+ * @return The directory, or empty if the cgroup cannot be resolved.
+ */
+std::string cgroupDirectory(const std::string& controller) {
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line)) {
+        // hierarchy-ID:controller-list:path
+        size_t first = line.find(':');
+        size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+        if (second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        bool match = controller.empty() ? line.compare(0, first, "0") == 0 && controllers.empty()
+                                        : ("," + controllers + ",").find("," + controller + ",") != std::string::npos;
+        if (!match) {
+            continue;
+        }
+        std::string path = line.substr(second + 1);
+        std::string root;
+        std::string mount = cgroupMount(controller.empty() ? "cgroup2" : "cgroup", controller, root);
+        if (mount.empty()) {
+            return std::string();
+        }
+        if (root != "/") {
+            // Only the part of the hierarchy below root is visible
+            if (path.compare(0, root.size(), root) != 0 || (path.size() > root.size() && path[root.size()] != '/')) {
+                return std::string();
+            }
+            path.erase(0, root.size());
+        }
+        return path == "/" ? mount : mount + path;
+    }
+    return std::string();
+}
+
+} // namespace
+
+/**
+ * @brief Retrieves the process-wide governor.
+ *
+ * @return The governor, disabled until setBudget() is called.
+ */
+CpuGovernor& CpuGovernor::instance() {
+    static CpuGovernor governor;
+    return governor;
+}
+
+/**
+ * @brief Constructs a disabled governor with relaxed limits.
+ */
+CpuGovernor::CpuGovernor()
+    : budgetCores(0), source(Source::PROCESS), pacingDelayMicros(0), currentBatchSize(1),
+      currentMaxCodec(CompressionTuner::defaultCodecs().size() - 1), backlogBytes(0),
+      lastSampleNanos(steadyNanos()), lastCpuSeconds(processCpuSeconds()),
+      budgetGauge(Metrics::instance().gauge("sparky_cpu_budget_cores")),
+      utilizationGauge(Metrics::instance().gauge("sparky_cpu_budget_utilization")),
+      pacingGauge(Metrics::instance().gauge("sparky_cpu_pacing_delay_microseconds")),
+      batchGauge(Metrics::instance().gauge("sparky_cpu_batch_size")),
+      codecGauge(Metrics::instance().gauge("sparky_cpu_max_codec")),
+      backlogGauge(Metrics::instance().gauge("sparky_cpu_deferred_backlog_bytes")) {
+    batchGauge.set(1);
+    codecGauge.set(static_cast<double>(currentMaxCodec.load()));
+}
+
+/**
+ * @brief Sets the CPU budget.
+ *
+ * Setting a budget of 0 disables the governor and immediately relaxes all of
+ * its limits.
+ *
+ * @param cores Budget in cores; 0 disables the governor.
+ * @param newSource Where CPU usage is read from. CGROUP falls back to PROCESS
+ *        if no cgroup accounting file can be read.
+ */
+void CpuGovernor::setBudget(double cores, Source newSource) {
+    std::lock_guard<std::mutex> lock(sampleMutex);
+    if (newSource == Source::CGROUP && cgroupCpuSeconds() < 0) {
+        newSource = Source::PROCESS;
+    }
+    source.store(newSource);
+    budgetCores.store(cores);
+    budgetGauge.set(cores);
+    if (cores <= 0) {
+        pacingDelayMicros.store(0);
+        currentBatchSize.store(1);
+        currentMaxCodec.store(CompressionTuner::defaultCodecs().size() - 1);
+    }
+    lastSampleNanos.store(steadyNanos());
+    lastCpuSeconds = cpuSeconds();
+}
+
+/**
+ * @brief Samples CPU usage if due, then sleeps for the current pacing delay.
+ *
+ * Only one thread samples at a time; others skip the sample and just pace.
+ */
+void CpuGovernor::pace() {
+    if (budgetCores.load(std::memory_order_relaxed) <= 0) {
+        return;
+    }
+    const int64_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(SAMPLE_INTERVAL).count();
+    if (steadyNanos() - lastSampleNanos.load(std::memory_order_relaxed) >= interval) {
+        std::unique_lock<std::mutex> lock(sampleMutex, std::try_to_lock);
+        if (lock.owns_lock() && steadyNanos() - lastSampleNanos.load() >= interval) {
+            sample();
+        }
+    }
+    int64_t delay = pacingDelayMicros.load(std::memory_order_relaxed);
+    if (delay > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+    }
+}
+
+/**
+ * @brief Measures utilization of the budget since the last sample and adjusts the limits.
+ *
+ * Over budget, every knob tightens at once: the pacing delay doubles, the
+ * batch size doubles and the codec limit drops by one. Under 70% of the
+ * budget the knobs relax one at a time, pacing first since it costs the most
+ * throughput, then batching, then compression.
+ *
+ * Must be called with sampleMutex held.
+ */
+void CpuGovernor::sample() {
+    int64_t now = steadyNanos();
+    double cpu = cpuSeconds();
+    double wall = (now - lastSampleNanos.load()) / 1e9;
+    double budget = budgetCores.load();
+    double utilization = (cpu - lastCpuSeconds) / (wall * budget);
+    lastSampleNanos.store(now);
+    lastCpuSeconds = cpu;
+
+    int64_t delay = pacingDelayMicros.load();
+    size_t batch = currentBatchSize.load();
+    size_t codec = currentMaxCodec.load();
+    if (utilization > 1.0) {
+        delay = std::min(MAX_PACING_DELAY_US, std::max(MIN_PACING_DELAY_US, delay * 2));
+        batch = std::min(MAX_BATCH_SIZE, batch * 2);
+        codec = codec > 0 ? codec - 1 : 0;
+    } else if (utilization < RELAX_UTILIZATION) {
+        if (delay > 0) {
+            delay = delay / 2 < MIN_PACING_DELAY_US ? 0 : delay / 2;
+        } else if (batch > 1) {
+            batch /= 2;
+        } else if (codec + 1 < CompressionTuner::defaultCodecs().size()) {
+            codec++;
+        }
+    }
+    pacingDelayMicros.store(delay);
+    currentBatchSize.store(batch);
+    currentMaxCodec.store(codec);
+
+    utilizationGauge.set(utilization);
+    pacingGauge.set(static_cast<double>(delay));
+    batchGauge.set(static_cast<double>(batch));
+    codecGauge.set(static_cast<double>(codec));
+}
+
+/**
+ * @brief Records a change in the number of unread bytes in monitored files.
+ *
+ * @param delta Change in backlog bytes.
+ */
+void CpuGovernor::addBacklog(int64_t delta) {
+    backlogGauge.set(static_cast<double>(backlogBytes.fetch_add(delta) + delta));
+}
+
+/**
+ * @brief Reads CPU time from the configured source.
+ *
+ * @return CPU time in seconds.
+ */
+double CpuGovernor::cpuSeconds() const {
+    if (source.load() == Source::CGROUP) {
+        double seconds = cgroupCpuSeconds();
+        if (seconds >= 0) {
+            return seconds;
+        }
+    }
+    return processCpuSeconds();
+}
+
+/**
+ * @brief Retrieves the CPU time (user + system) consumed by this process so far.
+ *
+ * @return CPU time in seconds.
+ */
+double CpuGovernor::processCpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * @brief Retrieves the CPU time consumed by this process's cgroup so far.
+ *
+ * The cgroup is resolved once from /proc/self/cgroup and /proc/self/mountinfo,
+ * so it is the process's own cgroup even where `/sys/fs/cgroup` is the
+ * hierarchy root, e.g. on a host or in a container without a cgroup
+ * namespace. Reads `usage_usec` from its cgroup v2 `cpu.stat`, or
+ * `cpuacct.usage` (nanoseconds) from its cgroup v1 `cpuacct` hierarchy.
+ *
+ * @return CPU time in seconds, or -1 if the cgroup or its accounting file cannot be read.
+ */
+double CpuGovernor::cgroupCpuSeconds() {
+    static const std::string v2Directory = cgroupDirectory("");
+    static const std::string v1Directory = cgroupDirectory("cpuacct");
+    uint64_t value;
+    if (!v2Directory.empty()) {
+        std::ifstream v2(v2Directory + "/cpu.stat");
+        std::string key;
+        while (v2 >> key >> value) {
+            if (key == "usage_usec") {
+                return value / 1e6;
+            }
+        }
+    }
+    if (!v1Directory.empty()) {
+        std::ifstream v1(v1Directory + "/cpuacct.usage");
+        if (v1 >> value) {
+            return value / 1e9;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,117 @@
+#ifndef CPUGOVERNOR_H
+#define CPUGOVERNOR_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "Metrics.h"
+
+
+/**
+ * @class CpuGovernor
+ * @brief Keeps the forwarder's own CPU use under a configured budget.
+ *
+ * The governor periodically samples CPU time consumed, either by this process
+ * (getrusage) or by its own cgroup as listed in /proc/self/cgroup (cgroup v2
+ * `cpu.stat`, falling back to v1 `cpuacct.usage`), and compares it with the
+ * budget. Over budget it backs off
+ * multiplicatively: readers sleep longer between chunks, delivery reports are
+ * served in larger batches and the most expensive compression codecs are ruled
+ * out. Comfortably under budget it relaxes the same knobs again, so the
+ * forwarder runs as fast as the budget allows.
+ *
+ * Readers call pace() between chunks; sampling happens inside pace() on
+ * whichever thread gets there first once the sample interval has elapsed.
+ */
+class CpuGovernor {
+public:
+    /**
+     * @brief Where CPU usage is read from.
+     */
+    enum class Source {
+        PROCESS, ///< getrusage(RUSAGE_SELF) for this process.
+        CGROUP   ///< The cgroup this process runs in; PROCESS if it cannot be resolved.
+    };
+
+    /**
+     * @brief Retrieves the process-wide governor.
+     * @return The governor, disabled until a budget is set.
+     */
+    static CpuGovernor& instance();
+
+    /**
+     * @brief Sets the CPU budget.
+     * @param cores Budget in cores (0.05 is 5% of one core); 0 disables the governor.
+     * @param source Where CPU usage is read from.
+     */
+    void setBudget(double cores, Source source = Source::PROCESS);
+
+    /**
+     * @brief Samples CPU usage if due and sleeps for the current pacing delay.
+     */
+    void pace();
+
+    /**
+     * @brief Number of messages to produce between serving delivery reports.
+     * @return The batch size, 1 when the governor is idle.
+     */
+    size_t batchSize() const { return currentBatchSize.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Index of the most expensive compression codec allowed.
+     * @return The codec index limit for KafkaSink::setMaxCodec().
+     */
+    size_t maxCodec() const { return currentMaxCodec.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief The CPU budget.
+     * @return Budget in cores; 0 if disabled.
+     */
+    double budget() const { return budgetCores.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Records a change in the number of bytes waiting unread in monitored files.
+     * @param delta Change in backlog bytes, positive or negative.
+     */
+    void addBacklog(int64_t delta);
+
+    /**
+     * @brief Retrieves the CPU time consumed by this process so far.
+     * @return CPU time (user + system) in seconds.
+     */
+    static double processCpuSeconds();
+
+    /**
+     * @brief Retrieves the CPU time consumed by this process's cgroup so far.
+     * @return CPU time in seconds, or a negative value if no cgroup accounting is available.
+     */
+    static double cgroupCpuSeconds();
+
+private:
+    CpuGovernor();
+
+    void sample();
+    double cpuSeconds() const;
+
+    std::mutex sampleMutex; ///< Held by the thread taking a sample.
+    std::atomic<double> budgetCores; ///< Budget in cores; 0 if disabled.
+    std::atomic<Source> source; ///< Where CPU usage is read from.
+    std::atomic<int64_t> pacingDelayMicros; ///< Sleep per pace() call.
+    std::atomic<size_t> currentBatchSize; ///< Messages between delivery report polls.
+    std::atomic<size_t> currentMaxCodec; ///< Most expensive codec allowed.
+    std::atomic<int64_t> backlogBytes; ///< Unread bytes in monitored files.
+    std::atomic<int64_t> lastSampleNanos; ///< Steady-clock time of the last sample, in nanoseconds.
+    double lastCpuSeconds; ///< CPU time at the last sample.
+
+    Metrics::Gauge& budgetGauge; ///< sparky_cpu_budget_cores
+    Metrics::Gauge& utilizationGauge; ///< sparky_cpu_budget_utilization
+    Metrics::Gauge& pacingGauge; ///< sparky_cpu_pacing_delay_microseconds
+    Metrics::Gauge& batchGauge; ///< sparky_cpu_batch_size
+    Metrics::Gauge& codecGauge; ///< sparky_cpu_max_codec
+    Metrics::Gauge& backlogGauge; ///< sparky_cpu_deferred_backlog_bytes
+};
+
+#endif
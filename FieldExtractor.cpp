@@ -0,0 +1,201 @@
+#include "FieldExtractor.h"
+#include <stdexcept>               // Used for std::runtime_error
+#include <algorithm>               // Used for std::max and std::binary_search
+
+FieldExtractor::FieldExtractor() = default;
+
+FieldExtractor::~FieldExtractor() = default;
+
+/**
+ * @brief Compiles a pattern and adds it to a sourcetype.
+ *
+ * @param sourcetype The sourcetype.
+ * @param pattern RE2 pattern with named groups.
+ *
+ * The pattern is compiled by the sourcetype's prefilter, which keeps it.
+ *
+ * @throws std::runtime_error If the pattern does not compile or the extractor was compiled.
+ */
+void FieldExtractor::addPattern(const std::string& sourcetype, const std::string& pattern) {
+    std::unique_ptr<PatternPrefilter>& prefilter = prefilters[sourcetype];
+    if (!prefilter) {
+        prefilter.reset(new PatternPrefilter());
+    }
+    Pattern compiledPattern;
+    try {
+        compiledPattern.regex = &prefilter->pattern(prefilter->add(pattern));
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("Sourcetype " + sourcetype + ": " + e.what());
+    }
+    bind(compiledPattern);
+    sourcetypes[sourcetype].push_back(compiled.size());
+    compiled.push_back(std::move(compiledPattern));
+}
+
+/**
+ * @brief Compiles every sourcetype's prefilter.
+ */
+void FieldExtractor::compile() {
+    for (auto& prefilter : prefilters) {
+        prefilter.second->compile();
+    }
+}
+
+/**
+ * @brief Declares a field as referenced and binds it in every pattern that captures it.
+ *
+ * @param field The field name.
+ * @return The field's index; the existing index if it was already referenced.
+ */
+size_t FieldExtractor::reference(const std::string& field) {
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (fields[i] == field) {
+            return i;
+        }
+    }
+    fields.push_back(field);
+    for (Pattern& pattern : compiled) {
+        bind(pattern);
+    }
+    return fields.size() - 1;
+}
+
+/**
+ * @brief Works out which of a pattern's groups are referenced fields.
+ *
+ * Only as many submatches as the highest referenced group are requested when
+ * matching, so unreferenced trailing groups cost nothing, and a pattern
+ * without referenced groups is skipped altogether.
+ *
+ * @param pattern The pattern.
+ */
+void FieldExtractor::bind(Pattern& pattern) {
+    pattern.captures.clear();
+    pattern.submatches = 0;
+    const std::map<std::string, int>& groups = pattern.regex->NamedCapturingGroups();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        auto it = groups.find(fields[i]);
+        if (it != groups.end()) {
+            pattern.captures.emplace_back(i, it->second);
+            pattern.submatches = std::max(pattern.submatches, it->second + 1);
+        }
+    }
+}
+
+/**
+ * @brief Binds a view to a sourcetype and sizes its scratch space.
+ *
+ * @param extractor The configured extractor.
+ * @param sourcetype The sourcetype of the lines to be extracted.
+ */
+FieldExtractor::Fields::Fields(const FieldExtractor& extractor, const std::string& sourcetype)
+    : extractor(extractor), patterns(nullptr), prefilter(nullptr), filtered(false), evaluations(0) {
+    auto it = extractor.sourcetypes.find(sourcetype);
+    if (it != extractor.sourcetypes.end()) {
+        patterns = &it->second;
+        prefilter = extractor.prefilters.at(sourcetype).get();
+        ran.assign(patterns->size(), false);
+        candidates.reserve(patterns->size());
+    }
+    int submatchCount = 0;
+    for (const Pattern& pattern : extractor.compiled) {
+        submatchCount = std::max(submatchCount, pattern.submatches);
+    }
+    submatches.resize(static_cast<size_t>(submatchCount));
+    resolved.assign(extractor.fields.size(), false);
+    values.assign(extractor.fields.size(), std::string_view());
+}
+
+FieldExtractor::Fields::~Fields() = default;
+
+/**
+ * @brief Forgets the previous line's matches.
+ *
+ * @param line The new line; values returned later point into it.
+ */
+void FieldExtractor::Fields::reset(std::string_view line) {
+    this->line = line;
+    std::fill(ran.begin(), ran.end(), false);
+    std::fill(resolved.begin(), resolved.end(), false);
+    std::fill(values.begin(), values.end(), std::string_view());
+    filtered = false;
+    evaluations = 0;
+}
+
+/**
+ * @brief Retrieves a field, running the sourcetype's patterns that capture it, in order, until one yields it.
+ *
+ * @param field The field's index.
+ * @param value Receives the value.
+ * @return False if no pattern matched the field.
+ */
+bool FieldExtractor::Fields::get(size_t field, std::string_view& value) {
+    if (field >= resolved.size()) {
+        return false;
+    }
+    if (!resolved[field]) {
+        resolved[field] = true;
+        for (size_t i = 0; patterns && i < patterns->size() && values[field].data() == nullptr; ++i) {
+            if (ran[i]) {
+                continue;
+            }
+            const Pattern& pattern = extractor.compiled[(*patterns)[i]];
+            for (const auto& capture : pattern.captures) {
+                if (capture.first == field) {
+                    run(i);
+                    break;
+                }
+            }
+        }
+    }
+    value = values[field];
+    return value.data() != nullptr;
+}
+
+/**
+ * @brief Retrieves a field by name.
+ *
+ * @param field The field name.
+ * @param value Receives the value.
+ * @return False if the field was never referenced or did not match.
+ */
+bool FieldExtractor::Fields::get(const std::string& field, std::string_view& value) {
+    for (size_t i = 0; i < extractor.fields.size(); ++i) {
+        if (extractor.fields[i] == field) {
+            return get(i, value);
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Runs one of the sourcetype's patterns and records every referenced field it captures.
+ *
+ * The first call for a line has the prefilter find the patterns that can
+ * match it; a pattern ruled out is skipped. Fields already found by an
+ * earlier pattern are kept.
+ *
+ * @param index Position of the pattern in the sourcetype's list.
+ */
+void FieldExtractor::Fields::run(size_t index) {
+    ran[index] = true;
+    if (!filtered) {
+        prefilter->candidates(line, scratch, candidates);
+        filtered = true;
+    }
+    if (!std::binary_search(candidates.begin(), candidates.end(), static_cast<int>(index))) {
+        return;
+    }
+    evaluations++;
+    const Pattern& pattern = extractor.compiled[(*patterns)[index]];
+    re2::StringPiece text(line.data(), line.size());
+    if (!pattern.regex->Match(text, 0, text.size(), RE2::UNANCHORED, submatches.data(), pattern.submatches)) {
+        return;
+    }
+    for (const auto& capture : pattern.captures) {
+        const re2::StringPiece& group = submatches[static_cast<size_t>(capture.second)];
+        if (group.data() != nullptr && values[capture.first].data() == nullptr) {
+            values[capture.first] = std::string_view(group.data(), group.size());
+        }
+    }
+}
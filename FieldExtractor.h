@@ -0,0 +1,159 @@
+#ifndef FIELDEXTRACTOR_H
+#define FIELDEXTRACTOR_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstddef>
+#include "PatternPrefilter.h"
+
+
+/**
+ * @class FieldExtractor
+ * @brief Extracts named fields from lines with per-sourcetype regexes compiled once with RE2.
+ *
+ * Patterns use RE2 syntax with named groups, e.g.
+ * `Failed password for (?P<user>\S+) from (?P<src_ip>[\d.]+)`. RE2 matches in
+ * linear time and uses a DFA to find matches, falling back to slower engines
+ * only for the submatches that were asked for.
+ *
+ * Only fields declared with reference() are ever extracted; other groups in
+ * a pattern are ignored, and a pattern without referenced groups is never
+ * run. Extraction is lazy: a Fields view runs a pattern the first time one of
+ * its fields is asked for, so a line whose routing or filter only needs one
+ * field pays for one regex.
+ *
+ * After compile(), each sourcetype's patterns are prefiltered: the first time
+ * a line needs a pattern, one Aho-Corasick scan finds which of the
+ * sourcetype's patterns can match at all, and the others are never run.
+ *
+ * Configure the extractor and compile() it before use; it may then be shared
+ * by any number of threads, each with its own Fields.
+ */
+class FieldExtractor {
+public:
+    FieldExtractor();
+    ~FieldExtractor();
+
+    FieldExtractor(const FieldExtractor&) = delete;
+    FieldExtractor& operator=(const FieldExtractor&) = delete;
+
+    /**
+     * @brief Adds a pattern for a sourcetype. Patterns are tried in the order added.
+     * @param sourcetype The sourcetype, e.g. "sshd".
+     * @param pattern RE2 pattern whose named groups are fields.
+     * @throws std::runtime_error If the pattern does not compile or the extractor was compiled.
+     */
+    void addPattern(const std::string& sourcetype, const std::string& pattern);
+
+    /**
+     * @brief Builds the per-sourcetype prefilters. Call after the last addPattern();
+     *        without it every pattern providing a field is run.
+     */
+    void compile();
+
+    /**
+     * @brief Declares a field as used by routing, filtering or output.
+     * @param field The field name.
+     * @return The field's index, for Fields::get(size_t, ...).
+     */
+    size_t reference(const std::string& field);
+
+    /**
+     * @brief Retrieves the referenced fields.
+     * @return Field names, indexed as returned by reference().
+     */
+    const std::vector<std::string>& referencedFields() const { return fields; }
+
+    /**
+     * @class Fields
+     * @brief Lazily extracted fields of one line at a time.
+     *
+     * Values point into the line, which must stay valid until the next
+     * reset(). Reusing one Fields for many lines allocates nothing per line.
+     */
+    class Fields {
+    public:
+        /**
+         * @brief Binds a view to a sourcetype's patterns.
+         * @param extractor The extractor; must outlive the view and not change afterwards.
+         * @param sourcetype The sourcetype; an unknown one yields no fields.
+         */
+        Fields(const FieldExtractor& extractor, const std::string& sourcetype);
+        ~Fields();
+
+        Fields(const Fields&) = delete;
+        Fields& operator=(const Fields&) = delete;
+
+        /**
+         * @brief Starts on a new line; nothing is matched until a field is asked for.
+         * @param line The line.
+         */
+        void reset(std::string_view line);
+
+        /**
+         * @brief Retrieves a field by index, running the patterns that provide it if needed.
+         * @param field Index returned by FieldExtractor::reference().
+         * @param value Receives the value.
+         * @return False if no pattern matched the field.
+         */
+        bool get(size_t field, std::string_view& value);
+
+        /**
+         * @brief Retrieves a field by name.
+         * @param field The field name; must have been referenced.
+         * @param value Receives the value.
+         * @return False if the field is unknown or no pattern matched it.
+         */
+        bool get(const std::string& field, std::string_view& value);
+
+        /**
+         * @brief Retrieves the number of patterns run for the current line, not counting those the prefilter ruled out.
+         * @return The count.
+         */
+        size_t evaluated() const { return evaluations; }
+
+        /**
+         * @brief Retrieves the extractor's referenced fields.
+         * @return Field names, indexed as for get(size_t, ...).
+         */
+        const std::vector<std::string>& extractorFields() const { return extractor.fields; }
+
+    private:
+        void run(size_t pattern);
+
+        const FieldExtractor& extractor; ///< The extractor.
+        const std::vector<size_t>* patterns; ///< Indexes of the sourcetype's patterns, or null.
+        const PatternPrefilter* prefilter; ///< The sourcetype's prefilter, or null.
+        PatternPrefilter::Scratch scratch; ///< Working memory of the prefilter.
+        std::vector<int> candidates; ///< Positions in patterns that may match the line.
+        bool filtered; ///< Whether candidates were found for the line.
+        std::string_view line; ///< The current line.
+        std::vector<bool> ran; ///< Whether each of the sourcetype's patterns was run on the line.
+        std::vector<bool> resolved; ///< Whether each field was looked for on the line.
+        std::vector<std::string_view> values; ///< Value of each field; null data if absent.
+        std::vector<re2::StringPiece> submatches; ///< Scratch space for matching.
+        size_t evaluations; ///< Patterns run on the current line.
+    };
+
+private:
+    /**
+     * @brief A compiled pattern and the referenced fields it captures.
+     */
+    struct Pattern {
+        const re2::RE2* regex; ///< The compiled pattern, owned by the sourcetype's prefilter.
+        std::vector<std::pair<size_t, int>> captures; ///< (field index, group number) of each referenced group.
+        int submatches; ///< Submatches needed: the highest captured group number plus one, or 0.
+    };
+
+    void bind(Pattern& pattern);
+
+    std::vector<Pattern> compiled; ///< All patterns.
+    std::map<std::string, std::vector<size_t>> sourcetypes; ///< Pattern indexes by sourcetype.
+    std::map<std::string, std::unique_ptr<PatternPrefilter>> prefilters; ///< Compiled patterns by sourcetype.
+    std::vector<std::string> fields; ///< Referenced fields.
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "FileMonitor.h"
+#include "Probes.h"
+#include "AllocationAccounting.h"
+#include "JsonEscape.h"
 #include <librdkafka/rdkafkacpp.h> // Used for Kafka producer
 #include <sys/inotify.h>           // Used for inotify functions
 #include <unistd.h>                // Used for close()
+#include <poll.h>                  // Used for poll()
 #include <stdexcept>               // Used for std::runtime_error
 #include <cstring>                 // Used for strerror()
 #include <sstream>                 // Used for std::ostringstream
@@ -10,6 +14,18 @@
 #include <fstream>                 // Used for std::ifstream
 #include <errno.h>                 // Used for errno
 #include <chrono>                  // Used for timestamp generation
+#include <cstdio>                  // Used for std::snprintf
+#include <cstdint>                 // Used for uint64_t
+#include <ctime>                   // Used for localtime_r() and std::strftime
+#include <limits.h>                // Used for HOST_NAME_MAX
+#include <thread>                  // Used for std::this_thread::sleep_for
+
+namespace {
+
+/// How long the reader backs off when its producer queue is full.
+const std::chrono::milliseconds QUEUE_FULL_BACKOFF(1);
+
+} // namespace
 
 /**
  * @brief Constructs a FileMonitor object to monitor a file for modifications and send events to a Kafka topic.
@@ -17,28 +33,77 @@
  * @param filePath The path of the file to monitor for modifications.
  * @param kafkaBroker The Kafka broker address to connect to.
  * @param kafkaTopic The Kafka topic to which file modification events will be sent.
+ * @param producerConfig Additional librdkafka properties for the producer, e.g.
+ *        `test.mock.num.brokers` to run against librdkafka's in-process mock cluster.
  * 
  * @throws std::runtime_error If Kafka producer initialization fails or inotify setup fails.
  * 
- * This constructor initializes the Kafka producer with the specified broker and topic,
+ * This constructor initializes the Kafka sink with the specified broker and topic,
  * and sets up inotify to monitor the specified file for modifications. If any of these
  * steps fail, an exception is thrown with an appropriate error message.
  */
-FileMonitor::FileMonitor(const std::string& filePath, const std::string& kafkaBroker, const std::string& kafkaTopic)
-    : filePath(filePath), kafkaBroker(kafkaBroker), kafkaTopic(kafkaTopic) {
-    // Initialize Kafka producer
-    std::string errstr;
-    RdKafka::Conf* conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
-    if (conf->set("bootstrap.servers", kafkaBroker, errstr) != RdKafka::Conf::CONF_OK) {
-        throw std::runtime_error("Failed to set Kafka broker: " + errstr);
-    }
-    producer = RdKafka::Producer::create(conf, errstr);
-    if (!producer) {
-        throw std::runtime_error("Failed to create Kafka producer: " + errstr);
-    }
-    delete conf;
+FileMonitor::FileMonitor(const std::string& filePath, const std::string& kafkaBroker, const std::string& kafkaTopic,
+                         const std::map<std::string, std::string>& producerConfig)
+    : filePath(filePath), kafkaBroker(kafkaBroker), kafkaTopic(kafkaTopic),
+      sink(new KafkaSink(kafkaBroker, kafkaTopic, filePath, producerConfig)), scheduler(nullptr),
+      priority(LaneScheduler::NORMAL), running(true), templateMining(false),
+      limiter("file:" + filePath, &RateLimiter::pipeline("default")), latency(filePath), lag(filePath),
+      healthReporter(nullptr), capture(nullptr), sampler(nullptr), accessEncoding(AccessLogBatch::JSON), accessBatchRows(1024),
+      linesRead(Metrics::instance().counter("sparky_lines_read_total", Metrics::label("file", filePath))),
+      bytesRead(Metrics::instance().counter("sparky_bytes_read_total", Metrics::label("file", filePath))),
+      linesDropped(Metrics::instance().counter("sparky_lines_dropped_total", Metrics::label("file", filePath))),
+      jsonInvalid(Metrics::instance().counter("sparky_json_invalid_total", Metrics::label("file", filePath))),
+      parseFailed(Metrics::instance().counter("sparky_parse_failed_total", Metrics::label("file", filePath))),
+      syslogInvalid(Metrics::instance().counter("sparky_syslog_invalid_total", Metrics::label("file", filePath))),
+      timestampMissing(Metrics::instance().counter("sparky_timestamp_missing_total", Metrics::label("file", filePath))),
+      accessInvalid(Metrics::instance().counter("sparky_access_invalid_total", Metrics::label("file", filePath))),
+      lagBytes(Metrics::instance().gauge("sparky_file_lag_bytes", Metrics::label("file", filePath))),
+      fileSizeBytes(Metrics::instance().gauge("sparky_file_size_bytes", Metrics::label("file", filePath))),
+      readOffsetBytes(Metrics::instance().gauge("sparky_file_read_offset_bytes", Metrics::label("file", filePath))), readOffset(0),
+      lineEndOffset(0), reportedBacklog(0), unpolled(0) {
+    initInotify();
+    registerStats();
+}
+
+/**
+ * @brief Constructs a FileMonitor that sends through a priority lane.
+ *
+ * @param filePath The path of the file to monitor for modifications.
+ * @param scheduler The shared lane scheduler; messages go to its topic.
+ * @param priority The lane used for this file, e.g. CRITICAL for auth logs.
+ *
+ * @throws std::runtime_error If inotify setup fails.
+ *
+ * No producer is created; batching, compression and delivery are handled by
+ * the scheduler's per-lane sinks.
+ */
+FileMonitor::FileMonitor(const std::string& filePath, LaneScheduler& scheduler, LaneScheduler::Priority priority)
+    : filePath(filePath), kafkaTopic(scheduler.topic()), scheduler(&scheduler),
+      priority(priority), running(true), templateMining(false),
+      limiter("file:" + filePath, &RateLimiter::pipeline("default")), latency(filePath), lag(filePath),
+      healthReporter(nullptr), capture(nullptr), sampler(nullptr), accessEncoding(AccessLogBatch::JSON), accessBatchRows(1024),
+      linesRead(Metrics::instance().counter("sparky_lines_read_total", Metrics::label("file", filePath))),
+      bytesRead(Metrics::instance().counter("sparky_bytes_read_total", Metrics::label("file", filePath))),
+      linesDropped(Metrics::instance().counter("sparky_lines_dropped_total", Metrics::label("file", filePath))),
+      jsonInvalid(Metrics::instance().counter("sparky_json_invalid_total", Metrics::label("file", filePath))),
+      parseFailed(Metrics::instance().counter("sparky_parse_failed_total", Metrics::label("file", filePath))),
+      syslogInvalid(Metrics::instance().counter("sparky_syslog_invalid_total", Metrics::label("file", filePath))),
+      timestampMissing(Metrics::instance().counter("sparky_timestamp_missing_total", Metrics::label("file", filePath))),
+      accessInvalid(Metrics::instance().counter("sparky_access_invalid_total", Metrics::label("file", filePath))),
+      lagBytes(Metrics::instance().gauge("sparky_file_lag_bytes", Metrics::label("file", filePath))),
+      fileSizeBytes(Metrics::instance().gauge("sparky_file_size_bytes", Metrics::label("file", filePath))),
+      readOffsetBytes(Metrics::instance().gauge("sparky_file_read_offset_bytes", Metrics::label("file", filePath))), readOffset(0),
+      lineEndOffset(0), reportedBacklog(0), unpolled(0) {
+    initInotify();
+    registerStats();
+}
 
-    // Initialize inotify
+/**
+ * @brief Initializes inotify and adds a modification watch on the monitored file.
+ *
+ * @throws std::runtime_error If inotify cannot be initialized or the watch cannot be added.
+ */
+void FileMonitor::initInotify() {
     inotifyFd = inotify_init();
     if (inotifyFd < 0) {
         throw std::runtime_error("Failed to initialize inotify: " + std::string(strerror(errno)));
@@ -49,17 +114,183 @@ FileMonitor::FileMonitor(const std::string& filePath, const std::string& kafkaBr
     }
 }
 
+/**
+ * @brief Registers the file's counters for publication in the shared memory stats segment.
+ *
+ * The queue shown for the file is its own producer's queue, or its lane's
+ * queue when sending through a scheduler. Unshipped bytes and in-flight
+ * lines come from the file's LagTracker.
+ */
+void FileMonitor::registerStats() {
+    Metrics& metrics = Metrics::instance();
+    StatsSegment::Input input;
+    input.name = filePath;
+    input.linesRead = &linesRead;
+    input.bytesRead = &bytesRead;
+    input.delivered = &latency.histogram(LatencyTracker::TOTAL);
+    input.fileSize = &fileSizeBytes;
+    input.readOffset = &readOffsetBytes;
+    input.queueDepth = scheduler
+        ? &metrics.gauge("sparky_lane_queue_depth", Metrics::label("lane", LaneScheduler::laneName(priority)))
+        : &metrics.gauge("sparky_producer_queue_depth", Metrics::label("sink", filePath));
+    input.unshippedBytes = &metrics.gauge("sparky_file_unshipped_bytes", Metrics::label("file", filePath));
+    input.inFlight = &metrics.gauge("sparky_file_in_flight_lines", Metrics::label("file", filePath));
+    StatsSegment::registerInput(input);
+}
+
 /**
  * @brief Destructor for the FileMonitor class.
  *
  * This destructor is responsible for cleaning up resources used by the
- * FileMonitor instance. It removes the inotify watch, closes the inotify
- * file descriptor, and deletes the producer object to prevent memory leaks.
+ * FileMonitor instance. It removes the file from the stats segment, removes
+ * the inotify watch and closes the inotify file descriptor; the Kafka sink
+ * releases its producer on its own. With a lane scheduler it first waits for
+ * the monitor's messages, in case monitor() did not return normally.
  */
 FileMonitor::~FileMonitor() {
+    if (scheduler) {
+        scheduler->waitDelivered(latency);
+    }
+    StatsSegment::unregisterInput(filePath);
     inotify_rm_watch(inotifyFd, watchFd);
     close(inotifyFd);
-    delete producer;
+}
+
+/**
+ * @brief Asks monitor() to return.
+ *
+ * monitor() notices within its poll interval, sends its "CLOSE" message and
+ * flushes its producer, or waits for its lane messages, before returning.
+ */
+void FileMonitor::stop() {
+    running.store(false);
+}
+
+/**
+ * @brief Enables or disables template mining for the monitored file.
+ *
+ * @param enabled Whether lines should be sent as template ID plus parameters.
+ */
+void FileMonitor::setTemplateMining(bool enabled) {
+    templateMining = enabled;
+}
+
+/**
+ * @brief Enables lag alerting for the monitored file.
+ *
+ * @param maxUnshippedBytes Unshipped bytes above which to alert; 0 disables the check.
+ * @param maxAgeMs Age of the oldest unshipped byte above which to alert, in milliseconds; 0 disables the check.
+ * @param reporter Destination of "LAG" and "LAG RECOVERED" health events, or nullptr.
+ */
+void FileMonitor::setLagAlerts(uint64_t maxUnshippedBytes, int64_t maxAgeMs, HealthReporter* reporter) {
+    lag.setThresholds(maxUnshippedBytes, maxAgeMs);
+    healthReporter = reporter;
+}
+
+/**
+ * @brief Enables or disables field extraction for the monitored file.
+ *
+ * @param extractor The configured extractor, or nullptr to disable extraction.
+ * @param sourcetype The sourcetype whose patterns apply to the file.
+ */
+void FileMonitor::setFieldExtraction(const FieldExtractor* extractor, const std::string& sourcetype) {
+    fields.reset(extractor ? new FieldExtractor::Fields(*extractor, sourcetype) : nullptr);
+}
+
+/**
+ * @brief Sets the drop and keep rules for the monitored file.
+ *
+ * @param filter The rules, or nullptr to keep every line.
+ */
+void FileMonitor::setFilter(const LineFilter* filter) {
+    this->filter = filter ? filter->bind(filePath) : LineFilter::Binding();
+}
+
+/**
+ * @brief Sets the consistent-hash sampler for the monitored file.
+ *
+ * The rate is formatted once, with up to 9 significant digits.
+ *
+ * @param sampler The sampler, or nullptr to send every line.
+ */
+void FileMonitor::setSampler(const HashSampler* sampler) {
+    this->sampler = sampler;
+    sampleRateJson.clear();
+    if (sampler) {
+        char rate[32];
+        std::snprintf(rate, sizeof(rate), "%.9g", sampler->rate());
+        sampleRateJson = std::string(", \"sampleRate\": ") + rate;
+    }
+}
+
+/**
+ * @brief Enables or disables JSON line parsing for the monitored file.
+ *
+ * @param config Parser with the renames and drops to apply, or nullptr.
+ */
+void FileMonitor::setJsonParsing(const JsonLogParser* config) {
+    json.reset(config ? new JsonLogParser(*config) : nullptr);
+}
+
+/**
+ * @brief Enables or disables key=value, CEF or LEEF parsing for the monitored file.
+ *
+ * @param config Parser for the file's format, or nullptr.
+ */
+void FileMonitor::setLineParsing(const KeyValueParser* config) {
+    lineParser.reset(config ? new KeyValueParser(*config) : nullptr);
+}
+
+/**
+ * @brief Enables or disables syslog header decoding for the monitored file.
+ *
+ * @param enabled Whether syslog headers are decoded.
+ */
+void FileMonitor::setSyslogParsing(bool enabled) {
+    syslog.reset(enabled ? new SyslogParser() : nullptr);
+}
+
+/**
+ * @brief Enables or disables event time extraction for the monitored file.
+ *
+ * @param config Parser for the file's timestamps, or nullptr.
+ */
+void FileMonitor::setTimestampExtraction(const TimestampParser* config) {
+    timestamps.reset(config ? new TimestampParser(*config) : nullptr);
+}
+
+/**
+ * @brief Enables or disables access log parsing for the monitored file.
+ *
+ * Rows still batched are sent first.
+ *
+ * @param enabled Whether access log lines are parsed.
+ * @param encoding How rows are sent.
+ * @param batchRows Most rows per batch; at least 1.
+ */
+void FileMonitor::setAccessLogParsing(bool enabled, AccessLogBatch::Encoding encoding, size_t batchRows) {
+    if (accessBatch.size() > 0) {
+        sendAccessBatch();
+    }
+    accessParser.reset(enabled ? new AccessLogParser() : nullptr);
+    accessEncoding = encoding;
+    accessBatchRows = batchRows > 0 ? batchRows : 1;
+}
+
+/**
+ * @brief Enables or disables auditd record correlation for the monitored file.
+ *
+ * Events still open when correlation is disabled are sent first.
+ *
+ * @param windowMs How long an event waits for more records, in milliseconds; 0 disables.
+ * @param maxEvents Most events open at once.
+ */
+void FileMonitor::setAuditCorrelation(int64_t windowMs, size_t maxEvents) {
+    if (audit) {
+        audit->flush(auditDone);
+        sendAuditEvents();
+    }
+    audit.reset(windowMs > 0 ? new AuditCorrelator(filePath, windowMs, maxEvents) : nullptr);
 }
 
 /**
@@ -91,6 +322,23 @@ std::string FileMonitor::getCurrentTimestamp() {
     return timestamp.str();
 }
 
+/**
+ * @brief Formats a time in the format of getCurrentTimestamp().
+ *
+ * @param timeUs Microseconds since the epoch.
+ * @return The local time as "YYYY-MM-DD HH:MM:SS.mmm".
+ */
+std::string FileMonitor::formatTimestamp(int64_t timeUs) {
+    int64_t milliseconds = timeUs / 1000;
+    std::time_t seconds = static_cast<std::time_t>(milliseconds / 1000);
+    std::tm local;
+    localtime_r(&seconds, &local);
+    char buffer[64];
+    size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%03d", static_cast<int>(milliseconds % 1000));
+    return buffer;
+}
+
 /**
  * @brief Formats a message as a JSON string with metadata.
  * 
@@ -106,10 +354,459 @@ std::string FileMonitor::getCurrentTimestamp() {
 std::string FileMonitor::formatMessage(const std::string& filePath, const std::string& line, const std::string& kafkaTopic, const std::string& messageType) {
     std::string timestamp = getCurrentTimestamp();
     // Format the message as a JSON string
-    std::string formattedMessage = "{\"timestamp\": \"" + timestamp + "\", \"filePath\": \"" + filePath + "\", \"kafkaTopic\": \"" + kafkaTopic + "\", \"message\": \"" + line + "\", \"type\": \"" + messageType + "\"}";
+    std::string formattedMessage = "{\"timestamp\": \"" + timestamp + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" + kafkaTopic + "\", \"message\": \"" + escapeJson(line) + "\", \"type\": \"" + messageType + "\"}";
     return formattedMessage;
 }
 
+/**
+ * @brief Formats a templated line as a JSON string with metadata.
+ *
+ * The line is represented by its template ID and the tokens found at the
+ * template's wildcard positions. Consumers rebuild the original line with
+ * TemplateDecoder using the matching "TEMPLATE" event.
+ *
+ * @param templateId The ID of the template the line belongs to.
+ * @param params The line's parameters, in wildcard order.
+ * @return A JSON-formatted string with type "MODIFY" and no "message" field.
+ */
+std::string FileMonitor::formatTemplateMatch(int templateId, const std::vector<std::string>& params) {
+    std::string timestamp = getCurrentTimestamp();
+    std::string formattedMessage = "{\"timestamp\": \"" + timestamp + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" + kafkaTopic + "\", \"templateId\": " + std::to_string(templateId) + ", \"params\": [";
+    for (size_t i = 0; i < params.size(); ++i) {
+        if (i > 0) {
+            formattedMessage += ", ";
+        }
+        formattedMessage += "\"" + escapeJson(params[i]) + "\"";
+    }
+    formattedMessage += "], \"type\": \"MODIFY\"}";
+    return formattedMessage;
+}
+
+/**
+ * @brief Formats a template definition as a JSON string with metadata.
+ *
+ * @param templateId The ID of the template.
+ * @param templateText The template tokens joined by single spaces, with "<*>" at variable positions.
+ * @return A JSON-formatted string with type "TEMPLATE".
+ */
+std::string FileMonitor::formatTemplateDefinition(int templateId, const std::string& templateText) {
+    std::string timestamp = getCurrentTimestamp();
+    return "{\"timestamp\": \"" + timestamp + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" + kafkaTopic + "\", \"templateId\": " + std::to_string(templateId) + ", \"template\": \"" + escapeJson(templateText) + "\", \"type\": \"TEMPLATE\"}";
+}
+
+/**
+ * @brief Formats a lag health event as a JSON string with metadata.
+ *
+ * The event names the host so capacity problems can be traced to the
+ * machine whose forwarder is falling behind.
+ *
+ * @param messageType "LAG" or "LAG RECOVERED".
+ * @return A JSON-formatted string with the file size, committed offset,
+ *         unshipped bytes and age of the oldest unshipped byte.
+ */
+std::string FileMonitor::formatLagEvent(const std::string& messageType) {
+    char host[HOST_NAME_MAX + 1] = "";
+    gethostname(host, sizeof(host) - 1);
+    uint64_t committed = lag.committedOffset();
+    uint64_t unshipped = lag.unshippedBytes();
+    char age[32];
+    std::snprintf(age, sizeof(age), "%.3f", lag.oldestUnshippedSeconds(LatencyTracker::now()));
+    std::string timestamp = getCurrentTimestamp();
+    return "{\"timestamp\": \"" + timestamp + "\", \"host\": \"" + escapeJson(host) + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" + kafkaTopic + "\", \"fileSize\": " + std::to_string(committed + unshipped) + ", \"committedOffset\": " + std::to_string(committed) + ", \"unshippedBytes\": " + std::to_string(unshipped) + ", \"oldestUnshippedSeconds\": " + age + ", \"type\": \"" + messageType + "\"}";
+}
+
+/**
+ * @brief Refreshes the file's lag metrics and reports alert transitions.
+ *
+ * Called by the monitoring thread after every read and at least once per
+ * poll interval, so the age keeps growing while nothing is delivered.
+ */
+void FileMonitor::checkLag() {
+    LagTracker::Transition transition = lag.update(LatencyTracker::now());
+    if (transition == LagTracker::NONE) {
+        return;
+    }
+    std::string type = transition == LagTracker::RAISED ? "LAG" : "LAG RECOVERED";
+    std::cerr << "Lag " << (transition == LagTracker::RAISED ? "alert" : "recovered") << " for " << filePath
+              << ": " << lag.unshippedBytes() << " bytes unshipped" << std::endl;
+    if (healthReporter) {
+        healthReporter->report(formatLagEvent(type), filePath);
+    }
+}
+
+/**
+ * @brief Formats a parsed JSON line as an envelope with the line's members merged in.
+ *
+ * The envelope members come first, so consumers find them in the same
+ * place as in formatMessage(); the line's members follow verbatim.
+ *
+ * @param filePath The path of the file being monitored.
+ * @param parser The parser that parsed the line.
+ * @param kafkaTopic The Kafka topic to which the message will be sent.
+ * @param messageType The type of message.
+ * @return A JSON object with no "message" member.
+ */
+std::string FileMonitor::formatJsonMessage(const std::string& filePath, const JsonLogParser& parser, const std::string& kafkaTopic, const std::string& messageType) {
+    std::string timestamp = getCurrentTimestamp();
+    std::string formattedMessage = "{\"timestamp\": \"" + timestamp + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" + kafkaTopic + "\", \"type\": \"" + messageType + "\"";
+    parser.appendMembers(formattedMessage);
+    formattedMessage += "}";
+    return formattedMessage;
+}
+
+/**
+ * @brief Formats a correlated audit event as a JSON message.
+ *
+ * Each record becomes an object holding its "type" and its fields, in
+ * order. Hex-encoded values (e.g. proctitle, EXECVE arguments) are decoded,
+ * with argument separators turned into spaces.
+ *
+ * @param filePath The path of the file being monitored.
+ * @param event The event.
+ * @param kafkaTopic The Kafka topic to which the message will be sent.
+ * @return The JSON message.
+ */
+std::string FileMonitor::formatAuditEvent(const std::string& filePath, const AuditCorrelator::Event& event, const std::string& kafkaTopic) {
+    std::string timestamp = getCurrentTimestamp();
+    std::string formattedMessage = "{\"timestamp\": \"" + timestamp + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" + kafkaTopic +
+                                   "\", \"type\": \"AUDIT\", \"auditTime\": \"" + escapeJson(event.time) + "\", \"serial\": " + std::to_string(event.serial) + ", \"records\": [";
+    std::vector<AuditCorrelator::Field> fields;
+    std::string decoded;
+    std::string_view type;
+    size_t start = 0;
+    bool first = true;
+    while (start < event.records.size()) {
+        size_t end = event.records.find('\n', start);
+        std::string_view record(event.records.data() + start, end - start);
+        start = end + 1;
+        if (!AuditCorrelator::fields(record, type, fields)) {
+            continue;
+        }
+        formattedMessage += first ? "{\"type\": \"" : ", {\"type\": \"";
+        first = false;
+        formattedMessage += escapeJson(std::string(type)) + "\"";
+        for (const AuditCorrelator::Field& field : fields) {
+            if (field.hex) {
+                AuditCorrelator::decodeHex(field.value, decoded);
+            } else {
+                decoded.assign(field.value.data(), field.value.size());
+            }
+            formattedMessage += ", \"" + escapeJson(std::string(field.key)) + "\": \"" + escapeJson(decoded) + "\"";
+        }
+        formattedMessage += "}";
+    }
+    formattedMessage += "]}";
+    return formattedMessage;
+}
+
+/**
+ * @brief Formats a row of an access log batch as a JSON message.
+ *
+ * The envelope timestamp is the request time and the time the message was
+ * formatted is kept as "ingestTimestamp", as for extracted event times.
+ *
+ * @param filePath The path of the file being monitored.
+ * @param batch The batch.
+ * @param row The row.
+ * @param kafkaTopic The Kafka topic to which the message will be sent.
+ * @return The JSON message.
+ */
+std::string FileMonitor::formatAccessRow(const std::string& filePath, const AccessLogBatch& batch, size_t row, const std::string& kafkaTopic) {
+    std::string formattedMessage = "{\"timestamp\": \"" + getCurrentTimestamp() + "\", \"filePath\": \"" + escapeJson(filePath) + "\", \"kafkaTopic\": \"" +
+                                   kafkaTopic + "\", \"type\": \"ACCESS\", ";
+    batch.appendJson(row, formattedMessage);
+    formattedMessage += "}";
+    setEventTime(formattedMessage, batch.timeUs(row));
+    return formattedMessage;
+}
+
+/**
+ * @brief Makes a syslog line's header part of its formatted message.
+ *
+ * Nil and absent header fields are left out of the "syslog" object.
+ *
+ * @param message The formatted message, ending in '}'.
+ * @param header The decoded header.
+ */
+void FileMonitor::appendSyslog(std::string& message, const SyslogParser::Message& header) {
+    if (message.empty() || message.back() != '}') {
+        return;
+    }
+    std::string object = ", \"syslog\": {\"format\": \"";
+    object += header.format == SyslogParser::RFC5424 ? "rfc5424\"" : "rfc3164\"";
+    if (header.priority >= 0) {
+        object += ", \"priority\": " + std::to_string(header.priority) + ", \"facility\": " + std::to_string(header.facility()) +
+                  ", \"severity\": " + std::to_string(header.severity());
+    }
+    const std::pair<const char*, std::string_view> members[] = {
+        {"hostname", header.hostname}, {"appName", header.appName}, {"procId", header.procId},
+        {"msgId", header.msgId}, {"structuredData", header.structuredData}};
+    for (const auto& member : members) {
+        if (!member.second.empty()) {
+            object += std::string(", \"") + member.first + "\": \"" + escapeJson(std::string(member.second)) + "\"";
+        }
+    }
+    object += "}";
+    message.insert(message.size() - 1, object);
+}
+
+/**
+ * @brief Makes the event time the record time of a formatted message.
+ *
+ * @param message The formatted message, starting with `{"timestamp": "` and ending in '}'.
+ * @param timeUs The event time in microseconds since the epoch.
+ */
+void FileMonitor::setEventTime(std::string& message, int64_t timeUs) {
+    static const char PREFIX[] = "{\"timestamp\": \"";
+    const size_t prefixLength = sizeof(PREFIX) - 1;
+    if (message.compare(0, prefixLength, PREFIX) != 0 || message.back() != '}') {
+        return;
+    }
+    size_t end = message.find('"', prefixLength);
+    if (end == std::string::npos) {
+        return;
+    }
+    std::string ingest = ", \"ingestTimestamp\": \"" + message.substr(prefixLength, end - prefixLength) + "\"";
+    message.replace(prefixLength, end - prefixLength, formatTimestamp(timeUs));
+    message.insert(message.size() - 1, ingest);
+}
+
+/**
+ * @brief Escapes a string for use inside a JSON string literal.
+ *
+ * Quotes, backslashes and control characters are escaped; all other bytes,
+ * including UTF-8 sequences, are copied unchanged.
+ *
+ * @param text The text to escape.
+ * @return The escaped text, without surrounding quotes.
+ */
+std::string FileMonitor::escapeJson(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    appendEscapedJson(escaped, text);
+    return escaped;
+}
+
+/**
+ * @brief Sends one line read from the monitored file.
+ *
+ * With JSON parsing enabled, a line that is a JSON object is sent with its
+ * members merged into the envelope. Otherwise, without template mining the
+ * line is sent verbatim. With template mining the
+ * line is matched against the mined templates; a "TEMPLATE" event is sent
+ * first whenever a template is created or generalized, followed by the line as
+ * template ID plus parameters. Lines that cannot be templated (the cluster
+ * limit was reached) fall back to verbatim. Only the line's own message
+ * carries the latency trace; template definitions are not traced. The line's
+ * event also carries its extracted and parsed fields, its syslog header, the
+ * event time from the header or the line as its timestamp, and the sampling
+ * rate, if enabled.
+ *
+ * @param line The line to send.
+ * @param trace Latency trace for the line; this function takes ownership.
+ */
+void FileMonitor::sendLine(const std::string& line, EventTrace* trace) {
+    SPARKY_ALLOC_STAGE(FORMAT);
+    std::unique_ptr<EventTrace> owned(trace);
+    std::string message;
+    std::string key;
+    if (lineParser && !lineParser->parse(line)) {
+        parseFailed.add();
+    }
+    SyslogParser::Message header;
+    bool hasHeader = syslog && syslog->parse(line, header);
+    if (syslog && !hasHeader) {
+        syslogInvalid.add();
+    }
+    int64_t eventTime = hasHeader ? header.timeUs : -1;
+    if (timestamps && eventTime < 0 && !timestamps->extract(line, eventTime)) {
+        timestampMissing.add();
+    }
+    bool structured = json && json->parse(line);
+    if (json && !structured) {
+        jsonInvalid.add();
+    }
+    if (structured) {
+        message = formatJsonMessage(filePath, *json, kafkaTopic, "MODIFY");
+    } else if (!templateMining) {
+        message = formatMessage(filePath, line, kafkaTopic, "MODIFY");
+    } else {
+        key = filePath;
+        TemplateMiner::Match match = templateMiner.add(line);
+        if (match.templateId < 0) {
+            message = formatMessage(filePath, line, kafkaTopic, "MODIFY");
+        } else {
+            if (match.isNew) {
+                sendToKafka(formatTemplateDefinition(match.templateId, templateMiner.templateText(match.templateId)), key);
+            }
+            message = formatTemplateMatch(match.templateId, match.params);
+        }
+    }
+    if (fields || lineParser) {
+        appendFields(message);
+    }
+    if (hasHeader) {
+        appendSyslog(message, header);
+    }
+    if (eventTime >= 0) {
+        setEventTime(message, eventTime);
+    }
+    if (sampler && !message.empty() && message.back() == '}') {
+        message.insert(message.size() - 1, sampleRateJson);
+    }
+    owned->formatted = LatencyTracker::now();
+    SPARKY_PROBE4(format, filePath.c_str(), line.size(), message.size(), owned->read);
+    sendToKafka(message, key, owned.release());
+}
+
+/**
+ * @brief Sends one message with a latency trace that stands for the file up to an offset.
+ *
+ * The trace starts at the given times and acknowledges the offset in the lag
+ * tracker once the message is delivered. If formatting or sending fails the
+ * error is logged and the offset is acknowledged right away: the message is
+ * not retried, so it must not hold back the committed offset.
+ *
+ * @param notified When inotify reported the write of the message's first line.
+ * @param read When the chunk holding that line was read.
+ * @param endOffset Offset just past the message's last line.
+ * @param lagGeneration Generation of that line in the lag tracker.
+ * @param send Formats and sends the message; takes ownership of the trace it is given.
+ */
+template <typename Send>
+void FileMonitor::sendTraced(int64_t notified, int64_t read, uint64_t endOffset, uint32_t lagGeneration, Send send) {
+    EventTrace* trace = latency.begin(notified, read);
+    trace->lag = &lag;
+    trace->endOffset = endOffset;
+    trace->lagGeneration = lagGeneration;
+    try {
+        send(trace);
+    } catch (const std::exception& e) {
+        std::cerr << "Error sending message to Kafka: " << e.what() << std::endl;
+        lag.acknowledge(endOffset, lagGeneration);
+    }
+}
+
+/**
+ * @brief Sends the completed audit events.
+ *
+ * An event's message carries the latency trace of its first record and
+ * stands for its last record in the lag tracker; the other records are
+ * acknowledged when the event is handed over, which cannot move the
+ * committed offset past the last record before the event is delivered. An
+ * event without records (a late EOE) is only acknowledged.
+ *
+ * The sampler decides once per event, keyed by its field if the records
+ * have it and by the records otherwise, so an event is sent whole or not at
+ * all; sent events carry the sampling rate.
+ */
+void FileMonitor::sendAuditEvents() {
+    SPARKY_ALLOC_STAGE(FORMAT);
+    for (const AuditCorrelator::Event& event : auditDone) {
+        const AuditCorrelator::Origin& last = event.origins.back();
+        for (size_t i = 0; i + 1 < event.origins.size(); ++i) {
+            lag.acknowledge(event.origins[i].endOffset, event.origins[i].lagGeneration);
+        }
+        if (event.records.empty()) {
+            lag.acknowledge(last.endOffset, last.lagGeneration);
+            continue;
+        }
+        if (sampler) {
+            if (fields) {
+                fields->reset(event.records);
+            }
+            if (!sampler->keep(event.records, fields.get())) {
+                linesDropped.add(event.origins.size());
+                lag.acknowledge(last.endOffset, last.lagGeneration);
+                continue;
+            }
+        }
+        const AuditCorrelator::Origin& first = event.origins.front();
+        sendTraced(first.notified, first.read, last.endOffset, last.lagGeneration, [&](EventTrace* trace) {
+            std::string message = formatAuditEvent(filePath, event, kafkaTopic);
+            if (sampler) {
+                message.insert(message.size() - 1, sampleRateJson);
+            }
+            trace->formatted = LatencyTracker::now();
+            sendToKafka(message, "", trace);
+        });
+    }
+    auditDone.clear();
+}
+
+/**
+ * @brief Sends the rows of the access log batch and clears it.
+ *
+ * With JSON each row is its own message with its own latency trace. A
+ * columnar batch is one message that carries the trace of its first row and
+ * stands for its last row in the lag tracker; the other rows are
+ * acknowledged when it is handed over, as for audit events. Either way the
+ * sampling rate goes with the rows, in the envelope or the batch header.
+ */
+void FileMonitor::sendAccessBatch() {
+    SPARKY_ALLOC_STAGE(FORMAT);
+    if (accessEncoding == AccessLogBatch::JSON) {
+        for (size_t row = 0; row < accessBatch.size(); ++row) {
+            const AccessRow& origin = accessRows[row];
+            sendTraced(origin.notified, origin.read, origin.endOffset, origin.lagGeneration, [&](EventTrace* trace) {
+                std::string message = formatAccessRow(filePath, accessBatch, row, kafkaTopic);
+                if (sampler) {
+                    message.insert(message.size() - 1, sampleRateJson);
+                }
+                trace->formatted = LatencyTracker::now();
+                sendToKafka(message, "", trace);
+            });
+        }
+    } else {
+        const AccessRow& last = accessRows.back();
+        for (size_t row = 0; row + 1 < accessRows.size(); ++row) {
+            lag.acknowledge(accessRows[row].endOffset, accessRows[row].lagGeneration);
+        }
+        const AccessRow& first = accessRows.front();
+        sendTraced(first.notified, first.read, last.endOffset, last.lagGeneration, [&](EventTrace* trace) {
+            std::string message;
+            accessBatch.encode(filePath, sampler ? sampler->rate() : 1.0, message);
+            trace->formatted = LatencyTracker::now();
+            sendToKafka(message, "", trace);
+        });
+    }
+    accessBatch.clear();
+    accessRows.clear();
+}
+
+/**
+ * @brief Appends the referenced fields extracted from a line, then its parsed fields, to its message.
+ *
+ * Each referenced field is asked for in turn, so patterns run lazily and at
+ * most once per line; fields already used by the filter are not extracted
+ * again. Nothing is added when no field matched and nothing was parsed.
+ *
+ * @param message The formatted message, ending in '}'.
+ */
+void FileMonitor::appendFields(std::string& message) {
+    std::string object;
+    std::string_view value;
+    if (fields) {
+        const std::vector<std::string>& names = fields->extractorFields();
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (!fields->get(i, value)) {
+                continue;
+            }
+            object += object.empty() ? "{" : ", ";
+            object += "\"" + escapeJson(names[i]) + "\": \"" + escapeJson(std::string(value)) + "\"";
+        }
+    }
+    if (lineParser && !lineParser->fields().empty()) {
+        object += object.empty() ? "{" : ", ";
+        lineParser->appendJson(object);
+    }
+    if (object.empty() || message.empty() || message.back() != '}') {
+        return;
+    }
+    message.pop_back();
+    message += ", \"fields\": " + object + "}}";
+}
+
 /**
  * @brief Monitors a file for modifications and sends updates to a Kafka topic.
  *
@@ -120,19 +817,21 @@ std::string FileMonitor::formatMessage(const std::string& filePath, const std::s
  * @details
  * - Sends an "INIT" message to Kafka when monitoring starts.
  * - Sends an "INIT - FILE OPEN" message to Kafka after verifying the file is accessible.
+ * - Sends the lines already present in the file.
  * - Monitors the file for `IN_MODIFY` events using inotify.
- * - Reads the modified file line by line and sends each line to Kafka with a "MODIFY" tag.
+ * - Reads the lines appended since the last read and sends each line to Kafka with a "MODIFY" tag.
  * - Handles errors such as file access issues or Kafka message sending failures.
  * - Sends a "CLOSE" message to Kafka before exiting the function.
  *
  * @note This function assumes that the file path and Kafka topic are properly initialized.
  *       It also assumes that the Kafka producer is set up and accessible.
  *
- * @warning The function runs an infinite loop and does not provide a mechanism for graceful
- *          termination. Ensure proper handling to stop the loop when needed.
+ * @note The function runs until stop() is called; inotify is polled with a
+ *       timeout so a stop request is noticed within POLL_INTERVAL_MS.
+ *       With a lane scheduler it then waits until all of its messages have
+ *       been delivered or have failed, since their traces point at it.
  *
  * @todo Add a check to ensure the file is accessible before starting monitoring.
- * @todo Implement a mechanism to gracefully terminate the infinite loop.
  */
 void FileMonitor::monitor() {
     sendToKafka(formatMessage(filePath, " ", kafkaTopic, "INIT"));
@@ -142,8 +841,30 @@ void FileMonitor::monitor() {
     // TODO: Check if the file is accessible
 
     sendToKafka(formatMessage(filePath, " ", kafkaTopic, "INIT - FILE OPEN"));
+    // Ship what is already in the file before waiting for modifications
+    readNewLines(LatencyTracker::now());
     // Start monitoring for file modifications
-    while (true) {
+    while (running.load()) {
+        latency.logSummaryIfDue();
+        if (audit) {
+            audit->expire(LatencyTracker::now(), auditDone);
+            sendAuditEvents();
+        }
+        checkLag();
+        struct pollfd pfd = {inotifyFd, POLLIN, 0};
+        int ready = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (ready <= 0) {
+            if (ready < 0 && errno != EINTR) {
+                std::cerr << "Error polling inotify: " << strerror(errno) << std::endl;
+            }
+            if (sink) {
+                // Serve delivery reports for the tail of the last burst while idle
+                sink->poll();
+                unpolled = 0;
+            }
+            continue;
+        }
+        int64_t notified = LatencyTracker::now();
         int length = read(inotifyFd, buffer, sizeof(buffer));
         if (length < 0) {
             std::cerr << "Error reading inotify events: " << strerror(errno) << std::endl;
@@ -153,48 +874,192 @@ void FileMonitor::monitor() {
         for (int i = 0; i < length;) {
             struct inotify_event* event = (struct inotify_event*)&buffer[i];
             if (event->mask & IN_MODIFY) {
-                std::ifstream file(filePath);
-                if (!file.is_open()) {
-                    std::cerr << "Failed to open file: " << filePath << std::endl;
-                    sendToKafka(formatMessage(filePath, " ", kafkaTopic, "ERROR - FILE OPEN"));
-                    continue;
-                }
-                std::string line;
-                while (std::getline(file, line)) {
-                    try {
-                        sendToKafka(formatMessage(filePath, line, kafkaTopic, "MODIFY"));
-                    } catch (const std::exception& e) {
-                        std::cerr << "Error sending message to Kafka: " << e.what() << std::endl;
-                    }
-                }
+                readNewLines(notified);
             }
             i += sizeof(struct inotify_event) + event->len;
         }
     }
+    if (audit) {
+        audit->flush(auditDone);
+        sendAuditEvents();
+    }
     sendToKafka(formatMessage(filePath, " ", kafkaTopic, "CLOSE"));
-    producer->flush(1000);
+    if (sink) {
+        sink->flush(1000);
+    } else {
+        // Queued and in-flight traces point at latency and lag, which die with the monitor
+        scheduler->waitDelivered(latency);
+    }
+}
+
+/**
+ * @brief Reads and sends the lines appended to the file since the last read.
+ *
+ * The file is read in chunks from the current read offset and split on '\n'.
+ * A trailing partial line is kept until the rest of it is written. Before each
+ * line is sent, the rate limiter hierarchy (file, pipeline, global) is charged
+ * for its bytes; if any level is over its limit this call sleeps, leaving the
+ * rest of the data unread in the file instead of dropping it. Between chunks
+ * the CPU governor may pace reading to keep the process within its CPU budget;
+ * the bytes left unread are reported to it as deferred backlog. A file that
+ * shrank below the read offset is assumed truncated and is read from the start.
+ *
+ * Each line gets a latency trace starting at the notification time and the
+ * time its chunk was read. Its end offset is tracked by the lag tracker until
+ * the delivery report acknowledges it. With audit correlation, audit records
+ * are held by the correlator and sent as part of their event. With access
+ * log parsing, access log lines are batched and sent at the end of the
+ * chunk, or sooner when the batch is full.
+ *
+ * @param notified When the modification was noticed, from LatencyTracker::now().
+ */
+void FileMonitor::readNewLines(int64_t notified) {
+    SPARKY_ALLOC_STAGE(READ);
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open file: " << filePath << std::endl;
+        sendToKafka(formatMessage(filePath, " ", kafkaTopic, "ERROR - FILE OPEN"));
+        return;
+    }
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    if (fileSize < readOffset) {
+        readOffset = 0;
+        lineEndOffset = 0;
+        pendingLine.clear();
+        lag.truncated();
+        if (capture) {
+            capture->truncate(filePath, notified);
+        }
+    }
+    lag.observe(fileSize, notified);
+    file.seekg(static_cast<std::streamoff>(readOffset));
+
+    CpuGovernor& governor = CpuGovernor::instance();
+    char chunk[READ_CHUNK_SIZE];
+    while (true) {
+        int64_t backlog = static_cast<int64_t>(fileSize > readOffset ? fileSize - readOffset : 0);
+        governor.addBacklog(backlog - reportedBacklog);
+        reportedBacklog = backlog;
+        lagBytes.set(static_cast<double>(backlog));
+        fileSizeBytes.set(static_cast<double>(fileSize));
+        readOffsetBytes.set(static_cast<double>(readOffset));
+        governor.pace();
+        if (!file.read(chunk, sizeof(chunk)) && file.gcount() == 0) {
+            break;
+        }
+        size_t length = static_cast<size_t>(file.gcount());
+        readOffset += length;
+        bytesRead.add(length);
+        int64_t readAt = LatencyTracker::now();
+        SPARKY_PROBE3(file_read, filePath.c_str(), readOffset - length, length);
+        if (capture) {
+            capture->write(filePath, notified, chunk, length);
+        }
+        size_t lines = splitLines(chunk, length, pendingLine, [this, notified, readAt](const std::string& line) {
+            lineEndOffset += line.size() + 1;
+            if (fields) {
+                fields->reset(line);
+            }
+            // Audit records are sampled per event once correlated, so events stay whole
+            if ((filter.active() && !filter.keep(line, fields.get())) ||
+                (sampler && !(audit && AuditCorrelator::isRecord(line)) && !sampler->keep(line, fields.get()))) {
+                linesDropped.add();
+                // Dropped lines are done, so they must not hold back the committed offset
+                lag.acknowledge(lineEndOffset, lag.track(lineEndOffset));
+                return;
+            }
+            limiter.acquire(line.size() + 1);
+            uint32_t generation = lag.track(lineEndOffset);
+            if (audit && audit->add(line, AuditCorrelator::Origin{lineEndOffset, generation, notified, readAt}, LatencyTracker::now(), auditDone)) {
+                sendAuditEvents();
+                return;
+            }
+            if (accessParser) {
+                AccessLogParser::Record record;
+                if (accessParser->parse(line, record)) {
+                    accessBatch.add(record);
+                    accessRows.push_back(AccessRow{lineEndOffset, generation, notified, readAt});
+                    if (accessBatch.size() >= accessBatchRows) {
+                        sendAccessBatch();
+                    }
+                    return;
+                }
+                accessInvalid.add();
+                if (accessBatch.size() > 0) {
+                    // Keep messages in file order
+                    sendAccessBatch();
+                }
+            }
+            sendTraced(notified, readAt, lineEndOffset, generation, [&](EventTrace* trace) { sendLine(line, trace); });
+        });
+        if (accessBatch.size() > 0) {
+            sendAccessBatch();
+        }
+        SPARKY_PROBE3(line_split, filePath.c_str(), lines, pendingLine.size());
+        linesRead.add(lines);
+        checkLag();
+    }
 }
 
 /**
- * @brief Sends a message to a Kafka topic using the configured Kafka producer.
+ * @brief Assigns the file to a pipeline for rate limiting.
  *
- * This method produces a message to the specified Kafka topic and handles any
- * errors that may occur during the production process. If the message fails
- * to be produced, an exception is thrown with the corresponding error message.
+ * @param pipeline The pipeline name; its limiter sits between this file's
+ *        limiter and the global one.
+ */
+void FileMonitor::setPipeline(const std::string& pipeline) {
+    limiter.setParent(&RateLimiter::pipeline(pipeline));
+}
+
+/**
+ * @brief Sends a message to a Kafka topic using the Kafka sink.
+ *
+ * This method hands the message to the sink, which produces it with the
+ * currently selected compression codec. Delivery reports are served every
+ * few messages, as many as the CPU governor's current batch size, and the
+ * governor's budget and codec limit are passed on to the sink. When the
+ * monitor was created with a lane scheduler the message is queued on its
+ * lane instead, blocking while the lane is full. Otherwise a full producer
+ * queue throttles the reader the same way: delivery reports are served and
+ * the message is retried until the queue has room, so unread data waits in
+ * the file rather than being dropped. If the message fails to be produced,
+ * an exception is thrown with the corresponding error message.
  *
  * @param message The message to be sent to the Kafka topic.
+ * @param key The message key used for partitioning; an empty key lets the
+ *        partitioner pick any partition.
+ * @param trace Latency trace for the message, or nullptr; this function takes
+ *        ownership and stamps its enqueue time.
  *
- * @throws std::runtime_error If the message fails to be produced, an exception
- *         is thrown with the error description.
+ * @throws std::runtime_error If the message fails to be produced, or the
+ *         monitor is stopped while waiting for room in the producer queue.
  */
-void FileMonitor::sendToKafka(const std::string& message) {
-    RdKafka::ErrorCode resp = producer->produce(
-        kafkaTopic, RdKafka::Topic::PARTITION_UA,
-        RdKafka::Producer::RK_MSG_COPY,
-        const_cast<char*>(message.c_str()), message.size(),
-        nullptr, 0, 0, nullptr, nullptr);
-    if (resp != RdKafka::ERR_NO_ERROR) {
-        throw std::runtime_error("Failed to produce message: " + RdKafka::err2str(resp));
+void FileMonitor::sendToKafka(const std::string& message, const std::string& key, EventTrace* trace) {
+    SPARKY_ALLOC_STAGE(PRODUCE);
+    std::unique_ptr<EventTrace> owned(trace);
+    if (scheduler) {
+        scheduler->submit(priority, message, key, owned.release());
+        return;
+    }
+    if (owned) {
+        owned->enqueued = LatencyTracker::now();
+    }
+    while (!sink->tryProduce(message, key, owned.get())) {
+        if (!running.load()) {
+            throw std::runtime_error("Monitor stopped while the producer queue was full");
+        }
+        sink->poll();
+        std::this_thread::sleep_for(QUEUE_FULL_BACKOFF);
+    }
+    owned.release();
+    CpuGovernor& governor = CpuGovernor::instance();
+    if (++unpolled >= governor.batchSize()) {
+        if (governor.budget() > 0) {
+            sink->setCpuBudget(governor.budget());
+            sink->setMaxCodec(governor.maxCodec());
+        }
+        sink->poll();
+        unpolled = 0;
     }
-    producer->poll(0);
 }
\ No newline at end of file
@@ -2,7 +2,32 @@
 #define FILEMONITOR_H
 
 #include <string>
-#include <librdkafka/rdkafkacpp.h>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+#include <cstring>
+#include "KafkaSink.h"
+#include "LaneScheduler.h"
+#include "CpuGovernor.h"
+#include "RateLimiter.h"
+#include "TemplateMiner.h"
+#include "LatencyTracker.h"
+#include "LagTracker.h"
+#include "HealthReporter.h"
+#include "TraceFile.h"
+#include "FieldExtractor.h"
+#include "LineFilter.h"
+#include "HashSampler.h"
+#include "JsonLogParser.h"
+#include "KeyValueParser.h"
+#include "AuditCorrelator.h"
+#include "SyslogParser.h"
+#include "TimestampParser.h"
+#include "AccessLogBatch.h"
+#include "Metrics.h"
+#include "StatsSegment.h"
 
 
 /**
@@ -19,8 +44,18 @@ public:
      * @param filePath The path of the file to monitor.
      * @param kafkaBroker The address of the Kafka broker.
      * @param kafkaTopic The Kafka topic to which messages will be sent.
+     * @param producerConfig Additional librdkafka properties for the file's producer.
      */
-    FileMonitor(const std::string& filePath, const std::string& kafkaBroker, const std::string& kafkaTopic);
+    FileMonitor(const std::string& filePath, const std::string& kafkaBroker, const std::string& kafkaTopic,
+                const std::map<std::string, std::string>& producerConfig = {});
+
+    /**
+     * @brief Constructs a FileMonitor that sends through a priority lane of a shared scheduler.
+     * @param filePath The path of the file to monitor.
+     * @param scheduler The lane scheduler; its topic is used and it must outlive the monitor.
+     * @param priority The lane this file's messages are queued on.
+     */
+    FileMonitor(const std::string& filePath, LaneScheduler& scheduler, LaneScheduler::Priority priority);
 
     /**
      * @brief Destroys the FileMonitor object and releases resources.
@@ -35,12 +70,227 @@ public:
      */
     void monitor();
 
-private:
+    /**
+     * @brief Asks monitor() to return. Safe to call from any thread.
+     */
+    void stop();
+
+    /**
+     * @brief Enables or disables log template mining.
+     *
+     * When enabled, each line is clustered into a template. A "TEMPLATE" event
+     * carrying the template definition is sent the first time a template is
+     * seen, and lines are then sent as a template ID plus parameters instead
+     * of verbatim text. Messages are keyed by file path so definitions and the
+     * lines that use them stay on the same partition, in order.
+     *
+     * @param enabled Whether template mining is enabled.
+     */
+    void setTemplateMining(bool enabled);
+
+    /**
+     * @brief Assigns the file to a named pipeline for rate limiting.
+     *
+     * Files start in the "default" pipeline.
+     *
+     * @param pipeline The pipeline name.
+     */
+    void setPipeline(const std::string& pipeline);
+
+    /**
+     * @brief Enables alerting on how far deliveries trail the end of the file.
+     *
+     * While either threshold is exceeded `sparky_file_lag_alert` is 1. With a
+     * reporter, a "LAG" health event is sent when a threshold is crossed and a
+     * "LAG RECOVERED" event once the file is back within both.
+     *
+     * @param maxUnshippedBytes File size minus committed offset above which to alert; 0 disables the check.
+     * @param maxAgeMs Age of the oldest unshipped byte above which to alert, in milliseconds; 0 disables the check.
+     * @param reporter Where to send health events, or nullptr for metrics only; must outlive the monitor.
+     */
+    void setLagAlerts(uint64_t maxUnshippedBytes, int64_t maxAgeMs, HealthReporter* reporter = nullptr);
+
+    /**
+     * @brief Records everything read from the file, with its timing, into a capture trace.
+     *
+     * Each chunk is recorded with the time its modification was noticed, so
+     * a replay reproduces the write pattern rather than the reader's pacing.
+     *
+     * @param writer The trace to record into, or nullptr to stop; must outlive the monitor.
+     */
+    void setCapture(TraceWriter* writer) { capture = writer; }
+
+    /**
+     * @brief Extracts the extractor's referenced fields from each line into a "fields" object.
+     *
+     * Only fields declared with FieldExtractor::reference() are extracted, and
+     * only the sourcetype's patterns that capture them are run. Fields that do
+     * not match are left out of the object.
+     *
+     * @param extractor The configured extractor, or nullptr to stop; must outlive the monitor.
+     * @param sourcetype The file's sourcetype, e.g. "sshd".
+     */
+    void setFieldExtraction(const FieldExtractor* extractor, const std::string& sourcetype);
+
+    /**
+     * @brief Applies drop and keep rules to each line right after it is split off.
+     *
+     * Dropped lines are not formatted, rate limited or produced; they count in
+     * `sparky_lines_dropped_total` and their offsets are committed at once.
+     * Field rules see the fields of setFieldExtraction(), so enable extraction
+     * first.
+     *
+     * @param filter The rules, or nullptr to keep every line; must outlive the monitor.
+     */
+    void setFilter(const LineFilter* filter);
+
+    /**
+     * @brief Samples the lines that pass the filter by a consistent hash.
+     *
+     * Lines outside the sample are discarded like filtered lines, before
+     * formatting, and count in `sparky_lines_dropped_total`. Events in the
+     * sample carry `"sampleRate"` in their envelope. A field-keyed sampler
+     * uses the fields of setFieldExtraction(); without extraction lines are
+     * keyed by their text. Correlated audit records are sampled per event.
+     *
+     * @param sampler The sampler, or nullptr to send every line; must outlive the monitor.
+     */
+    void setSampler(const HashSampler* sampler);
+
+    /**
+     * @brief Treats lines as JSON objects and merges their members into the envelope.
+     *
+     * A line that is a valid JSON object is sent as the envelope members
+     * followed by the object's own members, copied without re-escaping, with
+     * the parser's renames and drops applied. Other lines are sent as usual
+     * and counted in `sparky_json_invalid_total`.
+     *
+     * @param config Parser holding the renames and drops, copied; nullptr to stop.
+     */
+    void setJsonParsing(const JsonLogParser* config);
+
+    /**
+     * @brief Parses lines as key=value, CEF or LEEF and adds their fields to the "fields" object.
+     *
+     * Parsing runs before formatting, on the line as read. Fields are
+     * decoded and JSON-escaped straight into the message. Lines not in the
+     * format are sent without parsed fields and counted in
+     * `sparky_parse_failed_total`.
+     *
+     * @param config Parser for the file's format, copied; nullptr to stop.
+     */
+    void setLineParsing(const KeyValueParser* config);
+
+    /**
+     * @brief Groups auditd records sharing an audit serial into one "AUDIT" event.
+     *
+     * Records are collected until the event's EOE record or until the window
+     * has passed since its first record, then sent as one message with a
+     * "records" array of decoded fields. Lines that are not audit records
+     * are sent as usual. Each record's offset is committed once its event is
+     * delivered. With a sampler, audit records skip per-line sampling and
+     * each event is sampled as a whole.
+     *
+     * @param windowMs How long an event waits for more records, in milliseconds; 0 to stop.
+     * @param maxEvents Most events open at once; the oldest is sent early when full.
+     */
+    void setAuditCorrelation(int64_t windowMs, size_t maxEvents = 4096);
+
+    /**
+     * @brief Decodes RFC 3164 and RFC 5424 syslog headers and uses the event time as the record time.
+     *
+     * For a syslog line, the envelope "timestamp" is the time in the line's
+     * header, the read time moves to "ingestTimestamp", and a "syslog" object
+     * carries the PRI, facility, severity, hostname, app-name, procid, msgid
+     * and structured data. Other lines are sent as usual and counted in
+     * `sparky_syslog_invalid_total`.
+     *
+     * @param enabled Whether syslog headers are decoded.
+     */
+    void setSyslogParsing(bool enabled);
+
+    /**
+     * @brief Uses the time found in each line as the record time.
+     *
+     * The envelope "timestamp" becomes the line's own time and the read time
+     * moves to "ingestTimestamp", so events keep their order when a backlog
+     * is read late. A decoded syslog header's time takes precedence. Lines
+     * without a timestamp keep the read time and are counted in
+     * `sparky_timestamp_missing_total`.
+     *
+     * @param config Parser for the file's timestamps, copied; a default-constructed one detects the format. nullptr to stop.
+     */
+    void setTimestampExtraction(const TimestampParser* config);
+
+    /**
+     * @brief Parses Apache and nginx access log lines into typed columns.
+     *
+     * The lines of each chunk read are collected into an AccessLogBatch of up
+     * to batchRows rows. With JSON, each row is then sent as an "ACCESS"
+     * message with its fields typed and its request time as the timestamp;
+     * with COLUMNAR, the batch is sent as one binary message in the columnar
+     * batch format, with the sampler's rate in its header. Lines that are not
+     * access log lines are sent as usual, as JSON envelopes on the same
+     * topic, and counted in `sparky_access_invalid_total`.
+     *
+     * @param enabled Whether access log lines are parsed.
+     * @param encoding How rows are sent.
+     * @param batchRows Most rows per batch.
+     */
+    void setAccessLogParsing(bool enabled, AccessLogBatch::Encoding encoding = AccessLogBatch::JSON, size_t batchRows = 1024);
+
+    /**
+     * @brief Retrieves the file's lag tracker.
+     * @return The tracker holding the committed offset and unshipped bytes.
+     */
+    const LagTracker& lagTracker() const { return lag; }
+
+    /**
+     * @brief Retrieves this file's rate limiter so its limits can be changed at runtime.
+     * @return The per-file rate limiter.
+     */
+    RateLimiter& rateLimiter() { return limiter; }
+
+    /**
+     * @brief Retrieves the file's own Kafka sink.
+     * @return The sink, or nullptr when the monitor sends through a lane scheduler.
+     */
+    KafkaSink* kafkaSink() { return sink.get(); }
+
     /**
      * @brief Retrieves the current timestamp in a formatted string.
      * @return A string representing the current timestamp.
      */
-    std::string getCurrentTimestamp();
+    static std::string getCurrentTimestamp();
+
+    /**
+     * @brief Formats a time like getCurrentTimestamp().
+     * @param timeUs Microseconds since the epoch.
+     * @return The local time as "YYYY-MM-DD HH:MM:SS.mmm".
+     */
+    static std::string formatTimestamp(int64_t timeUs);
+
+    /**
+     * @brief Makes a syslog line's header part of its formatted message.
+     *
+     * A "syslog" object is inserted before the closing brace.
+     *
+     * @param message The formatted message.
+     * @param header The line's decoded header.
+     */
+    static void appendSyslog(std::string& message, const SyslogParser::Message& header);
+
+    /**
+     * @brief Makes the event time the record time of a formatted message.
+     *
+     * The envelope timestamp, which every message starts with, is replaced
+     * by the event time and kept as "ingestTimestamp", inserted before the
+     * closing brace.
+     *
+     * @param message The formatted message.
+     * @param timeUs The event time in microseconds since the epoch.
+     */
+    static void setEventTime(std::string& message, int64_t timeUs);
 
     /**
      * @brief Formats a message to be sent to the Kafka topic.
@@ -50,21 +300,230 @@ private:
      * @param messageType The type of message (e.g., "MODIFY", "DELETE").
      * @return A formatted string containing the message.
      */
-    std::string formatMessage(const std::string& filePath, const std::string& line, const std::string& kafkaTopic, const std::string& messageType);
+    static std::string formatMessage(const std::string& filePath, const std::string& line, const std::string& kafkaTopic, const std::string& messageType);
+
+    /**
+     * @brief Escapes a string for inclusion in a JSON string literal.
+     * @param text The text to escape.
+     * @return The escaped text, without surrounding quotes.
+     */
+    static std::string escapeJson(const std::string& text);
+
+    /**
+     * @brief Formats a parsed JSON line as an envelope with the line's members merged in.
+     * @param filePath The path of the file being monitored.
+     * @param parser The parser holding the parsed line.
+     * @param kafkaTopic The Kafka topic to which the message will be sent.
+     * @param messageType The type of message (e.g., "MODIFY").
+     * @return The JSON message.
+     */
+    static std::string formatJsonMessage(const std::string& filePath, const JsonLogParser& parser, const std::string& kafkaTopic, const std::string& messageType);
+
+    /**
+     * @brief Formats a correlated audit event as a JSON message.
+     * @param filePath The path of the file being monitored.
+     * @param event The event and its records.
+     * @param kafkaTopic The Kafka topic to which the message will be sent.
+     * @return The JSON message, of type "AUDIT".
+     */
+    static std::string formatAuditEvent(const std::string& filePath, const AuditCorrelator::Event& event, const std::string& kafkaTopic);
+
+    /**
+     * @brief Formats a row of an access log batch as a JSON message.
+     * @param filePath The path of the file being monitored.
+     * @param batch The batch.
+     * @param row The row.
+     * @param kafkaTopic The Kafka topic to which the message will be sent.
+     * @return The JSON message, of type "ACCESS", with the request time as its timestamp.
+     */
+    static std::string formatAccessRow(const std::string& filePath, const AccessLogBatch& batch, size_t row, const std::string& kafkaTopic);
+
+    /**
+     * @brief Splits a chunk of file data into complete lines.
+     *
+     * Lines end at '\n' (not included). Data after the last newline is
+     * appended to pendingLine and completed by a later chunk.
+     *
+     * @param data The chunk of data.
+     * @param length The number of bytes in the chunk.
+     * @param pendingLine The partial line carried between chunks.
+     * @param handler Called with each complete line.
+     * @return The number of complete lines.
+     */
+    template <typename LineHandler>
+    static size_t splitLines(const char* data, size_t length, std::string& pendingLine, LineHandler&& handler) {
+        size_t lines = 0;
+        size_t start = 0;
+        while (start < length) {
+            const char* newline = static_cast<const char*>(std::memchr(data + start, '\n', length - start));
+            if (newline == nullptr) {
+                pendingLine.append(data + start, length - start);
+                break;
+            }
+            size_t end = static_cast<size_t>(newline - data);
+            pendingLine.append(data + start, end - start);
+            handler(static_cast<const std::string&>(pendingLine));
+            pendingLine.clear();
+            start = end + 1;
+            lines++;
+        }
+        return lines;
+    }
+
+private:
+    /**
+     * @brief Where a batched access log row came from, so it can be traced and acknowledged.
+     */
+    struct AccessRow {
+        uint64_t endOffset; ///< Offset just past the row's line.
+        uint32_t lagGeneration; ///< Generation returned by LagTracker::track().
+        int64_t notified; ///< When the write was noticed.
+        int64_t read; ///< When the row's chunk was read.
+    };
+
+    /// Size of the buffer used to read appended data.
+    static const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+    /// How often monitor() checks for a stop request while idle, in milliseconds.
+    static const int POLL_INTERVAL_MS = 200;
+
+    /**
+     * @brief Sets up the inotify watch on the monitored file.
+     */
+    void initInotify();
+
+    /**
+     * @brief Registers the file's statistics with the shared memory stats segment.
+     */
+    void registerStats();
+
+
+    /**
+     * @brief Refreshes the lag metrics and sends a health event if an alert was raised or cleared.
+     */
+    void checkLag();
+
+    /**
+     * @brief Formats a lag health event as a JSON message.
+     * @param messageType "LAG" or "LAG RECOVERED".
+     * @return A formatted string containing the message.
+     */
+    std::string formatLagEvent(const std::string& messageType);
+
+    /**
+     * @brief Formats a templated line as a JSON message.
+     * @param templateId The ID of the template the line belongs to.
+     * @param params The line's tokens at the template's wildcard positions.
+     * @return A formatted string containing the message.
+     */
+    std::string formatTemplateMatch(int templateId, const std::vector<std::string>& params);
+
+    /**
+     * @brief Formats a template definition as a JSON message.
+     * @param templateId The ID of the template.
+     * @param templateText The template text.
+     * @return A formatted string containing the message.
+     */
+    std::string formatTemplateDefinition(int templateId, const std::string& templateText);
+
+
+    /**
+     * @brief Reads the lines appended since the last read, throttled by the rate limiters, and sends them.
+     * @param notified When the modification was noticed, for latency tracing.
+     */
+    void readNewLines(int64_t notified);
+
+    /**
+     * @brief Sends one line read from the file, templated if template mining is enabled.
+     * @param line The line to send.
+     * @param trace The line's latency trace; ownership is taken.
+     */
+    void sendLine(const std::string& line, EventTrace* trace);
+
+    /**
+     * @brief Sends one message traced from an origin; on failure its offset is acknowledged, as it is not retried.
+     * @param notified When inotify reported the write of the message's first line.
+     * @param read When the chunk holding that line was read.
+     * @param endOffset Offset just past the message's last line.
+     * @param lagGeneration Generation of that line in the lag tracker.
+     * @param send Formats and sends the message; takes ownership of the trace.
+     */
+    template <typename Send>
+    void sendTraced(int64_t notified, int64_t read, uint64_t endOffset, uint32_t lagGeneration, Send send);
+
+    /**
+     * @brief Sends the audit events completed so far and acknowledges their records.
+     */
+    void sendAuditEvents();
+
+    /**
+     * @brief Sends the rows of the access log batch and clears it.
+     */
+    void sendAccessBatch();
+
+    /**
+     * @brief Appends the line's extracted and parsed fields to a formatted message.
+     * @param message The message; a "fields" object is inserted before its closing brace.
+     * @note The fields must already be reset to, and the parser run on, the line.
+     */
+    void appendFields(std::string& message);
 
     /**
      * @brief Sends a message to the Kafka topic.
      * @param message The message to be sent.
+     * @param key The message key used for partitioning; empty for no key.
+     * @param trace Latency trace for the message, or nullptr; ownership is taken.
      */
-    void sendToKafka(const std::string& message);
+    void sendToKafka(const std::string& message, const std::string& key = "", EventTrace* trace = nullptr);
 
     // Member variables
     std::string filePath; ///< The path of the file being monitored.
     std::string kafkaBroker; ///< The address of the Kafka broker.
     std::string kafkaTopic; ///< The Kafka topic to which messages are sent.
-    RdKafka::Producer* producer; ///< Pointer to the Kafka producer instance.
+    std::unique_ptr<KafkaSink> sink; ///< Own Kafka producer stage, or null when sending through a lane.
+    LaneScheduler* scheduler; ///< Shared lane scheduler, or null when using the own sink.
+    LaneScheduler::Priority priority; ///< Lane used with the scheduler.
+    std::atomic<bool> running; ///< Cleared by stop() to end monitor().
     int inotifyFd; ///< File descriptor for the inotify instance.
     int watchFd; ///< File descriptor for the inotify watch.
+    bool templateMining; ///< Whether lines are sent as template ID plus parameters.
+    TemplateMiner templateMiner; ///< Online template miner for this file.
+    RateLimiter limiter; ///< Per-file rate limiter, child of the pipeline limiter.
+    LatencyTracker latency; ///< Per-stage latency histograms for this file.
+    LagTracker lag; ///< Committed offset and age of the oldest unshipped byte.
+    HealthReporter* healthReporter; ///< Destination of lag health events, or null.
+    TraceWriter* capture; ///< Capture trace recording the data read, or null.
+    std::unique_ptr<FieldExtractor::Fields> fields; ///< Field extraction for the file's sourcetype, or null.
+    LineFilter::Binding filter; ///< Drop and keep rules for the file; keeps everything by default.
+    const HashSampler* sampler; ///< Consistent-hash sampler, or null.
+    std::string sampleRateJson; ///< The sampler's `, "sampleRate": RATE` envelope member.
+    std::unique_ptr<JsonLogParser> json; ///< Parser for JSON lines, or null.
+    std::unique_ptr<KeyValueParser> lineParser; ///< Parser for key=value, CEF or LEEF lines, or null.
+    std::unique_ptr<SyslogParser> syslog; ///< Syslog header decoder, or null.
+    std::unique_ptr<TimestampParser> timestamps; ///< Event time extraction, or null.
+    std::unique_ptr<AuditCorrelator> audit; ///< Groups auditd records into events, or null.
+    std::vector<AuditCorrelator::Event> auditDone; ///< Completed audit events waiting to be sent.
+    std::unique_ptr<AccessLogParser> accessParser; ///< Access log parser, or null.
+    AccessLogBatch accessBatch; ///< Access log rows of the current chunk.
+    std::vector<AccessRow> accessRows; ///< Origin of each row in accessBatch.
+    AccessLogBatch::Encoding accessEncoding; ///< How access log rows are sent.
+    size_t accessBatchRows; ///< Most rows per access log batch.
+    Metrics::Counter& linesRead; ///< sparky_lines_read_total
+    Metrics::Counter& bytesRead; ///< sparky_bytes_read_total
+    Metrics::Counter& linesDropped; ///< sparky_lines_dropped_total
+    Metrics::Counter& jsonInvalid; ///< sparky_json_invalid_total
+    Metrics::Counter& parseFailed; ///< sparky_parse_failed_total
+    Metrics::Counter& syslogInvalid; ///< sparky_syslog_invalid_total
+    Metrics::Counter& timestampMissing; ///< sparky_timestamp_missing_total
+    Metrics::Counter& accessInvalid; ///< sparky_access_invalid_total
+    Metrics::Gauge& lagBytes; ///< sparky_file_lag_bytes: bytes in the file not yet read
+    Metrics::Gauge& fileSizeBytes; ///< sparky_file_size_bytes
+    Metrics::Gauge& readOffsetBytes; ///< sparky_file_read_offset_bytes
+    uint64_t readOffset; ///< Offset in the file up to which data has been read.
+    uint64_t lineEndOffset; ///< Offset just past the last complete line read.
+    std::string pendingLine; ///< Partial last line waiting for its newline.
+    int64_t reportedBacklog; ///< Unread bytes last reported to the CPU governor.
+    size_t unpolled; ///< Messages produced since delivery reports were last served.
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "HashSampler.h"
+#include <stdexcept>               // Used for std::invalid_argument
+#include <cstring>                 // Used for memcpy()
+#include <cmath>                   // Used for std::ldexp
+
+namespace {
+
+/// Odd mixing constants of the hash.
+const uint64_t PRIME0 = 0xa0761d6478bd642fULL;
+const uint64_t PRIME1 = 0xe7037ed1a0b428dbULL;
+const uint64_t PRIME2 = 0x8ebc6af09c88c6e3ULL;
+
+/**
+ * @brief Multiplies two words into 128 bits and folds the halves together.
+ *
+ * @param a First factor.
+ * @param b Second factor.
+ * @return Low half XOR high half of the product.
+ */
+inline uint64_t mix(uint64_t a, uint64_t b) {
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+/**
+ * @brief Reads 8 bytes as a little-endian word.
+ *
+ * @param p The bytes.
+ * @return The word.
+ */
+inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+/**
+ * @brief Reads 4 bytes as a little-endian word.
+ *
+ * @param p The bytes.
+ * @return The word.
+ */
+inline uint64_t read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+/**
+ * @brief Checks a sampling rate.
+ *
+ * @param rate The rate.
+ * @return The rate.
+ *
+ * @throws std::invalid_argument If it is not between 0 and 1.
+ */
+double checkedRate(double rate) {
+    if (!(rate >= 0 && rate <= 1)) {
+        throw std::invalid_argument("Sampling rate must be between 0 and 1");
+    }
+    return rate;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a sampler keyed by the whole line.
+ *
+ * @param name Sampler name.
+ * @param rate Fraction of events kept.
+ * @param seed Hash seed.
+ *
+ * @throws std::invalid_argument If the rate is not between 0 and 1.
+ */
+HashSampler::HashSampler(const std::string& name, double rate, uint64_t seed)
+    : sampleRate(checkedRate(rate)), threshold(rate >= 1 ? 0 : static_cast<uint64_t>(std::ldexp(rate, 64))),
+      keepAll(rate >= 1), seed(seed), byField(false), field(0),
+      kept(Metrics::instance().counter("sparky_sampler_kept_total", Metrics::label("sampler", name))),
+      rejected(Metrics::instance().counter("sparky_sampler_rejected_total", Metrics::label("sampler", name))) {
+}
+
+/**
+ * @brief Constructs a sampler keyed by a field, and references the field.
+ *
+ * @param name Sampler name.
+ * @param rate Fraction of events kept.
+ * @param extractor The extractor providing the field.
+ * @param field The field name.
+ * @param seed Hash seed.
+ *
+ * @throws std::invalid_argument If the rate is not between 0 and 1.
+ */
+HashSampler::HashSampler(const std::string& name, double rate, FieldExtractor& extractor, const std::string& field, uint64_t seed)
+    : HashSampler(name, rate, seed) {
+    byField = true;
+    this->field = extractor.reference(field);
+}
+
+/**
+ * @brief Hashes the event's key and compares it with the threshold.
+ *
+ * @param line The line.
+ * @param fields The line's fields, or nullptr.
+ * @return True if the event is kept.
+ */
+bool HashSampler::keep(std::string_view line, FieldExtractor::Fields* fields) const {
+    std::string_view key = line;
+    if (byField && fields) {
+        std::string_view value;
+        if (fields->get(field, value)) {
+            key = value;
+        }
+    }
+    bool inSample = keepAll || hash(key, seed) < threshold;
+    (inSample ? kept : rejected).add();
+    return inSample;
+}
+
+/**
+ * @brief Hashes bytes, 16 at a time, with 64x64->128-bit multiply-and-fold rounds.
+ *
+ * Keys up to 16 bytes, the common case for IDs, are read with at most four
+ * overlapping loads and no loop.
+ *
+ * @param data The bytes.
+ * @param seed The seed.
+ * @return The hash.
+ */
+uint64_t HashSampler::hash(std::string_view data, uint64_t seed) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+    size_t length = data.size();
+    seed ^= mix(seed ^ PRIME0, PRIME1);
+    uint64_t a;
+    uint64_t b;
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + middle);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - middle);
+        } else if (length > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t remaining = length;
+        while (remaining > 16) {
+            seed = mix(read64(p) ^ PRIME1, read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+    return mix(PRIME1 ^ length, mix(a ^ PRIME1, b ^ seed ^ PRIME2));
+}
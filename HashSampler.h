@@ -0,0 +1,93 @@
+#ifndef HASHSAMPLER_H
+#define HASHSAMPLER_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include "FieldExtractor.h"
+#include "Metrics.h"
+
+
+/**
+ * @class HashSampler
+ * @brief Keeps a fixed fraction of events, chosen by a hash of a field or of the whole line.
+ *
+ * An event is kept when the 64-bit hash of its key is below rate * 2^64. The
+ * decision depends only on the key, the rate and the seed, so every host
+ * running the same configuration samples the same request IDs, and lowering
+ * the rate only ever removes keys from the sample. Kept events carry the
+ * rate in their envelope as "sampleRate", so counts downstream can be scaled
+ * by 1 / sampleRate.
+ *
+ * The key is a field from a FieldExtractor, e.g. a request ID; lines where
+ * the field is missing are keyed by the whole line.
+ *
+ * Exported per sampler:
+ * - sparky_sampler_kept_total
+ * - sparky_sampler_rejected_total
+ */
+class HashSampler {
+public:
+    /**
+     * @brief Constructs a sampler keyed by the whole line.
+     * @param name Sampler name, used as the `sampler` metric label.
+     * @param rate Fraction of events kept, 0 to 1.
+     * @param seed Hash seed; samplers with the same seed and rate pick the same keys.
+     * @throws std::invalid_argument If the rate is not between 0 and 1.
+     */
+    HashSampler(const std::string& name, double rate, uint64_t seed = 0);
+
+    /**
+     * @brief Constructs a sampler keyed by an extracted field.
+     * @param name Sampler name, used as the `sampler` metric label.
+     * @param rate Fraction of events kept, 0 to 1.
+     * @param extractor The extractor; the field is referenced in it, so construct the sampler
+     *        before monitors enable extraction.
+     * @param field The field to hash, e.g. "request_id".
+     * @param seed Hash seed.
+     * @throws std::invalid_argument If the rate is not between 0 and 1.
+     */
+    HashSampler(const std::string& name, double rate, FieldExtractor& extractor, const std::string& field, uint64_t seed = 0);
+
+    HashSampler(const HashSampler&) = delete;
+    HashSampler& operator=(const HashSampler&) = delete;
+
+    /**
+     * @brief Decides whether an event is kept.
+     * @param line The line.
+     * @param fields The line's fields, already reset to it, or nullptr to key by the line.
+     * @return True if the event is in the sample.
+     */
+    bool keep(std::string_view line, FieldExtractor::Fields* fields) const;
+
+    /**
+     * @brief Retrieves the sampling rate.
+     * @return The fraction of events kept.
+     */
+    double rate() const { return sampleRate; }
+
+    /**
+     * @brief Hashes bytes with a fast, seedable 64-bit hash.
+     *
+     * The output is part of the sampling contract: it must stay the same
+     * across versions and hosts, so never change it.
+     *
+     * @param data The bytes.
+     * @param seed The seed.
+     * @return The hash.
+     */
+    static uint64_t hash(std::string_view data, uint64_t seed);
+
+private:
+    double sampleRate; ///< Fraction of events kept.
+    uint64_t threshold; ///< Hashes below this are kept.
+    bool keepAll; ///< Whether the rate is 1, which no threshold can express.
+    uint64_t seed; ///< Hash seed.
+    bool byField; ///< Whether the key is a field rather than the line.
+    size_t field; ///< Field index in the extractor.
+    Metrics::Counter& kept; ///< sparky_sampler_kept_total
+    Metrics::Counter& rejected; ///< sparky_sampler_rejected_total
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "HealthReporter.h"
+#include <iostream>                // Used for std::cerr
+#include <stdexcept>               // Used for std::exception
+
+/**
+ * @brief Constructs a HealthReporter with its own producer.
+ *
+ * @param kafkaBroker The Kafka broker address to connect to.
+ * @param kafkaTopic The topic health events are sent to.
+ * @param producerConfig Additional librdkafka properties for the producer.
+ *
+ * @throws std::runtime_error If the producer cannot be created.
+ */
+HealthReporter::HealthReporter(const std::string& kafkaBroker, const std::string& kafkaTopic,
+                               const std::map<std::string, std::string>& producerConfig)
+    : kafkaTopic(kafkaTopic), sink(kafkaBroker, kafkaTopic, "health:" + kafkaTopic, producerConfig) {
+}
+
+/**
+ * @brief Flushes outstanding events before the producer is destroyed.
+ */
+HealthReporter::~HealthReporter() {
+    std::lock_guard<std::mutex> lock(mutex);
+    sink.flush(FLUSH_TIMEOUT_MS);
+}
+
+/**
+ * @brief Sends a health event and serves pending delivery reports.
+ *
+ * A failure is logged and otherwise ignored: health reporting must never
+ * interrupt forwarding.
+ *
+ * @param message The formatted event.
+ * @param key The message key used for partitioning; empty for no key.
+ */
+void HealthReporter::report(const std::string& message, const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    try {
+        sink.produce(message, key);
+    } catch (const std::exception& e) {
+        std::cerr << "Error sending health event to Kafka: " << e.what() << std::endl;
+    }
+    sink.poll();
+}
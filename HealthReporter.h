@@ -0,0 +1,61 @@
+#ifndef HEALTHREPORTER_H
+#define HEALTHREPORTER_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include "KafkaSink.h"
+
+
+/**
+ * @class HealthReporter
+ * @brief Sends the forwarder's own health events to a dedicated Kafka topic.
+ *
+ * Health events (e.g. a file's lag crossing its threshold) are rare, so one
+ * producer is shared by all monitors and every call to report() is serialized
+ * and followed by a poll. Keeping them off the data topic means they are
+ * neither rate limited, sampled nor stuck behind the backlog they report.
+ */
+class HealthReporter {
+public:
+    /**
+     * @brief Constructs a HealthReporter.
+     * @param kafkaBroker The address of the Kafka broker.
+     * @param kafkaTopic The topic health events are sent to.
+     * @param producerConfig Additional librdkafka properties for the producer.
+     * @throws std::runtime_error If the producer cannot be created.
+     */
+    HealthReporter(const std::string& kafkaBroker, const std::string& kafkaTopic,
+                   const std::map<std::string, std::string>& producerConfig = {});
+
+    /**
+     * @brief Waits briefly for outstanding events and destroys the producer.
+     */
+    ~HealthReporter();
+
+    HealthReporter(const HealthReporter&) = delete;
+    HealthReporter& operator=(const HealthReporter&) = delete;
+
+    /**
+     * @brief Sends an event. Safe to call from any thread; errors are logged, not thrown.
+     * @param message The formatted event.
+     * @param key The message key; empty for no key.
+     */
+    void report(const std::string& message, const std::string& key = "");
+
+    /**
+     * @brief Retrieves the health topic.
+     * @return The topic name.
+     */
+    const std::string& topic() const { return kafkaTopic; }
+
+private:
+    /// How long the destructor waits for outstanding events, in milliseconds.
+    static const int FLUSH_TIMEOUT_MS = 1000;
+
+    std::string kafkaTopic; ///< The health topic.
+    std::mutex mutex; ///< Serializes use of the sink.
+    KafkaSink sink; ///< Producer for the health topic.
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "JsonEscape.h"
+#include <cstdio>                  // Used for std::snprintf
+
+/**
+ * @brief Appends text to a JSON string literal.
+ *
+ * @param out The literal being built.
+ * @param text The text.
+ */
+void appendEscapedJson(std::string& out, std::string_view text) {
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        out.append(text.data() + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char unicode[7];
+                std::snprintf(unicode, sizeof(unicode), "\\u%04x", c);
+                out += unicode;
+            }
+        }
+    }
+    out.append(text.data() + run, text.size() - run);
+}
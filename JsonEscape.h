@@ -0,0 +1,20 @@
+#ifndef JSONESCAPE_H
+#define JSONESCAPE_H
+
+#include <string>
+#include <string_view>
+
+
+/**
+ * @brief Appends text to a JSON string literal.
+ *
+ * Quotes, backslashes and control characters are escaped; all other bytes,
+ * including UTF-8 sequences, are copied unchanged. Runs of bytes that need no
+ * escaping are appended at once.
+ *
+ * @param out The literal being built, without its closing quote.
+ * @param text The text.
+ */
+void appendEscapedJson(std::string& out, std::string_view text);
+
+#endif
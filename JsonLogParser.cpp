@@ -0,0 +1,575 @@
+#include "JsonLogParser.h"
+#include <cstring>                 // Used for memcmp() and strchr()
+#include <cstdint>                 // Used for uint32_t
+
+#if defined(__SSE2__)
+#include <emmintrin.h>             // Used for the 16-byte string scan
+#endif
+
+namespace {
+
+/// Deepest nesting accepted, so hostile lines cannot exhaust the stack.
+const int MAX_DEPTH = 128;
+
+/// Envelope members a log member must not shadow.
+const char* const ENVELOPE_KEYS[] = {"timestamp", "filePath", "kafkaTopic", "type", "fields", "sampleRate", "syslog", "ingestTimestamp"};
+
+/// Prefix given to log members whose key collides with the envelope.
+const char COLLISION_PREFIX[] = "log_";
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline bool isHex(char c) {
+    return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * @brief Reads the four hex digits of a `\\u` escape.
+ *
+ * @param digits The digits, already validated.
+ * @return The code unit.
+ */
+uint32_t hexValue(const char* digits) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = digits[i];
+        value = value << 4 | static_cast<uint32_t>(isDigit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return value;
+}
+
+/**
+ * @brief Appends a code point as UTF-8.
+ *
+ * @param out The string to append to.
+ * @param codePoint The code point; lone surrogates are encoded as they are.
+ */
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xc0 | codePoint >> 6);
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xe0 | codePoint >> 12);
+        out += static_cast<char>(0x80 | (codePoint >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | codePoint >> 18);
+        out += static_cast<char>(0x80 | (codePoint >> 12 & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+}
+
+/**
+ * @brief Decodes the escapes of a key, so keys can be compared by what they spell.
+ *
+ * @param key The key as written; its escapes were validated by the parser.
+ * @param buffer Holds the decoded key if it has escapes.
+ * @return The key itself if it has no escapes, otherwise a view of the buffer.
+ */
+std::string_view unescapeKey(std::string_view key, std::string& buffer) {
+    if (key.find('\\') == std::string_view::npos) {
+        return key;
+    }
+    buffer.clear();
+    for (size_t i = 0; i < key.size(); ++i) {
+        if (key[i] != '\\') {
+            buffer += key[i];
+            continue;
+        }
+        char escape = key[++i];
+        switch (escape) {
+            case 'b': buffer += '\b'; break;
+            case 'f': buffer += '\f'; break;
+            case 'n': buffer += '\n'; break;
+            case 'r': buffer += '\r'; break;
+            case 't': buffer += '\t'; break;
+            case 'u': {
+                uint32_t unit = hexValue(key.data() + i + 1);
+                i += 4;
+                if (unit >= 0xd800 && unit < 0xdc00 && i + 6 < key.size() && key[i + 1] == '\\' && key[i + 2] == 'u') {
+                    uint32_t low = hexValue(key.data() + i + 3);
+                    if (low >= 0xdc00 && low < 0xe000) {
+                        unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                        i += 6;
+                    }
+                }
+                appendUtf8(buffer, unit);
+                break;
+            }
+            default: buffer += escape; break;
+        }
+    }
+    return buffer;
+}
+
+/**
+ * @brief Checks whether a key is one of the envelope's own.
+ *
+ * @param key The key.
+ * @return True if it collides.
+ */
+bool isEnvelopeKey(std::string_view key) {
+    for (const char* envelopeKey : ENVELOPE_KEYS) {
+        if (key == envelopeKey) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+JsonLogParser::JsonLogParser() = default;
+
+/**
+ * @brief Renames a member in the envelope.
+ *
+ * @param from The key in the log line.
+ * @param to The key in the envelope.
+ */
+void JsonLogParser::rename(const std::string& from, const std::string& to) {
+    renames[from] = to;
+}
+
+/**
+ * @brief Leaves a member out of the envelope.
+ *
+ * @param key The key in the log line.
+ */
+void JsonLogParser::drop(const std::string& key) {
+    drops.insert(key);
+}
+
+/**
+ * @brief Validates a line as one JSON object and records its top-level members.
+ *
+ * @param line The line.
+ * @return True if the line is a single valid object.
+ */
+bool JsonLogParser::parse(std::string_view line) {
+    parsed.clear();
+    Cursor cursor{line.data(), line.data() + line.size()};
+    skipWhitespace(cursor);
+    if (cursor.position == cursor.end || *cursor.position != '{' || !parseObject(cursor, 0, &parsed)) {
+        parsed.clear();
+        return false;
+    }
+    skipWhitespace(cursor);
+    if (cursor.position != cursor.end) {
+        parsed.clear();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Looks up a top-level member; the last one wins if a key repeats.
+ *
+ * @param key The key as written.
+ * @param value Receives the value's JSON text.
+ * @return False if there is no such member.
+ */
+bool JsonLogParser::get(std::string_view key, std::string_view& value) const {
+    for (auto it = parsed.rbegin(); it != parsed.rend(); ++it) {
+        if (it->key == key) {
+            value = it->value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Finds the key a member goes into the envelope under, before any collision prefix.
+ *
+ * @param member The member.
+ * @param key Receives the key as it will be written: renamed, or as in the line.
+ * @return False if the member is dropped.
+ */
+bool JsonLogParser::envelopeKey(const Member& member, std::string_view& key) const {
+    if (!drops.empty() && drops.find(member.key) != drops.end()) {
+        return false;
+    }
+    key = member.key;
+    if (!renames.empty()) {
+        auto it = renames.find(member.key);
+        if (it != renames.end()) {
+            key = it->second;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Copies the members into the envelope, applying drops, renames and collision prefixes.
+ *
+ * Keys are checked against the envelope's with their escapes decoded, so
+ * `"time\u0073tamp"` is prefixed like `"timestamp"`. If the prefixed key
+ * is taken by another member, e.g. the line has both `timestamp` and
+ * `log_timestamp`, a counter is appended (`log_timestamp_2`) so the
+ * envelope never repeats a key. The set of taken keys is only built for
+ * lines with a collision.
+ *
+ * @param out The envelope, without its closing brace.
+ */
+void JsonLogParser::appendMembers(std::string& out) const {
+    std::string buffer;
+    std::set<std::string, std::less<>> taken;
+    for (const Member& member : parsed) {
+        std::string_view key;
+        if (!envelopeKey(member, key)) {
+            continue;
+        }
+        out += ", \"";
+        std::string_view name = unescapeKey(key, buffer);
+        if (isEnvelopeKey(name)) {
+            if (taken.empty()) {
+                std::string other;
+                for (const Member& each : parsed) {
+                    std::string_view eachKey;
+                    if (envelopeKey(each, eachKey)) {
+                        taken.emplace(unescapeKey(eachKey, other));
+                    }
+                }
+            }
+            std::string prefixed = COLLISION_PREFIX + std::string(name);
+            std::string suffix;
+            for (int n = 2; taken.find(prefixed + suffix) != taken.end(); ++n) {
+                suffix = "_" + std::to_string(n);
+            }
+            taken.insert(prefixed + suffix);
+            out += COLLISION_PREFIX;
+            out.append(key.data(), key.size());
+            out += suffix;
+        } else {
+            out.append(key.data(), key.size());
+        }
+        out += "\": ";
+        out.append(member.value.data(), member.value.size());
+    }
+}
+
+/**
+ * @brief Checks that a string is one valid JSON value.
+ *
+ * @param text The text.
+ * @return True if valid.
+ */
+bool JsonLogParser::validate(std::string_view text) {
+    Cursor cursor{text.data(), text.data() + text.size()};
+    skipWhitespace(cursor);
+    if (!parseValue(cursor, 0)) {
+        return false;
+    }
+    skipWhitespace(cursor);
+    return cursor.position == cursor.end;
+}
+
+/**
+ * @brief Skips JSON whitespace.
+ *
+ * @param cursor The cursor.
+ */
+void JsonLogParser::skipWhitespace(Cursor& cursor) {
+    while (cursor.position < cursor.end) {
+        char c = *cursor.position;
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            return;
+        }
+        cursor.position++;
+    }
+}
+
+/**
+ * @brief Parses any value.
+ *
+ * @param cursor The cursor, at the value.
+ * @param depth Nesting depth of the value.
+ * @return True if a valid value was consumed.
+ */
+bool JsonLogParser::parseValue(Cursor& cursor, int depth) {
+    if (cursor.position >= cursor.end) {
+        return false;
+    }
+    switch (*cursor.position) {
+        case '{': return parseObject(cursor, depth, nullptr);
+        case '[': return parseArray(cursor, depth);
+        case '"': return parseString(cursor);
+        case 't': return parseLiteral(cursor, "true", 4);
+        case 'f': return parseLiteral(cursor, "false", 5);
+        case 'n': return parseLiteral(cursor, "null", 4);
+        default: return parseNumber(cursor);
+    }
+}
+
+/**
+ * @brief Parses an object, optionally recording its members.
+ *
+ * @param cursor The cursor, at '{'.
+ * @param depth Nesting depth of the object.
+ * @param members Receives the members, or nullptr to only validate.
+ * @return True if a valid object was consumed.
+ */
+bool JsonLogParser::parseObject(Cursor& cursor, int depth, std::vector<Member>* members) {
+    if (depth >= MAX_DEPTH) {
+        return false;
+    }
+    cursor.position++;
+    skipWhitespace(cursor);
+    if (cursor.position < cursor.end && *cursor.position == '}') {
+        cursor.position++;
+        return true;
+    }
+    while (true) {
+        if (cursor.position >= cursor.end || *cursor.position != '"') {
+            return false;
+        }
+        const char* keyStart = cursor.position + 1;
+        if (!parseString(cursor)) {
+            return false;
+        }
+        const char* keyEnd = cursor.position - 1;
+        skipWhitespace(cursor);
+        if (cursor.position >= cursor.end || *cursor.position != ':') {
+            return false;
+        }
+        cursor.position++;
+        skipWhitespace(cursor);
+        const char* valueStart = cursor.position;
+        if (!parseValue(cursor, depth + 1)) {
+            return false;
+        }
+        if (members) {
+            members->push_back(Member{std::string_view(keyStart, static_cast<size_t>(keyEnd - keyStart)),
+                                      std::string_view(valueStart, static_cast<size_t>(cursor.position - valueStart))});
+        }
+        skipWhitespace(cursor);
+        if (cursor.position >= cursor.end) {
+            return false;
+        }
+        if (*cursor.position == '}') {
+            cursor.position++;
+            return true;
+        }
+        if (*cursor.position != ',') {
+            return false;
+        }
+        cursor.position++;
+        skipWhitespace(cursor);
+    }
+}
+
+/**
+ * @brief Parses an array.
+ *
+ * @param cursor The cursor, at '['.
+ * @param depth Nesting depth of the array.
+ * @return True if a valid array was consumed.
+ */
+bool JsonLogParser::parseArray(Cursor& cursor, int depth) {
+    if (depth >= MAX_DEPTH) {
+        return false;
+    }
+    cursor.position++;
+    skipWhitespace(cursor);
+    if (cursor.position < cursor.end && *cursor.position == ']') {
+        cursor.position++;
+        return true;
+    }
+    while (true) {
+        if (!parseValue(cursor, depth + 1)) {
+            return false;
+        }
+        skipWhitespace(cursor);
+        if (cursor.position >= cursor.end) {
+            return false;
+        }
+        if (*cursor.position == ']') {
+            cursor.position++;
+            return true;
+        }
+        if (*cursor.position != ',') {
+            return false;
+        }
+        cursor.position++;
+        skipWhitespace(cursor);
+    }
+}
+
+/**
+ * @brief Parses a string, checking escapes and UTF-8.
+ *
+ * Runs of plain printable ASCII are skipped 16 bytes at a time: a block is
+ * examined byte by byte only if it holds a quote, a backslash, a control
+ * byte or a byte of a multibyte UTF-8 sequence.
+ *
+ * @param cursor The cursor, at the opening quote.
+ * @return True if a valid string was consumed.
+ */
+bool JsonLogParser::parseString(Cursor& cursor) {
+    cursor.position++;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(0x20);
+#endif
+    while (true) {
+#if defined(__SSE2__)
+        while (cursor.end - cursor.position >= 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cursor.position));
+            // Signed comparison: control bytes and bytes >= 0x80 are both below 0x20
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                                           _mm_cmplt_epi8(block, space));
+            int mask = _mm_movemask_epi8(special);
+            if (mask != 0) {
+                cursor.position += __builtin_ctz(static_cast<unsigned>(mask));
+                break;
+            }
+            cursor.position += 16;
+        }
+#endif
+        if (cursor.position >= cursor.end) {
+            return false;
+        }
+        unsigned char c = static_cast<unsigned char>(*cursor.position);
+        if (c == '"') {
+            cursor.position++;
+            return true;
+        }
+        if (c == '\\') {
+            if (cursor.end - cursor.position < 2) {
+                return false;
+            }
+            char escaped = cursor.position[1];
+            if (escaped == 'u') {
+                if (cursor.end - cursor.position < 6 || !isHex(cursor.position[2]) || !isHex(cursor.position[3]) ||
+                    !isHex(cursor.position[4]) || !isHex(cursor.position[5])) {
+                    return false;
+                }
+                cursor.position += 6;
+            } else if (escaped != '\0' && std::strchr("\"\\/bfnrt", escaped)) {
+                cursor.position += 2;
+            } else {
+                return false;
+            }
+        } else if (c < 0x20) {
+            return false;
+        } else if (c >= 0x80) {
+            if (!skipUtf8(cursor)) {
+                return false;
+            }
+        } else {
+            cursor.position++;
+        }
+    }
+}
+
+/**
+ * @brief Consumes one multibyte UTF-8 sequence, rejecting overlong forms, surrogates and code points above U+10FFFF.
+ *
+ * @param cursor The cursor, at the lead byte.
+ * @return True if the sequence is valid.
+ */
+bool JsonLogParser::skipUtf8(Cursor& cursor) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(cursor.position);
+    size_t available = static_cast<size_t>(cursor.end - cursor.position);
+    unsigned char lead = p[0];
+    size_t length;
+    unsigned char low = 0x80;
+    unsigned char high = 0xbf;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        if (lead == 0xe0) {
+            low = 0xa0;
+        } else if (lead == 0xed) {
+            high = 0x9f;
+        }
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        if (lead == 0xf0) {
+            low = 0x90;
+        } else if (lead == 0xf4) {
+            high = 0x8f;
+        }
+    } else {
+        return false;
+    }
+    if (available < length || p[1] < low || p[1] > high) {
+        return false;
+    }
+    for (size_t i = 2; i < length; ++i) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return false;
+        }
+    }
+    cursor.position += length;
+    return true;
+}
+
+/**
+ * @brief Parses a number: optional minus, integer without leading zeros, optional fraction and exponent.
+ *
+ * @param cursor The cursor, at the number.
+ * @return True if a valid number was consumed.
+ */
+bool JsonLogParser::parseNumber(Cursor& cursor) {
+    const char*& p = cursor.position;
+    if (p < cursor.end && *p == '-') {
+        p++;
+    }
+    if (p >= cursor.end || !isDigit(*p)) {
+        return false;
+    }
+    if (*p == '0') {
+        p++;
+    } else {
+        while (p < cursor.end && isDigit(*p)) {
+            p++;
+        }
+    }
+    if (p < cursor.end && *p == '.') {
+        p++;
+        if (p >= cursor.end || !isDigit(*p)) {
+            return false;
+        }
+        while (p < cursor.end && isDigit(*p)) {
+            p++;
+        }
+    }
+    if (p < cursor.end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < cursor.end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p >= cursor.end || !isDigit(*p)) {
+            return false;
+        }
+        while (p < cursor.end && isDigit(*p)) {
+            p++;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Parses true, false or null.
+ *
+ * @param cursor The cursor, at the literal.
+ * @param literal The expected literal.
+ * @param length Its length.
+ * @return True if the literal was consumed.
+ */
+bool JsonLogParser::parseLiteral(Cursor& cursor, const char* literal, size_t length) {
+    if (static_cast<size_t>(cursor.end - cursor.position) < length || std::memcmp(cursor.position, literal, length) != 0) {
+        return false;
+    }
+    cursor.position += length;
+    return true;
+}
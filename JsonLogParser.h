@@ -0,0 +1,114 @@
+#ifndef JSONLOGPARSER_H
+#define JSONLOGPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <set>
+#include <cstddef>
+
+
+/**
+ * @class JsonLogParser
+ * @brief Validates JSON log lines and splices their members into the event envelope.
+ *
+ * Parsing is on demand: the line is validated in full (RFC 8259 grammar and
+ * UTF-8), but only the top-level members are recorded, each as the raw text
+ * of its key and value. Nested values are checked and skipped, never built,
+ * and nothing is unescaped or re-escaped: members are copied into the
+ * envelope byte for byte. Inside strings, 16 bytes are checked at a time
+ * with SSE2 for quotes, backslashes and control or non-ASCII bytes, so plain
+ * ASCII text is skipped in blocks.
+ *
+ * Members can be renamed or dropped on the way into the envelope; keys are
+ * compared as written in the line, escapes included. Members whose key
+ * collides with an envelope member, escapes decoded, are prefixed with
+ * "log_", and numbered (`log_timestamp_2`) if that key is taken too.
+ *
+ * Each monitor has its own parser, since parsing fills per-line state.
+ */
+class JsonLogParser {
+public:
+    /**
+     * @brief A top-level member of the parsed object.
+     */
+    struct Member {
+        std::string_view key; ///< The key, without quotes, as written.
+        std::string_view value; ///< The value's JSON text.
+    };
+
+    JsonLogParser();
+
+    /**
+     * @brief Renames a member in the envelope.
+     * @param from The key in the log line.
+     * @param to The key in the envelope; should not need escaping.
+     */
+    void rename(const std::string& from, const std::string& to);
+
+    /**
+     * @brief Leaves a member out of the envelope.
+     * @param key The key in the log line.
+     */
+    void drop(const std::string& key);
+
+    /**
+     * @brief Parses a line holding one JSON object, with optional surrounding whitespace.
+     * @param line The line; members point into it until the next parse.
+     * @return False if the line is not a single valid JSON object.
+     */
+    bool parse(std::string_view line);
+
+    /**
+     * @brief Retrieves the top-level members of the last parsed line.
+     * @return The members in order.
+     */
+    const std::vector<Member>& members() const { return parsed; }
+
+    /**
+     * @brief Retrieves a top-level member's value.
+     * @param key The key, as written in the line.
+     * @param value Receives the value's JSON text, e.g. `"error"` with quotes or `42`.
+     * @return False if the object has no such member.
+     */
+    bool get(std::string_view key, std::string_view& value) const;
+
+    /**
+     * @brief Appends the members as `, "key": value` pairs, with renames and drops applied.
+     * @param out The envelope being built.
+     */
+    void appendMembers(std::string& out) const;
+
+    /**
+     * @brief Checks that a string is a single valid JSON value of any type.
+     * @param text The text.
+     * @return True if valid.
+     */
+    static bool validate(std::string_view text);
+
+private:
+    /**
+     * @brief Cursor over the text being parsed.
+     */
+    struct Cursor {
+        const char* position; ///< Next byte.
+        const char* end; ///< End of the text.
+    };
+
+    static void skipWhitespace(Cursor& cursor);
+    static bool parseValue(Cursor& cursor, int depth);
+    static bool parseString(Cursor& cursor);
+    static bool parseNumber(Cursor& cursor);
+    static bool parseLiteral(Cursor& cursor, const char* literal, size_t length);
+    static bool parseObject(Cursor& cursor, int depth, std::vector<Member>* members);
+    static bool parseArray(Cursor& cursor, int depth);
+    static bool skipUtf8(Cursor& cursor);
+    bool envelopeKey(const Member& member, std::string_view& key) const;
+
+    std::map<std::string, std::string, std::less<>> renames; ///< Envelope keys by line key.
+    std::set<std::string, std::less<>> drops; ///< Keys left out of the envelope.
+    std::vector<Member> parsed; ///< Members of the last parsed line.
+};
+
+#endif
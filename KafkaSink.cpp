@@ -0,0 +1,529 @@
+#include "KafkaSink.h"
+#include "Probes.h"
+#include "AllocationAccounting.h"
+#include <stdexcept>               // Used for std::runtime_error
+#include <iostream>                // Used for std::cerr
+#include <cstdlib>                 // Used for std::strtod
+#include <algorithm>               // Used for std::find
+#include <pthread.h>               // Used for pthread_getcpuclockid()
+
+namespace {
+
+/// Length of a measurement window.
+const std::chrono::seconds WINDOW_LENGTH(5);
+
+/// How often librdkafka emits statistics, in milliseconds.
+const char* STATS_INTERVAL_MS = "1000";
+
+/// How long to wait for the old producer to drain when switching codecs.
+const int SWITCH_FLUSH_TIMEOUT_MS = 10000;
+
+/// Name of the interceptor that accounts for the CPU time of librdkafka's threads.
+const char* THREAD_INTERCEPTOR = "sparky-thread-cpu";
+
+/**
+ * @brief Reads a CPU-time clock.
+ *
+ * @param clock The clock.
+ * @return Its time in seconds, or 0 if it cannot be read.
+ */
+double clockSeconds(clockid_t clock) {
+    struct timespec time;
+    if (clock_gettime(clock, &time) != 0) {
+        return 0;
+    }
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Reads the number following `"key":` in a JSON document.
+ *
+ * This is just enough to pick scalar counters out of librdkafka's statistics
+ * without a JSON library.
+ *
+ * @param json The JSON document.
+ * @param key The key to look for.
+ * @param from Offset at which to start searching.
+ * @param value Receives the number.
+ * @return The offset just past the number, or std::string::npos if the key was not found.
+ */
+size_t findNumber(const std::string& json, const std::string& key, size_t from, double& value) {
+    std::string needle = "\"" + key + "\":";
+    size_t pos = json.find(needle, from);
+    if (pos == std::string::npos) {
+        return std::string::npos;
+    }
+    const char* start = json.c_str() + pos + needle.size();
+    char* end = nullptr;
+    value = std::strtod(start, &end);
+    return static_cast<size_t>(end - json.c_str());
+}
+
+/**
+ * @brief Top-level librdkafka statistics exported as `sparky_rdkafka_<field>` gauges.
+ *
+ * The queue fields precede the broker objects; the totals follow the topic
+ * objects, so they are the last occurrence of their key.
+ */
+const struct {
+    const char* field;
+    bool last;
+} STATS_GAUGES[] = {
+    {"replyq", false}, {"msg_cnt", false}, {"msg_size", false},
+    {"tx", true}, {"tx_bytes", true}, {"rx", true}, {"rx_bytes", true},
+    {"txmsgs", true}, {"txmsg_bytes", true}
+};
+
+/**
+ * @brief Sums every occurrence of a per-broker number in librdkafka statistics.
+ *
+ * @param json The statistics document.
+ * @param key The key, e.g. "txretries".
+ * @return The sum; 0 if the key does not occur.
+ */
+double sumNumbers(const std::string& json, const std::string& key) {
+    double total = 0;
+    double value = 0;
+    size_t pos = findNumber(json, key, 0, value);
+    while (pos != std::string::npos) {
+        total += value;
+        pos = findNumber(json, key, pos, value);
+    }
+    return total;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a KafkaSink and creates a producer with the tuner's initial codec.
+ *
+ * @param kafkaBroker The address of the Kafka broker.
+ * @param kafkaTopic The Kafka topic to which messages are sent.
+ * @param name Name used to label this sink's metrics.
+ * @param extraConfig Additional librdkafka properties applied to every producer.
+ *
+ * @throws std::runtime_error If the producer cannot be created.
+ */
+KafkaSink::KafkaSink(const std::string& kafkaBroker, const std::string& kafkaTopic, const std::string& name,
+                     const std::map<std::string, std::string>& extraConfig)
+    : kafkaBroker(kafkaBroker), kafkaTopic(kafkaTopic), labels(Metrics::label("sink", name)), extraConfig(extraConfig),
+      deliveryCallback(*this), statsCallback(*this), producer(nullptr),
+      eventsDelivered(Metrics::instance().counter("sparky_events_delivered_total", labels)),
+      deliveryFailures(Metrics::instance().counter("sparky_delivery_failures_total", labels)),
+      eventsProduced(Metrics::instance().counter("sparky_events_produced_total", labels)),
+      queueFull(Metrics::instance().counter("sparky_produce_queue_full_total", labels)),
+      producerQueueDepth(Metrics::instance().gauge("sparky_producer_queue_depth", labels)),
+      codecSwitches(Metrics::instance().counter("sparky_compression_switches_total", labels)),
+      brokerRtt(Metrics::instance().gauge("sparky_broker_rtt_microseconds", labels)) {
+    std::string errstr;
+    producer = createProducer(compressionTuner.codec(compressionTuner.current()), errstr);
+    if (!producer) {
+        throw std::runtime_error("Failed to create Kafka producer: " + errstr);
+    }
+    windowStart = std::chrono::steady_clock::now();
+    windowCpuStart = producerCpuSeconds();
+    publishCodecMetrics();
+}
+
+/**
+ * @brief Destroys the KafkaSink, its producer and any producers still draining after a codec switch.
+ */
+KafkaSink::~KafkaSink() {
+    for (RdKafka::Producer* old : retiring) {
+        delete old;
+    }
+    delete producer;
+}
+
+/**
+ * @brief Creates a producer using the given codec.
+ *
+ * @param codec The compression codec and level.
+ * @param errstr Receives the error description on failure.
+ * @return The producer, or nullptr on failure.
+ */
+RdKafka::Producer* KafkaSink::createProducer(const CompressionTuner::Codec& codec, std::string& errstr) {
+    RdKafka::Conf* conf = RdKafka::Conf::create(RdKafka::Conf::CONF_GLOBAL);
+    bool ok = conf->set("bootstrap.servers", kafkaBroker, errstr) == RdKafka::Conf::CONF_OK &&
+              conf->set("compression.codec", codec.name, errstr) == RdKafka::Conf::CONF_OK &&
+              (codec.level < 0 || conf->set("compression.level", std::to_string(codec.level), errstr) == RdKafka::Conf::CONF_OK) &&
+              conf->set("statistics.interval.ms", STATS_INTERVAL_MS, errstr) == RdKafka::Conf::CONF_OK &&
+              conf->set("dr_cb", &deliveryCallback, errstr) == RdKafka::Conf::CONF_OK &&
+              conf->set("event_cb", &statsCallback, errstr) == RdKafka::Conf::CONF_OK;
+    if (ok && rd_kafka_conf_interceptor_add_on_new(conf->c_ptr_global(), THREAD_INTERCEPTOR, &KafkaSink::onNew, this) != RD_KAFKA_RESP_ERR_NO_ERROR) {
+        errstr = "cannot add the thread CPU interceptor";
+        ok = false;
+    }
+    for (auto it = extraConfig.begin(); ok && it != extraConfig.end(); ++it) {
+        ok = conf->set(it->first, it->second, errstr) == RdKafka::Conf::CONF_OK;
+    }
+    RdKafka::Producer* created = ok ? RdKafka::Producer::create(conf, errstr) : nullptr;
+    delete conf;
+    return created;
+}
+
+/**
+ * @brief Produces a message to the topic with the current codec.
+ *
+ * A keyed message first waits for any producer retired by a codec switch to
+ * drain, so it cannot overtake earlier messages with the same key.
+ *
+ * @param message The message to be sent.
+ * @param key The message key used for partitioning; empty for no key.
+ * @param trace Latency trace for the message, or nullptr. The sink owns it
+ *        only if the message was enqueued.
+ *
+ * @throws std::runtime_error If the message fails to be produced.
+ */
+void KafkaSink::produce(const std::string& message, const std::string& key, EventTrace* trace) {
+    if (!key.empty() && retiredPending()) {
+        for (RdKafka::Producer* old : retiring) {
+            old->flush(SWITCH_FLUSH_TIMEOUT_MS);
+        }
+        if (retiredPending()) {
+            throw std::runtime_error("Failed to produce message: the producer replaced by a codec switch is still draining");
+        }
+    }
+    if (!tryProduce(message, key, trace)) {
+        throw std::runtime_error("Failed to produce message: " + RdKafka::err2str(RdKafka::ERR__QUEUE_FULL));
+    }
+}
+
+/**
+ * @brief Produces a message to the topic unless the producer queue is full.
+ *
+ * A full queue is reported rather than thrown so callers that can hold the
+ * message (e.g. the lane scheduler) can apply backpressure instead. A keyed
+ * message is refused the same way while a producer retired by a codec switch
+ * still holds messages, so it cannot overtake earlier ones with the same key.
+ *
+ * @param message The message to be sent.
+ * @param key The message key used for partitioning; empty for no key.
+ * @param trace Latency trace passed as the message opaque and completed by the
+ *        delivery report, or nullptr. The sink owns it only if the message was enqueued.
+ * @return False if the producer queue is full, or the message is keyed and a
+ *         retired producer is still draining.
+ *
+ * @throws std::runtime_error If the message fails to be produced for any other reason.
+ */
+bool KafkaSink::tryProduce(const std::string& message, const std::string& key, EventTrace* trace) {
+    SPARKY_ALLOC_STAGE(PRODUCE);
+    if (!key.empty() && retiredPending()) {
+        return false;
+    }
+    RdKafka::ErrorCode resp = producer->produce(
+        kafkaTopic, RdKafka::Topic::PARTITION_UA,
+        RdKafka::Producer::RK_MSG_COPY,
+        const_cast<char*>(message.c_str()), message.size(),
+        key.empty() ? nullptr : key.data(), key.size(), 0, nullptr, trace);
+    SPARKY_PROBE4(produce, kafkaTopic.c_str(), message.size(), static_cast<int>(resp), trace ? trace->formatted : 0);
+    if (resp == RdKafka::ERR__QUEUE_FULL) {
+        queueFull.add();
+        return false;
+    }
+    if (resp != RdKafka::ERR_NO_ERROR) {
+        throw std::runtime_error("Failed to produce message: " + RdKafka::err2str(resp));
+    }
+    eventsProduced.add();
+    return true;
+}
+
+/**
+ * @brief Serves delivery reports and statistics without blocking.
+ *
+ * Producers retired by a codec switch are polled too and destroyed once they
+ * have drained. When the current measurement window has elapsed the codec
+ * choice is re-evaluated.
+ */
+void KafkaSink::poll() {
+    SPARKY_ALLOC_STAGE(DELIVERY);
+    producer->poll(0);
+    producerQueueDepth.set(static_cast<double>(producer->outq_len()));
+    retiredPending();
+    if (std::chrono::steady_clock::now() - windowStart >= WINDOW_LENGTH) {
+        evaluate();
+    }
+}
+
+/**
+ * @brief Serves the producers retired by codec switches and destroys those that have drained.
+ *
+ * @return True if a retired producer still holds messages.
+ */
+bool KafkaSink::retiredPending() {
+    for (auto it = retiring.begin(); it != retiring.end();) {
+        (*it)->poll(0);
+        if ((*it)->outq_len() == 0) {
+            delete *it;
+            it = retiring.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return !retiring.empty();
+}
+
+/**
+ * @brief Waits for all outstanding messages, including those of retired producers.
+ *
+ * @param timeoutMs Maximum time to wait for each producer, in milliseconds.
+ */
+void KafkaSink::flush(int timeoutMs) {
+    SPARKY_ALLOC_STAGE(DELIVERY);
+    for (RdKafka::Producer* old : retiring) {
+        old->flush(timeoutMs);
+    }
+    producer->flush(timeoutMs);
+}
+
+/**
+ * @brief Sets the CPU budget the codec choice must respect.
+ *
+ * @param cores CPU budget in cores.
+ */
+void KafkaSink::setCpuBudget(double cores) {
+    compressionTuner.setCpuBudget(cores);
+}
+
+/**
+ * @brief Limits compression to the cheapest maxIndex + 1 candidate codecs.
+ *
+ * @param maxIndex Index of the most expensive codec that may be chosen.
+ */
+void KafkaSink::setMaxCodec(size_t maxIndex) {
+    compressionTuner.setMaxCodec(maxIndex);
+}
+
+/**
+ * @brief Closes the current measurement window and applies the tuner's decision.
+ *
+ * When the codec changes, the current producer is flushed before the new one
+ * takes over so that messages with the same key stay in order. If the flush
+ * times out (e.g. the broker is unreachable) the old producer is kept draining
+ * in the background instead of dropping its queue.
+ *
+ * Without a blocking switch (lane sinks, polled from the dispatcher shared by
+ * every lane) the old producer is retired at once: poll() keeps serving it
+ * without waiting and destroys it once it has drained. Until then
+ * tryProduce() refuses keyed messages, which keeps them in order too.
+ */
+void KafkaSink::evaluate() {
+    auto now = std::chrono::steady_clock::now();
+    double cpuNow = producerCpuSeconds();
+
+    CompressionTuner::Sample sample;
+    sample.seconds = std::chrono::duration<double>(now - windowStart).count();
+    sample.eventsDelivered = windowDelivered;
+    sample.messageBytes = windowMessageBytes;
+    sample.wireBytes = windowWireBytes;
+    sample.cpuSeconds = cpuNow - windowCpuStart;
+    sample.rttMicros = rttMicros;
+
+    size_t previous = compressionTuner.current();
+    size_t next = compressionTuner.record(sample);
+    if (next != previous) {
+        std::string errstr;
+        RdKafka::Producer* replacement = createProducer(compressionTuner.codec(next), errstr);
+        if (!replacement) {
+            std::cerr << "Failed to create Kafka producer for codec switch: " << errstr << std::endl;
+        } else {
+            if (blockingSwitch && producer->flush(SWITCH_FLUSH_TIMEOUT_MS) == RdKafka::ERR_NO_ERROR) {
+                delete producer;
+            } else {
+                retiring.push_back(producer);
+            }
+            producer = replacement;
+            statsMessageBytes = 0;
+            statsWireBytes = 0;
+            codecSwitches.add();
+        }
+    }
+    publishCodecMetrics();
+
+    windowStart = std::chrono::steady_clock::now();
+    windowCpuStart = producerCpuSeconds();
+    windowDelivered = 0;
+    windowMessageBytes = 0;
+    windowWireBytes = 0;
+}
+
+/**
+ * @brief Retrieves the CPU time spent by the librdkafka threads of this sink's producers.
+ *
+ * Compression runs on librdkafka's broker threads, so this is what a codec
+ * costs without the reading, parsing and formatting done by the callers, or
+ * the work of other sinks. Threads of destroyed producers keep counting with
+ * the time they had when they exited.
+ *
+ * @return CPU time in seconds.
+ */
+double KafkaSink::producerCpuSeconds() {
+    std::lock_guard<std::mutex> lock(threadMutex);
+    double total = exitedThreadSeconds;
+    for (clockid_t clock : threadClocks) {
+        total += clockSeconds(clock);
+    }
+    return total;
+}
+
+/**
+ * @brief Interceptor run by librdkafka for each new producer; registers the thread hooks.
+ *
+ * @param rk The new producer.
+ * @param opaque The KafkaSink.
+ * @return An error if a hook cannot be registered.
+ */
+rd_kafka_resp_err_t KafkaSink::onNew(rd_kafka_t* rk, const rd_kafka_conf_t*, void* opaque, char*, size_t) {
+    rd_kafka_resp_err_t err = rd_kafka_interceptor_add_on_thread_start(rk, THREAD_INTERCEPTOR, &KafkaSink::onThreadStart, opaque);
+    if (err == RD_KAFKA_RESP_ERR_NO_ERROR) {
+        err = rd_kafka_interceptor_add_on_thread_exit(rk, THREAD_INTERCEPTOR, &KafkaSink::onThreadExit, opaque);
+    }
+    return err;
+}
+
+/**
+ * @brief Interceptor run on each librdkafka thread as it starts; starts accounting for its CPU clock.
+ *
+ * @param opaque The KafkaSink.
+ * @return Always RD_KAFKA_RESP_ERR_NO_ERROR.
+ */
+rd_kafka_resp_err_t KafkaSink::onThreadStart(rd_kafka_t*, rd_kafka_thread_type_t, const char*, void* opaque) {
+    KafkaSink* sink = static_cast<KafkaSink*>(opaque);
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) == 0) {
+        std::lock_guard<std::mutex> lock(sink->threadMutex);
+        sink->threadClocks.push_back(clock);
+    }
+    return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+/**
+ * @brief Interceptor run on each librdkafka thread as it exits; keeps its final CPU time.
+ *
+ * @param opaque The KafkaSink.
+ * @return Always RD_KAFKA_RESP_ERR_NO_ERROR.
+ */
+rd_kafka_resp_err_t KafkaSink::onThreadExit(rd_kafka_t*, rd_kafka_thread_type_t, const char*, void* opaque) {
+    KafkaSink* sink = static_cast<KafkaSink*>(opaque);
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) == 0) {
+        std::lock_guard<std::mutex> lock(sink->threadMutex);
+        auto it = std::find(sink->threadClocks.begin(), sink->threadClocks.end(), clock);
+        if (it != sink->threadClocks.end()) {
+            sink->threadClocks.erase(it);
+            sink->exitedThreadSeconds += clockSeconds(CLOCK_THREAD_CPUTIME_ID);
+        }
+    }
+    return RD_KAFKA_RESP_ERR_NO_ERROR;
+}
+
+/**
+ * @brief Publishes the active codec and the tuner's per-codec estimates as metrics.
+ *
+ * Exposed per sink and codec:
+ * - sparky_compression_active: 1 for the codec in use, 0 otherwise
+ * - sparky_compression_events_per_second: smoothed delivered events per second
+ * - sparky_compression_cpu_cores: smoothed CPU use of the producer threads while the codec was active
+ * - sparky_compression_ratio: smoothed uncompressed bytes per wire byte
+ */
+void KafkaSink::publishCodecMetrics() {
+    Metrics& metrics = Metrics::instance();
+    for (size_t i = 0; i < compressionTuner.size(); ++i) {
+        std::string codecLabels = labels + "," + compressionTuner.codec(i).labels();
+        const CompressionTuner::Estimate& estimate = compressionTuner.estimate(i);
+        metrics.gauge("sparky_compression_active", codecLabels).set(i == compressionTuner.current() ? 1 : 0);
+        metrics.gauge("sparky_compression_events_per_second", codecLabels).set(estimate.eventsPerSecond);
+        metrics.gauge("sparky_compression_cpu_cores", codecLabels).set(estimate.cpuFraction);
+        metrics.gauge("sparky_compression_ratio", codecLabels).set(estimate.compressionRatio);
+    }
+}
+
+/**
+ * @brief Counts the outcome of each message delivery, completes its latency
+ *        trace and hands delivered messages to the delivery hook.
+ *
+ * @param message The delivered (or failed) message.
+ */
+void KafkaSink::DeliveryCallback::dr_cb(RdKafka::Message& message) {
+    EventTrace* trace = static_cast<EventTrace*>(message.msg_opaque());
+    SPARKY_PROBE4(delivery, sink.kafkaTopic.c_str(), message.len(), static_cast<int>(message.err()), trace ? trace->notified : 0);
+    if (trace) {
+        LatencyTracker::delivered(trace, message.err() == RdKafka::ERR_NO_ERROR);
+    }
+    if (message.err() != RdKafka::ERR_NO_ERROR) {
+        sink.deliveryFailures.add();
+        std::cerr << "Kafka delivery failed: " << message.errstr() << std::endl;
+        return;
+    }
+    sink.eventsDelivered.add();
+    sink.windowDelivered++;
+    if (sink.deliveryHook) {
+        sink.deliveryHook(static_cast<const char*>(message.payload()), message.len());
+    }
+}
+
+/**
+ * @brief Reads byte counters and broker round trip times from a statistics event.
+ *
+ * Only statistics from the current producer are used; its cumulative
+ * `txmsg_bytes` (uncompressed) and `tx_bytes` (wire) counters are turned into
+ * per-window deltas, and the average `rtt` of all brokers with samples is kept.
+ * Queue sizes and traffic totals are also exported as `sparky_rdkafka_*`
+ * gauges, along with the retries and errors summed over all brokers.
+ *
+ * @param event The librdkafka event.
+ */
+void KafkaSink::StatsCallback::event_cb(RdKafka::Event& event) {
+    if (event.type() != RdKafka::Event::EVENT_STATS) {
+        if (event.type() == RdKafka::Event::EVENT_ERROR) {
+            std::cerr << "Kafka error: " << RdKafka::err2str(event.err()) << " " << event.str() << std::endl;
+        }
+        return;
+    }
+    std::string json = event.str();
+    if (json.find("\"" + sink.producer->name() + "\"") == std::string::npos) {
+        return;
+    }
+
+    double value = 0;
+    Metrics& metrics = Metrics::instance();
+    for (const auto& stat : STATS_GAUGES) {
+        std::string needle = std::string("\"") + stat.field + "\":";
+        size_t pos = stat.last ? json.rfind(needle) : json.find(needle);
+        if (pos != std::string::npos && findNumber(json, stat.field, pos, value) != std::string::npos) {
+            metrics.gauge(std::string("sparky_rdkafka_") + stat.field, sink.labels).set(value);
+        }
+    }
+    metrics.gauge("sparky_rdkafka_broker_tx_retries", sink.labels).set(sumNumbers(json, "txretries"));
+    metrics.gauge("sparky_rdkafka_broker_tx_errors", sink.labels).set(sumNumbers(json, "txerrs"));
+
+    if (findNumber(json, "txmsg_bytes", 0, value) != std::string::npos) {
+        uint64_t total = static_cast<uint64_t>(value);
+        sink.windowMessageBytes += total - sink.statsMessageBytes;
+        sink.statsMessageBytes = total;
+    }
+    if (findNumber(json, "tx_bytes", 0, value) != std::string::npos) {
+        uint64_t total = static_cast<uint64_t>(value);
+        sink.windowWireBytes += total - sink.statsWireBytes;
+        sink.statsWireBytes = total;
+    }
+
+    double rttSum = 0;
+    int brokers = 0;
+    size_t pos = json.find("\"rtt\":");
+    while (pos != std::string::npos) {
+        size_t next = findNumber(json, "avg", pos, value);
+        if (next == std::string::npos) {
+            break;
+        }
+        if (value > 0) {
+            rttSum += value;
+            brokers++;
+        }
+        pos = json.find("\"rtt\":", next);
+    }
+    if (brokers > 0) {
+        sink.rttMicros = rttSum / brokers;
+        sink.brokerRtt.set(sink.rttMicros);
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef KAFKASINK_H
+#define KAFKASINK_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <functional>
+#include <librdkafka/rdkafka.h>
+#include <librdkafka/rdkafkacpp.h>
+#include "CompressionTuner.h"
+#include "Metrics.h"
+#include "LatencyTracker.h"
+
+
+/**
+ * @class KafkaSink
+ * @brief Produces messages to a Kafka topic, adapting the compression codec to measured cost.
+ *
+ * The sink owns a single librdkafka producer configured with the codec chosen
+ * by a CompressionTuner. Every measurement window it feeds the tuner the
+ * delivered event count, the CPU time of the producers' own librdkafka threads
+ * (where compression runs), the uncompressed and wire byte
+ * counts and the broker round trip time (the last three from librdkafka's
+ * statistics). When the tuner picks another codec the current producer is
+ * flushed, so ordering is preserved, and replaced by one using the new codec.
+ * A sink polled from a thread that must not block (see setBlockingSwitch())
+ * instead retires the old producer, which drains in the background; keyed
+ * messages are held back until it has, so they stay in order as well.
+ *
+ * Delivery reports and statistics are served from poll(), so all state is
+ * only touched by the thread calling produce() and poll(), except the thread
+ * CPU accounting, which librdkafka's threads update as they start and exit.
+ */
+class KafkaSink {
+public:
+    /**
+     * @brief Called from poll() or flush() with the payload of each successfully delivered message.
+     */
+    using DeliveryHook = std::function<void(const char* payload, size_t length)>;
+
+    /**
+     * @brief Constructs a KafkaSink.
+     * @param kafkaBroker The address of the Kafka broker.
+     * @param kafkaTopic The Kafka topic to which messages are sent.
+     * @param name Name used to label this sink's metrics.
+     * @param extraConfig Additional librdkafka properties (e.g. `linger.ms`) applied to every producer.
+     * @throws std::runtime_error If the producer cannot be created.
+     */
+    KafkaSink(const std::string& kafkaBroker, const std::string& kafkaTopic, const std::string& name,
+              const std::map<std::string, std::string>& extraConfig = {});
+
+    /**
+     * @brief Destroys the KafkaSink and its producer.
+     */
+    ~KafkaSink();
+
+    KafkaSink(const KafkaSink&) = delete;
+    KafkaSink& operator=(const KafkaSink&) = delete;
+
+    /**
+     * @brief Produces a message to the topic.
+     * @param message The message to be sent.
+     * @param key The message key used for partitioning; empty for no key.
+     * @param trace Latency trace completed by the delivery report; owned by the sink once enqueued.
+     * @throws std::runtime_error If the message cannot be enqueued, or it is keyed and the
+     *         producer retired by a codec switch does not drain in time.
+     */
+    void produce(const std::string& message, const std::string& key = "", EventTrace* trace = nullptr);
+
+    /**
+     * @brief Produces a message to the topic unless the producer queue is full.
+     * @param message The message to be sent.
+     * @param key The message key used for partitioning; empty for no key.
+     * @param trace Latency trace completed by the delivery report; owned by the sink once enqueued.
+     * @return False if the producer queue is full, or the message is keyed and a producer
+     *         retired by a codec switch is still draining; the message was not enqueued.
+     * @throws std::runtime_error If the message cannot be enqueued for any other reason.
+     */
+    bool tryProduce(const std::string& message, const std::string& key = "", EventTrace* trace = nullptr);
+
+    /**
+     * @brief Serves delivery reports and statistics and re-evaluates the codec when a window ends.
+     */
+    void poll();
+
+    /**
+     * @brief Waits for all outstanding messages to be delivered.
+     * @param timeoutMs Maximum time to wait, in milliseconds.
+     */
+    void flush(int timeoutMs);
+
+    /**
+     * @brief Sets the CPU budget the codec choice must respect.
+     * @param cores CPU budget in cores (1.0 is one full core).
+     */
+    void setCpuBudget(double cores);
+
+    /**
+     * @brief Limits compression to the cheapest maxIndex + 1 candidate codecs.
+     * @param maxIndex Index of the most expensive codec that may be chosen.
+     */
+    void setMaxCodec(size_t maxIndex);
+
+    /**
+     * @brief Chooses whether a codec switch flushes the old producer before the new one takes over.
+     * @param blocking True (the default) to flush; false to retire the old producer without waiting.
+     */
+    void setBlockingSwitch(bool blocking) { blockingSwitch = blocking; }
+
+    /**
+     * @brief Registers a function to be called for every delivered message.
+     * @param hook The function, or an empty function to remove it.
+     */
+    void setDeliveryHook(DeliveryHook hook) { deliveryHook = std::move(hook); }
+
+    /**
+     * @brief Retrieves the compression tuner.
+     * @return The tuner, for inspecting candidates and estimates.
+     */
+    const CompressionTuner& tuner() const { return compressionTuner; }
+
+private:
+    /**
+     * @brief Counts delivered and failed messages.
+     */
+    class DeliveryCallback : public RdKafka::DeliveryReportCb {
+    public:
+        explicit DeliveryCallback(KafkaSink& sink) : sink(sink) {}
+        void dr_cb(RdKafka::Message& message) override;
+    private:
+        KafkaSink& sink;
+    };
+
+    /**
+     * @brief Extracts byte counters and broker round trip time from librdkafka statistics.
+     */
+    class StatsCallback : public RdKafka::EventCb {
+    public:
+        explicit StatsCallback(KafkaSink& sink) : sink(sink) {}
+        void event_cb(RdKafka::Event& event) override;
+    private:
+        KafkaSink& sink;
+    };
+
+    RdKafka::Producer* createProducer(const CompressionTuner::Codec& codec, std::string& errstr);
+    void evaluate();
+    bool retiredPending();
+    void publishCodecMetrics();
+    double producerCpuSeconds();
+    static rd_kafka_resp_err_t onNew(rd_kafka_t* rk, const rd_kafka_conf_t* conf, void* opaque, char* errstr, size_t errstrSize);
+    static rd_kafka_resp_err_t onThreadStart(rd_kafka_t* rk, rd_kafka_thread_type_t type, const char* name, void* opaque);
+    static rd_kafka_resp_err_t onThreadExit(rd_kafka_t* rk, rd_kafka_thread_type_t type, const char* name, void* opaque);
+
+    std::string kafkaBroker; ///< The address of the Kafka broker.
+    std::string kafkaTopic; ///< The Kafka topic to which messages are sent.
+    std::string labels; ///< Metric labels identifying this sink.
+    std::map<std::string, std::string> extraConfig; ///< Additional librdkafka properties.
+    DeliveryCallback deliveryCallback; ///< Delivery report callback for the producer.
+    StatsCallback statsCallback; ///< Statistics callback for the producer.
+    CompressionTuner compressionTuner; ///< Chooses the codec for each window.
+    RdKafka::Producer* producer; ///< Producer configured with the current codec.
+    std::vector<RdKafka::Producer*> retiring; ///< Producers from earlier codecs still draining.
+    bool blockingSwitch = true; ///< Whether a codec switch flushes the old producer first.
+
+    std::chrono::steady_clock::time_point windowStart; ///< Start of the current measurement window.
+    double windowCpuStart; ///< Producer thread CPU seconds at the start of the window.
+    uint64_t windowDelivered = 0; ///< Events delivered during the window.
+    uint64_t windowMessageBytes = 0; ///< Uncompressed bytes sent during the window (from statistics).
+    uint64_t windowWireBytes = 0; ///< Bytes on the wire during the window (from statistics).
+    uint64_t statsMessageBytes = 0; ///< Last cumulative uncompressed byte count reported by the producer.
+    uint64_t statsWireBytes = 0; ///< Last cumulative wire byte count reported by the producer.
+    double rttMicros = 0; ///< Latest average broker round trip time.
+    DeliveryHook deliveryHook; ///< Observer of delivered messages, if any.
+    std::mutex threadMutex; ///< Protects threadClocks and exitedThreadSeconds.
+    std::vector<clockid_t> threadClocks; ///< CPU clocks of the producers' running librdkafka threads.
+    double exitedThreadSeconds = 0; ///< CPU time of the producers' librdkafka threads that have exited.
+
+    Metrics::Counter& eventsDelivered; ///< sparky_events_delivered_total
+    Metrics::Counter& deliveryFailures; ///< sparky_delivery_failures_total
+    Metrics::Counter& eventsProduced; ///< sparky_events_produced_total
+    Metrics::Counter& queueFull; ///< sparky_produce_queue_full_total: produce attempts refused by a full queue
+    Metrics::Gauge& producerQueueDepth; ///< sparky_producer_queue_depth: messages awaiting delivery
+    Metrics::Counter& codecSwitches; ///< sparky_compression_switches_total
+    Metrics::Gauge& brokerRtt; ///< sparky_broker_rtt_microseconds
+};
+
+#endif
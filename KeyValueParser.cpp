@@ -0,0 +1,417 @@
+#include "KeyValueParser.h"
+#include "JsonEscape.h"
+#include <stdexcept>               // Used for std::invalid_argument
+
+namespace {
+
+/// CEF header fields, named as in the ArcSight data dictionary.
+const char* const CEF_HEADER[] = {"cefVersion", "deviceVendor", "deviceProduct", "deviceVersion",
+                                  "deviceEventClassId", "name", "severity"};
+
+/// LEEF header fields.
+const char* const LEEF_HEADER[] = {"leefVersion", "vendor", "product", "version", "eventId"};
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * @brief Checks whether a character may appear in a CEF extension key.
+ *
+ * @param c The character.
+ * @return True for letters, digits and `_ . - [ ]`.
+ */
+inline bool isCefKeyChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '.' || c == '-' || c == '[' || c == ']';
+}
+
+/**
+ * @brief Converts a hex digit.
+ *
+ * @param c The character.
+ * @return Its value, or -1 if it is not a hex digit.
+ */
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a parser for one format.
+ *
+ * @param format The format of the lines.
+ */
+KeyValueParser::KeyValueParser(Format format) : lineFormat(format) {}
+
+/**
+ * @brief Looks up a format by its configuration name.
+ *
+ * @param name "kv", "cef" or "leef".
+ * @return The format.
+ * @throws std::invalid_argument If the name is unknown.
+ */
+KeyValueParser::Format KeyValueParser::formatByName(const std::string& name) {
+    if (name == "kv") {
+        return KEY_VALUE;
+    }
+    if (name == "cef") {
+        return CEF;
+    }
+    if (name == "leef") {
+        return LEEF;
+    }
+    throw std::invalid_argument("Unknown line format: " + name);
+}
+
+/**
+ * @brief Parses a line in the parser's format.
+ *
+ * @param line The line.
+ * @return False if the line is not in the format.
+ */
+bool KeyValueParser::parse(std::string_view line) {
+    parsed.clear();
+    Cursor cursor{line.data(), line.data() + line.size()};
+    bool valid = false;
+    switch (lineFormat) {
+        case KEY_VALUE: valid = parseKeyValue(cursor); break;
+        case CEF: valid = parseCef(cursor); break;
+        case LEEF: valid = parseLeef(cursor); break;
+    }
+    if (!valid) {
+        parsed.clear();
+    }
+    return valid;
+}
+
+/**
+ * @brief Looks up a field; the last one wins if a key repeats.
+ *
+ * @param key The key.
+ * @param field Receives the field.
+ * @return False if there is no such field.
+ */
+bool KeyValueParser::get(std::string_view key, Field& field) const {
+    for (auto it = parsed.rbegin(); it != parsed.rend(); ++it) {
+        if (it->key == key) {
+            field = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes a field's value into a string.
+ *
+ * @param field The field.
+ * @return The decoded value.
+ */
+std::string KeyValueParser::value(const Field& field) const {
+    std::string decoded;
+    decoded.reserve(field.value.size());
+    decode(field, [&decoded](const char* text, size_t length) { decoded.append(text, length); });
+    return decoded;
+}
+
+/**
+ * @brief Appends the fields as JSON members.
+ *
+ * @param out The object being built.
+ */
+void KeyValueParser::appendJson(std::string& out) const {
+    bool first = true;
+    for (const Field& field : parsed) {
+        out += first ? "\"" : ", \"";
+        first = false;
+        appendEscapedJson(out, field.key);
+        out += "\": \"";
+        decode(field, [&out](const char* text, size_t length) { appendEscapedJson(out, std::string_view(text, length)); });
+        out += '"';
+    }
+}
+
+/**
+ * @brief Passes a field's value to a sink in runs, with escapes resolved.
+ *
+ * A backslash followed by a character the format does not escape is kept,
+ * so Windows paths survive in formats that do not escape backslashes
+ * consistently.
+ *
+ * @param field The field.
+ * @param sink Called with (text, length) for each run of decoded text.
+ */
+template <typename Sink>
+void KeyValueParser::decode(const Field& field, Sink&& sink) const {
+    if (!field.escaped) {
+        sink(field.value.data(), field.value.size());
+        return;
+    }
+    const char* text = field.value.data();
+    size_t length = field.value.size();
+    size_t run = 0;
+    for (size_t i = 0; i + 1 < length; ++i) {
+        if (text[i] != '\\') {
+            continue;
+        }
+        char escaped = text[i + 1];
+        const char* replacement = nullptr;
+        if (escaped == '\\' || (escaped == '"' && lineFormat == KEY_VALUE) || (escaped == '|' && lineFormat != KEY_VALUE) ||
+            (escaped == '=' && lineFormat == CEF)) {
+            replacement = text + i + 1;
+        } else if (escaped == 'n' && lineFormat == CEF) {
+            replacement = "\n";
+        } else if (escaped == 'r' && lineFormat == CEF) {
+            replacement = "\r";
+        } else {
+            continue;
+        }
+        sink(text + run, i - run);
+        sink(replacement, 1);
+        i++;
+        run = i + 1;
+    }
+    sink(text + run, length - run);
+}
+
+/**
+ * @brief Parses whitespace-separated key=value pairs.
+ *
+ * @param cursor Cursor over the line.
+ * @return False if the line holds no pair or has an unterminated quote.
+ */
+bool KeyValueParser::parseKeyValue(Cursor cursor) {
+    const char*& p = cursor.position;
+    while (true) {
+        while (p < cursor.end && isSpace(*p)) {
+            p++;
+        }
+        if (p >= cursor.end) {
+            break;
+        }
+        const char* keyStart = p;
+        while (p < cursor.end && !isSpace(*p) && *p != '=') {
+            p++;
+        }
+        if (p >= cursor.end || *p != '=' || p == keyStart) {
+            // A word that is not a pair, e.g. a leading syslog header
+            while (p < cursor.end && !isSpace(*p)) {
+                p++;
+            }
+            continue;
+        }
+        std::string_view key(keyStart, static_cast<size_t>(p - keyStart));
+        p++;
+        const char* valueStart = p;
+        bool escaped = false;
+        if (p < cursor.end && *p == '"') {
+            valueStart = ++p;
+            while (p < cursor.end && *p != '"') {
+                if (*p == '\\' && p + 1 < cursor.end) {
+                    escaped = true;
+                    p++;
+                }
+                p++;
+            }
+            if (p >= cursor.end) {
+                return false;
+            }
+            parsed.push_back(Field{key, std::string_view(valueStart, static_cast<size_t>(p - valueStart)), escaped});
+            p++;
+        } else {
+            while (p < cursor.end && !isSpace(*p)) {
+                p++;
+            }
+            parsed.push_back(Field{key, std::string_view(valueStart, static_cast<size_t>(p - valueStart)), false});
+        }
+    }
+    return !parsed.empty();
+}
+
+/**
+ * @brief Parses pipe-separated header fields, each terminated by an unescaped '|'.
+ *
+ * @param cursor Cursor at the first field; left after the last field's '|'.
+ * @param names Names of the fields.
+ * @param count Number of fields.
+ * @return False if the line ends before the last '|'.
+ */
+bool KeyValueParser::parseHeader(Cursor& cursor, const char* const* names, size_t count) {
+    const char*& p = cursor.position;
+    for (size_t i = 0; i < count; ++i) {
+        const char* start = p;
+        bool escaped = false;
+        while (p < cursor.end && *p != '|') {
+            if (*p == '\\' && p + 1 < cursor.end) {
+                escaped = true;
+                p++;
+            }
+            p++;
+        }
+        if (p >= cursor.end) {
+            return false;
+        }
+        parsed.push_back(Field{names[i], std::string_view(start, static_cast<size_t>(p - start)), escaped});
+        p++;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a CEF record, which may follow a syslog header.
+ *
+ * @param cursor Cursor over the line.
+ * @return False if the line has no complete CEF header.
+ */
+bool KeyValueParser::parseCef(Cursor cursor) {
+    std::string_view line(cursor.position, static_cast<size_t>(cursor.end - cursor.position));
+    size_t start = line.find("CEF:");
+    if (start == std::string_view::npos) {
+        return false;
+    }
+    cursor.position += start + 4;
+    if (!parseHeader(cursor, CEF_HEADER, sizeof(CEF_HEADER) / sizeof(CEF_HEADER[0]))) {
+        return false;
+    }
+    parseCefExtension(cursor);
+    return true;
+}
+
+/**
+ * @brief Parses a CEF extension.
+ *
+ * Values may contain unescaped spaces, so a value ends only at the last
+ * space before the next `key=`. Parsing stops at the first text that does
+ * not start with a key.
+ *
+ * @param cursor Cursor at the extension.
+ */
+void KeyValueParser::parseCefExtension(Cursor cursor) {
+    const char*& p = cursor.position;
+    while (p < cursor.end && *p == ' ') {
+        p++;
+    }
+    while (p < cursor.end) {
+        const char* keyStart = p;
+        while (p < cursor.end && isCefKeyChar(*p)) {
+            p++;
+        }
+        if (p >= cursor.end || *p != '=' || p == keyStart) {
+            return;
+        }
+        std::string_view key(keyStart, static_cast<size_t>(p - keyStart));
+        const char* valueStart = ++p;
+        const char* lastSpace = nullptr;
+        const char* nextKey = nullptr;
+        bool escaped = false;
+        while (p < cursor.end) {
+            char c = *p;
+            if (c == '\\' && p + 1 < cursor.end) {
+                escaped = true;
+                p += 2;
+                continue;
+            }
+            if (c == ' ') {
+                lastSpace = p;
+            } else if (c == '=' && lastSpace != nullptr && lastSpace + 1 < p) {
+                const char* candidate = lastSpace + 1;
+                while (candidate < p && isCefKeyChar(*candidate)) {
+                    candidate++;
+                }
+                if (candidate == p) {
+                    nextKey = lastSpace + 1;
+                    break;
+                }
+            }
+            p++;
+        }
+        const char* valueEnd = nextKey ? lastSpace : cursor.end;
+        while (valueEnd > valueStart && valueEnd[-1] == ' ') {
+            valueEnd--;
+        }
+        parsed.push_back(Field{key, std::string_view(valueStart, static_cast<size_t>(valueEnd - valueStart)), escaped});
+        if (!nextKey) {
+            return;
+        }
+        p = nextKey;
+    }
+}
+
+/**
+ * @brief Parses a LEEF 1.0 or 2.0 record, which may follow a syslog header.
+ *
+ * @param cursor Cursor over the line.
+ * @return False if the line has no complete LEEF header.
+ */
+bool KeyValueParser::parseLeef(Cursor cursor) {
+    std::string_view line(cursor.position, static_cast<size_t>(cursor.end - cursor.position));
+    size_t start = line.find("LEEF:");
+    if (start == std::string_view::npos) {
+        return false;
+    }
+    cursor.position += start + 5;
+    if (!parseHeader(cursor, LEEF_HEADER, sizeof(LEEF_HEADER) / sizeof(LEEF_HEADER[0]))) {
+        return false;
+    }
+    char delimiter = '\t';
+    if (!parsed.front().value.empty() && parsed.front().value[0] == '2') {
+        const char* specStart = cursor.position;
+        while (cursor.position < cursor.end && *cursor.position != '|') {
+            cursor.position++;
+        }
+        if (cursor.position >= cursor.end) {
+            return false;
+        }
+        std::string_view spec(specStart, static_cast<size_t>(cursor.position - specStart));
+        cursor.position++;
+        if (spec.size() == 1) {
+            delimiter = spec[0];
+        } else if (!spec.empty()) {
+            size_t digits = spec.compare(0, 2, "0x") == 0 ? 2 : (spec[0] == 'x' || spec[0] == 'X') ? 1 : 0;
+            if (digits == 0 || spec.size() != digits + 2 || hexValue(spec[digits]) < 0 || hexValue(spec[digits + 1]) < 0) {
+                return false;
+            }
+            delimiter = static_cast<char>(hexValue(spec[digits]) * 16 + hexValue(spec[digits + 1]));
+        }
+    }
+    parseDelimited(cursor, delimiter);
+    return true;
+}
+
+/**
+ * @brief Parses `key=value` attributes separated by a delimiter; values are taken as written.
+ *
+ * @param cursor Cursor at the attributes.
+ * @param delimiter The attribute delimiter.
+ */
+void KeyValueParser::parseDelimited(Cursor cursor, char delimiter) {
+    const char*& p = cursor.position;
+    while (p < cursor.end) {
+        const char* start = p;
+        const char* equals = nullptr;
+        while (p < cursor.end && *p != delimiter) {
+            if (*p == '=' && equals == nullptr) {
+                equals = p;
+            }
+            p++;
+        }
+        if (equals != nullptr && equals > start) {
+            parsed.push_back(Field{std::string_view(start, static_cast<size_t>(equals - start)),
+                                   std::string_view(equals + 1, static_cast<size_t>(p - equals - 1)), false});
+        }
+        if (p < cursor.end) {
+            p++;
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef KEYVALUEPARSER_H
+#define KEYVALUEPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+
+/**
+ * @class KeyValueParser
+ * @brief Splits key=value, CEF and LEEF lines into fields that point into the line.
+ *
+ * Fields are views into the line, so parsing allocates nothing once the
+ * field vector has grown to the largest line's field count. Escapes are
+ * recognized but left in place; a field whose value holds one is marked
+ * `escaped` and is decoded only when appended to the envelope.
+ *
+ * Formats:
+ * - KEY_VALUE: whitespace-separated `key=value` pairs. Values are bare words
+ *   or double-quoted strings in which `\"` and `\\` are escapes. Words
+ *   without '=' are skipped.
+ * - CEF: `CEF:Version|Vendor|Product|Version|SignatureID|Name|Severity|Extension`,
+ *   possibly after a syslog header. Header fields escape `\|` and `\\`. In
+ *   the extension a value runs up to the space before the next `key=`, and
+ *   escapes `\=`, `\\`, `\n` and `\r`. Header fields are named after the
+ *   ArcSight dictionary (`cefVersion`, `deviceVendor`, ..., `severity`).
+ * - LEEF: `LEEF:Version|Vendor|Product|Version|EventID|` followed by
+ *   tab-separated `key=value` attributes; LEEF 2.0 adds a header field
+ *   naming the delimiter, as a character or as hex (`x5E`, `0x5E`).
+ *
+ * Each monitor has its own parser, since parsing fills per-line state.
+ */
+class KeyValueParser {
+public:
+    /**
+     * @brief Line format.
+     */
+    enum Format {
+        KEY_VALUE, ///< key=value pairs
+        CEF,       ///< ArcSight Common Event Format
+        LEEF       ///< IBM Log Event Extended Format
+    };
+
+    /**
+     * @brief A field of the parsed line.
+     */
+    struct Field {
+        std::string_view key; ///< The key.
+        std::string_view value; ///< The value as written, without quotes.
+        bool escaped; ///< Whether the value holds escapes to decode.
+    };
+
+    /**
+     * @brief Constructs a parser for one format.
+     * @param format The format of the lines.
+     */
+    explicit KeyValueParser(Format format);
+
+    /**
+     * @brief Looks up a format by name.
+     * @param name "kv", "cef" or "leef".
+     * @return The format.
+     * @throws std::invalid_argument If the name is unknown.
+     */
+    static Format formatByName(const std::string& name);
+
+    /**
+     * @brief Retrieves the parser's format.
+     * @return The format.
+     */
+    Format format() const { return lineFormat; }
+
+    /**
+     * @brief Parses a line.
+     * @param line The line; fields point into it until the next parse.
+     * @return False if the line is not in the format; the fields are then empty.
+     */
+    bool parse(std::string_view line);
+
+    /**
+     * @brief Retrieves the fields of the last parsed line.
+     * @return The fields in order, header fields first.
+     */
+    const std::vector<Field>& fields() const { return parsed; }
+
+    /**
+     * @brief Retrieves a field by key; the last one wins if a key repeats.
+     * @param key The key.
+     * @param field Receives the field.
+     * @return False if the line has no such field.
+     */
+    bool get(std::string_view key, Field& field) const;
+
+    /**
+     * @brief Decodes a field's value.
+     * @param field A field of the last parsed line.
+     * @return The value with its escapes resolved.
+     */
+    std::string value(const Field& field) const;
+
+    /**
+     * @brief Appends the fields as `"key": "value"` JSON members separated by ", ".
+     *
+     * Values are decoded and JSON-escaped in one pass.
+     *
+     * @param out The object being built; nothing is added before the first member.
+     */
+    void appendJson(std::string& out) const;
+
+private:
+    /**
+     * @brief Cursor over the line being parsed.
+     */
+    struct Cursor {
+        const char* position; ///< Next byte.
+        const char* end; ///< End of the line.
+    };
+
+    bool parseKeyValue(Cursor cursor);
+    bool parseCef(Cursor cursor);
+    bool parseLeef(Cursor cursor);
+    bool parseHeader(Cursor& cursor, const char* const* names, size_t count);
+    void parseCefExtension(Cursor cursor);
+    void parseDelimited(Cursor cursor, char delimiter);
+
+    template <typename Sink>
+    void decode(const Field& field, Sink&& sink) const;
+
+    Format lineFormat; ///< Format of the lines.
+    std::vector<Field> parsed; ///< Fields of the last parsed line.
+};
+
+#endif
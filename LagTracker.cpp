@@ -0,0 +1,183 @@
+#include "LagTracker.h"
+#include "Probes.h"
+#include <algorithm>               // Used for std::lower_bound
+
+/**
+ * @brief Constructs a LagTracker and registers its metrics.
+ *
+ * @param file Name of the file, e.g. its path.
+ */
+LagTracker::LagTracker(const std::string& file)
+    : file(file), committed(0), fileSize(0), generation(0), inFlight(0), maxUnshippedBytes(0), maxAgeMs(0), alerting(false),
+      committedGauge(Metrics::instance().gauge("sparky_file_committed_offset_bytes", Metrics::label("file", file))),
+      unshippedGauge(Metrics::instance().gauge("sparky_file_unshipped_bytes", Metrics::label("file", file))),
+      inFlightGauge(Metrics::instance().gauge("sparky_file_in_flight_lines", Metrics::label("file", file))),
+      ageGauge(Metrics::instance().gauge("sparky_file_oldest_unshipped_seconds", Metrics::label("file", file))),
+      alertGauge(Metrics::instance().gauge("sparky_file_lag_alert", Metrics::label("file", file))),
+      alerts(Metrics::instance().counter("sparky_file_lag_alerts_total", Metrics::label("file", file))) {
+}
+
+/**
+ * @brief Sets the alert thresholds; either check can be disabled with 0.
+ *
+ * @param maxUnshippedBytes Unshipped bytes above which to alert.
+ * @param maxAgeMs Age of the oldest unshipped byte above which to alert, in milliseconds.
+ */
+void LagTracker::setThresholds(uint64_t maxUnshippedBytes, int64_t maxAgeMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->maxUnshippedBytes = maxUnshippedBytes;
+    this->maxAgeMs = maxAgeMs;
+}
+
+/**
+ * @brief Records the file size seen by the reader.
+ *
+ * Growth is remembered with the time it was first seen, so the age of any
+ * unshipped byte can later be looked up.
+ *
+ * @param fileSize The size.
+ * @param now When it was seen.
+ */
+void LagTracker::observe(uint64_t fileSize, int64_t now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->fileSize = fileSize;
+    uint64_t known = arrivals.empty() ? committed : arrivals.back().fileSize;
+    if (fileSize <= known) {
+        return;
+    }
+    if (arrivals.size() < MAX_ARRIVALS) {
+        arrivals.push_back(Arrival{fileSize, now});
+    } else {
+        // Overestimates the age of the newest bytes rather than losing track of them
+        arrivals.back().fileSize = fileSize;
+    }
+}
+
+/**
+ * @brief Starts over at offset 0 after the file was truncated.
+ *
+ * The generation is bumped so late acknowledgements of the old contents
+ * cannot advance the new committed offset.
+ */
+void LagTracker::truncated() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+    arrivals.clear();
+    committed = 0;
+    fileSize = 0;
+    inFlight = 0;
+    generation++;
+}
+
+/**
+ * @brief Registers a line handed to a producer.
+ *
+ * @param endOffset Offset just past the line's newline; must not be less than
+ *        the end offset of the previous tracked line.
+ * @return The current generation.
+ */
+uint32_t LagTracker::track(uint64_t endOffset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(Pending{endOffset, false});
+    inFlight++;
+    return generation;
+}
+
+/**
+ * @brief Marks a line as done and advances the committed offset over the acknowledged prefix.
+ *
+ * Called from delivery reports, so possibly on another thread than the reader.
+ *
+ * @param endOffset The offset the line was tracked with.
+ * @param generation The generation returned by track().
+ */
+void LagTracker::acknowledge(uint64_t endOffset, uint32_t generation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (generation != this->generation) {
+        return;
+    }
+    auto it = std::lower_bound(pending.begin(), pending.end(), endOffset,
+                               [](const Pending& line, uint64_t offset) { return line.endOffset < offset; });
+    if (it == pending.end() || it->endOffset != endOffset || it->acknowledged) {
+        return;
+    }
+    it->acknowledged = true;
+    inFlight--;
+    if (it != pending.begin()) {
+        return;
+    }
+    while (!pending.empty() && pending.front().acknowledged) {
+        committed = pending.front().endOffset;
+        pending.pop_front();
+    }
+    SPARKY_PROBE3(checkpoint, file.c_str(), committed, pending.size());
+    while (!arrivals.empty() && arrivals.front().fileSize <= committed) {
+        arrivals.pop_front();
+    }
+}
+
+/**
+ * @brief Publishes the committed offset, unshipped bytes, in-flight lines and age, and checks the thresholds.
+ *
+ * An alert is raised when either threshold is exceeded and cleared once both
+ * are met again, so each episode yields exactly one RAISED and one CLEARED.
+ *
+ * @param now The current time.
+ * @return The alert transition, if any.
+ */
+LagTracker::Transition LagTracker::update(int64_t now) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t unshipped = fileSize > committed ? fileSize - committed : 0;
+    int64_t ageNanos = unshipped > 0 && !arrivals.empty() && now > arrivals.front().seen ? now - arrivals.front().seen : 0;
+    committedGauge.set(static_cast<double>(committed));
+    unshippedGauge.set(static_cast<double>(unshipped));
+    inFlightGauge.set(static_cast<double>(inFlight));
+    ageGauge.set(ageNanos / 1e9);
+
+    bool over = (maxUnshippedBytes > 0 && unshipped > maxUnshippedBytes) ||
+                (maxAgeMs > 0 && ageNanos / 1000000 > maxAgeMs);
+    if (over == alerting) {
+        return NONE;
+    }
+    alerting = over;
+    alertGauge.set(over ? 1 : 0);
+    if (over) {
+        alerts.add();
+        return RAISED;
+    }
+    return CLEARED;
+}
+
+/**
+ * @brief Retrieves the committed offset.
+ *
+ * @return End of the acknowledged prefix of the file.
+ */
+uint64_t LagTracker::committedOffset() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return committed;
+}
+
+/**
+ * @brief Retrieves the number of unshipped bytes.
+ *
+ * @return Last observed file size minus the committed offset.
+ */
+uint64_t LagTracker::unshippedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return fileSize > committed ? fileSize - committed : 0;
+}
+
+/**
+ * @brief Retrieves the age of the oldest unshipped byte.
+ *
+ * @param now The current time.
+ * @return Seconds since the reader first saw the oldest unshipped byte; 0 if none.
+ */
+double LagTracker::oldestUnshippedSeconds(int64_t now) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (fileSize <= committed || arrivals.empty() || now <= arrivals.front().seen) {
+        return 0;
+    }
+    return (now - arrivals.front().seen) / 1e9;
+}
@@ -0,0 +1,160 @@
+#ifndef LAGTRACKER_H
+#define LAGTRACKER_H
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "Metrics.h"
+
+
+/**
+ * @class LagTracker
+ * @brief Tracks how far Kafka's acknowledgements trail the end of one file.
+ *
+ * The committed offset is the end of the longest prefix of the file whose
+ * lines have all been acknowledged (or given up on). Lines may be acknowledged
+ * out of order, e.g. across partitions or lanes, so every line handed to a
+ * producer is kept in order of its end offset until it and all lines before
+ * it are done. Unshipped bytes are everything between the committed offset and
+ * the file size, including unread data and a trailing partial line.
+ *
+ * The age of the oldest unshipped byte is taken from when the reader first saw
+ * the file grow past it. The reader records each size it observes with the
+ * time it observed it; arrivals at or below the committed offset are dropped.
+ *
+ * Exported per file:
+ * - sparky_file_committed_offset_bytes
+ * - sparky_file_unshipped_bytes: file size minus committed offset
+ * - sparky_file_in_flight_lines: lines handed to a producer and not yet acknowledged
+ * - sparky_file_oldest_unshipped_seconds
+ * - sparky_file_lag_alert: 1 while a threshold is exceeded
+ * - sparky_file_lag_alerts_total
+ *
+ * acknowledge() may be called from any thread; everything else is called by
+ * the thread reading the file.
+ */
+class LagTracker {
+public:
+    /**
+     * @brief Result of an update(), for raising and clearing alerts.
+     */
+    enum Transition {
+        NONE,     ///< The alert state did not change.
+        RAISED,   ///< A threshold was crossed.
+        CLEARED   ///< The file is back within its thresholds.
+    };
+
+    /**
+     * @brief Constructs a LagTracker with alerting disabled.
+     * @param file Name of the file, used as the `file` metric label.
+     */
+    explicit LagTracker(const std::string& file);
+
+    LagTracker(const LagTracker&) = delete;
+    LagTracker& operator=(const LagTracker&) = delete;
+
+    /**
+     * @brief Sets the alert thresholds.
+     * @param maxUnshippedBytes Unshipped bytes above which to alert; 0 disables the check.
+     * @param maxAgeMs Age of the oldest unshipped byte above which to alert, in milliseconds; 0 disables the check.
+     */
+    void setThresholds(uint64_t maxUnshippedBytes, int64_t maxAgeMs);
+
+    /**
+     * @brief Records the file size seen by the reader.
+     * @param fileSize The size.
+     * @param now When it was seen, from LatencyTracker::now().
+     */
+    void observe(uint64_t fileSize, int64_t now);
+
+    /**
+     * @brief Forgets all offsets after the file was truncated.
+     *
+     * Lines still awaiting acknowledgement are treated as done.
+     */
+    void truncated();
+
+    /**
+     * @brief Registers a line handed to a producer.
+     * @param endOffset Offset just past the line's newline.
+     * @return The generation to pass back to acknowledge().
+     */
+    uint32_t track(uint64_t endOffset);
+
+    /**
+     * @brief Marks a line as delivered or given up on. Repeated calls are ignored.
+     * @param endOffset The offset passed to track().
+     * @param generation The generation returned by track().
+     */
+    void acknowledge(uint64_t endOffset, uint32_t generation);
+
+    /**
+     * @brief Refreshes the metrics and evaluates the thresholds.
+     * @param now The current time, from LatencyTracker::now().
+     * @return Whether an alert was raised or cleared.
+     */
+    Transition update(int64_t now);
+
+    /**
+     * @brief Retrieves the committed offset.
+     * @return End of the acknowledged prefix of the file.
+     */
+    uint64_t committedOffset() const;
+
+    /**
+     * @brief Retrieves the number of unshipped bytes.
+     * @return Last observed file size minus the committed offset.
+     */
+    uint64_t unshippedBytes() const;
+
+    /**
+     * @brief Retrieves the age of the oldest unshipped byte.
+     * @param now The current time, from LatencyTracker::now().
+     * @return The age in seconds, 0 if everything was shipped.
+     */
+    double oldestUnshippedSeconds(int64_t now) const;
+
+private:
+    /// Most size observations kept; further growth is merged into the newest one.
+    static const size_t MAX_ARRIVALS = 1024;
+
+    /**
+     * @brief A line handed to a producer.
+     */
+    struct Pending {
+        uint64_t endOffset; ///< Offset just past the line.
+        bool acknowledged; ///< Whether the line is done.
+    };
+
+    /**
+     * @brief A size the file was seen to grow to.
+     */
+    struct Arrival {
+        uint64_t fileSize; ///< The size.
+        int64_t seen; ///< When it was first seen.
+    };
+
+    std::string file; ///< Name of the file.
+    mutable std::mutex mutex; ///< Protects the fields below.
+    std::deque<Pending> pending; ///< Lines not yet committed, by end offset.
+    std::deque<Arrival> arrivals; ///< Observed sizes above the committed offset, oldest first.
+    uint64_t committed; ///< The committed offset.
+    uint64_t fileSize; ///< Last observed file size.
+    uint32_t generation; ///< Bumped on truncation to ignore acknowledgements of the old contents.
+    uint64_t inFlight; ///< Tracked lines not yet acknowledged.
+
+    uint64_t maxUnshippedBytes; ///< Byte threshold; 0 if disabled.
+    int64_t maxAgeMs; ///< Age threshold; 0 if disabled.
+    bool alerting; ///< Whether an alert is currently raised.
+
+    Metrics::Gauge& committedGauge; ///< sparky_file_committed_offset_bytes
+    Metrics::Gauge& unshippedGauge; ///< sparky_file_unshipped_bytes
+    Metrics::Gauge& inFlightGauge; ///< sparky_file_in_flight_lines
+    Metrics::Gauge& ageGauge; ///< sparky_file_oldest_unshipped_seconds
+    Metrics::Gauge& alertGauge; ///< sparky_file_lag_alert
+    Metrics::Counter& alerts; ///< sparky_file_lag_alerts_total
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "LaneScheduler.h"
+#include "CpuGovernor.h"
+#include <vector>                  // Used for dispatch batches
+#include <iostream>                // Used for std::cerr
+#include <algorithm>               // Used for std::min
+
+namespace {
+
+/// How long the dispatcher sleeps when idle before serving delivery reports again.
+const std::chrono::milliseconds IDLE_POLL_INTERVAL(100);
+
+/// How long the dispatcher backs off when every non-empty lane's producer queue is full.
+const std::chrono::milliseconds FULL_BACKOFF(1);
+
+/// How often waitDelivered() checks for outstanding traces.
+const std::chrono::milliseconds DELIVERED_CHECK_INTERVAL(10);
+
+/// How long to wait for each lane's producer to drain on shutdown.
+const int SHUTDOWN_FLUSH_TIMEOUT_MS = 5000;
+
+} // namespace
+
+/**
+ * @brief Constructs a LaneScheduler with default lane settings and starts dispatching.
+ *
+ * @param kafkaBroker The address of the Kafka broker.
+ * @param kafkaTopic The Kafka topic to which messages are sent.
+ * @param criticalSlo Latency target for the critical lane.
+ *
+ * @throws std::runtime_error If a lane's producer cannot be created.
+ */
+LaneScheduler::LaneScheduler(const std::string& kafkaBroker, const std::string& kafkaTopic, std::chrono::milliseconds criticalSlo)
+    : kafkaTopic(kafkaTopic), criticalSlo(criticalSlo), running(true) {
+    Metrics& metrics = Metrics::instance();
+    for (size_t i = 0; i < LANE_COUNT; ++i) {
+        Priority priority = static_cast<Priority>(i);
+        Lane& lane = lanes[i];
+        lane.config = defaultConfig(priority);
+        std::map<std::string, std::string> producerConfig = {
+            {"linger.ms", std::to_string(lane.config.lingerMs)},
+            {"batch.num.messages", std::to_string(lane.config.batchMessages)}
+        };
+        lane.sink.reset(new KafkaSink(kafkaBroker, kafkaTopic, std::string("lane:") + laneName(priority), producerConfig));
+        lane.sink->setBlockingSwitch(false);
+        std::string labels = Metrics::label("lane", laneName(priority));
+        lane.depth = &metrics.gauge("sparky_lane_queue_depth", labels);
+        lane.maxWait = &metrics.gauge("sparky_lane_oldest_wait_microseconds", labels);
+        lane.dispatched = &metrics.counter("sparky_lane_dispatched_total", labels);
+        lane.blocked = &metrics.counter("sparky_lane_blocked_microseconds_total", labels);
+    }
+    dispatcher = std::thread(&LaneScheduler::dispatch, this);
+}
+
+/**
+ * @brief Stops the dispatcher once every queued message has been handed to a producer, then flushes.
+ */
+LaneScheduler::~LaneScheduler() {
+    running.store(false);
+    work.notify_all();
+    dispatcher.join();
+    for (Lane& lane : lanes) {
+        lane.sink->flush(SHUTDOWN_FLUSH_TIMEOUT_MS);
+    }
+}
+
+/**
+ * @brief The default settings for a lane.
+ *
+ * Critical lanes trade batching efficiency for latency; bulk lanes batch
+ * heavily and get one dispatch slot for every 16 critical ones.
+ *
+ * @param priority The lane.
+ * @return The lane's default settings.
+ */
+LaneScheduler::LaneConfig LaneScheduler::defaultConfig(Priority priority) {
+    switch (priority) {
+        case CRITICAL: return {5, 100, 10000, 16};
+        case NORMAL:   return {50, 1000, 10000, 4};
+        default:       return {500, 10000, 10000, 1};
+    }
+}
+
+/**
+ * @brief Retrieves the name of a lane.
+ *
+ * @param priority The lane.
+ * @return The lane name used in metric labels.
+ */
+const char* LaneScheduler::laneName(Priority priority) {
+    switch (priority) {
+        case CRITICAL: return "critical";
+        case NORMAL:   return "normal";
+        default:       return "bulk";
+    }
+}
+
+/**
+ * @brief Queues a message on a lane.
+ *
+ * Blocks while the lane's queue is at capacity; the time spent blocked is
+ * added to `sparky_lane_blocked_microseconds_total`.
+ *
+ * @param priority The lane.
+ * @param message The message to be sent.
+ * @param key The message key used for partitioning; empty for no key.
+ * @param trace Latency trace for the message, or nullptr. Its enqueue time is
+ *        set when the dispatcher hands the message to the lane's producer.
+ */
+void LaneScheduler::submit(Priority priority, const std::string& message, const std::string& key, EventTrace* trace) {
+    std::unique_ptr<EventTrace> owned(trace);
+    Lane& lane = lanes[priority];
+    std::unique_lock<std::mutex> lock(mutex);
+    if (lane.queue.size() >= lane.config.queueCapacity) {
+        auto start = std::chrono::steady_clock::now();
+        lane.space.wait(lock, [&lane] { return lane.queue.size() < lane.config.queueCapacity; });
+        lane.blocked->add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+    lane.queue.push_back(Item{message, key, std::chrono::steady_clock::now(), std::move(owned)});
+    lane.depth->set(static_cast<double>(lane.queue.size()));
+    lock.unlock();
+    work.notify_one();
+}
+
+/**
+ * @brief Waits until every message traced by a tracker has been delivered or has failed.
+ *
+ * The dispatcher keeps draining the lanes and serving delivery reports
+ * meanwhile, and a message that cannot be delivered fails after librdkafka's
+ * `message.timeout.ms`, so the wait ends. A monitor calls this before
+ * returning: the traces of its queued and in-flight messages point at its
+ * latency and lag trackers, which must outlive them.
+ *
+ * @param tracker The tracker.
+ */
+void LaneScheduler::waitDelivered(const LatencyTracker& tracker) {
+    while (tracker.outstanding() > 0) {
+        work.notify_one();
+        std::this_thread::sleep_for(DELIVERED_CHECK_INTERVAL);
+    }
+}
+
+/**
+ * @brief Dispatcher loop: drains the lanes into their producers by weighted round robin.
+ *
+ * Each round takes up to `weight` messages from every lane, critical first,
+ * or the whole critical queue if its oldest message is overdue. Messages a
+ * full producer queue refuses are put back at the head of their lane. After
+ * every round delivery reports are served and the CPU governor's limits are
+ * passed on to the lane producers.
+ *
+ * Nothing here may block, since every lane shares this thread: producing
+ * refuses rather than waits, and KafkaSink::poll() neither waits for reports
+ * nor, since lane sinks have no blocking switch, flushes when a lane switches
+ * codecs.
+ */
+void LaneScheduler::dispatch() {
+    CpuGovernor& governor = CpuGovernor::instance();
+    std::vector<Item> batch[LANE_COUNT];
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto pending = [this] {
+            for (const Lane& lane : lanes) {
+                if (!lane.queue.empty()) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        work.wait_for(lock, IDLE_POLL_INTERVAL, [&] { return !running.load() || pending(); });
+        if (!running.load() && !pending()) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < LANE_COUNT; ++i) {
+            Lane& lane = lanes[i];
+            if (lane.queue.empty()) {
+                continue;
+            }
+            auto oldest = now - lane.queue.front().enqueued;
+            lane.maxWait->set(static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(oldest).count()));
+            size_t take = std::min<size_t>(lane.queue.size(), lane.config.weight);
+            if (i == CRITICAL && oldest > criticalSlo / 4) {
+                take = lane.queue.size();
+            }
+            for (size_t k = 0; k < take; ++k) {
+                batch[i].push_back(std::move(lane.queue.front()));
+                lane.queue.pop_front();
+            }
+        }
+        lock.unlock();
+
+        bool progressed = false;
+        for (size_t i = 0; i < LANE_COUNT; ++i) {
+            Lane& lane = lanes[i];
+            size_t sent = 0;
+            while (sent < batch[i].size()) {
+                Item& item = batch[i][sent];
+                try {
+                    if (item.trace) {
+                        item.trace->enqueued = LatencyTracker::now();
+                    }
+                    if (!lane.sink->tryProduce(item.message, item.key, item.trace.get())) {
+                        break;
+                    }
+                    item.trace.release();
+                } catch (const std::exception& e) {
+                    std::cerr << "Error sending message to Kafka: " << e.what() << std::endl;
+                    if (item.trace) {
+                        LatencyTracker::delivered(item.trace.release(), false);
+                    }
+                }
+                sent++;
+            }
+            if (sent < batch[i].size()) {
+                // The producer queue is full: keep the rest at the head of the lane
+                std::lock_guard<std::mutex> relock(mutex);
+                for (size_t k = batch[i].size(); k > sent; --k) {
+                    lane.queue.push_front(std::move(batch[i][k - 1]));
+                }
+            }
+            if (sent > 0) {
+                progressed = true;
+                lane.dispatched->add(sent);
+            }
+            batch[i].clear();
+
+            if (governor.budget() > 0) {
+                lane.sink->setCpuBudget(governor.budget());
+                lane.sink->setMaxCodec(governor.maxCodec());
+            }
+            lane.sink->poll();
+        }
+
+        lock.lock();
+        for (Lane& lane : lanes) {
+            lane.depth->set(static_cast<double>(lane.queue.size()));
+            if (lane.queue.size() < lane.config.queueCapacity) {
+                lane.space.notify_all();
+            }
+        }
+        bool backlogged = pending();
+        lock.unlock();
+        if (!progressed && backlogged) {
+            std::this_thread::sleep_for(FULL_BACKOFF);
+        }
+    }
+}
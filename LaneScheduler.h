@@ -0,0 +1,141 @@
+#ifndef LANESCHEDULER_H
+#define LANESCHEDULER_H
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include "KafkaSink.h"
+#include "Metrics.h"
+#include "LatencyTracker.h"
+
+
+/**
+ * @class LaneScheduler
+ * @brief Routes messages through per-priority lanes so critical sources are not stuck behind bulk traffic.
+ *
+ * Each lane has its own bounded queue and its own KafkaSink, so its producer
+ * batching (`linger.ms`, `batch.num.messages`) and broker queue are separate
+ * from the other lanes. A single dispatcher thread drains the queues with
+ * weighted round robin, critical first. If the oldest critical message has
+ * waited longer than a quarter of the critical latency SLO, the critical lane
+ * is drained completely before any other lane gets a turn.
+ *
+ * submit() blocks while a lane's queue is full, and the dispatcher leaves
+ * messages queued while a lane's producer queue is full. Under saturation the
+ * bulk readers therefore stall and their unread data stays in their files,
+ * while critical readers keep flowing.
+ */
+class LaneScheduler {
+public:
+    /**
+     * @brief Priority classes, highest first.
+     */
+    enum Priority {
+        CRITICAL = 0, ///< Security-critical sources such as auth and audit logs.
+        NORMAL = 1,   ///< Everything else.
+        BULK = 2      ///< Verbose, latency-tolerant sources.
+    };
+
+    /// Number of priority classes.
+    static const size_t LANE_COUNT = 3;
+
+    /**
+     * @brief Per-lane settings.
+     */
+    struct LaneConfig {
+        int lingerMs;         ///< librdkafka `linger.ms` for the lane's producer.
+        int batchMessages;    ///< librdkafka `batch.num.messages` for the lane's producer.
+        size_t queueCapacity; ///< Messages the lane queues before submit() blocks.
+        unsigned weight;      ///< Messages dispatched from the lane per round.
+    };
+
+    /**
+     * @brief Constructs a LaneScheduler and starts its dispatcher thread.
+     * @param kafkaBroker The address of the Kafka broker.
+     * @param kafkaTopic The Kafka topic to which messages are sent.
+     * @param criticalSlo Latency target for the critical lane.
+     * @throws std::runtime_error If a lane's producer cannot be created.
+     */
+    LaneScheduler(const std::string& kafkaBroker, const std::string& kafkaTopic,
+                  std::chrono::milliseconds criticalSlo = std::chrono::milliseconds(1000));
+
+    /**
+     * @brief Stops the dispatcher after draining the queues, then flushes the producers.
+     */
+    ~LaneScheduler();
+
+    LaneScheduler(const LaneScheduler&) = delete;
+    LaneScheduler& operator=(const LaneScheduler&) = delete;
+
+    /**
+     * @brief The default settings for a lane.
+     * @param priority The lane.
+     * @return 5 ms linger and weight 16 for critical, 50 ms and 4 for normal, 500 ms and 1 for bulk.
+     */
+    static LaneConfig defaultConfig(Priority priority);
+
+    /**
+     * @brief Queues a message on a lane, blocking while the lane is full.
+     * @param priority The lane.
+     * @param message The message to be sent.
+     * @param key The message key used for partitioning; empty for no key.
+     * @param trace Latency trace for the message, or nullptr; the scheduler takes ownership.
+     */
+    void submit(Priority priority, const std::string& message, const std::string& key = "", EventTrace* trace = nullptr);
+
+    /**
+     * @brief Waits until every message traced by a tracker has been delivered or has failed.
+     * @param tracker The tracker; a monitor's, whose traces also point at its lag tracker.
+     */
+    void waitDelivered(const LatencyTracker& tracker);
+
+    /**
+     * @brief Retrieves the Kafka topic the scheduler produces to.
+     * @return The topic name.
+     */
+    const std::string& topic() const { return kafkaTopic; }
+
+    /**
+     * @brief Retrieves the name of a lane.
+     * @param priority The lane.
+     * @return "critical", "normal" or "bulk".
+     */
+    static const char* laneName(Priority priority);
+
+private:
+    struct Item {
+        std::string message;
+        std::string key;
+        std::chrono::steady_clock::time_point enqueued;
+        std::unique_ptr<EventTrace> trace;
+    };
+
+    struct Lane {
+        LaneConfig config;
+        std::unique_ptr<KafkaSink> sink;
+        std::deque<Item> queue;
+        std::condition_variable space;
+        Metrics::Gauge* depth;
+        Metrics::Gauge* maxWait;
+        Metrics::Counter* dispatched;
+        Metrics::Counter* blocked;
+    };
+
+    void dispatch();
+
+    std::string kafkaTopic; ///< The Kafka topic to which messages are sent.
+    std::chrono::milliseconds criticalSlo; ///< Latency target for the critical lane.
+    Lane lanes[LANE_COUNT]; ///< The lanes, indexed by Priority.
+    std::mutex mutex; ///< Protects every lane queue.
+    std::condition_variable work; ///< Signalled when a message is queued or on shutdown.
+    std::atomic<bool> running; ///< Cleared to stop the dispatcher.
+    std::thread dispatcher; ///< Drains the lanes into their producers.
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "LatencyHistogram.h"
+#include <algorithm>               // Used for std::min and std::max
+
+namespace {
+
+/// Values below this get a bucket each.
+const uint64_t LINEAR_LIMIT = 128;
+
+/// Buckets per power of two above LINEAR_LIMIT.
+const unsigned SUB_BUCKET_BITS = 6;
+
+} // namespace
+
+/**
+ * @brief Constructs an empty histogram.
+ */
+LatencyHistogram::LatencyHistogram()
+    : counts(BUCKET_COUNT), total(0), sum(0), max(0) {
+}
+
+/**
+ * @brief Maps a value to its bucket.
+ *
+ * For a value v >= 128 with highest set bit b, the bucket is identified by
+ * b and the 6 bits below it; values that differ only in lower bits share it.
+ *
+ * @param value The value.
+ * @return The bucket index, at most BUCKET_COUNT - 1.
+ */
+size_t LatencyHistogram::bucketFor(uint64_t value) {
+    if (value < LINEAR_LIMIT) {
+        return static_cast<size_t>(value);
+    }
+    unsigned highBit = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    unsigned shift = highBit - SUB_BUCKET_BITS;
+    size_t bucket = LINEAR_LIMIT + (shift - 1) * (1u << SUB_BUCKET_BITS) +
+                    static_cast<size_t>((value >> shift) - (1u << SUB_BUCKET_BITS));
+    return std::min(bucket, BUCKET_COUNT - 1);
+}
+
+/**
+ * @brief Retrieves the largest value that maps to a bucket.
+ *
+ * @param bucket The bucket index.
+ * @return The bucket's upper bound.
+ */
+uint64_t LatencyHistogram::bucketUpperBound(size_t bucket) {
+    if (bucket < LINEAR_LIMIT) {
+        return bucket;
+    }
+    size_t offset = bucket - LINEAR_LIMIT;
+    unsigned shift = static_cast<unsigned>(offset >> SUB_BUCKET_BITS) + 1;
+    uint64_t mantissa = (offset & ((1u << SUB_BUCKET_BITS) - 1)) + (1u << SUB_BUCKET_BITS);
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * @brief Records a value.
+ *
+ * @param value The value.
+ */
+void LatencyHistogram::record(uint64_t value) {
+    counts[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Copies the current counts.
+ *
+ * Values recorded while the copy is taken may or may not be included; the
+ * total is recomputed from the copied buckets so the snapshot is consistent.
+ *
+ * @return The snapshot.
+ */
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot snapshot;
+    snapshot.counts.resize(BUCKET_COUNT);
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        snapshot.counts[i] = counts[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.sum = sum.load(std::memory_order_relaxed);
+    snapshot.max = max.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+/**
+ * @brief Retrieves the value at a quantile.
+ *
+ * @param quantile The quantile, between 0 and 1.
+ * @return The upper bound of the bucket holding the value at that rank; 0 if empty.
+ */
+uint64_t LatencyHistogram::Snapshot::percentile(double quantile) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(quantile * count + 0.5);
+    rank = std::min(count, std::max<uint64_t>(rank, 1));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief Retrieves the values recorded between an earlier snapshot and this one.
+ *
+ * @param earlier The earlier snapshot; an empty one yields this snapshot.
+ * @return The difference, with this snapshot's maximum.
+ */
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::since(const Snapshot& earlier) const {
+    Snapshot difference = *this;
+    if (earlier.counts.size() != counts.size()) {
+        return difference;
+    }
+    difference.count = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        difference.counts[i] = counts[i] - earlier.counts[i];
+        difference.count += difference.counts[i];
+    }
+    difference.sum = sum - earlier.sum;
+    return difference;
+}
+
+/**
+ * @brief Adds another snapshot's values to this one.
+ *
+ * An empty snapshot takes the other's buckets as they are.
+ *
+ * @param other The snapshot to add.
+ */
+void LatencyHistogram::Snapshot::merge(const Snapshot& other) {
+    if (counts.empty()) {
+        counts.assign(other.counts.size(), 0);
+    }
+    for (size_t i = 0; i < counts.size() && i < other.counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
@@ -0,0 +1,99 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @class LatencyHistogram
+ * @brief Lock-free HDR-style histogram of non-negative integer values.
+ *
+ * Values below 128 get a bucket each; above that every power of two is split
+ * into 64 linear buckets, so a reported value is within 1.6% of the recorded
+ * one across the whole range (below 2^41). Recording is a handful of relaxed
+ * atomic increments, so any number of threads can record concurrently without
+ * locks, and readers take snapshots at any time.
+ */
+class LatencyHistogram {
+public:
+    /**
+     * @brief A point-in-time copy of a histogram's buckets.
+     */
+    struct Snapshot {
+        std::vector<uint64_t> counts; ///< Count per bucket.
+        uint64_t count = 0; ///< Total number of values.
+        uint64_t sum = 0; ///< Sum of all values.
+        uint64_t max = 0; ///< Largest value; for a difference, the largest of the later snapshot.
+
+        /**
+         * @brief Retrieves the value at a quantile.
+         * @param quantile The quantile, e.g. 0.99.
+         * @return The upper bound of the bucket holding that quantile; 0 if empty.
+         */
+        uint64_t percentile(double quantile) const;
+
+        /**
+         * @brief Retrieves the values recorded between an earlier snapshot and this one.
+         * @param earlier A snapshot of the same histogram taken before this one.
+         * @return The difference.
+         */
+        Snapshot since(const Snapshot& earlier) const;
+
+        /**
+         * @brief Adds the values of another histogram's snapshot, e.g. to combine inputs.
+         * @param other The snapshot to add.
+         */
+        void merge(const Snapshot& other);
+    };
+
+    /// Number of buckets.
+    static const size_t BUCKET_COUNT = 128 + 34 * 64;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /**
+     * @brief Records a value. Safe to call from any thread.
+     * @param value The value; values of 2^41 and above land in the last bucket.
+     */
+    void record(uint64_t value);
+
+    /**
+     * @brief Retrieves the number of values recorded.
+     * @return The count, without taking a snapshot.
+     */
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Copies the current counts.
+     * @return The snapshot.
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Maps a value to its bucket.
+     * @param value The value.
+     * @return The bucket index.
+     */
+    static size_t bucketFor(uint64_t value);
+
+    /**
+     * @brief Retrieves the largest value that maps to a bucket.
+     * @param bucket The bucket index.
+     * @return The bucket's upper bound.
+     */
+    static uint64_t bucketUpperBound(size_t bucket);
+
+private:
+    std::vector<std::atomic<uint64_t>> counts; ///< Count per bucket.
+    std::atomic<uint64_t> total; ///< Total number of values.
+    std::atomic<uint64_t> sum; ///< Sum of all values.
+    std::atomic<uint64_t> max; ///< Largest value recorded.
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "LatencyTracker.h"
+#include "Metrics.h"
+#include "LagTracker.h"
+#include <iostream>                // Used for std::cerr
+#include <sstream>                 // Used for std::ostringstream
+
+namespace {
+
+/// How often logSummaryIfDue() logs.
+const std::chrono::seconds SUMMARY_INTERVAL(60);
+
+} // namespace
+
+/**
+ * @brief Constructs a LatencyTracker and registers its histograms.
+ *
+ * @param input Name of the input, e.g. the file path.
+ */
+LatencyTracker::LatencyTracker(const std::string& input)
+    : input(input), lastSummaryNanos(now()) {
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        std::string labels = Metrics::label("input", input) + "," + Metrics::label("stage", stageName(static_cast<Stage>(i)));
+        histograms[i] = &Metrics::instance().histogram("sparky_latency_microseconds", labels);
+    }
+}
+
+/**
+ * @brief Retrieves the name of a stage.
+ *
+ * @param stage The stage.
+ * @return "read", "format", "enqueue", "delivery" or "total".
+ */
+const char* LatencyTracker::stageName(Stage stage) {
+    switch (stage) {
+        case READ:     return "read";
+        case FORMAT:   return "format";
+        case ENQUEUE:  return "enqueue";
+        case DELIVERY: return "delivery";
+        default:       return "total";
+    }
+}
+
+/**
+ * @brief Starts a trace for an event.
+ *
+ * @param notified When the write was noticed.
+ * @param read When the chunk holding the event was read.
+ * @return The trace; formatted and enqueued are filled in by later stages, and
+ *         the lag fields by the reader if the line's offset is tracked.
+ */
+EventTrace* LatencyTracker::begin(int64_t notified, int64_t read) {
+    traces.fetch_add(1, std::memory_order_relaxed);
+    return new EventTrace{this, notified, read, read, read, nullptr, 0, 0};
+}
+
+/**
+ * @brief Removes the trace from its tracker's outstanding traces.
+ *
+ * Runs however the trace is freed, on delivery or when its message is given
+ * up on, after every other use of the tracker and the lag tracker.
+ */
+EventTrace::~EventTrace() {
+    tracker->traces.fetch_sub(1, std::memory_order_release);
+}
+
+/**
+ * @brief Records every stage of a delivered event, acknowledges its offset and frees its trace.
+ *
+ * Called from delivery report callbacks, so possibly on another thread than
+ * the one that started the trace, and for messages that failed to be
+ * produced. Failed lines are acknowledged too: they will not be retried, so
+ * they must not hold back the committed offset.
+ *
+ * @param trace The trace.
+ * @param success Whether the message was delivered.
+ */
+void LatencyTracker::delivered(EventTrace* trace, bool success) {
+    if (success) {
+        int64_t deliveredAt = now();
+        LatencyTracker& tracker = *trace->tracker;
+        tracker.record(READ, trace->notified, trace->read);
+        tracker.record(FORMAT, trace->read, trace->formatted);
+        tracker.record(ENQUEUE, trace->formatted, trace->enqueued);
+        tracker.record(DELIVERY, trace->enqueued, deliveredAt);
+        tracker.record(TOTAL, trace->notified, deliveredAt);
+    }
+    if (trace->lag) {
+        trace->lag->acknowledge(trace->endOffset, trace->lagGeneration);
+    }
+    delete trace;
+}
+
+/**
+ * @brief Records the time between two trace points in a stage's histogram.
+ *
+ * @param stage The stage.
+ * @param from Start of the stage, in nanoseconds.
+ * @param to End of the stage, in nanoseconds.
+ */
+void LatencyTracker::record(Stage stage, int64_t from, int64_t to) {
+    histograms[stage]->record(to > from ? static_cast<uint64_t>(to - from) / 1000 : 0);
+}
+
+/**
+ * @brief Logs per-stage percentiles for the events delivered since the last summary.
+ *
+ * Only called by the thread that owns the input; recording threads are not
+ * affected since the histograms are only read.
+ */
+void LatencyTracker::logSummaryIfDue() {
+    int64_t current = now();
+    if (current - lastSummaryNanos < std::chrono::duration_cast<std::chrono::nanoseconds>(SUMMARY_INTERVAL).count()) {
+        return;
+    }
+    lastSummaryNanos = current;
+
+    std::ostringstream summary;
+    summary << "Latency " << input << ":";
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        LatencyHistogram::Snapshot snapshot = histograms[i]->snapshot();
+        LatencyHistogram::Snapshot interval = snapshot.since(lastSummary[i]);
+        lastSummary[i] = std::move(snapshot);
+        if (i == TOTAL && interval.count == 0) {
+            return;
+        }
+        summary << " " << stageName(static_cast<Stage>(i)) << " p50/p99/p999 "
+                << interval.percentile(0.5) << "/" << interval.percentile(0.99) << "/" << interval.percentile(0.999) << "us";
+        if (i == TOTAL) {
+            summary << " (" << interval.count << " events)";
+        }
+    }
+    std::cerr << summary.str() << std::endl;
+}
@@ -0,0 +1,140 @@
+#ifndef LATENCYTRACKER_H
+#define LATENCYTRACKER_H
+
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "LatencyHistogram.h"
+
+class LatencyTracker;
+class LagTracker;
+
+
+/**
+ * @brief Timestamps of one event on its way from the file to Kafka.
+ *
+ * All times are steady-clock nanoseconds from LatencyTracker::now(). A trace
+ * travels with its message as the librdkafka message opaque and is completed
+ * and freed by the delivery report, which also acknowledges the line's offset
+ * to the input's LagTracker. Its tracker counts it as outstanding until it is
+ * freed, so the input's owner can wait for its traces before going away.
+ */
+struct EventTrace {
+    LatencyTracker* tracker; ///< The tracker of the input the event came from.
+    int64_t notified; ///< inotify reported the write (or the initial read began).
+    int64_t read; ///< The chunk holding the line was read.
+    int64_t formatted; ///< The message was formatted.
+    int64_t enqueued; ///< The message was handed to the producer.
+    LagTracker* lag; ///< Lag tracker to acknowledge the line to, or nullptr.
+    uint64_t endOffset; ///< Offset just past the line in its file.
+    uint32_t lagGeneration; ///< Generation returned by LagTracker::track().
+
+    /**
+     * @brief Removes the trace from its tracker's outstanding traces; the last access to the tracker.
+     */
+    ~EventTrace();
+};
+
+/**
+ * @class LatencyTracker
+ * @brief Per-input latency histograms for each stage between a write and its delivery report.
+ *
+ * The stages are:
+ * - read: write notification to the chunk being read (pacing and backlog)
+ * - format: chunk read to formatted message (rate limiting, templating, formatting)
+ * - enqueue: formatted to handed to the producer (lane queueing)
+ * - delivery: handed to the producer to the delivery report (batching, network, broker)
+ * - total: write notification to the delivery report
+ *
+ * Each stage is a LatencyHistogram in microseconds registered with Metrics as
+ * `sparky_latency_microseconds{input="...",stage="..."}`, so recording needs
+ * no locks and can happen on whichever thread serves the delivery report.
+ */
+class LatencyTracker {
+public:
+    /**
+     * @brief Pipeline stages.
+     */
+    enum Stage {
+        READ = 0,
+        FORMAT = 1,
+        ENQUEUE = 2,
+        DELIVERY = 3,
+        TOTAL = 4
+    };
+
+    /// Number of stages.
+    static const size_t STAGE_COUNT = 5;
+
+    /**
+     * @brief Constructs a LatencyTracker.
+     * @param input Name of the input, used as the `input` metric label.
+     */
+    explicit LatencyTracker(const std::string& input);
+
+    LatencyTracker(const LatencyTracker&) = delete;
+    LatencyTracker& operator=(const LatencyTracker&) = delete;
+
+    /**
+     * @brief Starts a trace for an event read from this input.
+     * @param notified When the write was noticed.
+     * @param read When the chunk holding the event was read.
+     * @return The trace, owned by the caller until handed to a producer.
+     */
+    EventTrace* begin(int64_t notified, int64_t read);
+
+    /**
+     * @brief Completes a trace on its delivery report, or when its message is given up on, and frees it.
+     * @param trace The trace.
+     * @param success Whether the message was delivered; failed deliveries are not recorded.
+     */
+    static void delivered(EventTrace* trace, bool success);
+
+    /**
+     * @brief Retrieves the number of traces started and not yet freed.
+     * @return The count; traces of messages queued or in flight hold pointers to this tracker.
+     */
+    size_t outstanding() const { return traces.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Logs the latency percentiles since the previous summary if the summary interval has passed.
+     */
+    void logSummaryIfDue();
+
+    /**
+     * @brief Retrieves a stage's histogram.
+     * @param stage The stage.
+     * @return The histogram, in microseconds.
+     */
+    const LatencyHistogram& histogram(Stage stage) const { return *histograms[stage]; }
+
+    /**
+     * @brief Retrieves the name of a stage.
+     * @param stage The stage.
+     * @return The name used in the `stage` metric label.
+     */
+    static const char* stageName(Stage stage);
+
+    /**
+     * @brief Retrieves the clock used for traces.
+     * @return Steady-clock time in nanoseconds.
+     */
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    friend struct EventTrace;
+
+    void record(Stage stage, int64_t from, int64_t to);
+
+    std::string input; ///< Name of the input.
+    LatencyHistogram* histograms[STAGE_COUNT]; ///< Per-stage histograms, owned by Metrics.
+    LatencyHistogram::Snapshot lastSummary[STAGE_COUNT]; ///< Snapshots at the previous summary.
+    int64_t lastSummaryNanos; ///< When the previous summary was logged.
+    std::atomic<size_t> traces{0}; ///< Traces started and not yet freed.
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "LineFilter.h"
+#include <fnmatch.h>               // Used for fnmatch()
+#include <fstream>                 // Used for std::ifstream
+#include <sstream>                 // Used for std::istringstream
+#include <stdexcept>               // Used for std::invalid_argument and std::runtime_error
+#include <cmath>                   // Used for std::ldexp
+#include <algorithm>               // Used for std::binary_search
+
+namespace {
+
+/**
+ * @brief Removes leading and trailing spaces and tabs.
+ *
+ * @param text The text.
+ * @return The trimmed text.
+ */
+std::string trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a rule and registers its hit counter.
+ *
+ * @param name The rule name.
+ */
+LineFilter::Rule::Rule(const std::string& name)
+    : name(name), action(KEEP), match(ANY), pattern(-1), field(0), rate(0), sampled(0),
+      hits(Metrics::instance().counter("sparky_filter_rule_hits_total", Metrics::label("rule", name))) {
+}
+
+/**
+ * @brief Constructs a filter with no rules.
+ *
+ * @param extractor Extractor for field rules, or nullptr.
+ */
+LineFilter::LineFilter(FieldExtractor* extractor) : extractor(extractor), defaultAction(KEEP) {
+}
+
+/**
+ * @brief Compiles and appends a rule.
+ *
+ * Field rules reference their field in the extractor, so it is extracted
+ * for every file with extraction enabled. Regex rules add their pattern to
+ * the prefilter, which keeps the compiled RE2.
+ *
+ * @param name Rule name.
+ * @param action What to do with matching lines.
+ * @param match What the rule looks at.
+ * @param argument Glob, text, pattern or NAME=VALUE.
+ * @param rate Fraction of matching lines a SAMPLE rule keeps, 0 to 1.
+ *
+ * @throws std::invalid_argument If the argument is invalid or a field rule has no extractor.
+ * @throws std::runtime_error If a regex rule is added after compile().
+ */
+void LineFilter::addRule(const std::string& name, Action action, Match match, const std::string& argument, double rate) {
+    std::unique_ptr<Rule> rule(new Rule(name));
+    rule->action = action;
+    rule->match = match;
+    rule->text = argument;
+    if (action == SAMPLE) {
+        if (!(rate >= 0 && rate <= 1)) {
+            throw std::invalid_argument("Rule " + name + ": sampling rate must be between 0 and 1");
+        }
+        rule->rate = static_cast<uint64_t>(std::ldexp(rate, 32));
+    }
+    if (match != ANY && argument.empty()) {
+        throw std::invalid_argument("Rule " + name + ": missing argument");
+    }
+    if (match == REGEX) {
+        RE2::Options options;
+        options.set_log_errors(false);
+        RE2 regex(argument, options);
+        if (!regex.ok()) {
+            throw std::invalid_argument("Rule " + name + ": invalid pattern: " + regex.error());
+        }
+        rule->pattern = patterns.add(argument);
+    } else if (match == FIELD) {
+        size_t equals = argument.find('=');
+        if (equals == std::string::npos || equals == 0) {
+            throw std::invalid_argument("Rule " + name + ": field match must be NAME=VALUE");
+        }
+        if (!extractor) {
+            throw std::invalid_argument("Rule " + name + ": field match needs a field extractor");
+        }
+        rule->field = extractor->reference(argument.substr(0, equals));
+        rule->text = argument.substr(equals + 1);
+    }
+    rules.push_back(std::move(rule));
+}
+
+/**
+ * @brief Parses and appends a rule, or sets the default action.
+ *
+ * @param text `NAME: ACTION MATCH ARGUMENT` or `default: ACTION`.
+ *
+ * @throws std::invalid_argument If the rule cannot be parsed.
+ */
+void LineFilter::addRule(const std::string& text) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos) {
+        throw std::invalid_argument("Rule without a name: " + text);
+    }
+    std::string name = trim(text.substr(0, colon));
+    std::istringstream in(text.substr(colon + 1));
+    std::string actionWord;
+    in >> actionWord;
+    Action action;
+    double rate = 1.0;
+    if (actionWord == "keep") {
+        action = KEEP;
+    } else if (actionWord == "drop") {
+        action = DROP;
+    } else if (actionWord == "sample" && in >> rate) {
+        action = SAMPLE;
+    } else {
+        throw std::invalid_argument("Rule " + name + ": expected keep, drop or sample RATE");
+    }
+
+    if (name == "default") {
+        if (action == SAMPLE) {
+            throw std::invalid_argument("The default action must be keep or drop");
+        }
+        defaultAction = action;
+        return;
+    }
+
+    std::string matchWord;
+    in >> matchWord;
+    std::string argument;
+    std::getline(in, argument);
+    argument = trim(argument);
+    Match match;
+    if (matchWord == "any") {
+        match = ANY;
+    } else if (matchWord == "source") {
+        match = SOURCE;
+    } else if (matchWord == "literal") {
+        match = LITERAL;
+    } else if (matchWord == "regex") {
+        match = REGEX;
+    } else if (matchWord == "field") {
+        match = FIELD;
+    } else {
+        throw std::invalid_argument("Rule " + name + ": expected any, source, literal, regex or field");
+    }
+    addRule(name, action, match, argument, rate);
+}
+
+/**
+ * @brief Appends the rules in a file.
+ *
+ * @param path The file.
+ *
+ * @throws std::runtime_error If the file cannot be opened.
+ * @throws std::invalid_argument If a rule cannot be parsed.
+ */
+void LineFilter::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open filter rules " + path);
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        try {
+            addRule(line);
+        } catch (const std::invalid_argument& e) {
+            throw std::invalid_argument(path + ":" + std::to_string(number) + ": " + e.what());
+        }
+    }
+}
+
+/**
+ * @brief Resolves the rules for one file.
+ *
+ * Source rules that do not match the path are left out. One that does, like
+ * an `any` rule, matches every line, so the rules after it are left out too
+ * unless it samples.
+ *
+ * @param filePath The file's path.
+ * @return The rules that apply to the file.
+ */
+LineFilter::Binding LineFilter::bind(const std::string& filePath) const {
+    Binding binding;
+    binding.filter = this;
+    bool terminated = false;
+    for (size_t i = 0; i < rules.size() && !terminated; ++i) {
+        const Rule& rule = *rules[i];
+        if (rule.match == SOURCE && fnmatch(rule.text.c_str(), filePath.c_str(), 0) != 0) {
+            continue;
+        }
+        binding.rules.push_back(i);
+        terminated = (rule.match == ANY || rule.match == SOURCE) && rule.action != SAMPLE;
+    }
+    binding.keepsAll = terminated || defaultAction == KEEP;
+    for (size_t index : binding.rules) {
+        if (rules[index]->action != KEEP) {
+            binding.keepsAll = false;
+        }
+    }
+    return binding;
+}
+
+/**
+ * @brief Evaluates the file's rules against a line; the first matching rule decides.
+ *
+ * @param line The line.
+ * @param fields The line's fields, or nullptr.
+ * @return True to send the line.
+ */
+bool LineFilter::Binding::keep(std::string_view line, FieldExtractor::Fields* fields) const {
+    if (keepsAll) {
+        return true;
+    }
+    bool prefiltered = false;
+    for (size_t index : rules) {
+        const Rule& rule = *filter->rules[index];
+        if (filter->matches(rule, line, fields, *this, prefiltered)) {
+            rule.hits.add();
+            return filter->apply(rule);
+        }
+    }
+    return filter->defaultAction == KEEP;
+}
+
+/**
+ * @brief Checks whether a rule matches a line.
+ *
+ * The first regex rule reached for a line has the prefilter find the regex
+ * rules that can match it; a regex rule that is not among them is skipped
+ * without running its pattern.
+ *
+ * @param rule The rule; source rules were resolved when binding and always match.
+ * @param line The line.
+ * @param fields The line's fields, or nullptr; a field rule never matches without them.
+ * @param binding The binding holding the prefilter's working memory and candidates.
+ * @param prefiltered Whether the candidates were already found for this line; set once they are.
+ * @return True if the rule matches.
+ */
+bool LineFilter::matches(const Rule& rule, std::string_view line, FieldExtractor::Fields* fields,
+                         const Binding& binding, bool& prefiltered) const {
+    switch (rule.match) {
+        case ANY:
+        case SOURCE:
+            return true;
+        case LITERAL:
+            return line.find(rule.text) != std::string_view::npos;
+        case REGEX:
+            if (!prefiltered) {
+                patterns.candidates(line, binding.scratch, binding.candidates);
+                prefiltered = true;
+            }
+            return std::binary_search(binding.candidates.begin(), binding.candidates.end(), rule.pattern) &&
+                   RE2::PartialMatch(re2::StringPiece(line.data(), line.size()), patterns.pattern(rule.pattern));
+        case FIELD: {
+            std::string_view value;
+            return fields && fields->get(rule.field, value) && value == rule.text;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Applies a matching rule's action.
+ *
+ * Sampling keeps a line whenever the running total of the rate crosses an
+ * integer, so exactly that fraction of matching lines is kept, evenly
+ * spread, across all files sharing the rule.
+ *
+ * @param rule The rule.
+ * @return True to send the line.
+ */
+bool LineFilter::apply(const Rule& rule) const {
+    if (rule.action != SAMPLE) {
+        return rule.action == KEEP;
+    }
+    uint64_t seen = rule.sampled.fetch_add(1, std::memory_order_relaxed);
+    uint64_t fraction = (seen * rule.rate) & 0xffffffffULL;
+    return fraction + rule.rate >= (1ULL << 32);
+}
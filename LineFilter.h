@@ -0,0 +1,196 @@
+#ifndef LINEFILTER_H
+#define LINEFILTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <re2/re2.h>
+#include "FieldExtractor.h"
+#include "PatternPrefilter.h"
+#include "Metrics.h"
+
+
+/**
+ * @class LineFilter
+ * @brief Drop and keep rules applied to lines before they are formatted.
+ *
+ * Rules are evaluated in order and the first rule matching a line decides
+ * its fate; a line no rule matches gets the default action, keep unless set
+ * otherwise. Rules are written one per line:
+ *
+ *     NAME: ACTION MATCH ARGUMENT
+ *
+ * - ACTION is `drop`, `keep` or `sample RATE`, which keeps that fraction
+ *   (0 to 1) of the matching lines, evenly spaced, and drops the rest.
+ * - MATCH is one of:
+ *   - `source GLOB`: the file path matches the glob, e.g. `/var/log/debug-*.log`
+ *   - `literal TEXT`: the line contains TEXT
+ *   - `regex PATTERN`: RE2 pattern found in the line
+ *   - `field NAME=VALUE`: the extracted field equals VALUE; needs a FieldExtractor
+ *   - `any`: every line
+ *
+ * For example:
+ *
+ *     health-checks: sample 0.01 literal GET /healthz
+ *     keep-errors: keep regex \b(ERROR|FATAL)\b
+ *     debug-noise: drop literal DEBUG
+ *     default: drop
+ *
+ * Each rule counts its hits in `sparky_filter_rule_hits_total{rule="NAME"}`.
+ *
+ * The patterns of all regex rules go into one PatternPrefilter, so a line is
+ * scanned once for their literals and only the rules that can match run
+ * their regex.
+ *
+ * Configure the filter and compile() it before monitors bind to it; it may
+ * then be shared by any number of monitors on any threads.
+ */
+class LineFilter {
+public:
+    /**
+     * @brief What to do with a line a rule matches.
+     */
+    enum Action {
+        KEEP,   ///< Send the line.
+        DROP,   ///< Discard the line before it is formatted.
+        SAMPLE  ///< Keep a fraction of the lines.
+    };
+
+    /**
+     * @brief What a rule looks at.
+     */
+    enum Match {
+        ANY,     ///< Every line.
+        SOURCE,  ///< The file path, against a glob.
+        LITERAL, ///< A substring of the line.
+        REGEX,   ///< An RE2 pattern in the line.
+        FIELD    ///< An extracted field's value.
+    };
+
+    /**
+     * @class Binding
+     * @brief A filter's rules as they apply to one file.
+     *
+     * Source rules are resolved once when binding, so only rules about line
+     * content are evaluated per line. A binding holds the prefilter's working
+     * memory, so it must be used by one thread at a time.
+     */
+    class Binding {
+    public:
+        /**
+         * @brief Decides whether a line is sent.
+         * @param line The line.
+         * @param fields The line's fields, already reset to it, or nullptr if the file has no extraction.
+         * @return True to send the line, false to drop it.
+         */
+        bool keep(std::string_view line, FieldExtractor::Fields* fields) const;
+
+        /**
+         * @brief Tells whether any rule can drop lines of the file.
+         * @return False if every line is kept without evaluation.
+         */
+        bool active() const { return !keepsAll; }
+
+    private:
+        friend class LineFilter;
+        const LineFilter* filter = nullptr; ///< The filter.
+        std::vector<size_t> rules; ///< Indexes of the rules that apply to the file.
+        bool keepsAll = true; ///< Whether every line is kept.
+        mutable PatternPrefilter::Scratch scratch; ///< Working memory of the regex prefilter.
+        mutable std::vector<int> candidates; ///< Regex rules that may match the current line, by pattern ID.
+    };
+
+    /**
+     * @brief Constructs an empty filter that keeps everything.
+     * @param extractor Extractor for field rules, or nullptr if there are none;
+     *        must outlive the filter, and is told which fields the rules reference.
+     */
+    explicit LineFilter(FieldExtractor* extractor = nullptr);
+
+    LineFilter(const LineFilter&) = delete;
+    LineFilter& operator=(const LineFilter&) = delete;
+
+    /**
+     * @brief Appends a rule.
+     * @param name Rule name, used as the metric label.
+     * @param action What to do with matching lines.
+     * @param match What the rule looks at.
+     * @param argument Glob, text, pattern or NAME=VALUE; ignored for ANY.
+     * @param rate Fraction of matching lines kept by a SAMPLE rule.
+     * @throws std::invalid_argument If the argument is invalid for the match, or a field rule has no extractor.
+     * @throws std::runtime_error If a regex rule is added after compile().
+     */
+    void addRule(const std::string& name, Action action, Match match, const std::string& argument, double rate = 1.0);
+
+    /**
+     * @brief Appends a rule written as `NAME: ACTION MATCH ARGUMENT`, or sets the default with `default: ACTION`.
+     * @param text The rule.
+     * @throws std::invalid_argument If the rule cannot be parsed.
+     */
+    void addRule(const std::string& text);
+
+    /**
+     * @brief Appends the rules in a file, one per line; blank lines and lines starting with '#' are skipped.
+     * @param path The file.
+     * @throws std::runtime_error If the file cannot be read.
+     * @throws std::invalid_argument If a rule cannot be parsed; the message names the line.
+     */
+    void load(const std::string& path);
+
+    /**
+     * @brief Builds the prefilter over the regex rules. Call after the last rule;
+     *        until then every regex rule runs on every line it is reached for.
+     */
+    void compile() { patterns.compile(); }
+
+    /**
+     * @brief Sets the action for lines no rule matches.
+     * @param action KEEP or DROP.
+     */
+    void setDefault(Action action) { defaultAction = action; }
+
+    /**
+     * @brief Resolves the rules for a file.
+     * @param filePath The file's path.
+     * @return The binding; valid while the filter lives.
+     */
+    Binding bind(const std::string& filePath) const;
+
+    /**
+     * @brief Retrieves the number of rules.
+     * @return The count.
+     */
+    size_t size() const { return rules.size(); }
+
+private:
+    /**
+     * @brief A compiled rule.
+     */
+    struct Rule {
+        std::string name; ///< Rule name.
+        Action action; ///< What to do with matching lines.
+        Match match; ///< What the rule looks at.
+        std::string text; ///< Glob, literal or field value.
+        int pattern; ///< ID of a REGEX rule's pattern in the prefilter.
+        size_t field; ///< Field index of a FIELD rule.
+        uint64_t rate; ///< SAMPLE: fraction of matching lines kept, in 32-bit fixed point.
+        mutable std::atomic<uint64_t> sampled; ///< SAMPLE: matching lines so far.
+        Metrics::Counter& hits; ///< sparky_filter_rule_hits_total
+
+        explicit Rule(const std::string& name);
+    };
+
+    bool matches(const Rule& rule, std::string_view line, FieldExtractor::Fields* fields, const Binding& binding, bool& prefiltered) const;
+    bool apply(const Rule& rule) const;
+
+    FieldExtractor* extractor; ///< Extractor for field rules, or null.
+    std::vector<std::unique_ptr<Rule>> rules; ///< Rules in evaluation order.
+    PatternPrefilter patterns; ///< Patterns of the regex rules.
+    Action defaultAction; ///< Action for lines no rule matches.
+};
+
+#endif
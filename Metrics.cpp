@@ -0,0 +1,231 @@
+#include "Metrics.h"
+#include <sstream>                 // Used for std::ostringstream
+#include <utility>                 // Used for std::make_pair
+#include <vector>                  // Used for std::vector
+#include <cmath>                   // Used for std::isnan, std::isinf and std::nearbyint
+#include <iomanip>                 // Used for std::setprecision
+#include <limits>                  // Used for std::numeric_limits
+
+namespace {
+
+/// Quantiles rendered for each histogram, as label text and value.
+const std::pair<const char*, double> QUANTILES[] = {{"0.5", 0.5}, {"0.99", 0.99}, {"0.999", 0.999}};
+
+/// Largest magnitude below which every integer is exactly representable as a double (2^53).
+const double EXACT_INTEGER_LIMIT = 9007199254740992.0;
+
+/**
+ * @brief Formats a counter value.
+ *
+ * @param value The value.
+ * @return The value in decimal.
+ */
+std::string formatValue(uint64_t value) {
+    return std::to_string(value);
+}
+
+/**
+ * @brief Formats a gauge value without losing precision.
+ *
+ * Whole numbers (byte counts, offsets, queue depths) are printed as integers;
+ * anything else with enough digits to round-trip. The stream default of six
+ * significant digits would turn a 1234567890 byte offset into 1.23457e+09.
+ *
+ * @param value The value.
+ * @return The value as the exposition format expects it, including `NaN` and `+Inf`/`-Inf`.
+ */
+std::string formatValue(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::nearbyint(value) == value && std::fabs(value) < EXACT_INTEGER_LIMIT) {
+        return std::to_string(static_cast<int64_t>(value));
+    }
+    std::ostringstream out;
+    out << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+    return out.str();
+}
+
+/**
+ * @brief Renders counters or gauges, each family under a single `# TYPE` line.
+ *
+ * The maps are ordered by rendered name, in which a family can be split by
+ * another name that extends it (`x`, `x_y`, `x{a="1"}` sort in that order),
+ * so entries are grouped by the name before the labels first.
+ *
+ * @param out The stream to render to.
+ * @param metrics The metrics by rendered name.
+ * @param type The Prometheus metric type.
+ */
+template <typename Metric>
+void renderFamilies(std::ostringstream& out, const std::map<std::string, std::unique_ptr<Metric>>& metrics, const char* type) {
+    std::map<std::string, std::vector<const std::pair<const std::string, std::unique_ptr<Metric>>*>> families;
+    for (const auto& entry : metrics) {
+        families[entry.first.substr(0, entry.first.find('{'))].push_back(&entry);
+    }
+    for (const auto& family : families) {
+        out << "# TYPE " << family.first << " " << type << "\n";
+        for (const auto* entry : family.second) {
+            out << entry->first << " " << formatValue(entry->second->get()) << "\n";
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Retrieves the process-wide metrics registry.
+ *
+ * @return The registry, created on first use.
+ */
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+/**
+ * @brief Retrieves the calling thread's counter shard.
+ *
+ * @return A shard index, fixed for the lifetime of the thread.
+ */
+size_t Metrics::Counter::shardIndex() {
+    static std::atomic<size_t> nextShard(0);
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return shard;
+}
+
+/**
+ * @brief Builds the rendered name of a metric, e.g. `name{labels}`.
+ *
+ * @param name The metric name.
+ * @param labels The label set without braces.
+ * @return The name alone if there are no labels, otherwise the name followed by the braced labels.
+ */
+std::string Metrics::key(const std::string& name, const std::string& labels) {
+    return labels.empty() ? name : name + "{" + labels + "}";
+}
+
+/**
+ * @brief Builds a single `name="value"` label.
+ *
+ * Backslashes, double quotes and newlines in the value are escaped.
+ *
+ * @param name The label name.
+ * @param value The label value.
+ * @return The label.
+ */
+std::string Metrics::label(const std::string& name, const std::string& value) {
+    std::string rendered = name + "=\"";
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            rendered += '\\';
+            rendered += c;
+        } else if (c == '\n') {
+            rendered += "\\n";
+        } else {
+            rendered += c;
+        }
+    }
+    return rendered + "\"";
+}
+
+/**
+ * @brief Finds or creates a counter.
+ *
+ * @param name The metric name.
+ * @param labels The label set without braces; empty for none.
+ * @return The counter. The reference stays valid for the lifetime of the process.
+ */
+Metrics::Counter& Metrics::counter(const std::string& name, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<Counter>& slot = counters[key(name, labels)];
+    if (!slot) {
+        slot.reset(new Counter());
+    }
+    return *slot;
+}
+
+/**
+ * @brief Finds or creates a gauge.
+ *
+ * @param name The metric name.
+ * @param labels The label set without braces; empty for none.
+ * @return The gauge. The reference stays valid for the lifetime of the process.
+ */
+Metrics::Gauge& Metrics::gauge(const std::string& name, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<Gauge>& slot = gauges[key(name, labels)];
+    if (!slot) {
+        slot.reset(new Gauge());
+    }
+    return *slot;
+}
+
+/**
+ * @brief Finds or creates a histogram.
+ *
+ * @param name The metric name.
+ * @param labels The label set without braces; empty for none.
+ * @return The histogram. The reference stays valid for the lifetime of the process.
+ */
+LatencyHistogram& Metrics::histogram(const std::string& name, const std::string& labels) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<LatencyHistogram>& slot = histograms[std::make_pair(name, labels)];
+    if (!slot) {
+        slot.reset(new LatencyHistogram());
+    }
+    return *slot;
+}
+
+/**
+ * @brief Sums a counter over all of its label sets.
+ *
+ * @param name The metric name.
+ * @return The sum; 0 if no counter has that name.
+ */
+uint64_t Metrics::total(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t sum = 0;
+    for (auto it = counters.lower_bound(name); it != counters.end() && it->first.compare(0, name.size(), name) == 0; ++it) {
+        if (it->first.size() == name.size() || it->first[name.size()] == '{') {
+            sum += it->second->get();
+        }
+    }
+    return sum;
+}
+
+/**
+ * @brief Renders all metrics in the Prometheus text exposition format.
+ *
+ * Each metric family is preceded by a single `# TYPE` line, and its lines
+ * follow it together. Gauges keep full precision. Histograms are
+ * rendered as summaries: one line per quantile plus `_sum` and `_count`.
+ *
+ * @return The rendered metrics, counters first, one metric per line.
+ */
+std::string Metrics::render() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    renderFamilies(out, counters, "counter");
+    renderFamilies(out, gauges, "gauge");
+    std::string family;
+    for (const auto& entry : histograms) {
+        const std::string& name = entry.first.first;
+        const std::string& labels = entry.first.second;
+        if (name != family) {
+            out << "# TYPE " << name << " summary\n";
+            family = name;
+        }
+        LatencyHistogram::Snapshot snapshot = entry.second->snapshot();
+        std::string prefix = labels.empty() ? "" : labels + ",";
+        for (const auto& quantile : QUANTILES) {
+            out << name << "{" << prefix << "quantile=\"" << quantile.first << "\"} " << snapshot.percentile(quantile.second) << "\n";
+        }
+        out << key(name + "_sum", labels) << " " << snapshot.sum << "\n";
+        out << key(name + "_count", labels) << " " << snapshot.count << "\n";
+    }
+    return out.str();
+}
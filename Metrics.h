@@ -0,0 +1,152 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include "LatencyHistogram.h"
+
+
+/**
+ * @class Metrics
+ * @brief Process-wide registry of named counters, gauges and histograms.
+ *
+ * Metrics are identified by a Prometheus-style name and an optional label set
+ * (e.g. `codec="lz4"`). Looking a metric up takes a lock, so callers on hot
+ * paths should look their metrics up once and keep the returned reference,
+ * which stays valid for the lifetime of the process.
+ */
+class Metrics {
+public:
+    /**
+     * @class Counter
+     * @brief A monotonically increasing count, sharded per thread.
+     *
+     * Each thread adds to its own cache-line-sized shard, so threads updating
+     * the same counter never contend; get() sums the shards when scraped.
+     * Threads are assigned shards round robin, so with more than SHARD_COUNT
+     * threads some share a shard.
+     */
+    class Counter {
+    public:
+        /// Number of shards.
+        static const size_t SHARD_COUNT = 16;
+
+        /**
+         * @brief Adds to the calling thread's shard of the counter.
+         * @param amount The amount to add.
+         */
+        void add(uint64_t amount = 1) { shards[shardIndex()].value.fetch_add(amount, std::memory_order_relaxed); }
+
+        /**
+         * @brief Reads the counter.
+         * @return The current count, summed over all shards.
+         */
+        uint64_t get() const {
+            uint64_t total = 0;
+            for (const Shard& shard : shards) {
+                total += shard.value.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> value{0}; ///< This shard's share of the count.
+        };
+
+        static size_t shardIndex();
+
+        Shard shards[SHARD_COUNT]; ///< Per-thread shards.
+    };
+
+    /**
+     * @class Gauge
+     * @brief A value that can go up and down.
+     */
+    class Gauge {
+    public:
+        /**
+         * @brief Sets the gauge.
+         * @param v The new value.
+         */
+        void set(double v) { value.store(v, std::memory_order_relaxed); }
+
+        /**
+         * @brief Reads the gauge.
+         * @return The current value.
+         */
+        double get() const { return value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<double> value{0.0}; ///< The current value.
+    };
+
+    /**
+     * @brief Retrieves the process-wide registry.
+     * @return The registry.
+     */
+    static Metrics& instance();
+
+    /**
+     * @brief Finds or creates a counter.
+     * @param name The metric name.
+     * @param labels The label set without braces, e.g. `file="/var/log/auth.log"`; empty for none.
+     * @return The counter, valid for the lifetime of the process.
+     */
+    Counter& counter(const std::string& name, const std::string& labels = "");
+
+    /**
+     * @brief Finds or creates a gauge.
+     * @param name The metric name.
+     * @param labels The label set without braces; empty for none.
+     * @return The gauge, valid for the lifetime of the process.
+     */
+    Gauge& gauge(const std::string& name, const std::string& labels = "");
+
+    /**
+     * @brief Finds or creates a histogram, rendered as a summary with 0.5, 0.99 and 0.999 quantiles.
+     * @param name The metric name.
+     * @param labels The label set without braces; empty for none.
+     * @return The histogram, valid for the lifetime of the process.
+     */
+    LatencyHistogram& histogram(const std::string& name, const std::string& labels = "");
+
+    /**
+     * @brief Sums a counter over all of its label sets.
+     * @param name The metric name.
+     * @return The sum of every counter with that name; 0 if there is none.
+     */
+    uint64_t total(const std::string& name) const;
+
+    /**
+     * @brief Renders every metric in the Prometheus text exposition format.
+     * @return One `name{labels} value` line per metric, grouped by family and sorted by name.
+     */
+    std::string render() const;
+
+    /**
+     * @brief Builds a single label, escaping the value as the exposition format requires.
+     * @param name The label name.
+     * @param value The label value.
+     * @return The label, e.g. `file="/var/log/auth.log"`.
+     */
+    static std::string label(const std::string& name, const std::string& value);
+
+private:
+    Metrics() = default;
+
+    static std::string key(const std::string& name, const std::string& labels);
+
+    mutable std::mutex mutex; ///< Protects the metric maps (not the metric values).
+    std::map<std::string, std::unique_ptr<Counter>> counters; ///< Counters by rendered name.
+    std::map<std::string, std::unique_ptr<Gauge>> gauges; ///< Gauges by rendered name.
+    std::map<std::pair<std::string, std::string>, std::unique_ptr<LatencyHistogram>> histograms; ///< Histograms by name and labels.
+};
+
+#endif
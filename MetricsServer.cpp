@@ -0,0 +1,198 @@
+#include "MetricsServer.h"
+#include "Metrics.h"
+#include <sys/socket.h>            // Used for socket(), bind(), listen() and accept()
+#include <sys/un.h>                // Used for sockaddr_un
+#include <netinet/in.h>            // Used for sockaddr_in
+#include <arpa/inet.h>             // Used for inet_pton()
+#include <unistd.h>                // Used for close() and unlink()
+#include <poll.h>                  // Used for poll()
+#include <stdexcept>               // Used for std::runtime_error
+#include <cstring>                 // Used for strerror() and memset()
+#include <iostream>                // Used for std::cerr
+#include <cstdlib>                 // Used for std::atoi
+#include <errno.h>                 // Used for errno
+
+namespace {
+
+/// Prefix selecting a Unix domain socket address.
+const std::string UNIX_PREFIX = "unix:";
+
+/**
+ * @brief Writes a whole buffer to a socket.
+ *
+ * @param fd The socket.
+ * @param data The data.
+ * @return False if the peer went away.
+ */
+bool writeAll(int fd, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * @brief Binds the listening socket and starts the server thread.
+ *
+ * @param address `host:port`, `:port` or `unix:/path`.
+ *
+ * @throws std::runtime_error If the address cannot be parsed or bound.
+ */
+MetricsServer::MetricsServer(const std::string& address)
+    : listenFd(-1), running(true) {
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        listenUnix(address.substr(UNIX_PREFIX.size()));
+    } else {
+        listenTcp(address);
+    }
+    server = std::thread(&MetricsServer::serve, this);
+}
+
+/**
+ * @brief Stops the server thread and closes the listening socket.
+ */
+MetricsServer::~MetricsServer() {
+    running.store(false);
+    server.join();
+    close(listenFd);
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+}
+
+/**
+ * @brief Listens on a TCP address.
+ *
+ * @param address `host:port`; an empty host means all interfaces.
+ *
+ * @throws std::runtime_error If the address is invalid or cannot be bound.
+ */
+void MetricsServer::listenTcp(const std::string& address) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        throw std::runtime_error("Invalid metrics address: " + address);
+    }
+    std::string host = address.substr(0, colon);
+    int port = std::atoi(address.c_str() + colon + 1);
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (port <= 0 || port > 65535 || (!host.empty() && inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1)) {
+        throw std::runtime_error("Invalid metrics address: " + address);
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error("Failed to create metrics socket: " + std::string(strerror(errno)));
+    }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+        std::string error = strerror(errno);
+        close(listenFd);
+        throw std::runtime_error("Failed to listen on " + address + ": " + error);
+    }
+}
+
+/**
+ * @brief Listens on a Unix domain socket, replacing a stale socket file.
+ *
+ * @param path The socket path.
+ *
+ * @throws std::runtime_error If the path is too long or cannot be bound.
+ */
+void MetricsServer::listenUnix(const std::string& path) {
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("Invalid metrics socket path: " + path);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw std::runtime_error("Failed to create metrics socket: " + std::string(strerror(errno)));
+    }
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+        std::string error = strerror(errno);
+        close(listenFd);
+        throw std::runtime_error("Failed to listen on " + path + ": " + error);
+    }
+    socketPath = path;
+}
+
+/**
+ * @brief Server loop: accepts connections until the server is destroyed.
+ */
+void MetricsServer::serve() {
+    while (running.load()) {
+        struct pollfd pfd = {listenFd, POLLIN, 0};
+        int ready = poll(&pfd, 1, POLL_INTERVAL_MS);
+        if (ready <= 0) {
+            if (ready < 0 && errno != EINTR) {
+                std::cerr << "Error polling metrics socket: " << strerror(errno) << std::endl;
+            }
+            continue;
+        }
+        int clientFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (clientFd < 0) {
+            continue;
+        }
+        handle(clientFd);
+        close(clientFd);
+    }
+}
+
+/**
+ * @brief Answers one HTTP request.
+ *
+ * Only the request line is looked at: `GET /metrics` (or `/`) gets the
+ * rendered metrics, anything else a 404. The connection is closed after the
+ * response, so no keep-alive handling is needed.
+ *
+ * @param clientFd The connected client socket.
+ */
+void MetricsServer::handle(int clientFd) {
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        struct pollfd pfd = {clientFd, POLLIN, 0};
+        if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        ssize_t n = recv(clientFd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    std::string requestLine = request.substr(0, request.find("\r\n"));
+    std::string status = "200 OK";
+    std::string body;
+    if (requestLine.compare(0, 13, "GET /metrics ") == 0 || requestLine.compare(0, 6, "GET / ") == 0) {
+        body = Metrics::instance().render();
+    } else {
+        status = "404 Not Found";
+        body = "Not found\n";
+    }
+    writeAll(clientFd, "HTTP/1.1 " + status + "\r\n"
+                       "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "Connection: close\r\n\r\n" + body);
+}
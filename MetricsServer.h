@@ -0,0 +1,54 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+
+
+/**
+ * @class MetricsServer
+ * @brief Minimal HTTP server exposing the Metrics registry for Prometheus scrapes.
+ *
+ * The server listens on a TCP address or a Unix domain socket and answers
+ * `GET /metrics` with Metrics::render(). It serves one connection at a time on
+ * its own thread, so a scrape never runs on, or blocks, the forwarding path;
+ * the counters are summed from their per-thread shards while rendering.
+ */
+class MetricsServer {
+public:
+    /**
+     * @brief Starts serving metrics.
+     * @param address `host:port` (e.g. "127.0.0.1:9464", or ":9464" for all
+     *        interfaces) or `unix:/path/to/socket`.
+     * @throws std::runtime_error If the address is invalid or cannot be bound.
+     */
+    explicit MetricsServer(const std::string& address);
+
+    /**
+     * @brief Stops the server and removes its Unix socket, if any.
+     */
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+private:
+    /// How often the server checks for a stop request while idle, in milliseconds.
+    static const int POLL_INTERVAL_MS = 200;
+
+    /// How long a client may take to send its request, in milliseconds.
+    static const int REQUEST_TIMEOUT_MS = 1000;
+
+    void listenTcp(const std::string& address);
+    void listenUnix(const std::string& path);
+    void serve();
+    void handle(int clientFd);
+
+    std::string socketPath; ///< Path of the Unix socket; empty for TCP.
+    int listenFd; ///< The listening socket.
+    std::atomic<bool> running; ///< Cleared to stop the server.
+    std::thread server; ///< Accepts and answers scrapes.
+};
+
+#endif
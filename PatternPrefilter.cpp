@@ -0,0 +1,390 @@
+#include "PatternPrefilter.h"
+#include <stdexcept>               // Used for std::runtime_error
+#include <algorithm>               // Used for std::fill
+#include <cstring>                 // Used for memset()
+#include <deque>                   // Used for the breadth-first construction queue
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>             // Used for the SSSE3 first-byte scan
+#define SPARKY_PREFILTER_SIMD 1
+#endif
+
+namespace {
+
+/// Shortest atom RE2 may require of a pattern; shorter literals would make poor filters.
+const int MIN_ATOM_LENGTH = 3;
+
+/// Most distinct first bytes for which the SIMD scan pays off; denser sets hit nearly every block.
+const int MAX_SIMD_FIRST_BYTES = 48;
+
+/**
+ * @brief Lowercases an ASCII letter.
+ *
+ * @param c The byte.
+ * @return The lowercase letter, or the byte unchanged.
+ */
+inline unsigned char lower(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+/**
+ * @brief Uppercases an ASCII letter.
+ *
+ * @param c The byte.
+ * @return The uppercase letter, or the byte unchanged.
+ */
+inline unsigned char upper(unsigned char c) {
+    return c >= 'a' && c <= 'z' ? static_cast<unsigned char>(c - ('a' - 'A')) : c;
+}
+
+} // namespace
+
+/**
+ * @brief Builds the byte classes, the trie, its failure links and the start-state skip tables.
+ *
+ * The trie is completed into a DFA breadth first: a missing transition takes
+ * the transition of the failure state, which is already complete because it
+ * is shallower.
+ *
+ * @param literals The literals; matched ignoring ASCII case.
+ */
+AhoCorasick::AhoCorasick(const std::vector<std::string>& literals)
+    : classes(1), pairs(65536 / 64, 0), simd(false) {
+    std::memset(byteClass, 0, sizeof(byteClass));
+    std::memset(firstByte, 0, sizeof(firstByte));
+    std::memset(singleByte, 0, sizeof(singleByte));
+    std::memset(lowNibbles, 0, sizeof(lowNibbles));
+    std::memset(highNibbles, 0, sizeof(highNibbles));
+    for (const std::string& literal : literals) {
+        for (char c : literal) {
+            unsigned char folded = lower(static_cast<unsigned char>(c));
+            if (byteClass[folded] == 0) {
+                byteClass[folded] = static_cast<uint8_t>(classes);
+                byteClass[upper(folded)] = static_cast<uint8_t>(classes);
+                classes++;
+            }
+        }
+    }
+
+    transitions.assign(classes, -1);
+    outputs.push_back(-1);
+    for (size_t i = 0; i < literals.size(); ++i) {
+        const std::string& literal = literals[i];
+        if (literal.empty()) {
+            continue;
+        }
+        int32_t state = 0;
+        for (char c : literal) {
+            size_t next = static_cast<size_t>(state) * classes + byteClass[static_cast<unsigned char>(c)];
+            if (transitions[next] < 0) {
+                transitions[next] = static_cast<int32_t>(outputs.size());
+                transitions.resize(transitions.size() + classes, -1);
+                outputs.push_back(-1);
+            }
+            state = transitions[next];
+        }
+        if (outputs[state] < 0) {
+            outputs[state] = static_cast<int32_t>(i);
+        }
+
+        unsigned char first = lower(static_cast<unsigned char>(literal[0]));
+        firstByte[first] = firstByte[upper(first)] = true;
+        if (literal.size() == 1) {
+            singleByte[first] = singleByte[upper(first)] = true;
+        } else {
+            size_t pair = static_cast<size_t>(first) << 8 | lower(static_cast<unsigned char>(literal[1]));
+            pairs[pair / 64] |= 1ULL << (pair % 64);
+        }
+    }
+
+    std::vector<int32_t> failure(outputs.size(), 0);
+    dictionaryLinks.assign(outputs.size(), -1);
+    std::deque<int32_t> queue;
+    for (size_t c = 0; c < classes; ++c) {
+        if (transitions[c] < 0) {
+            transitions[c] = 0;
+        } else {
+            queue.push_back(transitions[c]);
+        }
+    }
+    while (!queue.empty()) {
+        int32_t state = queue.front();
+        queue.pop_front();
+        size_t row = static_cast<size_t>(state) * classes;
+        size_t failureRow = static_cast<size_t>(failure[state]) * classes;
+        for (size_t c = 0; c < classes; ++c) {
+            int32_t child = transitions[row + c];
+            if (child < 0) {
+                transitions[row + c] = transitions[failureRow + c];
+                continue;
+            }
+            int32_t link = transitions[failureRow + c];
+            failure[child] = link;
+            dictionaryLinks[child] = outputs[link] >= 0 ? link : dictionaryLinks[link];
+            queue.push_back(child);
+        }
+    }
+
+#ifdef SPARKY_PREFILTER_SIMD
+    // Shufti: each high nibble gets a bucket bit, shared by high nibbles
+    // with the same set of low nibbles; past 8 sets the rest share the last
+    // bucket, which only lets a few more bytes through to the scalar check.
+    uint16_t lowSets[16] = {0};
+    int firstBytes = 0;
+    for (int b = 0; b < 256; ++b) {
+        if (firstByte[b]) {
+            lowSets[b >> 4] |= static_cast<uint16_t>(1 << (b & 0x0f));
+            firstBytes++;
+        }
+    }
+    std::vector<uint16_t> buckets;
+    for (int high = 0; high < 16; ++high) {
+        if (lowSets[high] == 0) {
+            continue;
+        }
+        size_t bucket = std::find(buckets.begin(), buckets.end(), lowSets[high]) - buckets.begin();
+        if (bucket == buckets.size()) {
+            if (buckets.size() < 8) {
+                buckets.push_back(lowSets[high]);
+            } else {
+                bucket = 7;
+                buckets[7] |= lowSets[high];
+            }
+        }
+        highNibbles[high] = static_cast<uint8_t>(1 << bucket);
+    }
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        for (int low = 0; low < 16; ++low) {
+            if (buckets[bucket] & (1 << low)) {
+                lowNibbles[low] |= static_cast<uint8_t>(1 << bucket);
+            }
+        }
+    }
+    simd = firstBytes > 0 && firstBytes <= MAX_SIMD_FIRST_BYTES && __builtin_cpu_supports("ssse3");
+#endif
+}
+
+/**
+ * @brief Advances from the start state to the next position where a literal may begin.
+ *
+ * @param text The text.
+ * @param position Where to start looking.
+ * @param length Length of the text.
+ * @return The position, or length if no literal can begin in the rest of the text.
+ */
+size_t AhoCorasick::skip(const unsigned char* text, size_t position, size_t length) const {
+    while (position < length) {
+        if (simd) {
+            position = skipSimd(text, position, length);
+            if (position >= length) {
+                break;
+            }
+        }
+        if (startsLiteral(text, position, length)) {
+            return position;
+        }
+        position++;
+    }
+    return length;
+}
+
+/**
+ * @brief Checks whether the bytes at a position match the start of some literal.
+ *
+ * @param text The text.
+ * @param position The position.
+ * @param length Length of the text.
+ * @return False if no literal can begin at the position.
+ */
+bool AhoCorasick::startsLiteral(const unsigned char* text, size_t position, size_t length) const {
+    unsigned char first = text[position];
+    if (!firstByte[first]) {
+        return false;
+    }
+    if (singleByte[first]) {
+        return true;
+    }
+    if (position + 1 >= length) {
+        return false;
+    }
+    size_t pair = static_cast<size_t>(lower(first)) << 8 | lower(text[position + 1]);
+    return (pairs[pair / 64] >> (pair % 64)) & 1;
+}
+
+#ifdef SPARKY_PREFILTER_SIMD
+/**
+ * @brief Skips 16-byte blocks containing no byte that can begin a literal.
+ *
+ * Each byte's low and high nibbles look up bucket bits in the shufti tables;
+ * a byte is a possible first byte if the two share a bit.
+ *
+ * @param text The text.
+ * @param position Where to start looking.
+ * @param length Length of the text.
+ * @return The first possible first byte, or the start of the last partial block.
+ */
+__attribute__((target("ssse3")))
+size_t AhoCorasick::skipSimd(const unsigned char* text, size_t position, size_t length) const {
+    const __m128i lowTable = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowNibbles));
+    const __m128i highTable = _mm_loadu_si128(reinterpret_cast<const __m128i*>(highNibbles));
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    while (position + 16 <= length) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + position));
+        __m128i low = _mm_and_si128(block, nibble);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(block, 4), nibble);
+        __m128i hits = _mm_and_si128(_mm_shuffle_epi8(lowTable, low), _mm_shuffle_epi8(highTable, high));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(hits, zero))) & 0xffff;
+        if (mask != 0) {
+            return position + static_cast<size_t>(__builtin_ctz(mask));
+        }
+        position += 16;
+    }
+    return position;
+}
+#else
+/**
+ * @brief Without SIMD support, leaves every position to the scalar check.
+ *
+ * @param position Where to start looking.
+ * @return The position, unchanged.
+ */
+size_t AhoCorasick::skipSimd(const unsigned char*, size_t position, size_t) const {
+    return position;
+}
+#endif
+
+PatternPrefilter::PatternPrefilter() : filter(MIN_ATOM_LENGTH) {
+}
+
+PatternPrefilter::~PatternPrefilter() = default;
+
+/**
+ * @brief Compiles a pattern and adds it to the filter.
+ *
+ * @param pattern RE2 pattern.
+ * @return The pattern's ID.
+ *
+ * @throws std::runtime_error If the pattern does not compile or the prefilter is already compiled.
+ */
+int PatternPrefilter::add(const std::string& pattern) {
+    if (compiled()) {
+        throw std::runtime_error("Cannot add a pattern to a compiled prefilter");
+    }
+    RE2::Options options;
+    options.set_log_errors(false);
+    int id = -1;
+    if (filter.Add(pattern, options, &id) != RE2::NoError) {
+        RE2 invalid(pattern, options);
+        throw std::runtime_error("Invalid pattern " + pattern + ": " + invalid.error());
+    }
+    return id;
+}
+
+/**
+ * @brief Has RE2 extract each pattern's atoms and builds the automaton over the ASCII ones.
+ *
+ * Atoms containing a non-ASCII byte are left out of the automaton (as empty
+ * literals, so the indices still line up) and recorded in assumedAtoms.
+ */
+void PatternPrefilter::compile() {
+    if (compiled()) {
+        return;
+    }
+    if (size() > 0) {
+        filter.Compile(&atoms);
+    }
+    std::vector<std::string> literals(atoms);
+    for (size_t i = 0; i < literals.size(); ++i) {
+        for (char c : literals[i]) {
+            if (static_cast<unsigned char>(c) >= 0x80) {
+                assumedAtoms.push_back(static_cast<int>(i));
+                literals[i].clear();
+                break;
+            }
+        }
+    }
+    automaton.reset(new AhoCorasick(literals));
+}
+
+/**
+ * @brief Collects the distinct atoms occurring in a line into the scratch.
+ *
+ * Atoms the automaton cannot fold are always included.
+ *
+ * Atoms are deduplicated with a per-line stamp rather than by clearing a
+ * table, so the cost is proportional to the atoms found.
+ *
+ * @param line The line.
+ * @param scratch Working memory.
+ */
+void PatternPrefilter::findAtoms(std::string_view line, Scratch& scratch) const {
+    if (scratch.seen.size() != atoms.size()) {
+        scratch.seen.assign(atoms.size(), 0);
+        scratch.stamp = 0;
+    }
+    if (++scratch.stamp == 0) {
+        std::fill(scratch.seen.begin(), scratch.seen.end(), 0);
+        scratch.stamp = 1;
+    }
+    scratch.atoms.clear();
+    for (int atom : assumedAtoms) {
+        scratch.seen[atom] = scratch.stamp;
+        scratch.atoms.push_back(atom);
+    }
+    automaton->scan(line, [&scratch](int atom) {
+        if (scratch.seen[atom] != scratch.stamp) {
+            scratch.seen[atom] = scratch.stamp;
+            scratch.atoms.push_back(atom);
+        }
+    });
+}
+
+/**
+ * @brief Finds the patterns whose required atoms occur in a line.
+ *
+ * Before compile() every pattern is a candidate.
+ *
+ * @param line The line.
+ * @param scratch Working memory of the calling thread.
+ * @param candidates Receives the candidate IDs.
+ */
+void PatternPrefilter::candidates(std::string_view line, Scratch& scratch, std::vector<int>& candidates) const {
+    candidates.clear();
+    if (!compiled()) {
+        for (size_t id = 0; id < size(); ++id) {
+            candidates.push_back(static_cast<int>(id));
+        }
+        return;
+    }
+    if (size() == 0) {
+        return;
+    }
+    findAtoms(line, scratch);
+    filter.AllPotentials(scratch.atoms, &candidates);
+}
+
+/**
+ * @brief Finds the patterns that match a line.
+ *
+ * @param line The line.
+ * @param scratch Working memory of the calling thread.
+ * @param matches Receives the matching IDs.
+ */
+void PatternPrefilter::matches(std::string_view line, Scratch& scratch, std::vector<int>& matches) const {
+    matches.clear();
+    if (size() == 0) {
+        return;
+    }
+    re2::StringPiece text(line.data(), line.size());
+    if (!compiled()) {
+        for (size_t id = 0; id < size(); ++id) {
+            if (RE2::PartialMatch(text, pattern(static_cast<int>(id)))) {
+                matches.push_back(static_cast<int>(id));
+            }
+        }
+        return;
+    }
+    findAtoms(line, scratch);
+    filter.AllMatches(text, scratch.atoms, &matches);
+}
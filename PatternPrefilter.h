@@ -0,0 +1,196 @@
+#ifndef PATTERNPREFILTER_H
+#define PATTERNPREFILTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <re2/re2.h>
+#include <re2/filtered_re2.h>
+
+
+/**
+ * @class AhoCorasick
+ * @brief Finds every occurrence of a set of literals in one pass, ignoring ASCII case.
+ *
+ * The automaton is a dense DFA over byte classes: bytes that occur in no
+ * literal share one class, and upper- and lowercase letters share theirs, so
+ * the table stays small for thousands of literals.
+ *
+ * Most of a line is usually spent in the start state, waiting for a byte that
+ * can begin a literal. There the scan skips ahead: 16 bytes at a time with an
+ * SSSE3 nibble lookup ("shufti") of the first bytes when the CPU has it, then
+ * a check of the first two bytes against a table of literal prefixes, before
+ * the automaton is entered.
+ */
+class AhoCorasick {
+public:
+    /**
+     * @brief Builds the automaton.
+     * @param literals The literals; empty ones are ignored.
+     */
+    explicit AhoCorasick(const std::vector<std::string>& literals);
+
+    /**
+     * @brief Scans a text for the literals.
+     * @param text The text.
+     * @param found Called with the index of each literal found, once per occurrence.
+     */
+    template <typename Callback>
+    void scan(std::string_view text, Callback&& found) const;
+
+    /**
+     * @brief Retrieves the number of automaton states.
+     * @return The count.
+     */
+    size_t states() const { return outputs.size(); }
+
+private:
+    size_t skip(const unsigned char* text, size_t position, size_t length) const;
+    size_t skipSimd(const unsigned char* text, size_t position, size_t length) const;
+    bool startsLiteral(const unsigned char* text, size_t position, size_t length) const;
+
+    uint8_t byteClass[256]; ///< Class of each byte; 0 for bytes in no literal.
+    size_t classes; ///< Number of byte classes.
+    std::vector<int32_t> transitions; ///< Next state by state * classes + class.
+    std::vector<int32_t> outputs; ///< Literal ending at each state, or -1.
+    std::vector<int32_t> dictionaryLinks; ///< Nearest state on the failure chain with an output, or -1.
+    std::vector<uint64_t> pairs; ///< Bitmap of the (lowercased) first two bytes of the literals.
+    bool firstByte[256]; ///< Bytes that can begin a literal, in either case.
+    bool singleByte[256]; ///< Bytes that are a whole literal, in either case.
+    bool simd; ///< Whether the SSSE3 scan is used.
+    uint8_t lowNibbles[16]; ///< Shufti table: bucket bits by low nibble.
+    uint8_t highNibbles[16]; ///< Shufti table: bucket bits by high nibble.
+};
+
+/**
+ * @class PatternPrefilter
+ * @brief Picks the patterns that can match a line from the literals they require.
+ *
+ * RE2 works out, for each pattern, the literals ("atoms") any match must
+ * contain. All atoms of all patterns go into one Aho-Corasick automaton, so
+ * a line is scanned once however many patterns there are, and only patterns
+ * whose required atoms occur are candidates for a full match. A pattern with
+ * no usable atom (e.g. `\d+`) is always a candidate.
+ *
+ * RE2 lowercases atoms with Unicode case folding, but the automaton only
+ * folds ASCII, so an atom with a non-ASCII byte could miss a line that does
+ * match (`ОШИБКА` against the atom `ошибка`). Such atoms are not scanned for
+ * and count as present in every line, which leaves the decision to RE2.
+ *
+ * Add every pattern, then compile(); the prefilter may then be shared by
+ * any number of threads, each with its own Scratch.
+ */
+class PatternPrefilter {
+public:
+    /**
+     * @brief Per-thread working memory for candidates().
+     */
+    class Scratch {
+    public:
+        Scratch() : stamp(0) {}
+
+    private:
+        friend class PatternPrefilter;
+        std::vector<int> atoms; ///< Atoms found in the line, each once.
+        std::vector<uint32_t> seen; ///< Stamp of the line each atom was last found in.
+        uint32_t stamp; ///< Stamp of the current line.
+    };
+
+    PatternPrefilter();
+    ~PatternPrefilter();
+
+    PatternPrefilter(const PatternPrefilter&) = delete;
+    PatternPrefilter& operator=(const PatternPrefilter&) = delete;
+
+    /**
+     * @brief Adds a pattern.
+     * @param pattern RE2 pattern.
+     * @return The pattern's ID, counting from 0 in the order added.
+     * @throws std::runtime_error If the pattern does not compile or compile() was already called.
+     */
+    int add(const std::string& pattern);
+
+    /**
+     * @brief Extracts the atoms and builds the automaton. Call once, after the last add().
+     */
+    void compile();
+
+    /**
+     * @brief Finds the patterns that may match a line.
+     * @param line The line.
+     * @param scratch Working memory of the calling thread.
+     * @param candidates Receives the IDs of the candidate patterns, ascending.
+     */
+    void candidates(std::string_view line, Scratch& scratch, std::vector<int>& candidates) const;
+
+    /**
+     * @brief Finds the patterns that match a line, running only the candidates.
+     * @param line The line.
+     * @param scratch Working memory of the calling thread.
+     * @param matches Receives the IDs of the matching patterns, ascending.
+     */
+    void matches(std::string_view line, Scratch& scratch, std::vector<int>& matches) const;
+
+    /**
+     * @brief Retrieves a compiled pattern.
+     * @param id The pattern's ID.
+     * @return The pattern.
+     */
+    const RE2& pattern(int id) const { return filter.GetRE2(id); }
+
+    /**
+     * @brief Retrieves the number of patterns added.
+     * @return The count.
+     */
+    size_t size() const { return static_cast<size_t>(filter.NumRegexps()); }
+
+    /**
+     * @brief Retrieves the number of distinct atoms in the automaton.
+     * @return The count; 0 before compile().
+     */
+    size_t atomCount() const { return atoms.size(); }
+
+    /**
+     * @brief Tells whether compile() was called.
+     * @return True once the prefilter is usable.
+     */
+    bool compiled() const { return automaton != nullptr; }
+
+private:
+    void findAtoms(std::string_view line, Scratch& scratch) const;
+
+    re2::FilteredRE2 filter; ///< The patterns and the tree of atoms each requires.
+    std::vector<std::string> atoms; ///< Distinct lowercase atoms of all patterns.
+    std::vector<int> assumedAtoms; ///< Atoms with non-ASCII bytes, taken to occur in every line.
+    std::unique_ptr<AhoCorasick> automaton; ///< Automaton over the atoms; null before compile().
+};
+
+/**
+ * @brief Scans a text, staying in the start state's skip loop whenever the automaton is there.
+ *
+ * @param text The text.
+ * @param found Called with the index of each literal found.
+ */
+template <typename Callback>
+void AhoCorasick::scan(std::string_view text, Callback&& found) const {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t length = text.size();
+    int32_t state = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (state == 0) {
+            i = skip(bytes, i, length);
+            if (i >= length) {
+                break;
+            }
+        }
+        state = transitions[static_cast<size_t>(state) * classes + byteClass[bytes[i]]];
+        for (int32_t output = outputs[state] >= 0 ? state : dictionaryLinks[state]; output > 0; output = dictionaryLinks[output]) {
+            found(outputs[output]);
+        }
+    }
+}
+
+#endif
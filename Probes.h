@@ -0,0 +1,46 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/**
+ * @file Probes.h
+ * @brief USDT probe points on the event pipeline, for bpftrace and perf.
+ *
+ * Probes use the `sparky` provider. They compile to a single nop, and the
+ * arguments are only read when a tracer attaches, so every argument passed
+ * here must be a value the code has at hand anyway. Without `sys/sdt.h`
+ * (systemtap-sdt-dev / systemtap-sdt-devel), or with `-DSPARKY_NO_PROBES`,
+ * the probes compile out entirely.
+ *
+ * | Probe      | Arguments                                                             |
+ * |------------|-----------------------------------------------------------------------|
+ * | file_read  | file path, chunk offset, chunk bytes                                  |
+ * | line_split | file path, complete lines in the chunk, bytes of partial line carried |
+ * | format     | file path, line bytes, message bytes, chunk read time                 |
+ * | produce    | topic, message bytes, librdkafka error code, formatted time           |
+ * | delivery   | topic, message bytes, librdkafka error code, write notification time  |
+ * | checkpoint | file path, committed offset, lines awaiting acknowledgement           |
+ *
+ * Times are CLOCK_MONOTONIC nanoseconds taken from the message's latency
+ * trace, the same clock as bpftrace's `nsecs`, so a script gets the latency
+ * up to the probe as `nsecs - argN` without the forwarder reading the clock
+ * again. They are 0 for messages without a trace (e.g. "INIT" events).
+ * List them on a built binary with `readelf -n SparkySIEM` or
+ * `bpftrace -l 'usdt:./SparkySIEM:*'`.
+ */
+
+#if !defined(SPARKY_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SPARKY_PROBES_ENABLED 1
+#endif
+#endif
+
+#ifdef SPARKY_PROBES_ENABLED
+#define SPARKY_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(sparky, name, a1, a2, a3)
+#define SPARKY_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(sparky, name, a1, a2, a3, a4)
+#else
+#define SPARKY_PROBE3(name, a1, a2, a3) ((void)0)
+#define SPARKY_PROBE4(name, a1, a2, a3, a4) ((void)0)
+#endif
+
+#endif
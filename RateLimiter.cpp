@@ -0,0 +1,158 @@
+#include "RateLimiter.h"
+#include <map>                     // Used for the pipeline registry
+#include <memory>                  // Used for std::unique_ptr
+#include <thread>                  // Used for std::this_thread::sleep_for
+#include <algorithm>               // Used for std::min
+
+/**
+ * @brief Constructs a TokenBucket that starts full.
+ *
+ * @param rate Tokens added per second; 0 means unlimited.
+ * @param burst Bucket capacity; 0 means one second's worth of tokens.
+ */
+TokenBucket::TokenBucket(double rate, double burst)
+    : tokensPerSecond(rate), capacity(burst > 0 ? burst : rate), tokens(capacity),
+      lastRefill(std::chrono::steady_clock::now()) {}
+
+/**
+ * @brief Changes the rate and capacity.
+ *
+ * Stored tokens are clamped to the new capacity; any outstanding debt is kept
+ * and will be repaid at the new rate.
+ *
+ * @param rate Tokens added per second; 0 means unlimited.
+ * @param burst Bucket capacity; 0 means one second's worth of tokens.
+ */
+void TokenBucket::setRate(double rate, double burst) {
+    std::lock_guard<std::mutex> lock(mutex);
+    tokensPerSecond = rate;
+    capacity = burst > 0 ? burst : rate;
+    tokens = std::min(tokens, capacity);
+    lastRefill = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Retrieves the current rate.
+ *
+ * @return Tokens added per second; 0 if unlimited.
+ */
+double TokenBucket::rate() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return tokensPerSecond;
+}
+
+/**
+ * @brief Takes tokens from the bucket, going into debt if necessary.
+ *
+ * @param count The number of tokens to take.
+ * @return How long the caller must wait for the bucket to be back at zero;
+ *         zero if the tokens were available or the bucket is unlimited.
+ */
+std::chrono::nanoseconds TokenBucket::reserve(double count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (tokensPerSecond <= 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    tokens = std::min(capacity, tokens + elapsed * tokensPerSecond);
+    lastRefill = now;
+
+    tokens -= count;
+    if (tokens >= 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::nanoseconds(static_cast<int64_t>(-tokens / tokensPerSecond * 1e9));
+}
+
+/**
+ * @brief Constructs an unlimited RateLimiter.
+ *
+ * @param name Name used to label this limiter's metrics.
+ * @param parent The next limiter up the hierarchy, or nullptr for the root.
+ */
+RateLimiter::RateLimiter(const std::string& name, RateLimiter* parent)
+    : name(name), parent(parent),
+      throttled(Metrics::instance().counter("sparky_throttled_microseconds_total", Metrics::label("limiter", name))) {}
+
+/**
+ * @brief Retrieves the process-wide root limiter.
+ *
+ * @return The global limiter, unlimited until configured.
+ */
+RateLimiter& RateLimiter::global() {
+    static RateLimiter limiter("global");
+    return limiter;
+}
+
+/**
+ * @brief Finds or creates a named pipeline limiter.
+ *
+ * @param name The pipeline name.
+ * @return The pipeline limiter, whose parent is the global limiter.
+ */
+RateLimiter& RateLimiter::pipeline(const std::string& name) {
+    static std::mutex registryMutex;
+    static std::map<std::string, std::unique_ptr<RateLimiter>> registry;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::unique_ptr<RateLimiter>& slot = registry[name];
+    if (!slot) {
+        slot.reset(new RateLimiter("pipeline:" + name, &global()));
+    }
+    return *slot;
+}
+
+/**
+ * @brief Changes the byte rate limit.
+ *
+ * @param bytesPerSecond Bytes per second; 0 means unlimited.
+ * @param burst Burst size in bytes; 0 means one second's worth.
+ */
+void RateLimiter::setByteRate(double bytesPerSecond, double burst) {
+    byteBucket.setRate(bytesPerSecond, burst);
+}
+
+/**
+ * @brief Changes the event rate limit.
+ *
+ * @param eventsPerSecond Events per second; 0 means unlimited.
+ * @param burst Burst size in events; 0 means one second's worth.
+ */
+void RateLimiter::setEventRate(double eventsPerSecond, double burst) {
+    eventBucket.setRate(eventsPerSecond, burst);
+}
+
+/**
+ * @brief Moves this limiter under another parent.
+ *
+ * @param newParent The new parent, or nullptr for none.
+ */
+void RateLimiter::setParent(RateLimiter* newParent) {
+    parent.store(newParent);
+}
+
+/**
+ * @brief Takes bytes and events from every level of the hierarchy and waits out the longest debt.
+ *
+ * The wait is charged to the throttling counter of the limiter that imposed
+ * it, so the metrics show which level is the bottleneck.
+ *
+ * @param bytes Number of bytes about to be sent.
+ * @param events Number of events about to be sent.
+ */
+void RateLimiter::acquire(size_t bytes, size_t events) {
+    std::chrono::nanoseconds longest(0);
+    RateLimiter* bottleneck = nullptr;
+    for (RateLimiter* level = this; level != nullptr; level = level->parent.load()) {
+        std::chrono::nanoseconds wait = std::max(level->byteBucket.reserve(static_cast<double>(bytes)),
+                                                 level->eventBucket.reserve(static_cast<double>(events)));
+        if (wait > longest) {
+            longest = wait;
+            bottleneck = level;
+        }
+    }
+    if (bottleneck != nullptr) {
+        std::this_thread::sleep_for(longest);
+        bottleneck->throttled.add(std::chrono::duration_cast<std::chrono::microseconds>(longest).count());
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include "Metrics.h"
+
+
+/**
+ * @class TokenBucket
+ * @brief A thread-safe token bucket that lets callers run into debt.
+ *
+ * reserve() always takes the requested tokens, even if that leaves the bucket
+ * negative, and returns how long the caller must wait for the debt to be
+ * repaid. This keeps the bucket lock-light and fair between callers and lets a
+ * single request larger than the burst size through at the configured rate.
+ */
+class TokenBucket {
+public:
+    /**
+     * @brief Constructs a TokenBucket.
+     * @param rate Tokens added per second; 0 means unlimited.
+     * @param burst Bucket capacity; 0 means one second's worth of tokens.
+     */
+    explicit TokenBucket(double rate = 0, double burst = 0);
+
+    /**
+     * @brief Changes the rate and capacity. Safe to call while other threads reserve.
+     * @param rate Tokens added per second; 0 means unlimited.
+     * @param burst Bucket capacity; 0 means one second's worth of tokens.
+     */
+    void setRate(double rate, double burst = 0);
+
+    /**
+     * @brief Retrieves the current rate.
+     * @return Tokens added per second; 0 if unlimited.
+     */
+    double rate() const;
+
+    /**
+     * @brief Takes tokens from the bucket.
+     * @param tokens The number of tokens to take.
+     * @return How long the caller must wait before proceeding; zero if tokens were available.
+     */
+    std::chrono::nanoseconds reserve(double tokens);
+
+private:
+    mutable std::mutex mutex; ///< Protects all fields below.
+    double tokensPerSecond; ///< Refill rate; 0 means unlimited.
+    double capacity; ///< Maximum number of stored tokens.
+    double tokens; ///< Currently stored tokens; negative while in debt.
+    std::chrono::steady_clock::time_point lastRefill; ///< Last time tokens were added.
+};
+
+/**
+ * @class RateLimiter
+ * @brief Hierarchical byte and event rate limiter.
+ *
+ * Each limiter holds a bytes/sec and an events/sec bucket and an optional
+ * parent. acquire() takes tokens from the limiter and all of its ancestors and
+ * sleeps for the longest wait any of them imposes, so a file is held to its
+ * own limit, its pipeline's limit and the global limit at once. Time spent
+ * waiting is charged to the limiter that imposed the longest wait and exported
+ * as `sparky_throttled_microseconds_total{limiter="..."}`.
+ *
+ * Callers throttle reading rather than dropping: while a reader sleeps in
+ * acquire(), unread data simply stays in the file.
+ */
+class RateLimiter {
+public:
+    /**
+     * @brief Constructs an unlimited RateLimiter.
+     * @param name Name used to label this limiter's metrics, e.g. "file:/var/log/syslog".
+     * @param parent The next limiter up the hierarchy, or nullptr for the root.
+     */
+    RateLimiter(const std::string& name, RateLimiter* parent = nullptr);
+
+    RateLimiter(const RateLimiter&) = delete;
+    RateLimiter& operator=(const RateLimiter&) = delete;
+
+    /**
+     * @brief Retrieves the process-wide root limiter.
+     * @return The global limiter.
+     */
+    static RateLimiter& global();
+
+    /**
+     * @brief Finds or creates a named pipeline limiter whose parent is the global limiter.
+     * @param name The pipeline name.
+     * @return The pipeline limiter, valid for the lifetime of the process.
+     */
+    static RateLimiter& pipeline(const std::string& name);
+
+    /**
+     * @brief Changes the byte rate limit.
+     * @param bytesPerSecond Bytes per second; 0 means unlimited.
+     * @param burst Burst size in bytes; 0 means one second's worth.
+     */
+    void setByteRate(double bytesPerSecond, double burst = 0);
+
+    /**
+     * @brief Changes the event rate limit.
+     * @param eventsPerSecond Events per second; 0 means unlimited.
+     * @param burst Burst size in events; 0 means one second's worth.
+     */
+    void setEventRate(double eventsPerSecond, double burst = 0);
+
+    /**
+     * @brief Moves this limiter under another parent.
+     * @param newParent The new parent, or nullptr for none.
+     */
+    void setParent(RateLimiter* newParent);
+
+    /**
+     * @brief Takes bytes and events from this limiter and its ancestors, sleeping if any is over its limit.
+     * @param bytes Number of bytes about to be sent.
+     * @param events Number of events about to be sent.
+     */
+    void acquire(size_t bytes, size_t events = 1);
+
+private:
+    std::string name; ///< Name used in metric labels.
+    std::atomic<RateLimiter*> parent; ///< The next limiter up the hierarchy.
+    TokenBucket byteBucket; ///< Bytes per second.
+    TokenBucket eventBucket; ///< Events per second.
+    Metrics::Counter& throttled; ///< Microseconds callers waited because of this limiter.
+};
+
+#endif
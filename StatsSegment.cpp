@@ -0,0 +1,185 @@
+#include "StatsSegment.h"
+#include <sys/mman.h>              // Used for shm_open() and mmap()
+#include <sys/stat.h>              // Used for mode constants
+#include <fcntl.h>                 // Used for O_* constants
+#include <unistd.h>                // Used for ftruncate(), close() and getpid()
+#include <stdexcept>               // Used for std::runtime_error
+#include <cstring>                 // Used for strerror(), memcpy() and strncpy()
+#include <ctime>                   // Used for clock_gettime()
+#include <chrono>                  // Used for the publish interval
+#include <algorithm>               // Used for std::min
+#include <errno.h>                 // Used for errno
+
+std::mutex StatsSegment::inputsMutex;
+std::vector<StatsSegment::Input> StatsSegment::inputs;
+
+namespace {
+
+int64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} // namespace
+
+/**
+ * @brief Creates the shared memory segment, writes its header and starts the publisher.
+ *
+ * A segment left behind by a previous run under the same name is replaced.
+ *
+ * @param name POSIX shared memory name.
+ *
+ * @throws std::runtime_error If the segment cannot be created, sized or mapped.
+ */
+StatsSegment::StatsSegment(const std::string& name)
+    : name(name), layout(nullptr), staging(), running(true) {
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create stats segment " + name + ": " + strerror(errno));
+    }
+    if (ftruncate(fd, sizeof(StatsLayout)) < 0) {
+        std::string error = strerror(errno);
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Failed to size stats segment " + name + ": " + error);
+    }
+    void* mapped = mmap(nullptr, sizeof(StatsLayout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::runtime_error("Failed to map stats segment " + name + ": " + strerror(errno));
+    }
+    // The new segment is zero-filled, so the sequence starts even.
+    layout = static_cast<StatsLayout*>(mapped);
+    layout->version = STATS_SEGMENT_VERSION;
+    layout->payloadSize = sizeof(StatsPayload);
+    layout->pid = static_cast<int32_t>(getpid());
+    std::atomic_thread_fence(std::memory_order_release);
+    layout->magic = STATS_SEGMENT_MAGIC;
+    publisher = std::thread(&StatsSegment::run, this);
+}
+
+/**
+ * @brief Stops the publisher, unmaps and removes the segment.
+ */
+StatsSegment::~StatsSegment() {
+    running.store(false);
+    publisher.join();
+    munmap(layout, sizeof(StatsLayout));
+    shm_unlink(name.c_str());
+}
+
+/**
+ * @brief Adds an input to the published statistics.
+ *
+ * @param input The input's statistics sources; an input with the same name is replaced.
+ */
+void StatsSegment::registerInput(const Input& input) {
+    std::lock_guard<std::mutex> lock(inputsMutex);
+    for (Input& existing : inputs) {
+        if (existing.name == input.name) {
+            existing = input;
+            return;
+        }
+    }
+    inputs.push_back(input);
+}
+
+/**
+ * @brief Removes an input from the published statistics.
+ *
+ * @param name The input's name.
+ */
+void StatsSegment::unregisterInput(const std::string& name) {
+    std::lock_guard<std::mutex> lock(inputsMutex);
+    for (auto it = inputs.begin(); it != inputs.end(); ++it) {
+        if (it->name == name) {
+            inputs.erase(it);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Publisher loop.
+ */
+void StatsSegment::run() {
+    while (running.load()) {
+        publish();
+        std::this_thread::sleep_for(std::chrono::milliseconds(PUBLISH_INTERVAL_MS));
+    }
+}
+
+/**
+ * @brief Assembles an update and copies it into the segment under the seqlock.
+ *
+ * The update is built in a private buffer first so the segment is only
+ * inconsistent for the duration of one memcpy.
+ */
+void StatsSegment::publish() {
+    Metrics& metrics = Metrics::instance();
+    staging.publishedNanos = monotonicNanos();
+    staging.updates++;
+    staging.eventsDelivered = metrics.total("sparky_events_delivered_total");
+    staging.deliveryFailures = metrics.total("sparky_delivery_failures_total");
+    const char* lanes[] = {"critical", "normal", "bulk"};
+    for (size_t i = 0; i < 3; ++i) {
+        staging.laneDepth[i] = metrics.gauge("sparky_lane_queue_depth", Metrics::label("lane", lanes[i])).get();
+    }
+    staging.cpuUtilization = metrics.gauge("sparky_cpu_budget_utilization").get();
+    {
+        std::lock_guard<std::mutex> lock(inputsMutex);
+        staging.inputCount = static_cast<uint32_t>(std::min(inputs.size(), StatsPayload::MAX_INPUTS));
+        for (uint32_t i = 0; i < staging.inputCount; ++i) {
+            const Input& input = inputs[i];
+            StatsInputRecord& record = staging.inputs[i];
+            std::strncpy(record.name, input.name.c_str(), sizeof(record.name) - 1);
+            record.name[sizeof(record.name) - 1] = '\0';
+            record.linesRead = input.linesRead->get();
+            record.bytesRead = input.bytesRead->get();
+            record.eventsDelivered = input.delivered->count();
+            record.fileSize = static_cast<uint64_t>(input.fileSize->get());
+            record.readOffset = static_cast<uint64_t>(input.readOffset->get());
+            record.queueDepth = static_cast<uint64_t>(input.queueDepth->get());
+            record.unshippedBytes = static_cast<uint64_t>(input.unshippedBytes->get());
+            record.inFlight = static_cast<uint64_t>(input.inFlight->get());
+        }
+    }
+
+    uint64_t sequence = layout->sequence.load(std::memory_order_relaxed);
+    layout->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&layout->payload, &staging, sizeof(StatsPayload));
+    layout->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Copies a consistent payload out of a mapped segment.
+ *
+ * @param layout The mapped segment, possibly read-only.
+ * @param payload Receives the payload.
+ * @param maxAttempts How many times to retry while the writer is updating.
+ * @return False if the segment is not (yet) a valid segment of this version,
+ *         or the writer kept it busy for every attempt.
+ */
+bool StatsSegment::read(const StatsLayout& layout, StatsPayload& payload, int maxAttempts) {
+    if (layout.magic != STATS_SEGMENT_MAGIC || layout.version != STATS_SEGMENT_VERSION ||
+        layout.payloadSize != sizeof(StatsPayload)) {
+        return false;
+    }
+    for (int attempt = 0; attempt < maxAttempts; ++attempt) {
+        uint64_t before = layout.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy(&payload, &layout.payload, sizeof(StatsPayload));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (layout.sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
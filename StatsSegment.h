@@ -0,0 +1,158 @@
+#ifndef STATSSEGMENT_H
+#define STATSSEGMENT_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "Metrics.h"
+#include "LatencyHistogram.h"
+
+
+/**
+ * @brief Magic number at the start of a stats segment ("SPKYSTAT").
+ */
+const uint64_t STATS_SEGMENT_MAGIC = 0x54415453594b5053ULL;
+
+/**
+ * @brief Layout version of the stats segment; bumped whenever StatsPayload changes.
+ */
+const uint32_t STATS_SEGMENT_VERSION = 2;
+
+/**
+ * @brief One monitored input as published in the stats segment.
+ */
+struct StatsInputRecord {
+    char name[256]; ///< The input's name (file path), NUL-terminated and possibly truncated.
+    uint64_t linesRead; ///< Lines read so far.
+    uint64_t bytesRead; ///< Bytes read so far.
+    uint64_t eventsDelivered; ///< Lines whose delivery Kafka acknowledged.
+    uint64_t fileSize; ///< Size of the file at the last read.
+    uint64_t readOffset; ///< Offset up to which the file has been read.
+    uint64_t queueDepth; ///< Messages queued for the input's producer or lane.
+    uint64_t unshippedBytes; ///< File size minus the offset up to which Kafka acknowledged every line.
+    uint64_t inFlight; ///< Lines handed to a producer and not yet acknowledged.
+};
+
+/**
+ * @brief Everything published in one update of the stats segment.
+ *
+ * Plain data only, so readers can copy it as a whole between two reads of the
+ * sequence counter.
+ */
+struct StatsPayload {
+    /// Most inputs the segment can describe.
+    static const size_t MAX_INPUTS = 256;
+
+    int64_t publishedNanos; ///< CLOCK_MONOTONIC time of this update, in nanoseconds.
+    uint64_t updates; ///< Number of updates published so far.
+    uint64_t eventsDelivered; ///< Messages delivered, all sinks.
+    uint64_t deliveryFailures; ///< Messages that failed delivery, all sinks.
+    double laneDepth[3]; ///< Queue depth of the critical, normal and bulk lanes.
+    double cpuUtilization; ///< Share of the CPU budget used at the last governor sample.
+    uint32_t inputCount; ///< Number of valid entries in inputs.
+    StatsInputRecord inputs[MAX_INPUTS]; ///< The monitored inputs.
+};
+
+/**
+ * @brief The shared memory segment: a header followed by a seqlock-protected payload.
+ *
+ * The writer makes `sequence` odd, updates the payload and makes it even
+ * again. A reader copies the payload and retries if `sequence` was odd or
+ * changed meanwhile, so it never blocks the writer.
+ */
+struct StatsLayout {
+    uint64_t magic; ///< STATS_SEGMENT_MAGIC once initialized.
+    uint32_t version; ///< STATS_SEGMENT_VERSION.
+    uint32_t payloadSize; ///< sizeof(StatsPayload), as a second layout check.
+    int32_t pid; ///< Process ID of the forwarder.
+    std::atomic<uint64_t> sequence; ///< Seqlock counter; odd while an update is in progress.
+    StatsPayload payload; ///< The published statistics.
+};
+
+
+/**
+ * @class StatsSegment
+ * @brief Publishes forwarder statistics to a POSIX shared memory segment for sparky-top.
+ *
+ * Monitors register their inputs with registerInput(). While a StatsSegment
+ * exists, a background thread copies the registered counters and the global
+ * metrics into the segment 20 times a second. Reading the segment needs no
+ * network port and takes nothing from the forwarder: readers only map it
+ * read-only, and the publisher only reads atomics the hot path updates anyway.
+ */
+class StatsSegment {
+public:
+    /**
+     * @brief Sources of one input's statistics. All pointers must stay valid
+     *        until the input is unregistered; Metrics entries always do.
+     */
+    struct Input {
+        std::string name; ///< The input's name.
+        const Metrics::Counter* linesRead; ///< Lines read.
+        const Metrics::Counter* bytesRead; ///< Bytes read.
+        const LatencyHistogram* delivered; ///< Histogram with one entry per delivered line.
+        const Metrics::Gauge* fileSize; ///< File size.
+        const Metrics::Gauge* readOffset; ///< Read offset.
+        const Metrics::Gauge* queueDepth; ///< Producer or lane queue depth.
+        const Metrics::Gauge* unshippedBytes; ///< Unshipped bytes, from the input's LagTracker.
+        const Metrics::Gauge* inFlight; ///< In-flight lines, from the input's LagTracker.
+    };
+
+    /**
+     * @brief Creates (or replaces) the segment and starts publishing.
+     * @param name POSIX shared memory name, e.g. "/sparky-stats".
+     * @throws std::runtime_error If the segment cannot be created or mapped.
+     */
+    explicit StatsSegment(const std::string& name = "/sparky-stats");
+
+    /**
+     * @brief Stops publishing and removes the segment.
+     */
+    ~StatsSegment();
+
+    StatsSegment(const StatsSegment&) = delete;
+    StatsSegment& operator=(const StatsSegment&) = delete;
+
+    /**
+     * @brief Adds an input to every segment's updates.
+     * @param input The input's statistics sources.
+     */
+    static void registerInput(const Input& input);
+
+    /**
+     * @brief Removes an input.
+     * @param name The input's name.
+     */
+    static void unregisterInput(const std::string& name);
+
+    /**
+     * @brief Copies a consistent payload out of a mapped segment.
+     * @param layout The mapped segment.
+     * @param payload Receives the payload.
+     * @param maxAttempts How many times to retry while the writer is updating.
+     * @return False if the segment has the wrong magic or layout, or no consistent copy was obtained.
+     */
+    static bool read(const StatsLayout& layout, StatsPayload& payload, int maxAttempts = 1000);
+
+private:
+    /// Time between updates.
+    static const int PUBLISH_INTERVAL_MS = 50;
+
+    void publish();
+    void run();
+
+    static std::mutex inputsMutex; ///< Protects inputs.
+    static std::vector<Input> inputs; ///< Registered inputs.
+
+    std::string name; ///< Shared memory name.
+    StatsLayout* layout; ///< The mapped segment.
+    StatsPayload staging; ///< Update being assembled before it is copied into the segment.
+    std::atomic<bool> running; ///< Cleared to stop the publisher.
+    std::thread publisher; ///< Publishes updates.
+};
+
+#endif
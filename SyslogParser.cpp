@@ -0,0 +1,247 @@
+#include "SyslogParser.h"
+#include <cstring>                 // Used for memchr()
+
+namespace {
+
+/// UTF-8 byte order mark allowed before an RFC 5424 MSG.
+const char BOM[] = "\xEF\xBB\xBF";
+
+} // namespace
+
+/**
+ * @brief Parses a syslog line.
+ *
+ * @param line The line.
+ * @param message Receives the header.
+ * @return False if the line is not syslog.
+ */
+bool SyslogParser::parse(std::string_view line, Message& message) {
+    message = Message();
+    message.priority = -1;
+    message.timeUs = -1;
+    Cursor cursor{line.data(), line.data() + line.size()};
+    if (cursor.position < cursor.end && *cursor.position == '<' && !parsePriority(cursor, message.priority)) {
+        return false;
+    }
+    if (cursor.end - cursor.position >= 2 && cursor.position[0] == '1' && cursor.position[1] == ' ') {
+        cursor.position += 2;
+        return parseRfc5424(cursor, message);
+    }
+    return parseRfc3164(cursor, message);
+}
+
+/**
+ * @brief Parses `<PRI>`: 1 to 3 digits, no leading zeros, at most 191.
+ *
+ * @param cursor The cursor, at '<'.
+ * @param priority Receives the value.
+ * @return False if malformed.
+ */
+bool SyslogParser::parsePriority(Cursor& cursor, int& priority) {
+    const char* p = cursor.position + 1;
+    int value = 0;
+    int digits = 0;
+    while (p < cursor.end && *p >= '0' && *p <= '9' && digits < 3) {
+        value = value * 10 + (*p - '0');
+        p++;
+        digits++;
+    }
+    if (digits == 0 || p >= cursor.end || *p != '>' || value > 191 || (digits > 1 && cursor.position[1] == '0')) {
+        return false;
+    }
+    priority = value;
+    cursor.position = p + 1;
+    return true;
+}
+
+/**
+ * @brief Parses a timestamp.
+ *
+ * @param cursor The cursor, at the timestamp; left after it.
+ * @param format The timestamp format.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return False if malformed.
+ */
+bool SyslogParser::parseTime(Cursor& cursor, TimestampParser::Format format, int64_t& timeUs) {
+    size_t used = times.parse(format, std::string_view(cursor.position, static_cast<size_t>(cursor.end - cursor.position)), timeUs);
+    cursor.position += used;
+    return used > 0;
+}
+
+/**
+ * @brief Parses STRUCTURED-DATA: one or more `[ID PARAM="VALUE" ...]` elements.
+ *
+ * Inside values, `\"`, `\\` and `\]` are escapes, so a ']' ends an element only outside quotes.
+ *
+ * @param cursor The cursor, at '['.
+ * @param data Receives the elements as written.
+ * @return False if an element is not closed.
+ */
+bool SyslogParser::parseStructuredData(Cursor& cursor, std::string_view& data) {
+    const char* start = cursor.position;
+    const char* p = start;
+    while (p < cursor.end && *p == '[') {
+        p++;
+        bool quoted = false;
+        while (p < cursor.end && (quoted || *p != ']')) {
+            if (quoted && *p == '\\' && p + 1 < cursor.end) {
+                p++;
+            } else if (*p == '"') {
+                quoted = !quoted;
+            }
+            p++;
+        }
+        if (p >= cursor.end) {
+            return false;
+        }
+        p++;
+    }
+    data = std::string_view(start, static_cast<size_t>(p - start));
+    cursor.position = p;
+    return true;
+}
+
+/**
+ * @brief Parses a space-terminated header field, mapping the nil value `-` to empty.
+ *
+ * @param cursor The cursor, at the field; left at the space after it.
+ * @return The field.
+ */
+std::string_view SyslogParser::parseField(Cursor& cursor) {
+    std::string_view field = nextWord(cursor);
+    return field == "-" ? std::string_view() : field;
+}
+
+/**
+ * @brief Reads a word up to the next space.
+ *
+ * @param cursor The cursor, at the word; left at the space after it.
+ * @return The word.
+ */
+std::string_view SyslogParser::nextWord(Cursor& cursor) {
+    const char* start = cursor.position;
+    const void* space = std::memchr(start, ' ', static_cast<size_t>(cursor.end - start));
+    cursor.position = space ? static_cast<const char*>(space) : cursor.end;
+    return std::string_view(start, static_cast<size_t>(cursor.position - start));
+}
+
+/**
+ * @brief Recognizes an RFC 3164 tag: `app:`, `app[pid]:` or `app[pid]`.
+ *
+ * @param word The word.
+ * @param message Receives appName and procId if the word is a tag.
+ * @return True if the word is a tag.
+ */
+bool SyslogParser::parseTag(std::string_view word, Message& message) {
+    bool colon = !word.empty() && word.back() == ':';
+    if (colon) {
+        word.remove_suffix(1);
+    }
+    std::string_view procId;
+    if (!word.empty() && word.back() == ']') {
+        size_t open = word.find('[');
+        if (open == std::string_view::npos || open == 0) {
+            return false;
+        }
+        procId = word.substr(open + 1, word.size() - open - 2);
+        word = word.substr(0, open);
+    } else if (!colon) {
+        return false;
+    }
+    if (word.empty()) {
+        return false;
+    }
+    message.appName = word;
+    message.procId = procId;
+    return true;
+}
+
+/**
+ * @brief Parses the RFC 5424 header after the version.
+ *
+ * @param cursor The cursor, at the timestamp.
+ * @param message Receives the header.
+ * @return False if malformed.
+ */
+bool SyslogParser::parseRfc5424(Cursor cursor, Message& message) {
+    message.format = RFC5424;
+    if (cursor.position < cursor.end && *cursor.position == '-') {
+        cursor.position++;
+    } else if (!parseTime(cursor, TimestampParser::RFC3339, message.timeUs)) {
+        return false;
+    }
+    std::string_view* fields[] = {&message.hostname, &message.appName, &message.procId, &message.msgId};
+    for (std::string_view* field : fields) {
+        if (cursor.position >= cursor.end || *cursor.position != ' ') {
+            return false;
+        }
+        cursor.position++;
+        *field = parseField(cursor);
+    }
+    if (cursor.position >= cursor.end || *cursor.position != ' ') {
+        return false;
+    }
+    cursor.position++;
+    if (cursor.position < cursor.end && *cursor.position == '-') {
+        cursor.position++;
+    } else if (cursor.position >= cursor.end || *cursor.position != '[' || !parseStructuredData(cursor, message.structuredData)) {
+        return false;
+    }
+    if (cursor.position < cursor.end) {
+        if (*cursor.position != ' ') {
+            return false;
+        }
+        cursor.position++;
+    }
+    std::string_view rest(cursor.position, static_cast<size_t>(cursor.end - cursor.position));
+    if (rest.compare(0, 3, BOM) == 0) {
+        rest.remove_prefix(3);
+    }
+    message.message = rest;
+    return true;
+}
+
+/**
+ * @brief Parses an RFC 3164 header, or rsyslog's variant with an RFC 3339 timestamp.
+ *
+ * The hostname is optional: a first word that is a tag is taken as the tag.
+ * Without a tag in the first two words, the first word is the hostname and
+ * the rest of the line is the message.
+ *
+ * @param cursor The cursor, at the timestamp.
+ * @param message Receives the header.
+ * @return False if there is no valid timestamp.
+ */
+bool SyslogParser::parseRfc3164(Cursor cursor, Message& message) {
+    message.format = RFC3164;
+    const char* p = cursor.position;
+    bool iso = cursor.end - p >= 5 && p[0] >= '0' && p[0] <= '9' && p[4] == '-';
+    if (!parseTime(cursor, iso ? TimestampParser::ISO8601 : TimestampParser::SYSLOG, message.timeUs)) {
+        return false;
+    }
+    if (cursor.position < cursor.end && *cursor.position != ' ') {
+        return false;
+    }
+    while (cursor.position < cursor.end && *cursor.position == ' ') {
+        cursor.position++;
+    }
+    const char* firstStart = cursor.position;
+    std::string_view first = nextWord(cursor);
+    if (!parseTag(first, message)) {
+        if (cursor.position >= cursor.end) {
+            cursor.position = firstStart;
+        } else {
+            const char* secondStart = ++cursor.position;
+            message.hostname = first;
+            if (!parseTag(nextWord(cursor), message)) {
+                // No tag: everything after the hostname is the message
+                cursor.position = secondStart;
+            }
+        }
+    }
+    if (message.appName.data() != nullptr && cursor.position < cursor.end) {
+        cursor.position++;
+    }
+    message.message = std::string_view(cursor.position, static_cast<size_t>(cursor.end - cursor.position));
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef SYSLOGPARSER_H
+#define SYSLOGPARSER_H
+
+#include <string_view>
+#include <cstdint>
+#include "TimestampParser.h"
+
+
+/**
+ * @class SyslogParser
+ * @brief Decodes RFC 3164 and RFC 5424 syslog headers without allocating.
+ *
+ * Accepted forms, each with or without a leading `<PRI>` (files written by
+ * rsyslog usually drop it):
+ * - RFC 5424: `<PRI>1 TIMESTAMP HOST APP PROCID MSGID [SD...] MSG`, with `-`
+ *   for nil values and an optional UTF-8 BOM before MSG. TIMESTAMP must be
+ *   strict RFC 3339 (TimestampParser::RFC3339).
+ * - RFC 3164: `Mmm dd [yyyy ]hh:mm:ss[.frac] [yyyy ]HOST TAG[PID]: MSG`. The
+ *   year may come before or after the time; without one it is the year that
+ *   puts the timestamp closest to now. The time is local.
+ * - rsyslog's high-precision file format: an RFC 3339 timestamp in place of
+ *   the RFC 3164 one.
+ *
+ * Every text part of a Message is a view into the parsed line. Timestamps
+ * are decoded by a TimestampParser, which caches the local time offset
+ * used for RFC 3164 per hour of local time.
+ *
+ * Each monitor has its own parser, since the caches are per parser.
+ */
+class SyslogParser {
+public:
+    /**
+     * @brief Header layout of a parsed line.
+     */
+    enum Format {
+        RFC3164, ///< BSD syslog, including rsyslog's high-precision variant
+        RFC5424  ///< IETF syslog
+    };
+
+    /**
+     * @brief The decoded header of one line; views point into the line.
+     */
+    struct Message {
+        Format format; ///< Header layout.
+        int priority; ///< PRI value, or -1 if the line had none.
+        int64_t timeUs; ///< Event time in microseconds since the epoch, or -1 if absent or nil.
+        std::string_view hostname; ///< HOSTNAME, empty if nil.
+        std::string_view appName; ///< APP-NAME or the RFC 3164 tag, empty if nil.
+        std::string_view procId; ///< PROCID or the pid in the tag's brackets, empty if nil.
+        std::string_view msgId; ///< MSGID, empty if nil or RFC 3164.
+        std::string_view structuredData; ///< STRUCTURED-DATA elements as written, empty if nil or RFC 3164.
+        std::string_view message; ///< MSG, without a leading BOM.
+
+        /**
+         * @brief Retrieves the facility.
+         * @return PRI / 8, or -1 without PRI.
+         */
+        int facility() const { return priority < 0 ? -1 : priority >> 3; }
+
+        /**
+         * @brief Retrieves the severity.
+         * @return PRI % 8, or -1 without PRI.
+         */
+        int severity() const { return priority < 0 ? -1 : priority & 7; }
+    };
+
+    /**
+     * @brief Parses a syslog line.
+     * @param line The line.
+     * @param message Receives the header; valid until the line changes.
+     * @return False if the line is not syslog.
+     */
+    bool parse(std::string_view line, Message& message);
+
+private:
+    /**
+     * @brief Cursor over the line being parsed.
+     */
+    struct Cursor {
+        const char* position; ///< Next byte.
+        const char* end; ///< End of the line.
+    };
+
+    static bool parsePriority(Cursor& cursor, int& priority);
+    static bool parseStructuredData(Cursor& cursor, std::string_view& data);
+    static std::string_view nextWord(Cursor& cursor);
+    static std::string_view parseField(Cursor& cursor);
+    static bool parseTag(std::string_view word, Message& message);
+    bool parseTime(Cursor& cursor, TimestampParser::Format format, int64_t& timeUs);
+    bool parseRfc5424(Cursor cursor, Message& message);
+    bool parseRfc3164(Cursor cursor, Message& message);
+
+    TimestampParser times; ///< Decodes the header timestamps.
+};
+
+#endif
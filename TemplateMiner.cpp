@@ -0,0 +1,257 @@
+#include "TemplateMiner.h"
+#include <stdexcept>               // Used for std::runtime_error
+#include <cctype>                  // Used for std::isdigit
+
+const std::string TemplateMiner::WILDCARD = "<*>";
+
+namespace {
+
+/**
+ * @brief Checks whether a token should be treated as a variable from the start.
+ *
+ * Tokens containing digits (counters, IDs, addresses, timestamps) are almost
+ * always variable, so they are masked before they can split clusters. A
+ * literal wildcard token is masked too so that every "<*>" in a template is a
+ * parameter position and reconstruction stays unambiguous.
+ */
+bool isVariableToken(const std::string& token) {
+    if (token == TemplateMiner::WILDCARD) {
+        return true;
+    }
+    for (char c : token) {
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string joinTokens(const std::vector<std::string>& tokens) {
+    std::string text;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i > 0) {
+            text += ' ';
+        }
+        text += tokens[i];
+    }
+    return text;
+}
+
+} // namespace
+
+/**
+ * @brief Constructs a TemplateMiner with the given Drain parameters.
+ *
+ * @param depth Depth of the prefix tree. The first two levels are the root and
+ *        the token count; the remaining depth - 2 levels key on leading tokens.
+ * @param similarityThreshold Minimum fraction of matching tokens, wildcards
+ *        included, for a line to join an existing cluster.
+ * @param maxChildren Maximum children per tree node before further tokens are
+ *        routed through the wildcard branch.
+ * @param maxClusters Maximum number of clusters kept in memory.
+ */
+TemplateMiner::TemplateMiner(int depth, double similarityThreshold, size_t maxChildren, size_t maxClusters)
+    : depth(depth < 3 ? 3 : depth), similarityThreshold(similarityThreshold),
+      maxChildren(maxChildren), maxClusters(maxClusters) {}
+
+/**
+ * @brief Splits a line on single spaces.
+ *
+ * Consecutive spaces yield empty tokens, so joining the tokens with single
+ * spaces always reproduces the original line exactly.
+ *
+ * @param line The line to split.
+ * @return The tokens of the line (at least one, possibly empty).
+ */
+std::vector<std::string> TemplateMiner::tokenize(const std::string& line) {
+    std::vector<std::string> tokens;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find(' ', start);
+        if (end == std::string::npos) {
+            tokens.emplace_back(line, start);
+            break;
+        }
+        tokens.emplace_back(line, start, end - start);
+        start = end + 1;
+    }
+    return tokens;
+}
+
+/**
+ * @brief Walks the prefix tree to the leaf for a tokenized line.
+ *
+ * Missing nodes are created on the way down.
+ *
+ * @param tokens The tokens of the line.
+ * @return The leaf node for the line's length and leading tokens.
+ */
+TemplateMiner::Node* TemplateMiner::leafFor(const std::vector<std::string>& tokens) {
+    Node* node = &root;
+    std::string lengthKey = std::to_string(tokens.size());
+    auto it = node->children.find(lengthKey);
+    if (it == node->children.end()) {
+        it = node->children.emplace(lengthKey, std::unique_ptr<Node>(new Node())).first;
+    }
+    node = it->second.get();
+
+    size_t prefixLevels = static_cast<size_t>(depth - 2);
+    for (size_t i = 0; i < prefixLevels && i < tokens.size(); ++i) {
+        const std::string& key = isVariableToken(tokens[i]) ? WILDCARD : tokens[i];
+        auto child = node->children.find(key);
+        if (child == node->children.end()) {
+            // Once a node is full, new tokens share the wildcard branch
+            const std::string& branch = node->children.size() < maxChildren ? key : WILDCARD;
+            child = node->children.find(branch);
+            if (child == node->children.end()) {
+                child = node->children.emplace(branch, std::unique_ptr<Node>(new Node())).first;
+            }
+        }
+        node = child->second.get();
+    }
+    return node;
+}
+
+/**
+ * @brief Computes the similarity between a cluster template and a line.
+ *
+ * The similarity is the fraction of positions where the template holds a
+ * wildcard or a constant token equal to the line's token. As in Drain,
+ * wildcard positions count as matches, so a template that is mostly
+ * parameters keeps matching lines of its shape instead of spawning a new
+ * cluster per line.
+ *
+ * @param cluster The cluster to compare against.
+ * @param tokens The tokens of the line (same length as the template).
+ * @return A value between 0 and 1.
+ */
+double TemplateMiner::similarity(const Cluster& cluster, const std::vector<std::string>& tokens) const {
+    size_t matches = 0;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (cluster.tokens[i] == WILDCARD || cluster.tokens[i] == tokens[i]) {
+            ++matches;
+        }
+    }
+    return static_cast<double>(matches) / static_cast<double>(tokens.size());
+}
+
+/**
+ * @brief Matches a line against the mined templates.
+ *
+ * The line is routed through the prefix tree to a leaf and compared with the
+ * clusters stored there. If the best cluster is similar enough the line joins
+ * it, generalizing the template where tokens differ; otherwise a new cluster
+ * is created with variable-looking tokens already masked.
+ *
+ * @param line The line to match.
+ * @return The template ID, whether it was newly issued, and the line's parameters.
+ */
+TemplateMiner::Match TemplateMiner::add(const std::string& line) {
+    Match match;
+    std::vector<std::string> tokens = tokenize(line);
+
+    Node* leaf = leafFor(tokens);
+    Cluster* best = nullptr;
+    double bestSimilarity = -1.0;
+    for (Cluster* cluster : leaf->clusters) {
+        double sim = similarity(*cluster, tokens);
+        if (sim > bestSimilarity) {
+            bestSimilarity = sim;
+            best = cluster;
+        }
+    }
+
+    if (best != nullptr && bestSimilarity >= similarityThreshold) {
+        bool generalized = false;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            if (best->tokens[i] != WILDCARD && best->tokens[i] != tokens[i]) {
+                best->tokens[i] = WILDCARD;
+                generalized = true;
+            }
+        }
+        if (generalized) {
+            best->templateId = nextTemplateId++;
+            templates[best->templateId] = best->tokens;
+            match.isNew = true;
+        }
+    } else {
+        if (clusters.size() >= maxClusters) {
+            return match;
+        }
+        std::unique_ptr<Cluster> cluster(new Cluster());
+        cluster->templateId = nextTemplateId++;
+        cluster->tokens = tokens;
+        for (std::string& token : cluster->tokens) {
+            if (isVariableToken(token)) {
+                token = WILDCARD;
+            }
+        }
+        templates[cluster->templateId] = cluster->tokens;
+        best = cluster.get();
+        leaf->clusters.push_back(best);
+        clusters.push_back(std::move(cluster));
+        match.isNew = true;
+    }
+
+    match.templateId = best->templateId;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (best->tokens[i] == WILDCARD) {
+            match.params.push_back(std::move(tokens[i]));
+        }
+    }
+    return match;
+}
+
+/**
+ * @brief Retrieves the text of a template.
+ *
+ * @param templateId The ID returned by add().
+ * @return The template tokens joined by single spaces.
+ * @throws std::runtime_error If the template ID is unknown.
+ */
+std::string TemplateMiner::templateText(int templateId) const {
+    auto it = templates.find(templateId);
+    if (it == templates.end()) {
+        throw std::runtime_error("Unknown template ID: " + std::to_string(templateId));
+    }
+    return joinTokens(it->second);
+}
+
+/**
+ * @brief Registers a template definition received from the producer side.
+ *
+ * @param templateId The template ID.
+ * @param templateText The template text, tokens separated by single spaces.
+ */
+void TemplateDecoder::addTemplate(int templateId, const std::string& templateText) {
+    templates[templateId] = TemplateMiner::tokenize(templateText);
+}
+
+/**
+ * @brief Reconstructs a line from its template ID and parameters.
+ *
+ * @param templateId The template ID.
+ * @param params The parameters, one per wildcard position in the template.
+ * @return The original line.
+ * @throws std::runtime_error If the template is unknown or the parameter count does not match.
+ */
+std::string TemplateDecoder::reconstruct(int templateId, const std::vector<std::string>& params) const {
+    auto it = templates.find(templateId);
+    if (it == templates.end()) {
+        throw std::runtime_error("Unknown template ID: " + std::to_string(templateId));
+    }
+    std::vector<std::string> tokens = it->second;
+    size_t next = 0;
+    for (std::string& token : tokens) {
+        if (token == TemplateMiner::WILDCARD) {
+            if (next >= params.size()) {
+                throw std::runtime_error("Too few parameters for template " + std::to_string(templateId));
+            }
+            token = params[next++];
+        }
+    }
+    if (next != params.size()) {
+        throw std::runtime_error("Too many parameters for template " + std::to_string(templateId));
+    }
+    return joinTokens(tokens);
+}
@@ -0,0 +1,121 @@
+#ifndef TEMPLATEMINER_H
+#define TEMPLATEMINER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+
+/**
+ * @class TemplateMiner
+ * @brief Online Drain-style log template miner.
+ *
+ * Lines are split on single spaces and clustered by token count and leading
+ * tokens in a fixed-depth prefix tree. Each cluster carries a template where
+ * variable positions are replaced by the wildcard token "<*>". A line is then
+ * fully described by its template ID plus the tokens at the wildcard positions.
+ *
+ * Template IDs are immutable: when a cluster generalizes (a constant token
+ * becomes a wildcard) it is given a new ID, so a template definition that has
+ * been sent once never changes meaning.
+ */
+class TemplateMiner {
+public:
+    /// Token used to mark a variable position in a template.
+    static const std::string WILDCARD;
+
+    /**
+     * @brief The result of matching a line against the mined templates.
+     */
+    struct Match {
+        int templateId = -1;             ///< Template ID, or -1 if the line could not be templated.
+        bool isNew = false;              ///< True if the template was created or generalized by this line.
+        std::vector<std::string> params; ///< The line's tokens at each wildcard position, in order.
+    };
+
+    /**
+     * @brief Constructs a TemplateMiner.
+     * @param depth Depth of the prefix tree, including the root and token-count levels.
+     * @param similarityThreshold Minimum fraction of matching tokens, wildcards included, to join an existing cluster.
+     * @param maxChildren Maximum children per prefix tree node before tokens share a wildcard branch.
+     * @param maxClusters Maximum number of clusters; lines that would need a new cluster beyond this are not templated.
+     */
+    TemplateMiner(int depth = 4, double similarityThreshold = 0.5, size_t maxChildren = 100, size_t maxClusters = 10000);
+
+    /**
+     * @brief Matches a line against the known templates, creating or generalizing one if needed.
+     * @param line The line to match.
+     * @return The template ID and the line's parameters.
+     */
+    Match add(const std::string& line);
+
+    /**
+     * @brief Retrieves the text of a template.
+     * @param templateId The ID returned by add().
+     * @return The template tokens joined by single spaces.
+     */
+    std::string templateText(int templateId) const;
+
+    /**
+     * @brief Splits a line on single spaces, keeping empty tokens so the split is reversible.
+     * @param line The line to split.
+     * @return The tokens of the line.
+     */
+    static std::vector<std::string> tokenize(const std::string& line);
+
+private:
+    struct Cluster {
+        int templateId;
+        std::vector<std::string> tokens;
+    };
+
+    struct Node {
+        std::unordered_map<std::string, std::unique_ptr<Node>> children;
+        std::vector<Cluster*> clusters;
+    };
+
+    double similarity(const Cluster& cluster, const std::vector<std::string>& tokens) const;
+    Node* leafFor(const std::vector<std::string>& tokens);
+
+    int depth; ///< Depth of the prefix tree.
+    double similarityThreshold; ///< Minimum similarity to join a cluster.
+    size_t maxChildren; ///< Maximum children per tree node.
+    size_t maxClusters; ///< Maximum number of clusters.
+    Node root; ///< Root of the prefix tree.
+    std::vector<std::unique_ptr<Cluster>> clusters; ///< All clusters, owned.
+    std::unordered_map<int, std::vector<std::string>> templates; ///< Every template ID ever issued.
+    int nextTemplateId = 1; ///< Next template ID to issue.
+};
+
+/**
+ * @class TemplateDecoder
+ * @brief Reconstructs original lines from template definitions and parameters.
+ *
+ * This is the consumer-side counterpart of TemplateMiner. Reconstruction is
+ * lossless: joining the template tokens, with each wildcard replaced by the
+ * next parameter, yields the original line byte for byte.
+ */
+class TemplateDecoder {
+public:
+    /**
+     * @brief Registers (or replaces) a template definition.
+     * @param templateId The template ID.
+     * @param templateText The template text as returned by TemplateMiner::templateText().
+     */
+    void addTemplate(int templateId, const std::string& templateText);
+
+    /**
+     * @brief Reconstructs a line from its template and parameters.
+     * @param templateId The template ID.
+     * @param params The parameters, one per wildcard position.
+     * @return The original line.
+     * @throws std::runtime_error If the template is unknown or the parameter count does not match.
+     */
+    std::string reconstruct(int templateId, const std::vector<std::string>& params) const;
+
+private:
+    std::unordered_map<int, std::vector<std::string>> templates; ///< Known templates by ID.
+};
+
+#endif
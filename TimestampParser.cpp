@@ -0,0 +1,730 @@
+#include "TimestampParser.h"
+#include <cstring>                 // Used for memcmp()
+#include <climits>                 // Used for INT64_MIN
+#include <stdexcept>               // Used for std::invalid_argument
+
+namespace {
+
+const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+/// Epoch seconds accepted by EPOCH: 2000-01-01 up to 2100-01-01.
+const int64_t EPOCH_MIN = 946684800;
+const int64_t EPOCH_MAX = 4102444800;
+
+inline bool isDigit(char c) {
+    return static_cast<unsigned>(c - '0') <= 9;
+}
+
+inline bool isAlnum(char c) {
+    return isDigit(c) || static_cast<unsigned>((c | 0x20) - 'a') <= 25;
+}
+
+/**
+ * @brief Reads a fixed number of decimal digits.
+ *
+ * @param p The digits.
+ * @param count How many to read.
+ * @param value Receives their value.
+ * @return False if any of them is not a digit.
+ */
+inline bool readDigits(const char* p, int count, int& value) {
+    value = 0;
+    for (int i = 0; i < count; ++i) {
+        unsigned digit = static_cast<unsigned>(p[i] - '0');
+        if (digit > 9) {
+            return false;
+        }
+        value = value * 10 + static_cast<int>(digit);
+    }
+    return true;
+}
+
+/**
+ * @brief Reads one or two decimal digits.
+ *
+ * @param p The first digit; advanced past the last one.
+ * @param end End of the text.
+ * @param value Receives their value.
+ * @return False if there is no digit.
+ */
+inline bool readNumber(const char*& p, const char* end, int& value) {
+    if (p >= end || !isDigit(*p)) {
+        return false;
+    }
+    value = *p++ - '0';
+    if (p < end && isDigit(*p)) {
+        value = value * 10 + (*p++ - '0');
+    }
+    return true;
+}
+
+/**
+ * @brief Reads `hh:mm:ss`.
+ *
+ * @param p The text; at least 8 bytes must be available.
+ * @param seconds Receives seconds since midnight.
+ * @return False if the time is malformed or out of range (a leap second is accepted).
+ */
+inline bool readClock(const char* p, int& seconds) {
+    int hour;
+    int minute;
+    int second;
+    if (!readDigits(p, 2, hour) || p[2] != ':' || !readDigits(p + 3, 2, minute) || p[5] != ':' || !readDigits(p + 6, 2, second) ||
+        hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+    seconds = hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+/**
+ * @brief Reads a fraction of a second after its '.'.
+ *
+ * @param p The first digit; advanced past the last one.
+ * @param end End of the text.
+ * @return The fraction in microseconds; digits beyond the sixth are ignored.
+ */
+inline int64_t readFraction(const char*& p, const char* end) {
+    int64_t micros = 0;
+    int digits = 0;
+    while (p < end && isDigit(*p)) {
+        if (digits < 6) {
+            micros = micros * 10 + (*p - '0');
+        }
+        digits++;
+        p++;
+    }
+    for (; digits < 6; ++digits) {
+        micros *= 10;
+    }
+    return micros;
+}
+
+/**
+ * @brief Reads a month abbreviation.
+ *
+ * @param p The text; at least 3 bytes must be available.
+ * @return The month, 1 to 12, or 0.
+ */
+inline int readMonth(const char* p) {
+    for (int i = 0; i < 12; ++i) {
+        if (std::memcmp(p, MONTHS + i * 3, 3) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads a UTC offset: `Z`, `+HH:MM`, `+HHMM` or `+HH`.
+ *
+ * @param p The text; advanced past the offset.
+ * @param end End of the text.
+ * @param offset Receives the offset in seconds.
+ * @return False if there is no offset; p is unchanged.
+ */
+inline bool readZone(const char*& p, const char* end, int& offset) {
+    if (p < end && (*p == 'Z' || *p == 'z')) {
+        offset = 0;
+        p++;
+        return true;
+    }
+    if (end - p < 3 || (*p != '+' && *p != '-')) {
+        return false;
+    }
+    int hours;
+    int minutes = 0;
+    if (!readDigits(p + 1, 2, hours) || hours > 23) {
+        return false;
+    }
+    const char* q = p + 3;
+    if (end - q >= 3 && *q == ':' && readDigits(q + 1, 2, minutes)) {
+        q += 3;
+    } else if (end - q >= 2 && readDigits(q, 2, minutes)) {
+        q += 2;
+    } else {
+        minutes = 0;
+    }
+    if (minutes > 59) {
+        return false;
+    }
+    offset = (hours * 60 + minutes) * 60 * (*p == '-' ? -1 : 1);
+    p = q;
+    return true;
+}
+
+} // namespace
+
+TimestampParser::TimestampParser()
+    : current(AUTO), pinned(false), lastOffset(0), cachedDate(-1), cachedDays(0), cachedHour(INT64_MIN), cachedOffset(0),
+      yearCheckedAt(0), currentYear(1970), currentMonth(1) {}
+
+/**
+ * @brief Constructs a parser for a strptime-like pattern.
+ *
+ * The pattern is compiled into steps once; `%T` and `%F` are expanded.
+ *
+ * @param pattern The pattern.
+ * @throws std::invalid_argument If the pattern has an unknown directive or no date.
+ */
+TimestampParser::TimestampParser(const std::string& pattern) : TimestampParser() {
+    current = CUSTOM;
+    pinned = true;
+    bool month = false;
+    bool day = false;
+    bool epoch = false;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') {
+            steps.push_back({0, pattern[i]});
+            continue;
+        }
+        if (++i == pattern.size()) {
+            throw std::invalid_argument("Timestamp pattern ends in '%': " + pattern);
+        }
+        char directive = pattern[i];
+        switch (directive) {
+            case 'T':
+                steps.insert(steps.end(), {{'H', 0}, {0, ':'}, {'M', 0}, {0, ':'}, {'S', 0}});
+                break;
+            case 'F':
+                steps.insert(steps.end(), {{'Y', 0}, {0, '-'}, {'m', 0}, {0, '-'}, {'d', 0}});
+                month = day = true;
+                break;
+            case '%':
+                steps.push_back({0, '%'});
+                break;
+            case 'Y': case 'y': case 'H': case 'M': case 'S': case 'f': case 'z':
+                steps.push_back({directive, 0});
+                break;
+            case 'm': case 'b':
+                steps.push_back({directive, 0});
+                month = true;
+                break;
+            case 'd': case 'e':
+                steps.push_back({directive, 0});
+                day = true;
+                break;
+            case 's':
+                steps.push_back({directive, 0});
+                epoch = true;
+                break;
+            default:
+                throw std::invalid_argument(std::string("Unknown timestamp directive %") + directive + " in: " + pattern);
+        }
+    }
+    if (!epoch && !(month && day)) {
+        throw std::invalid_argument("Timestamp pattern needs a month and a day, or %s: " + pattern);
+    }
+}
+
+/**
+ * @brief Finds the timestamp in a line.
+ *
+ * The current format is tried at the offset where it was last found, then
+ * at every other offset. Failing that, unless the format was configured,
+ * each built-in format is tried at each offset and the first match becomes
+ * the current format.
+ *
+ * @param line The line.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return False if no timestamp was found.
+ */
+bool TimestampParser::extract(std::string_view line, int64_t& timeUs) {
+    size_t limit = line.size();
+    if (limit > SCAN_LIMIT) {
+        limit = SCAN_LIMIT;
+    }
+    if (current != AUTO) {
+        if (lastOffset < limit && parseAt(current, line, lastOffset, timeUs) > 0) {
+            return true;
+        }
+        for (size_t i = 0; i < limit; ++i) {
+            if (i != lastOffset && parseAt(current, line, i, timeUs) > 0) {
+                lastOffset = i;
+                return true;
+            }
+        }
+        if (pinned) {
+            return false;
+        }
+    }
+    static const Format DETECTED[] = {ISO8601, APACHE, SYSLOG, EPOCH};
+    for (size_t i = 0; i < limit; ++i) {
+        for (Format format : DETECTED) {
+            if (format != current && parseAt(format, line, i, timeUs) > 0) {
+                current = format;
+                lastOffset = i;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Parses a timestamp at the start of a text.
+ *
+ * @param format The format; AUTO tries ISO8601, APACHE, SYSLOG and EPOCH in turn.
+ * @param text The text.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parse(Format format, std::string_view text, int64_t& timeUs) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    switch (format) {
+        case ISO8601: return parseIso(p, end, timeUs, false);
+        case RFC3339: return parseIso(p, end, timeUs, true);
+        case SYSLOG: return parseSyslog(p, end, timeUs);
+        case APACHE: return parseApache(p, end, timeUs);
+        case EPOCH: return parseEpoch(p, end, timeUs);
+        case CUSTOM: return steps.empty() ? 0 : parseCustom(p, end, timeUs);
+        case AUTO: break;
+    }
+    size_t used = parseIso(p, end, timeUs, false);
+    if (used == 0) {
+        used = parseApache(p, end, timeUs);
+    }
+    if (used == 0) {
+        used = parseSyslog(p, end, timeUs);
+    }
+    if (used == 0) {
+        used = parseEpoch(p, end, timeUs);
+    }
+    return used;
+}
+
+/**
+ * @brief Retrieves the name of a format.
+ *
+ * @param format The format.
+ * @return The name, in lower case.
+ */
+const char* TimestampParser::formatName(Format format) {
+    switch (format) {
+        case ISO8601: return "iso8601";
+        case SYSLOG: return "syslog";
+        case APACHE: return "apache";
+        case EPOCH: return "epoch";
+        case CUSTOM: return "custom";
+        case RFC3339: return "rfc3339";
+        case AUTO: break;
+    }
+    return "auto";
+}
+
+/**
+ * @brief Converts a civil date to seconds since the epoch (proleptic Gregorian calendar).
+ *
+ * @param year The year.
+ * @param month The month, 1 to 12.
+ * @param day The day, 1 to 31.
+ * @param seconds Seconds since midnight.
+ * @return Seconds since 1970-01-01.
+ */
+int64_t TimestampParser::civilToSeconds(int year, int month, int day, int64_t seconds) {
+    // Days from civil: counts from 0000-03-01 so the leap day ends the year
+    int64_t y = month <= 2 ? year - 1 : year;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yearOfEra = y - era * 400;
+    int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    int64_t days = era * 146097 + dayOfEra - 719468;
+    return days * 86400 + seconds;
+}
+
+/**
+ * @brief Checks whether a timestamp of a format can start at an offset.
+ *
+ * A cheap filter on the first byte and word boundary before the full parse.
+ *
+ * @param format The format.
+ * @param line The line.
+ * @param offset The offset, within the line.
+ * @return False if the format cannot start there.
+ */
+bool TimestampParser::startsAt(Format format, std::string_view line, size_t offset) {
+    char c = line[offset];
+    char before = offset > 0 ? line[offset - 1] : ' ';
+    switch (format) {
+        case ISO8601: case RFC3339: return isDigit(c) && !isAlnum(before);
+        case SYSLOG: return c >= 'A' && c <= 'S' && !isAlnum(before);
+        case APACHE: return isDigit(c) && before == '[';
+        case EPOCH: return isDigit(c) && !isAlnum(before) && before != '.' && before != '-';
+        case CUSTOM: case AUTO: break;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a timestamp of a format at an offset in a line.
+ *
+ * @param format The format.
+ * @param line The line.
+ * @param offset The offset, within the line.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parseAt(Format format, std::string_view line, size_t offset, int64_t& timeUs) {
+    if (!startsAt(format, line, offset)) {
+        return 0;
+    }
+    return parse(format, line.substr(offset), timeUs);
+}
+
+/**
+ * @brief Parses `YYYY-MM-DD(T| )HH:MM[:SS][(.|,)frac][zone]`, or strictly RFC 3339.
+ *
+ * Strict parsing accepts only RFC 3339's date-time: 'T' between date and
+ * time, seconds, '.' before a fraction and a zone of `Z` or `+HH:MM`.
+ *
+ * @param p The text.
+ * @param end End of the text.
+ * @param timeUs Receives microseconds since the epoch.
+ * @param strict Whether to accept only RFC 3339.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parseIso(const char* p, const char* end, int64_t& timeUs, bool strict) {
+    const char* start = p;
+    if (end - p < 16) {
+        return 0;
+    }
+    int year;
+    int month;
+    int day;
+    int hour;
+    int minute;
+    if (!readDigits(p, 4, year) || p[4] != '-' || !readDigits(p + 5, 2, month) || p[7] != '-' || !readDigits(p + 8, 2, day) ||
+        (p[10] != 'T' && p[10] != 't' && (strict || p[10] != ' ')) || !readDigits(p + 11, 2, hour) || p[13] != ':' || !readDigits(p + 14, 2, minute) ||
+        month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59) {
+        return 0;
+    }
+    p += 16;
+    int clock = hour * 3600 + minute * 60;
+    int second;
+    if (end - p >= 3 && *p == ':' && readDigits(p + 1, 2, second)) {
+        if (second > 60) {
+            return 0;
+        }
+        clock += second;
+        p += 3;
+    } else if (strict) {
+        return 0;
+    }
+    int64_t micros = 0;
+    if (end - p >= 2 && (*p == '.' || (!strict && *p == ',')) && isDigit(p[1])) {
+        p++;
+        micros = readFraction(p, end);
+    }
+    int offset;
+    if (strict) {
+        bool numeric = end - p >= 6 && (*p == '+' || *p == '-') && p[3] == ':';
+        if (!numeric && (p >= end || (*p != 'Z' && *p != 'z'))) {
+            return 0;
+        }
+        if (!readZone(p, end, offset)) {
+            return 0;
+        }
+        timeUs = (toSeconds(year, month, day, clock) - offset) * 1000000 + micros;
+        return static_cast<size_t>(p - start);
+    }
+    int64_t seconds = toSeconds(year, month, day, clock);
+    seconds = readZone(p, end, offset) ? seconds - offset : localToUtc(seconds);
+    timeUs = seconds * 1000000 + micros;
+    return static_cast<size_t>(p - start);
+}
+
+/**
+ * @brief Parses RFC 3164's `Mmm dd hh:mm:ss`, with an optional fraction and an optional year before or after the time.
+ *
+ * A year after the time (`Mar 14 09:26:53 2025`, as Cisco devices write it)
+ * must be a whole word between 1970 and 2099, so a numeric hostname is not
+ * mistaken for it.
+ *
+ * @param p The text.
+ * @param end End of the text.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parseSyslog(const char* p, const char* end, int64_t& timeUs) {
+    const char* start = p;
+    if (end - p < 15) {
+        return 0;
+    }
+    int month = readMonth(p);
+    if (month == 0 || p[3] != ' ') {
+        return 0;
+    }
+    int day;
+    if (p[4] == ' ' ? !readDigits(p + 5, 1, day) : !readDigits(p + 4, 2, day)) {
+        return 0;
+    }
+    p += 6;
+    if (day < 1 || day > 31 || *p != ' ') {
+        return 0;
+    }
+    p++;
+    int year = 0;
+    int explicitYear;
+    if (end - p >= 13 && p[4] == ' ' && readDigits(p, 4, explicitYear)) {
+        year = explicitYear;
+        p += 5;
+    }
+    int clock;
+    if (end - p < 8 || !readClock(p, clock)) {
+        return 0;
+    }
+    p += 8;
+    int64_t micros = 0;
+    if (p < end && *p == '.') {
+        p++;
+        micros = readFraction(p, end);
+    }
+    if (year == 0 && end - p >= 5 && *p == ' ' && readDigits(p + 1, 4, explicitYear) &&
+        explicitYear >= 1970 && explicitYear <= 2099 && (end - p == 5 || p[5] == ' ')) {
+        year = explicitYear;
+        p += 5;
+    }
+    if (year == 0) {
+        year = inferYear(month);
+    }
+    timeUs = localToUtc(toSeconds(year, month, day, clock)) * 1000000 + micros;
+    return static_cast<size_t>(p - start);
+}
+
+/**
+ * @brief Parses `dd/Mmm/yyyy:hh:mm:ss[ +zzzz]`.
+ *
+ * @param p The text.
+ * @param end End of the text.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parseApache(const char* p, const char* end, int64_t& timeUs) {
+    const char* start = p;
+    if (end - p < 20) {
+        return 0;
+    }
+    int day;
+    int year;
+    int clock;
+    if (!readDigits(p, 2, day) || p[2] != '/' || p[6] != '/' || !readDigits(p + 7, 4, year) || p[11] != ':' || !readClock(p + 12, clock) ||
+        day < 1 || day > 31) {
+        return 0;
+    }
+    int month = readMonth(p + 3);
+    if (month == 0) {
+        return 0;
+    }
+    p += 20;
+    int64_t seconds = toSeconds(year, month, day, clock);
+    int offset;
+    const char* zone = p + 1;
+    if (end - p >= 6 && *p == ' ' && (*zone == '+' || *zone == '-') && readZone(zone, end, offset)) {
+        p = zone;
+        seconds -= offset;
+    } else {
+        seconds = localToUtc(seconds);
+    }
+    timeUs = seconds * 1000000;
+    return static_cast<size_t>(p - start);
+}
+
+/**
+ * @brief Parses epoch seconds (10 digits, optional fraction), milliseconds (13), microseconds (16) or nanoseconds (19).
+ *
+ * Only times between 2000 and 2100 are accepted, which keeps counters and
+ * ids from being taken for timestamps.
+ *
+ * @param p The text.
+ * @param end End of the text.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parseEpoch(const char* p, const char* end, int64_t& timeUs) {
+    const char* start = p;
+    // Unsigned, since 19 digits can exceed INT64_MAX; longer runs stop accumulating
+    uint64_t value = 0;
+    int digits = 0;
+    while (p < end && isDigit(*p)) {
+        if (digits < 19) {
+            value = value * 10 + (*p - '0');
+        }
+        p++;
+        digits++;
+    }
+    int64_t micros = 0;
+    switch (digits) {
+        case 10:
+            if (end - p >= 2 && *p == '.' && isDigit(p[1])) {
+                p++;
+                micros = readFraction(p, end);
+            }
+            micros += static_cast<int64_t>(value) * 1000000;
+            break;
+        case 13: micros = static_cast<int64_t>(value) * 1000; break;
+        case 16: micros = static_cast<int64_t>(value); break;
+        case 19: micros = static_cast<int64_t>(value / 1000); break;
+        default: return 0;
+    }
+    if (p < end && isAlnum(*p)) {
+        return 0;
+    }
+    if (micros / 1000000 < EPOCH_MIN || micros / 1000000 >= EPOCH_MAX) {
+        return 0;
+    }
+    timeUs = micros;
+    return static_cast<size_t>(p - start);
+}
+
+/**
+ * @brief Parses the text with the compiled pattern.
+ *
+ * @param p The text.
+ * @param end End of the text.
+ * @param timeUs Receives microseconds since the epoch.
+ * @return Bytes used, or 0.
+ */
+size_t TimestampParser::parseCustom(const char* p, const char* end, int64_t& timeUs) {
+    const char* start = p;
+    int year = 0;
+    int month = 1;
+    int day = 1;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    int64_t micros = 0;
+    int offset = 0;
+    bool zoned = false;
+    int64_t epoch = -1;
+    for (const Step& step : steps) {
+        bool ok = true;
+        switch (step.directive) {
+            case 0:
+                ok = p < end && *p == step.literal;
+                p += ok;
+                break;
+            case 'Y':
+                ok = end - p >= 4 && readDigits(p, 4, year);
+                p += ok ? 4 : 0;
+                break;
+            case 'y':
+                ok = end - p >= 2 && readDigits(p, 2, year);
+                year += year < 69 ? 2000 : 1900;
+                p += ok ? 2 : 0;
+                break;
+            case 'm': ok = readNumber(p, end, month); break;
+            case 'e':
+                if (p < end && *p == ' ') {
+                    p++;
+                }
+                ok = readNumber(p, end, day);
+                break;
+            case 'd': ok = readNumber(p, end, day); break;
+            case 'H': ok = readNumber(p, end, hour); break;
+            case 'M': ok = readNumber(p, end, minute); break;
+            case 'S': ok = readNumber(p, end, second); break;
+            case 'f':
+                ok = p < end && isDigit(*p);
+                micros = readFraction(p, end);
+                break;
+            case 'b':
+                ok = end - p >= 3 && (month = readMonth(p)) != 0;
+                p += ok ? 3 : 0;
+                break;
+            case 'z':
+                ok = readZone(p, end, offset);
+                zoned = true;
+                break;
+            case 's':
+                ok = p < end && isDigit(*p);
+                for (epoch = 0; ok && p < end && isDigit(*p) && epoch < INT64_MAX / 10 / 1000000; ++p) {
+                    epoch = epoch * 10 + (*p - '0');
+                }
+                break;
+        }
+        if (!ok) {
+            return 0;
+        }
+    }
+    if (epoch >= 0) {
+        timeUs = epoch * 1000000 + micros;
+        return static_cast<size_t>(p - start);
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return 0;
+    }
+    if (year == 0) {
+        year = inferYear(month);
+    }
+    int64_t seconds = toSeconds(year, month, day, hour * 3600 + minute * 60 + second);
+    seconds = zoned ? seconds - offset : localToUtc(seconds);
+    timeUs = seconds * 1000000 + micros;
+    return static_cast<size_t>(p - start);
+}
+
+/**
+ * @brief Converts a civil date and time to seconds since the epoch, reusing the last date's day number.
+ *
+ * @param year The year, 0 to 9999.
+ * @param month The month, 1 to 12.
+ * @param day The day, 1 to 31.
+ * @param seconds Seconds since midnight.
+ * @return Seconds since 1970-01-01 in the same time zone as the input.
+ */
+int64_t TimestampParser::toSeconds(int year, int month, int day, int64_t seconds) {
+    int date = year * 10000 + month * 100 + day;
+    if (date != cachedDate) {
+        cachedDays = civilToSeconds(year, month, day, 0) / 86400;
+        cachedDate = date;
+    }
+    return cachedDays * 86400 + seconds;
+}
+
+/**
+ * @brief Converts local seconds since the epoch to UTC, caching the offset per local hour.
+ *
+ * @param localSeconds Local civil time as seconds since the epoch.
+ * @return Seconds since the epoch.
+ */
+int64_t TimestampParser::localToUtc(int64_t localSeconds) {
+    int64_t hour = localSeconds >= 0 ? localSeconds / 3600 : (localSeconds - 3599) / 3600;
+    if (hour != cachedHour) {
+        std::tm local;
+        std::time_t guess = static_cast<std::time_t>(localSeconds);
+        localtime_r(&guess, &local);
+        guess = static_cast<std::time_t>(localSeconds - local.tm_gmtoff);
+        localtime_r(&guess, &local);
+        cachedHour = hour;
+        cachedOffset = local.tm_gmtoff;
+    }
+    return localSeconds - cachedOffset;
+}
+
+/**
+ * @brief Chooses the year for a date written without one.
+ *
+ * The current local year and month are refreshed at most once a minute. A
+ * month more than one ahead of now is last year's, e.g. December lines read
+ * in January; January read in December is next year's.
+ *
+ * @param month The date's month.
+ * @return The year.
+ */
+int TimestampParser::inferYear(int month) {
+    std::time_t now = std::time(nullptr);
+    if (now - yearCheckedAt >= 60) {
+        std::tm local;
+        localtime_r(&now, &local);
+        currentYear = local.tm_year + 1900;
+        currentMonth = local.tm_mon + 1;
+        yearCheckedAt = now;
+    }
+    if (month > currentMonth + 1) {
+        return currentYear - 1;
+    }
+    if (month == 1 && currentMonth == 12) {
+        return currentYear + 1;
+    }
+    return currentYear;
+}
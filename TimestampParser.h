@@ -0,0 +1,151 @@
+#ifndef TIMESTAMPPARSER_H
+#define TIMESTAMPPARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+
+/**
+ * @class TimestampParser
+ * @brief Finds and decodes the event time in a log line without strptime().
+ *
+ * Built-in formats:
+ * - ISO8601: `YYYY-MM-DD(T| )HH:MM[:SS][(.|,)frac][Z|+HH:MM|+HHMM|+HH]`
+ * - RFC3339: the strict subset `YYYY-MM-DDTHH:MM:SS[.frac](Z|+HH:MM)`, with
+ *   seconds and a zone required; never detected, only parsed on request
+ * - SYSLOG: `Mmm dd [yyyy ]hh:mm:ss[.frac][ yyyy]`; without a year, the one
+ *   that puts the time closest to now
+ * - APACHE: `dd/Mmm/yyyy:hh:mm:ss[ +zzzz]`, as written inside `[...]` by
+ *   Apache and nginx
+ * - EPOCH: 10-digit seconds with an optional fraction, or 13, 16 or 19
+ *   digits of milliseconds, microseconds or nanoseconds
+ * - CUSTOM: a strptime-like pattern, see TimestampParser(const std::string&)
+ *
+ * Times without a zone are local. The UTC offset is looked up once per
+ * local hour and the day number of the last date is kept, so consecutive
+ * lines from the same hour cost only digit arithmetic.
+ *
+ * A parser built without a pattern detects the format on the first line
+ * with a timestamp and then looks for that format, first at the offset
+ * where it was last found; it detects again when a line no longer has it.
+ * Only the first SCAN_LIMIT bytes of a line are searched.
+ *
+ * Not thread-safe; each monitor has its own parser, so the format is
+ * detected per source.
+ */
+class TimestampParser {
+public:
+    /// Bytes of a line searched for a timestamp.
+    static const size_t SCAN_LIMIT = 256;
+
+    /**
+     * @brief Timestamp formats.
+     */
+    enum Format {
+        AUTO,    ///< Not detected yet
+        ISO8601, ///< ISO 8601 / RFC 3339
+        SYSLOG,  ///< RFC 3164
+        APACHE,  ///< Apache and nginx access logs
+        EPOCH,   ///< Seconds or sub-seconds since the epoch
+        CUSTOM,  ///< The parser's pattern
+        RFC3339  ///< Strict RFC 3339, as RFC 5424 requires
+    };
+
+    /**
+     * @brief Constructs a parser that detects the format.
+     */
+    TimestampParser();
+
+    /**
+     * @brief Constructs a parser for a strptime-like pattern.
+     *
+     * Directives: `%Y` (4-digit year), `%y` (2-digit year, 1969-2068), `%m`,
+     * `%d`, `%e` (space-padded day), `%H`, `%M`, `%S`, `%f` (fraction
+     * digits), `%b` (month abbreviation), `%z` (`Z`, `+HH:MM`, `+HHMM` or
+     * `+HH`), `%s` (epoch seconds), `%T` (`%H:%M:%S`), `%F` (`%Y-%m-%d`) and
+     * `%%`. Other characters must match exactly. Without `%Y` or `%y` the year
+     * is inferred as for SYSLOG; without `%z` the time is local.
+     *
+     * @param pattern The pattern.
+     * @throws std::invalid_argument If the pattern has an unknown directive or no date.
+     */
+    explicit TimestampParser(const std::string& pattern);
+
+    /**
+     * @brief Finds the timestamp in a line.
+     * @param line The line.
+     * @param timeUs Receives microseconds since the epoch; unchanged if none is found.
+     * @return False if the line has no timestamp in the format.
+     */
+    bool extract(std::string_view line, int64_t& timeUs);
+
+    /**
+     * @brief Parses a timestamp at the start of a text.
+     * @param format The format; AUTO tries each built-in format.
+     * @param text The text.
+     * @param timeUs Receives microseconds since the epoch.
+     * @return Bytes used, or 0 if the text does not start with a timestamp.
+     */
+    size_t parse(Format format, std::string_view text, int64_t& timeUs);
+
+    /**
+     * @brief Retrieves the format in use.
+     * @return The detected or configured format; AUTO until one is detected.
+     */
+    Format format() const { return current; }
+
+    /**
+     * @brief Retrieves the name of a format.
+     * @param format The format.
+     * @return "iso8601", "syslog", "apache", "epoch", "custom", "rfc3339" or "auto".
+     */
+    static const char* formatName(Format format);
+
+    /**
+     * @brief Converts a civil date and time to seconds since the epoch.
+     * @param year The year.
+     * @param month The month, 1 to 12.
+     * @param day The day, 1 to 31.
+     * @param seconds Seconds since midnight.
+     * @return Seconds since 1970-01-01T00:00:00 in the same time zone as the input.
+     */
+    static int64_t civilToSeconds(int year, int month, int day, int64_t seconds);
+
+private:
+    /**
+     * @brief A step of a compiled pattern: a directive, or a literal byte when `directive` is 0.
+     */
+    struct Step {
+        char directive; ///< The directive letter, or 0.
+        char literal; ///< The byte to match when directive is 0.
+    };
+
+    static bool startsAt(Format format, std::string_view line, size_t offset);
+    size_t parseIso(const char* p, const char* end, int64_t& timeUs, bool strict);
+    size_t parseSyslog(const char* p, const char* end, int64_t& timeUs);
+    size_t parseApache(const char* p, const char* end, int64_t& timeUs);
+    static size_t parseEpoch(const char* p, const char* end, int64_t& timeUs);
+    size_t parseCustom(const char* p, const char* end, int64_t& timeUs);
+    size_t parseAt(Format format, std::string_view line, size_t offset, int64_t& timeUs);
+    int64_t toSeconds(int year, int month, int day, int64_t seconds);
+    int64_t localToUtc(int64_t localSeconds);
+    int inferYear(int month);
+
+    Format current; ///< Detected or configured format.
+    bool pinned; ///< Whether the format was configured and is never re-detected.
+    std::vector<Step> steps; ///< The compiled pattern for CUSTOM.
+    size_t lastOffset; ///< Offset in the line where the timestamp was last found.
+    int cachedDate; ///< Last date converted, as YYYYMMDD, or -1.
+    int64_t cachedDays; ///< Days since the epoch of cachedDate.
+    int64_t cachedHour; ///< Local hour (seconds / 3600) whose offset is cached, or INT64_MIN.
+    int64_t cachedOffset; ///< UTC offset of cachedHour, in seconds.
+    std::time_t yearCheckedAt; ///< Wall-clock second when currentYear was last derived.
+    int currentYear; ///< The local year now.
+    int currentMonth; ///< The local month now, 1 to 12.
+};
+
+#endif
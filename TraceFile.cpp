@@ -0,0 +1,335 @@
+#include "TraceFile.h"
+#include <fcntl.h>                 // Used for open()
+#include <unistd.h>                // Used for write(), ftruncate() and close()
+#include <stdexcept>               // Used for std::runtime_error
+#include <cstring>                 // Used for strerror() and memcmp()
+#include <algorithm>               // Used for std::count
+#include <thread>                  // Used for std::this_thread::sleep_until
+#include <chrono>                  // Used for replay timing
+#include <errno.h>                 // Used for errno
+
+namespace {
+
+/// Record types.
+const uint8_t RECORD_FILE = 1;
+const uint8_t RECORD_WRITE = 2;
+const uint8_t RECORD_TRUNCATE = 3;
+
+/// Length of the magic, without its terminating NUL.
+const size_t MAGIC_LENGTH = sizeof(TRACE_FILE_MAGIC) - 1;
+
+/// Longest path or write a reader accepts, to fail fast on a corrupt length.
+const uint64_t MAX_RECORD_LENGTH = 1ULL << 30;
+
+} // namespace
+
+/**
+ * @brief Creates a trace file and writes its magic.
+ *
+ * @param path The trace file; an existing file is overwritten.
+ *
+ * @throws std::runtime_error If the file cannot be created.
+ */
+TraceWriter::TraceWriter(const std::string& path)
+    : out(path, std::ios::binary | std::ios::trunc), lastTime(0) {
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to create trace file " + path + ": " + strerror(errno));
+    }
+    out.write(TRACE_FILE_MAGIC, MAGIC_LENGTH);
+}
+
+/**
+ * @brief Flushes the trace; the stream closes itself.
+ */
+TraceWriter::~TraceWriter() {
+    flush();
+}
+
+/**
+ * @brief Records data appended to a file.
+ *
+ * @param file The file's path; its FILE record is written the first time it appears.
+ * @param time When the data was written.
+ * @param data The data.
+ * @param length Its length in bytes.
+ */
+void TraceWriter::write(const std::string& file, int64_t time, const char* data, size_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeHeader(RECORD_WRITE, fileId(file), time);
+    writeVarint(length);
+    out.write(data, static_cast<std::streamsize>(length));
+}
+
+/**
+ * @brief Records that a file was truncated.
+ *
+ * @param file The file's path.
+ * @param time When the truncation was noticed.
+ */
+void TraceWriter::truncate(const std::string& file, int64_t time) {
+    std::lock_guard<std::mutex> lock(mutex);
+    writeHeader(RECORD_TRUNCATE, fileId(file), time);
+}
+
+/**
+ * @brief Writes buffered records to disk.
+ */
+void TraceWriter::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.flush();
+}
+
+/**
+ * @brief Looks up a file's ID, writing a FILE record for a new file.
+ *
+ * @param file The file's path.
+ * @return The ID.
+ */
+uint32_t TraceWriter::fileId(const std::string& file) {
+    auto it = ids.find(file);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(ids.size());
+    ids[file] = id;
+    out.put(static_cast<char>(RECORD_FILE));
+    writeVarint(id);
+    writeVarint(file.size());
+    out.write(file.data(), static_cast<std::streamsize>(file.size()));
+    return id;
+}
+
+/**
+ * @brief Writes the type, file ID and time delta of a WRITE or TRUNCATE record.
+ *
+ * Monitors stamp their records before taking the lock, so a record may carry
+ * a slightly earlier time than the previous one; its delta is then 0.
+ *
+ * @param type The record type.
+ * @param id The file ID.
+ * @param time The record's time.
+ */
+void TraceWriter::writeHeader(uint8_t type, uint32_t id, int64_t time) {
+    if (lastTime == 0) {
+        lastTime = time;
+    }
+    int64_t delta = time > lastTime ? time - lastTime : 0;
+    lastTime = std::max(lastTime, time);
+    out.put(static_cast<char>(type));
+    writeVarint(id);
+    writeVarint(static_cast<uint64_t>(delta));
+}
+
+/**
+ * @brief Writes an unsigned LEB128 varint.
+ *
+ * @param value The value.
+ */
+void TraceWriter::writeVarint(uint64_t value) {
+    while (value >= 0x80) {
+        out.put(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.put(static_cast<char>(value));
+}
+
+/**
+ * @brief Opens a trace and checks its magic.
+ *
+ * @param path The trace file.
+ *
+ * @throws std::runtime_error If the file cannot be opened or does not start with the magic.
+ */
+TraceReader::TraceReader(const std::string& path)
+    : in(path, std::ios::binary), time(0), skipData(false) {
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open trace file " + path + ": " + strerror(errno));
+    }
+    char magic[MAGIC_LENGTH];
+    if (!in.read(magic, MAGIC_LENGTH) || std::memcmp(magic, TRACE_FILE_MAGIC, MAGIC_LENGTH) != 0) {
+        throw std::runtime_error("Not a capture trace: " + path);
+    }
+}
+
+/**
+ * @brief Reads the next WRITE or TRUNCATE record, handling FILE records on the way.
+ *
+ * @param record Receives the record.
+ * @return False at the end of the trace.
+ *
+ * @throws std::runtime_error If a record is corrupt or cut short.
+ */
+bool TraceReader::next(Record& record) {
+    while (true) {
+        int type = in.get();
+        if (type == std::char_traits<char>::eof()) {
+            return false;
+        }
+        uint64_t id = requireVarint();
+        if (type == RECORD_FILE) {
+            uint64_t length = requireVarint();
+            if (id != paths.size() || length > MAX_RECORD_LENGTH) {
+                throw std::runtime_error("Corrupt capture trace: bad file record");
+            }
+            std::string path(length, '\0');
+            if (!in.read(&path[0], static_cast<std::streamsize>(length))) {
+                throw std::runtime_error("Capture trace is cut short");
+            }
+            paths.push_back(path);
+            continue;
+        }
+        if ((type != RECORD_WRITE && type != RECORD_TRUNCATE) || id >= paths.size()) {
+            throw std::runtime_error("Corrupt capture trace: bad record type or file ID");
+        }
+        time += static_cast<int64_t>(requireVarint());
+        record.fileId = static_cast<uint32_t>(id);
+        record.offsetNanos = time;
+        record.data.clear();
+        if (type == RECORD_TRUNCATE) {
+            record.type = Record::TRUNCATE;
+            return true;
+        }
+        record.type = Record::WRITE;
+        uint64_t length = requireVarint();
+        if (length > MAX_RECORD_LENGTH) {
+            throw std::runtime_error("Corrupt capture trace: bad write length");
+        }
+        if (skipData) {
+            in.seekg(static_cast<std::streamoff>(length), std::ios::cur);
+        } else {
+            record.data.resize(length);
+            in.read(&record.data[0], static_cast<std::streamsize>(length));
+        }
+        if (!in) {
+            throw std::runtime_error("Capture trace is cut short");
+        }
+        return true;
+    }
+}
+
+/**
+ * @brief Lists every file in a trace, seeking over the data.
+ *
+ * @param path The trace file.
+ * @return The paths, indexed by file ID.
+ *
+ * @throws std::runtime_error If the trace cannot be read.
+ */
+std::vector<std::string> TraceReader::listFiles(const std::string& path) {
+    TraceReader reader(path);
+    reader.skipData = true;
+    Record record;
+    while (reader.next(record)) {
+    }
+    return reader.paths;
+}
+
+/**
+ * @brief Reads an unsigned LEB128 varint.
+ *
+ * @param value Receives the value.
+ * @return False if the trace ended or the varint is longer than 64 bits.
+ */
+bool TraceReader::readVarint(uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = in.get();
+        if (byte == std::char_traits<char>::eof()) {
+            return false;
+        }
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads a varint that must be present.
+ *
+ * @return The value.
+ *
+ * @throws std::runtime_error If the trace ends inside the record.
+ */
+uint64_t TraceReader::requireVarint() {
+    uint64_t value;
+    if (!readVarint(value)) {
+        throw std::runtime_error("Capture trace is cut short");
+    }
+    return value;
+}
+
+/**
+ * @brief Opens a trace and creates an empty target file for each traced file.
+ *
+ * @param tracePath The trace file.
+ * @param dir The directory to replay into.
+ * @param speed Time scale; 0 for as fast as possible.
+ *
+ * @throws std::runtime_error If the trace cannot be read or a target cannot be created.
+ */
+TraceReplayer::TraceReplayer(const std::string& tracePath, const std::string& dir, double speed)
+    : reader(tracePath), speed(speed), lines(0), bytes(0) {
+    std::vector<std::string> files = TraceReader::listFiles(tracePath);
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string base = files[i].substr(files[i].rfind('/') + 1);
+        targetPaths.push_back(dir + "/" + std::to_string(i) + "-" + base);
+        int fd = open(targetPaths.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::string error = strerror(errno);
+            for (int created : fds) {
+                close(created);
+            }
+            throw std::runtime_error("Failed to create " + targetPaths.back() + ": " + error);
+        }
+        fds.push_back(fd);
+    }
+}
+
+/**
+ * @brief Closes the target files.
+ */
+TraceReplayer::~TraceReplayer() {
+    for (int fd : fds) {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Replays every record, sleeping until each one is due at the configured speed.
+ *
+ * A writer that falls behind does not sleep until it has caught up, so the
+ * replay never takes longer than the writes themselves.
+ *
+ * @throws std::runtime_error If the trace is corrupt or a target cannot be written.
+ */
+void TraceReplayer::run() {
+    auto start = std::chrono::steady_clock::now();
+    TraceReader::Record record;
+    while (reader.next(record)) {
+        if (speed > 0) {
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<int64_t>(record.offsetNanos / speed)));
+        }
+        int fd = fds[record.fileId];
+        if (record.type == TraceReader::Record::TRUNCATE) {
+            if (ftruncate(fd, 0) < 0) {
+                throw std::runtime_error("Failed to truncate " + targetPaths[record.fileId] + ": " + strerror(errno));
+            }
+            continue;
+        }
+        size_t written = 0;
+        while (written < record.data.size()) {
+            ssize_t n = ::write(fd, record.data.data() + written, record.data.size() - written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw std::runtime_error("Failed to write " + targetPaths[record.fileId] + ": " + strerror(errno));
+            }
+            written += static_cast<size_t>(n);
+        }
+        lines += static_cast<uint64_t>(std::count(record.data.begin(), record.data.end(), '\n'));
+        bytes += record.data.size();
+    }
+}
@@ -0,0 +1,197 @@
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+
+/**
+ * @brief Magic bytes at the start of a capture trace.
+ */
+const char TRACE_FILE_MAGIC[] = "SPKYTRC1";
+
+/**
+ * @class TraceWriter
+ * @brief Records the data read from monitored files, with its timing, into a capture trace.
+ *
+ * A trace is the magic followed by records, each a type byte and varints:
+ * - FILE: file ID, path length, path; precedes the file's first write
+ * - WRITE: file ID, nanoseconds since the previous record, length, data
+ * - TRUNCATE: file ID, nanoseconds since the previous record
+ *
+ * Times are deltas, so a steady stream of small writes costs a few bytes of
+ * framing per write. Monitors on several threads may share one writer.
+ */
+class TraceWriter {
+public:
+    /**
+     * @brief Creates (or overwrites) a trace file.
+     * @param path The trace file.
+     * @throws std::runtime_error If the file cannot be created.
+     */
+    explicit TraceWriter(const std::string& path);
+
+    /**
+     * @brief Flushes and closes the trace.
+     */
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    /**
+     * @brief Records data appended to a file.
+     * @param file The file's path.
+     * @param time When the data was written, from LatencyTracker::now().
+     * @param data The data.
+     * @param length Its length in bytes.
+     */
+    void write(const std::string& file, int64_t time, const char* data, size_t length);
+
+    /**
+     * @brief Records that a file was truncated.
+     * @param file The file's path.
+     * @param time When the truncation was noticed.
+     */
+    void truncate(const std::string& file, int64_t time);
+
+    /**
+     * @brief Writes buffered records to disk.
+     */
+    void flush();
+
+private:
+    uint32_t fileId(const std::string& file);
+    void writeHeader(uint8_t type, uint32_t id, int64_t time);
+    void writeVarint(uint64_t value);
+
+    std::mutex mutex; ///< Serializes records from several monitors.
+    std::ofstream out; ///< The trace file.
+    std::map<std::string, uint32_t> ids; ///< File IDs by path.
+    int64_t lastTime; ///< Time of the previous record; 0 before the first.
+};
+
+/**
+ * @class TraceReader
+ * @brief Reads a capture trace record by record.
+ */
+class TraceReader {
+public:
+    /**
+     * @brief A write or truncation read from a trace.
+     */
+    struct Record {
+        enum Type {
+            WRITE,   ///< Data was appended.
+            TRUNCATE ///< The file was truncated.
+        };
+        Type type; ///< What happened.
+        uint32_t fileId; ///< Index into files().
+        int64_t offsetNanos; ///< Time since the first record.
+        std::string data; ///< The data appended; empty for TRUNCATE.
+    };
+
+    /**
+     * @brief Opens a trace.
+     * @param path The trace file.
+     * @throws std::runtime_error If the file cannot be opened or is not a trace.
+     */
+    explicit TraceReader(const std::string& path);
+
+    /**
+     * @brief Reads the next write or truncation.
+     * @param record Receives the record.
+     * @return False at the end of the trace.
+     * @throws std::runtime_error If the trace is corrupt or cut short.
+     */
+    bool next(Record& record);
+
+    /**
+     * @brief Retrieves the paths of the files seen so far, indexed by file ID.
+     * @return The paths.
+     */
+    const std::vector<std::string>& files() const { return paths; }
+
+    /**
+     * @brief Lists every file in a trace without reading the data.
+     * @param path The trace file.
+     * @return The paths, indexed by file ID.
+     * @throws std::runtime_error If the trace cannot be read.
+     */
+    static std::vector<std::string> listFiles(const std::string& path);
+
+private:
+    bool readVarint(uint64_t& value);
+    uint64_t requireVarint();
+
+    std::ifstream in; ///< The trace file.
+    std::vector<std::string> paths; ///< File paths by ID.
+    int64_t time; ///< Time of the last record since the first.
+    bool skipData; ///< Seek over data instead of reading it (listFiles()).
+};
+
+/**
+ * @class TraceReplayer
+ * @brief Re-creates the writes of a capture trace in a directory.
+ *
+ * Each traced file is replayed to `DIR/<id>-<basename>`, created empty by
+ * the constructor so monitors can watch it before the replay starts.
+ */
+class TraceReplayer {
+public:
+    /**
+     * @brief Opens a trace and creates the files it will be replayed to.
+     * @param tracePath The trace file.
+     * @param dir The directory to replay into; must exist.
+     * @param speed Time scale: 1 replays in real time, 10 ten times faster, 0 as fast as possible.
+     * @throws std::runtime_error If the trace cannot be read or a file cannot be created.
+     */
+    TraceReplayer(const std::string& tracePath, const std::string& dir, double speed);
+
+    /**
+     * @brief Closes the replayed files.
+     */
+    ~TraceReplayer();
+
+    TraceReplayer(const TraceReplayer&) = delete;
+    TraceReplayer& operator=(const TraceReplayer&) = delete;
+
+    /**
+     * @brief Retrieves the files the trace is replayed to.
+     * @return The paths, indexed by file ID.
+     */
+    const std::vector<std::string>& targets() const { return targetPaths; }
+
+    /**
+     * @brief Replays the whole trace.
+     * @throws std::runtime_error If the trace is corrupt.
+     */
+    void run();
+
+    /**
+     * @brief Retrieves the number of complete lines written so far.
+     * @return The count of newlines written.
+     */
+    uint64_t linesWritten() const { return lines; }
+
+    /**
+     * @brief Retrieves the number of bytes written so far.
+     * @return The byte count.
+     */
+    uint64_t bytesWritten() const { return bytes; }
+
+private:
+    TraceReader reader; ///< The trace.
+    double speed; ///< Time scale; 0 for as fast as possible.
+    std::vector<std::string> targetPaths; ///< Replayed files by ID.
+    std::vector<int> fds; ///< Open replayed files by ID.
+    uint64_t lines; ///< Newlines written.
+    uint64_t bytes; ///< Bytes written.
+};
+
+#endif
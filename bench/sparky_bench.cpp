@@ -0,0 +1,777 @@
+//
+// Microbenchmarks for the FileMonitor hot path.
+//
+// Build with the sparky_bench line in cpp_compiler_commands.txt and run e.g.
+//   ./sparky_bench --benchmark_filter=FormatMessage
+//
+// Benchmarks taking (line length, escape density) arguments use lines of that
+// many bytes where the given percentage of bytes are characters JSON must
+// escape (quotes, backslashes, tabs).
+//
+// The Extract benchmarks compare field extraction with RE2 (FieldExtractor)
+// against std::regex on sshd and firewall lines; argument 0 extracts every
+// field, 1 only the first, as when routing needs a single field.
+//
+// The Prefilter benchmarks match a line against a rule set of 10 to 1000
+// patterns, once through PatternPrefilter and once by running every regex.
+//
+// The Json benchmarks parse a 64 MiB NDJSON buffer of application log lines
+// per iteration, and compare merging a JSON line into the envelope with
+// wrapping it as an escaped string.
+//
+// The LineParse benchmarks parse firewall and EDR lines per format (0 key=value,
+// 1 CEF, 2 LEEF); argument 1 also appends the decoded fields as JSON.
+//
+// The Syslog benchmarks decode the headers of bench/corpus/syslog.log (RFC 3164
+// with and without PRI, rsyslog high-precision and RFC 5424 lines), so run
+// them from the repository root.
+//
+// The Timestamp benchmarks extract the event time from lines per format
+// (0 ISO 8601 without zone, 1 syslog, 2 Apache, 3 epoch milliseconds, 4 the
+// custom pattern "%d/%m/%Y %T"); formats 0 to 3 are detected.
+//
+// The AccessLog benchmarks use combined-format lines: AccessLogParse parses
+// them into a batch, AccessLogEncode sends 1024-row batches as verbatim
+// envelopes (0), typed JSON rows (1) or one columnar batch (2) and reports
+// the output bytes per line.
+//
+// Built with -DSPARKY_ALLOC_ACCOUNTING (on every source file), each benchmark
+// also reports heap allocations and allocated bytes per item.
+//
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <regex>
+#include <fstream>
+#include <cstdio>
+#include "FileMonitor.h"
+#include "KafkaSink.h"
+#include "FieldExtractor.h"
+#include "PatternPrefilter.h"
+#include "HashSampler.h"
+#include "JsonLogParser.h"
+#include "KeyValueParser.h"
+#include "SyslogParser.h"
+#include "TimestampParser.h"
+#include "AccessLogBatch.h"
+#include "AllocationAccounting.h"
+
+namespace {
+
+/**
+ * @brief Builds a deterministic printable line with the given share of JSON-escaped characters.
+ *
+ * @param length Line length in bytes.
+ * @param escapePercent Percentage of bytes that need escaping.
+ * @param seed Seed for the generator, so runs are comparable.
+ * @return The line, without a trailing newline.
+ */
+std::string makeLine(size_t length, int escapePercent, unsigned seed = 42) {
+    static const char escaped[] = {'"', '\\', '\t'};
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> printable('a', 'z');
+    std::string line;
+    line.reserve(length);
+    for (size_t i = 0; i < length; ++i) {
+        if (percent(rng) < escapePercent) {
+            line += escaped[rng() % sizeof(escaped)];
+        } else {
+            line += static_cast<char>(printable(rng));
+        }
+    }
+    return line;
+}
+
+/**
+ * @brief Builds a chunk of newline-terminated lines, as read from a file.
+ *
+ * @param chunkSize Size of the chunk in bytes.
+ * @param lineLength Length of each line, excluding the newline.
+ * @return The chunk; the last line may be partial.
+ */
+std::string makeChunk(size_t chunkSize, size_t lineLength) {
+    std::string line = makeLine(lineLength, 0) + "\n";
+    std::string chunk;
+    chunk.reserve(chunkSize);
+    while (chunk.size() < chunkSize) {
+        chunk.append(line, 0, std::min(line.size(), chunkSize - chunk.size()));
+    }
+    return chunk;
+}
+
+/**
+ * @brief Reports allocations per item since construction as benchmark counters.
+ *
+ * Does nothing unless the build counts allocations.
+ */
+class AllocationCounter {
+public:
+    AllocationCounter() : start(AllocationAccounting::totals()) {}
+
+    /**
+     * @brief Sets the allocs/item and alloc_bytes/item counters.
+     *
+     * @param state The benchmark state.
+     * @param items Items processed since construction.
+     */
+    void report(benchmark::State& state, int64_t items) const {
+        if (!AllocationAccounting::enabled() || items <= 0) {
+            return;
+        }
+        AllocationAccounting::Totals used = AllocationAccounting::totals().since(start);
+        state.counters["allocs/item"] = static_cast<double>(used.allAllocations()) / items;
+        state.counters["alloc_bytes/item"] = static_cast<double>(used.allBytes()) / items;
+    }
+
+private:
+    AllocationAccounting::Totals start; ///< Totals when the benchmark loop started.
+};
+
+void lineArgs(benchmark::internal::Benchmark* bench) {
+    for (int length : {64, 256, 1024, 4096}) {
+        for (int escapePercent : {0, 5, 25}) {
+            bench->Args({length, escapePercent});
+        }
+    }
+}
+
+/**
+ * @brief A sourcetype with a sample line, its pattern and the fields it captures.
+ */
+struct ExtractionCase {
+    const char* sourcetype;
+    const char* line;
+    const char* pattern;
+    std::vector<std::string> fields;
+};
+
+/**
+ * @brief The sshd and firewall cases, indexed by benchmark argument.
+ */
+const ExtractionCase EXTRACTION_CASES[] = {
+    {"sshd",
+     "Mar 14 09:26:53 bastion sshd[24512]: Failed password for invalid user admin from 203.0.113.7 port 52144 ssh2",
+     "sshd\\[(?P<pid>\\d+)\\]: (?P<action>Failed|Accepted) (?P<method>\\S+) for (?:invalid user )?(?P<user>\\S+) from (?P<src_ip>[\\d.]+) port (?P<src_port>\\d+)",
+     {"src_ip", "user", "action", "method", "pid", "src_port"}},
+    {"firewall",
+     "Mar 14 09:26:54 gw01 kernel: [UFW BLOCK] IN=eth0 OUT= MAC=52:54:00:12:34:56 SRC=198.51.100.23 DST=192.0.2.10 LEN=60 TOS=0x00 PREC=0x00 TTL=52 ID=54321 DF PROTO=TCP SPT=44321 DPT=22 WINDOW=64240 RES=0x00 SYN URGP=0",
+     "\\[UFW (?P<action>\\w+)\\] IN=(?P<in>\\S*) OUT=(?P<out>\\S*) .*?SRC=(?P<src_ip>[\\d.]+) DST=(?P<dst_ip>[\\d.]+) .*?PROTO=(?P<proto>\\w+) SPT=(?P<src_port>\\d+) DPT=(?P<dst_port>\\d+)",
+     {"src_ip", "dst_ip", "dst_port", "action", "proto", "in", "out", "src_port"}},
+};
+
+/**
+ * @brief Rewrites an RE2 pattern with named groups for std::regex, which only has numbered ones.
+ *
+ * @param pattern The RE2 pattern.
+ * @param names Receives the group names in order.
+ * @return The pattern with `(?P<name>` turned into `(`.
+ */
+std::string toStdRegex(const std::string& pattern, std::vector<std::string>& names) {
+    std::string converted;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern.compare(i, 4, "(?P<") == 0) {
+            size_t end = pattern.find('>', i);
+            names.push_back(pattern.substr(i + 4, end - i - 4));
+            converted += '(';
+            i = end;
+        } else {
+            converted += pattern[i];
+        }
+    }
+    return converted;
+}
+
+/**
+ * @brief Builds a rule set of distinct patterns, each requiring its own keyword.
+ *
+ * Pattern i looks for "<keyword i> ... from <address>", where the keywords
+ * are random lowercase words, so a line mentions at most a few of them.
+ *
+ * @param count Number of patterns.
+ * @param keywords Receives the keyword of each pattern.
+ * @return The patterns.
+ */
+std::vector<std::string> makeRules(size_t count, std::vector<std::string>& keywords) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> rules;
+    for (size_t i = 0; i < count; ++i) {
+        std::string keyword;
+        for (int j = 0; j < 7; ++j) {
+            keyword += static_cast<char>(letter(rng));
+        }
+        keywords.push_back(keyword);
+        rules.push_back(keyword + " (\\S+) .*from ([\\d.]+)");
+    }
+    return rules;
+}
+
+/**
+ * @brief Builds an sshd-like line that mentions one rule's keyword.
+ *
+ * @param keyword The keyword.
+ * @return The line.
+ */
+std::string makeRuleLine(const std::string& keyword) {
+    return "Mar 14 09:26:53 bastion sshd[24512]: " + keyword + " admin session opened from 203.0.113.7 port 52144 ssh2";
+}
+
+/**
+ * @brief Builds a structured application log line.
+ *
+ * @param sequence Varies the values so lines differ.
+ * @return A JSON object on one line.
+ */
+std::string makeJsonLine(size_t sequence) {
+    static const char* const levels[] = {"info", "debug", "warn", "error"};
+    return "{\"ts\":\"2025-04-04T12:00:" + std::to_string(10 + sequence % 50) + ".123Z\",\"level\":\"" + levels[sequence % 4] +
+           "\",\"service\":\"checkout\",\"trace_id\":\"" + std::to_string(1000000007ULL * sequence) +
+           "\",\"msg\":\"order placed for customer \\\"" + std::to_string(sequence) + "\\\" in 12.5 ms\",\"http\":{\"method\":\"POST\",\"status\":201,\"path\":\"/api/v2/orders\"},\"items\":[1,2,3],\"ok\":true}";
+}
+
+/**
+ * @brief Builds an NDJSON buffer of application log lines.
+ *
+ * @param size Approximate size in bytes.
+ * @return The buffer, one object per line.
+ */
+const std::string& ndjsonBuffer(size_t size) {
+    static std::string buffer;
+    if (buffer.empty()) {
+        buffer.reserve(size + 512);
+        for (size_t sequence = 0; buffer.size() < size; ++sequence) {
+            buffer += makeJsonLine(sequence);
+            buffer += '\n';
+        }
+    }
+    return buffer;
+}
+
+/**
+ * @brief Builds firewall and EDR lines in a parser format.
+ *
+ * @param format The format.
+ * @return 64 lines with varying values and a few escapes.
+ */
+std::vector<std::string> makeFormatLines(KeyValueParser::Format format) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 64; ++i) {
+        std::string src = "10.1." + std::to_string(i) + "." + std::to_string(200 - i);
+        std::string port = std::to_string(1024 + i * 37);
+        switch (format) {
+            case KeyValueParser::KEY_VALUE:
+                lines.push_back("date=2025-03-14 time=09:26:53 devname=\"FGT-edge-01\" logid=\"0000000013\" type=\"traffic\" subtype=\"forward\" srcip=" +
+                                src + " srcport=" + port + " dstip=198.51.100.7 dstport=443 action=\"accept\" policyid=" + std::to_string(i % 9) +
+                                " app=\"HTTPS \\\"BROWSING\\\"\" sentbyte=" + std::to_string(i * 1511) + " rcvdbyte=" + std::to_string(i * 40213));
+                break;
+            case KeyValueParser::CEF:
+                lines.push_back("Mar 14 09:26:53 edr01 CEF:0|Acme|Endpoint Protect|4.2|" + std::to_string(100 + i % 7) +
+                                "|Suspicious process blocked|8|src=" + src + " spt=" + port + " dst=198.51.100.7 dpt=443 suser=CORP\\jdoe" +
+                                " fname=powershell.exe filePath=C:\\Windows\\System32\\powershell.exe msg=Encoded command \\= blocked by policy " +
+                                std::to_string(i % 9) + " act=blocked cs1Label=rule cs1=PS-ENC-001");
+                break;
+            case KeyValueParser::LEEF:
+                lines.push_back("LEEF:2.0|Lancope|StealthWatch|1.0|41|^|src=" + src + "^srcPort=" + port +
+                                "^dst=198.51.100.7^dstPort=443^proto=tcp^sev=" + std::to_string(i % 10) +
+                                "^usrName=jdoe^cat=Flow^devTime=Mar 14 2025 09:26:53^msg=flow exceeded byte threshold");
+                break;
+        }
+    }
+    return lines;
+}
+
+/**
+ * @brief Builds lines whose timestamps advance a second per line.
+ *
+ * @param format Argument of the Timestamp benchmarks, 0 to 4.
+ * @return 64 lines.
+ */
+std::vector<std::string> makeTimestampLines(int format) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < 64; ++i) {
+        char clock[16];
+        std::snprintf(clock, sizeof(clock), "09:%02d:%02d", 26 + i / 60, i % 60);
+        std::string client = "10.1." + std::to_string(i) + "." + std::to_string(200 - i * 3);
+        switch (format) {
+            case 0:
+                lines.push_back(std::string("2025-03-14 ") + clock + "," + std::to_string(100 + i) + " INFO  [http-nio-8080-exec-" +
+                                std::to_string(i % 8) + "] c.a.OrderService - order " + std::to_string(40000 + i) + " accepted");
+                break;
+            case 1:
+                lines.push_back(std::string("Mar 14 ") + clock + " web01 sshd[" + std::to_string(2000 + i) + "]: Accepted publickey for deploy from " +
+                                client + " port " + std::to_string(40000 + i) + " ssh2");
+                break;
+            case 2:
+                lines.push_back(client + " - - [14/Mar/2025:" + clock + " +0100] \"GET /api/v1/items/" + std::to_string(i) +
+                                " HTTP/1.1\" 200 " + std::to_string(512 + i * 13) + " \"-\" \"curl/8.5.0\"");
+                break;
+            case 3:
+                lines.push_back("{\"ts\":" + std::to_string(1741944413000LL + i * 1000) + ",\"level\":\"info\",\"msg\":\"request served\",\"status\":200}");
+                break;
+            default:
+                lines.push_back(std::string("14/03/2025 ") + clock + " | worker-" + std::to_string(i % 4) + " | job " + std::to_string(i) + " finished");
+                break;
+        }
+    }
+    return lines;
+}
+
+/**
+ * @brief Builds combined-format access log lines from a few hundred clients, a dozen agents and varied paths.
+ *
+ * @param count How many lines.
+ * @return The lines; their times advance about 20 ms per line.
+ */
+std::vector<std::string> makeAccessLines(size_t count) {
+    static const char* const agents[] = {
+        "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/122.0.0.0 Safari/537.36",
+        "Mozilla/5.0 (Macintosh; Intel Mac OS X 14_3) AppleWebKit/605.1.15 (KHTML, like Gecko) Version/17.3 Safari/605.1.15",
+        "Mozilla/5.0 (X11; Linux x86_64; rv:123.0) Gecko/20100101 Firefox/123.0",
+        "Mozilla/5.0 (iPhone; CPU iPhone OS 17_3 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Mobile/15E148",
+        "curl/8.5.0", "python-requests/2.31.0", "Go-http-client/1.1", "kube-probe/1.29",
+        "Mozilla/5.0 (compatible; Googlebot/2.1; +http://www.google.com/bot.html)", "Prometheus/2.50.0",
+        "okhttp/4.12.0", "Apache-HttpClient/4.5.14 (Java/17.0.10)"};
+    static const char* const methods[] = {"GET", "GET", "GET", "POST", "GET", "PUT", "GET", "DELETE"};
+    static const int statuses[] = {200, 200, 200, 304, 200, 404, 200, 201, 500, 200};
+    std::mt19937 rng(7);
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        int second = static_cast<int>(i / 50);
+        char time[40];
+        std::snprintf(time, sizeof(time), "[14/Mar/2025:09:%02d:%02d +0100]", 26 + second / 60 % 30, second % 60);
+        int status = statuses[rng() % 10];
+        std::string path = "/api/v1/items/" + std::to_string(rng() % 5000);
+        if (rng() % 3 == 0) {
+            path += "?page=" + std::to_string(rng() % 20) + "&sort=price";
+        }
+        lines.push_back("10." + std::to_string(rng() % 4) + "." + std::to_string(rng() % 16) + "." + std::to_string(rng() % 8) +
+                        (rng() % 10 == 0 ? " - alice " : " - - ") + time + " \"" + methods[rng() % 8] + " " + path + " HTTP/1.1\" " +
+                        std::to_string(status) + " " + (status == 304 ? std::string("-") : std::to_string(200 + rng() % 40000)) +
+                        " \"" + (rng() % 2 ? "https://shop.example.com/catalog" : "-") + "\" \"" + agents[rng() % 12] + "\"");
+    }
+    return lines;
+}
+
+/**
+ * @brief Reads the lines of a corpus file.
+ *
+ * @param path The file, relative to the working directory.
+ * @return The lines; empty if the file cannot be read.
+ */
+std::vector<std::string> readCorpus(const std::string& path) {
+    std::ifstream file(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void extractArgs(benchmark::internal::Benchmark* bench) {
+    for (int sourcetype : {0, 1}) {
+        for (int firstOnly : {0, 1}) {
+            bench->Args({sourcetype, firstOnly});
+        }
+    }
+}
+
+} // namespace
+
+static void BM_GetCurrentTimestamp(benchmark::State& state) {
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(FileMonitor::getCurrentTimestamp());
+    }
+    allocations.report(state, state.iterations());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetCurrentTimestamp);
+
+static void BM_EscapeJson(benchmark::State& state) {
+    std::string line = makeLine(static_cast<size_t>(state.range(0)), static_cast<int>(state.range(1)));
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(FileMonitor::escapeJson(line));
+    }
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EscapeJson)->Apply(lineArgs);
+
+static void BM_FormatMessage(benchmark::State& state) {
+    std::string line = makeLine(static_cast<size_t>(state.range(0)), static_cast<int>(state.range(1)));
+    const std::string filePath = "/var/log/auth.log";
+    const std::string topic = "my-topic";
+    const std::string type = "MODIFY";
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(FileMonitor::formatMessage(filePath, line, topic, type));
+    }
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FormatMessage)->Apply(lineArgs);
+
+static void BM_SplitLines(benchmark::State& state) {
+    std::string chunk = makeChunk(64 * 1024, static_cast<size_t>(state.range(0)));
+    std::string pending;
+    size_t lines = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        lines += FileMonitor::splitLines(chunk.data(), chunk.size(), pending, [](const std::string& line) {
+            benchmark::DoNotOptimize(line.data());
+        });
+    }
+    allocations.report(state, static_cast<int64_t>(lines));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(chunk.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(lines));
+}
+BENCHMARK(BM_SplitLines)->Arg(64)->Arg(256)->Arg(1024)->Arg(4096);
+
+/**
+ * Produces formatted messages through a KafkaSink whose producer talks to
+ * librdkafka's in-process mock cluster, so the cost measured is the produce
+ * call and delivery-report handling, without a real broker or network.
+ */
+static void BM_Produce(benchmark::State& state) {
+    KafkaSink sink("localhost:9092", "bench-topic", "bench", {{"test.mock.num.brokers", "1"}});
+    std::string message = FileMonitor::formatMessage("/var/log/auth.log", makeLine(static_cast<size_t>(state.range(0)), 0), "bench-topic", "MODIFY");
+    size_t produced = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        while (!sink.tryProduce(message)) {
+            sink.poll();
+        }
+        if (++produced % 1000 == 0) {
+            sink.poll();
+        }
+    }
+    // Timing stops when the loop ends, so draining is not measured
+    sink.flush(10000);
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(message.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Produce)->Arg(64)->Arg(256)->Arg(1024)->Arg(4096);
+
+static void BM_ExtractRe2(benchmark::State& state) {
+    const ExtractionCase& test = EXTRACTION_CASES[state.range(0)];
+    FieldExtractor extractor;
+    extractor.addPattern(test.sourcetype, test.pattern);
+    extractor.compile();
+    size_t wanted = state.range(1) ? 1 : test.fields.size();
+    for (size_t i = 0; i < wanted; ++i) {
+        extractor.reference(test.fields[i]);
+    }
+    FieldExtractor::Fields fields(extractor, test.sourcetype);
+    std::string line = test.line;
+    std::string_view value;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        fields.reset(line);
+        for (size_t i = 0; i < wanted; ++i) {
+            fields.get(i, value);
+            benchmark::DoNotOptimize(value.data());
+        }
+    }
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractRe2)->Apply(extractArgs);
+
+/**
+ * The same extraction with std::regex. std::regex cannot skip unreferenced
+ * groups, so the single-field variant only saves copying the other values.
+ */
+static void BM_ExtractStdRegex(benchmark::State& state) {
+    const ExtractionCase& test = EXTRACTION_CASES[state.range(0)];
+    std::vector<std::string> names;
+    std::regex regex(toStdRegex(test.pattern, names));
+    size_t wanted = state.range(1) ? 1 : test.fields.size();
+    std::vector<size_t> groups;
+    for (size_t i = 0; i < wanted; ++i) {
+        groups.push_back(static_cast<size_t>(std::find(names.begin(), names.end(), test.fields[i]) - names.begin()) + 1);
+    }
+    std::string line = test.line;
+    std::smatch match;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        if (std::regex_search(line, match, regex)) {
+            for (size_t group : groups) {
+                std::string value = match[group].str();
+                benchmark::DoNotOptimize(value.data());
+            }
+        }
+    }
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExtractStdRegex)->Apply(extractArgs);
+
+static void BM_Prefilter(benchmark::State& state) {
+    std::vector<std::string> keywords;
+    std::vector<std::string> rules = makeRules(static_cast<size_t>(state.range(0)), keywords);
+    PatternPrefilter prefilter;
+    for (const std::string& rule : rules) {
+        prefilter.add(rule);
+    }
+    prefilter.compile();
+    std::vector<std::string> lines = {makeRuleLine(keywords[keywords.size() / 2]), makeRuleLine("unknown")};
+    PatternPrefilter::Scratch scratch;
+    std::vector<int> matches;
+    size_t matched = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        for (const std::string& line : lines) {
+            prefilter.matches(line, scratch, matches);
+            matched += matches.size();
+        }
+    }
+    allocations.report(state, state.iterations() * 2);
+    state.counters["matches/line"] = static_cast<double>(matched) / (state.iterations() * 2);
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_Prefilter)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * The same rule set without a prefilter, one RE2 search per pattern.
+ */
+static void BM_PrefilterBaseline(benchmark::State& state) {
+    std::vector<std::string> keywords;
+    std::vector<std::string> rules = makeRules(static_cast<size_t>(state.range(0)), keywords);
+    std::vector<std::unique_ptr<RE2>> regexes;
+    for (const std::string& rule : rules) {
+        regexes.emplace_back(new RE2(rule));
+    }
+    std::vector<std::string> lines = {makeRuleLine(keywords[keywords.size() / 2]), makeRuleLine("unknown")};
+    size_t matched = 0;
+    for (auto _ : state) {
+        for (const std::string& line : lines) {
+            for (const auto& regex : regexes) {
+                matched += RE2::PartialMatch(line, *regex);
+            }
+        }
+    }
+    state.counters["matches/line"] = static_cast<double>(matched) / (state.iterations() * 2);
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_PrefilterBaseline)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * Sampling decision for keys of the given length: the hash and threshold
+ * test that run for every line before it is formatted.
+ */
+static void BM_HashSample(benchmark::State& state) {
+    HashSampler sampler("bench", 0.01);
+    std::string key = makeLine(static_cast<size_t>(state.range(0)), 0);
+    size_t kept = 0;
+    for (auto _ : state) {
+        key[0]++;
+        kept += sampler.keep(key, nullptr);
+    }
+    benchmark::DoNotOptimize(kept);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(key.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HashSample)->Arg(16)->Arg(64)->Arg(256)->Arg(1024);
+
+static void BM_LineParse(benchmark::State& state) {
+    KeyValueParser::Format format = static_cast<KeyValueParser::Format>(state.range(0));
+    std::vector<std::string> lines = makeFormatLines(format);
+    KeyValueParser parser(format);
+    std::string json;
+    size_t i = 0;
+    size_t bytes = 0;
+    size_t fields = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        const std::string& line = lines[i++ % lines.size()];
+        if (!parser.parse(line)) {
+            state.SkipWithError("generated line failed to parse");
+            break;
+        }
+        fields += parser.fields().size();
+        if (state.range(1)) {
+            json.clear();
+            parser.appendJson(json);
+            benchmark::DoNotOptimize(json.data());
+        }
+        bytes += line.size();
+    }
+    allocations.report(state, state.iterations());
+    state.counters["fields/line"] = static_cast<double>(fields) / static_cast<double>(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LineParse)->ArgsProduct({{0, 1, 2}, {0, 1}});
+
+static void BM_SyslogParse(benchmark::State& state) {
+    std::vector<std::string> lines = readCorpus("bench/corpus/syslog.log");
+    if (lines.empty()) {
+        state.SkipWithError("bench/corpus/syslog.log not found; run from the repository root");
+        return;
+    }
+    SyslogParser parser;
+    SyslogParser::Message message;
+    size_t i = 0;
+    size_t bytes = 0;
+    size_t invalid = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        const std::string& line = lines[i++ % lines.size()];
+        invalid += !parser.parse(line, message);
+        benchmark::DoNotOptimize(message.timeUs);
+        bytes += line.size();
+    }
+    allocations.report(state, state.iterations());
+    if (invalid > 0) {
+        state.SkipWithError("corpus line failed to parse");
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SyslogParse);
+
+static void BM_TimestampExtract(benchmark::State& state) {
+    int format = static_cast<int>(state.range(0));
+    std::vector<std::string> lines = makeTimestampLines(format);
+    TimestampParser parser = format == 4 ? TimestampParser("%d/%m/%Y %T") : TimestampParser();
+    size_t i = 0;
+    size_t bytes = 0;
+    size_t missing = 0;
+    int64_t timeUs = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        const std::string& line = lines[i++ % lines.size()];
+        missing += !parser.extract(line, timeUs);
+        benchmark::DoNotOptimize(timeUs);
+        bytes += line.size();
+    }
+    allocations.report(state, state.iterations());
+    if (missing > 0) {
+        state.SkipWithError("generated line has no timestamp");
+    }
+    state.SetLabel(TimestampParser::formatName(parser.format()));
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimestampExtract)->DenseRange(0, 4);
+
+static void BM_AccessLogParse(benchmark::State& state) {
+    std::vector<std::string> lines = makeAccessLines(4096);
+    AccessLogParser parser;
+    AccessLogParser::Record record;
+    AccessLogBatch batch;
+    size_t i = 0;
+    size_t bytes = 0;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        const std::string& line = lines[i++ % lines.size()];
+        if (!parser.parse(line, record)) {
+            state.SkipWithError("generated line failed to parse");
+            break;
+        }
+        batch.add(record);
+        if (batch.size() == 1024) {
+            batch.clear();
+        }
+        bytes += line.size();
+    }
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AccessLogParse);
+
+static void BM_AccessLogEncode(benchmark::State& state) {
+    const size_t rows = 1024;
+    std::vector<std::string> lines = makeAccessLines(rows);
+    AccessLogParser parser;
+    AccessLogParser::Record record;
+    AccessLogBatch batch;
+    size_t input = 0;
+    for (const std::string& line : lines) {
+        parser.parse(line, record);
+        batch.add(record);
+        input += line.size();
+    }
+    size_t output = 0;
+    std::string message;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        output = 0;
+        if (state.range(0) == 2) {
+            batch.encode("/var/log/nginx/access.log", 1.0, message);
+            output = message.size();
+        } else {
+            for (size_t row = 0; row < rows; ++row) {
+                message = state.range(0) == 0 ? FileMonitor::formatMessage("/var/log/nginx/access.log", lines[row], "bench-topic", "MODIFY")
+                                              : FileMonitor::formatAccessRow("/var/log/nginx/access.log", batch, row, "bench-topic");
+                output += message.size();
+            }
+        }
+        benchmark::DoNotOptimize(message.data());
+    }
+    allocations.report(state, state.iterations() * rows);
+    state.counters["in_bytes/line"] = static_cast<double>(input) / rows;
+    state.counters["out_bytes/line"] = static_cast<double>(output) / rows;
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * input));
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * rows));
+}
+BENCHMARK(BM_AccessLogEncode)->DenseRange(0, 2);
+
+static void BM_JsonParseNdjson(benchmark::State& state) {
+    const std::string& buffer = ndjsonBuffer(64 << 20);
+    JsonLogParser parser;
+    size_t lines = 0;
+    size_t invalid = 0;
+    for (auto _ : state) {
+        std::string_view rest(buffer);
+        while (!rest.empty()) {
+            size_t end = rest.find('\n');
+            invalid += !parser.parse(rest.substr(0, end));
+            lines++;
+            rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+        }
+    }
+    if (invalid > 0) {
+        state.SkipWithError("generated line failed to parse");
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(buffer.size()));
+    state.SetItemsProcessed(static_cast<int64_t>(lines));
+}
+BENCHMARK(BM_JsonParseNdjson)->Unit(benchmark::kMillisecond);
+
+/**
+ * A JSON line sent with its members merged into the envelope (argument 1)
+ * or escaped into the "message" string (argument 0).
+ */
+static void BM_JsonEnvelope(benchmark::State& state) {
+    std::string line = makeJsonLine(42);
+    JsonLogParser parser;
+    AllocationCounter allocations;
+    for (auto _ : state) {
+        std::string message;
+        if (state.range(0) && parser.parse(line)) {
+            message = FileMonitor::formatJsonMessage("/var/log/checkout.json", parser, "bench-topic", "MODIFY");
+        } else {
+            message = FileMonitor::formatMessage("/var/log/checkout.json", line, "bench-topic", "MODIFY");
+        }
+        benchmark::DoNotOptimize(message.data());
+    }
+    allocations.report(state, state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(line.size()));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_JsonEnvelope)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,112 @@
+//
+// Fuzz target for SyslogParser.
+//
+// With clang and libFuzzer (see cpp_compiler_commands.txt):
+//   ./sparky_fuzz_syslog fuzz/corpus/syslog
+// Built with g++ (without -DSPARKY_LIBFUZZER) the same target replays the
+// corpus files or directories given as arguments, e.g. under ASan and UBSan:
+//   ./sparky_fuzz_syslog_replay fuzz/corpus/syslog bench/corpus/syslog.log
+//
+// Besides memory errors, the target checks that every decoded field is a
+// view into the input and that the PRI is in range.
+//
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include "SyslogParser.h"
+
+namespace {
+
+/**
+ * @brief Aborts unless a field is empty or lies within the input.
+ *
+ * @param field The field.
+ * @param input The input.
+ */
+void checkView(std::string_view field, std::string_view input) {
+    if (field.empty()) {
+        return;
+    }
+    if (field.data() < input.data() || field.data() + field.size() > input.data() + input.size()) {
+        std::fprintf(stderr, "field outside the input\n");
+        std::abort();
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static SyslogParser parser;
+    std::string_view input(reinterpret_cast<const char*>(data), size);
+    SyslogParser::Message message;
+    if (!parser.parse(input, message)) {
+        return 0;
+    }
+    if (message.priority < -1 || message.priority > 191) {
+        std::abort();
+    }
+    for (std::string_view field : {message.hostname, message.appName, message.procId, message.msgId, message.structuredData, message.message}) {
+        checkView(field, input);
+    }
+    if (message.format == SyslogParser::RFC3164 && (!message.msgId.empty() || !message.structuredData.empty())) {
+        std::abort();
+    }
+    return 0;
+}
+
+#ifndef SPARKY_LIBFUZZER
+namespace {
+
+/**
+ * @brief Runs the target on one input, or on each line of a corpus file with several lines.
+ *
+ * @param path The file.
+ */
+void replayFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string input = contents.str();
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+    size_t start = 0;
+    while (start < input.size()) {
+        size_t end = input.find('\n', start);
+        if (end == std::string::npos) {
+            end = input.size();
+        }
+        if (start > 0 || end < input.size()) {
+            LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(input.data() + start), end - start);
+        }
+        start = end + 1;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t files = 0;
+    for (int i = 1; i < argc; ++i) {
+        DIR* directory = opendir(argv[i]);
+        if (directory == nullptr) {
+            replayFile(argv[i]);
+            files++;
+            continue;
+        }
+        while (struct dirent* entry = readdir(directory)) {
+            if (entry->d_name[0] != '.') {
+                replayFile(std::string(argv[i]) + "/" + entry->d_name);
+                files++;
+            }
+        }
+        closedir(directory);
+    }
+    std::printf("replayed %zu files\n", files);
+    return 0;
+}
+#endif
@@ -0,0 +1,433 @@
+//
+// End-to-end load test: file writer -> FileMonitor -> librdkafka mock cluster.
+//
+// Every monitored file gets its own producer talking to an in-process mock
+// cluster (test.mock.num.brokers), so the test runs fully offline. A writer
+// thread appends lines at a fixed rate, each stamped with the time it was
+// written; the delivery report for the line gives its write-to-ack latency.
+//
+// With --replay, the writer instead replays a capture trace (see
+// FileMonitor::setCapture()) into the directory, and the monitors tail the
+// replayed files. Latencies then come from the monitors' own write-to-delivery
+// histograms, since captured lines carry no write stamp.
+//
+// With --filter, the monitors apply the drop and keep rules in the given file
+// (see LineFilter); dropped lines count as done, and the report shows how
+// many there were, so the CPU saved by dropping can be compared.
+//
+// Usage: sparky_loadtest [--rate LINES_PER_SEC] [--line-size BYTES] [--files N]
+//                        [--duration SECONDS] [--dir PATH] [--filter RULES]
+//        sparky_loadtest --replay TRACE [--speed N|max] [--dir PATH] [--filter RULES]
+//
+// Built with -DSPARKY_ALLOC_ACCOUNTING (on every source file), the report
+// also shows heap allocations per delivered event for each pipeline stage.
+//
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include "FileMonitor.h"
+#include "CpuGovernor.h"
+#include "AllocationAccounting.h"
+#include "TraceFile.h"
+#include "LineFilter.h"
+
+namespace {
+
+/// Marker at the start of every generated line, followed by the write time.
+const char LINE_MARKER[] = "loadtest ";
+
+/// How long to wait for outstanding deliveries once writing stops.
+const std::chrono::seconds DRAIN_TIMEOUT(30);
+
+/// Interval at which the writer appends the lines that are due.
+const std::chrono::milliseconds WRITE_TICK(1);
+
+struct Options {
+    double rate = 10000;     ///< Lines per second, across all files.
+    size_t lineSize = 200;   ///< Bytes per line, excluding the newline.
+    size_t files = 1;        ///< Number of files written and monitored.
+    double duration = 10;    ///< Seconds of writing.
+    std::string dir;         ///< Directory for the files; a fresh temporary one if empty.
+    std::string replay;      ///< Capture trace to replay instead of generating lines.
+    double speed = 1;        ///< Replay time scale; 0 for as fast as possible.
+    std::string filter;      ///< Drop and keep rules file, or empty.
+};
+
+/**
+ * @brief Collects write-to-ack latencies reported by the monitors' delivery hooks.
+ */
+class LatencyRecorder {
+public:
+    /**
+     * @brief Records the latency of a delivered message if it carries a write time.
+     * @param payload The delivered message.
+     * @param length Length of the message in bytes.
+     */
+    void record(const char* payload, size_t length) {
+        int64_t now = steadyNanos();
+        std::string message(payload, length);
+        if (countOnly) {
+            if (message.find("\"type\": \"MODIFY\"") != std::string::npos) {
+                std::lock_guard<std::mutex> lock(mutex);
+                lastAck = now;
+                delivered.fetch_add(1);
+            }
+            return;
+        }
+        size_t pos = message.find(LINE_MARKER);
+        if (pos == std::string::npos) {
+            return;
+        }
+        int64_t written = std::strtoll(message.c_str() + pos + sizeof(LINE_MARKER) - 1, nullptr, 10);
+        std::lock_guard<std::mutex> lock(mutex);
+        latencies.push_back(now - written);
+        lastAck = now;
+        delivered.store(latencies.size());
+    }
+
+    /**
+     * @brief Retrieves the sorted latencies recorded so far.
+     * @return Latencies in nanoseconds, ascending.
+     */
+    std::vector<int64_t> sorted() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<int64_t> result = latencies;
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    /**
+     * @brief Retrieves the time the last generated line was acknowledged.
+     * @return Steady-clock nanoseconds, or 0 if nothing was delivered.
+     */
+    int64_t lastAckNanos() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lastAck;
+    }
+
+    static int64_t steadyNanos() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<uint64_t> delivered{0}; ///< Generated lines delivered so far.
+    bool countOnly = false; ///< Count delivered lines without stamps (replay) instead of timing them.
+
+private:
+    std::mutex mutex; ///< Protects latencies and lastAck; hooks run on every monitor thread.
+    std::vector<int64_t> latencies; ///< Write-to-ack latency of each delivered line, in nanoseconds.
+    int64_t lastAck = 0; ///< Time of the most recent delivery.
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [--rate LINES_PER_SEC] [--line-size BYTES] [--files N]"
+              << " [--duration SECONDS] [--dir PATH] [--filter RULES]" << std::endl
+              << "       " << program << " --replay TRACE [--speed N|max] [--dir PATH] [--filter RULES]" << std::endl;
+}
+
+/**
+ * @brief Parses the command line.
+ *
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return The options.
+ *
+ * @throws std::runtime_error On an unknown option or a missing or invalid value.
+ */
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::runtime_error("Missing value for " + name);
+        }
+        std::string value = argv[++i];
+        if (name == "--rate") {
+            options.rate = std::atof(value.c_str());
+        } else if (name == "--line-size") {
+            options.lineSize = static_cast<size_t>(std::atol(value.c_str()));
+        } else if (name == "--files") {
+            options.files = static_cast<size_t>(std::atol(value.c_str()));
+        } else if (name == "--duration") {
+            options.duration = std::atof(value.c_str());
+        } else if (name == "--dir") {
+            options.dir = value;
+        } else if (name == "--filter") {
+            options.filter = value;
+        } else if (name == "--replay") {
+            options.replay = value;
+        } else if (name == "--speed") {
+            options.speed = value == "max" ? 0 : std::atof(value.c_str());
+            if (value != "max" && options.speed <= 0) {
+                throw std::runtime_error("--speed must be positive or max");
+            }
+        } else {
+            throw std::runtime_error("Unknown option " + name);
+        }
+    }
+    if (options.rate <= 0 || options.files == 0 || options.duration <= 0) {
+        throw std::runtime_error("--rate, --files and --duration must be positive");
+    }
+    return options;
+}
+
+/**
+ * @brief Reads a memory figure from /proc/self/status.
+ *
+ * @param field The field, e.g. "VmRSS" or "VmHWM".
+ * @return The value in KiB, or 0 if unavailable.
+ */
+long procStatusKb(const std::string& field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, field.size() + 1, field + ":") == 0) {
+            return std::atol(line.c_str() + field.size() + 1);
+        }
+    }
+    return 0;
+}
+
+double threadCpuSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Appends stamped lines to the files at the configured rate.
+ *
+ * Lines are spread round robin over the files. Each tick the lines that have
+ * come due are written with one write() per file, all stamped with the time
+ * just before the write.
+ *
+ * @param options The load settings.
+ * @param paths The files to append to.
+ * @param written Receives the number of lines written.
+ * @param cpuSeconds Receives the CPU time used by the writer thread.
+ */
+void writeLoad(const Options& options, const std::vector<std::string>& paths, uint64_t& written, double& cpuSeconds) {
+    std::vector<int> fds;
+    for (const std::string& path : paths) {
+        int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+        }
+        fds.push_back(fd);
+    }
+
+    std::string padding(options.lineSize, 'x');
+    std::vector<std::string> batches(paths.size());
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.duration));
+    uint64_t sequence = 0;
+    for (auto now = start; now < end; now = std::chrono::steady_clock::now()) {
+        uint64_t due = static_cast<uint64_t>(std::chrono::duration<double>(now - start).count() * options.rate);
+        std::string stamp = LINE_MARKER + std::to_string(LatencyRecorder::steadyNanos()) + " ";
+        for (; sequence < due; ++sequence) {
+            std::string line = stamp + std::to_string(sequence) + " ";
+            line.append(padding, 0, options.lineSize > line.size() ? options.lineSize - line.size() : 0);
+            batches[sequence % paths.size()] += line + "\n";
+        }
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!batches[i].empty() && write(fds[i], batches[i].data(), batches[i].size()) < 0) {
+                std::cerr << "Failed to write " << paths[i] << ": " << strerror(errno) << std::endl;
+            }
+            batches[i].clear();
+        }
+        std::this_thread::sleep_for(WRITE_TICK);
+    }
+    for (int fd : fds) {
+        close(fd);
+    }
+    written = sequence;
+    cpuSeconds = threadCpuSeconds();
+}
+
+double percentile(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()));
+    return sorted[index] / 1000.0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (options.dir.empty()) {
+        char pattern[] = "/tmp/sparky_loadtest.XXXXXX";
+        if (!mkdtemp(pattern)) {
+            std::cerr << "Failed to create a temporary directory: " << strerror(errno) << std::endl;
+            return 1;
+        }
+        options.dir = pattern;
+    }
+
+    std::unique_ptr<TraceReplayer> replayer;
+    std::vector<std::string> paths;
+    if (!options.replay.empty()) {
+        try {
+            replayer.reset(new TraceReplayer(options.replay, options.dir, options.speed));
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        paths = replayer->targets();
+    } else {
+        for (size_t i = 0; i < options.files; ++i) {
+            paths.push_back(options.dir + "/file" + std::to_string(i) + ".log");
+            std::ofstream(paths.back(), std::ios::trunc);
+        }
+    }
+
+    LatencyRecorder recorder;
+    recorder.countOnly = replayer != nullptr;
+    LineFilter filter;
+    std::vector<std::unique_ptr<FileMonitor>> monitors;
+    std::vector<std::thread> threads;
+    try {
+        if (!options.filter.empty()) {
+            filter.load(options.filter);
+        }
+        filter.compile();
+        for (const std::string& path : paths) {
+            monitors.emplace_back(new FileMonitor(path, "localhost:9092", "loadtest", {{"test.mock.num.brokers", "1"}}));
+            monitors.back()->setFilter(&filter);
+            monitors.back()->kafkaSink()->setDeliveryHook([&recorder](const char* payload, size_t length) {
+                // The recorder's own allocations are not the pipeline's
+                SPARKY_ALLOC_STAGE(OTHER);
+                recorder.record(payload, length);
+            });
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    for (auto& monitor : monitors) {
+        threads.emplace_back(&FileMonitor::monitor, monitor.get());
+    }
+    // Give the producers time to bring up their mock clusters
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    if (replayer) {
+        std::cout << "Replaying " << options.replay << " to " << paths.size() << " file(s) in " << options.dir << " at ";
+        if (options.speed > 0) {
+            std::cout << options.speed << "x";
+        } else {
+            std::cout << "max";
+        }
+        std::cout << " speed" << std::endl;
+    } else {
+        std::cout << "Writing " << options.rate << " lines/s of " << options.lineSize << " bytes to "
+                  << options.files << " file(s) in " << options.dir << " for " << options.duration << " s" << std::endl;
+    }
+
+    AllocationAccounting::Totals allocationsStart = AllocationAccounting::totals();
+    double cpuStart = CpuGovernor::processCpuSeconds();
+    int64_t wallStart = LatencyRecorder::steadyNanos();
+    uint64_t written = 0;
+    double writerCpu = 0;
+    std::thread writer([&] {
+        try {
+            if (replayer) {
+                replayer->run();
+                written = replayer->linesWritten();
+                writerCpu = threadCpuSeconds();
+            } else {
+                writeLoad(options, paths, written, writerCpu);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    });
+    writer.join();
+
+    auto drainDeadline = std::chrono::steady_clock::now() + DRAIN_TIMEOUT;
+    Metrics& metrics = Metrics::instance();
+    while (recorder.delivered.load() + metrics.total("sparky_lines_dropped_total") < written &&
+           std::chrono::steady_clock::now() < drainDeadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    int64_t wallEnd = std::max(recorder.lastAckNanos(), wallStart + 1);
+    double cpuSeconds = CpuGovernor::processCpuSeconds() - cpuStart - writerCpu;
+    AllocationAccounting::Totals allocations = AllocationAccounting::totals().since(allocationsStart);
+    long rssKb = procStatusKb("VmRSS");
+    long peakRssKb = procStatusKb("VmHWM");
+
+    for (auto& monitor : monitors) {
+        monitor->stop();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<int64_t> latencies = recorder.sorted();
+    uint64_t delivered = recorder.delivered.load();
+    uint64_t dropped = metrics.total("sparky_lines_dropped_total");
+    double seconds = (wallEnd - wallStart) / 1e9;
+    std::printf("lines written:      %llu\n", static_cast<unsigned long long>(written));
+    std::printf("lines delivered:    %llu\n", static_cast<unsigned long long>(delivered));
+    if (!options.filter.empty()) {
+        std::printf("lines dropped:      %llu\n", static_cast<unsigned long long>(dropped));
+    }
+    std::printf("events/sec:         %.0f\n", delivered / seconds);
+    if (replayer) {
+        // Write notification to delivery report, as measured by the monitors
+        LatencyHistogram::Snapshot total;
+        for (const std::string& path : paths) {
+            std::string labels = Metrics::label("input", path) + "," + Metrics::label("stage", "total");
+            total.merge(Metrics::instance().histogram("sparky_latency_microseconds", labels).snapshot());
+        }
+        std::printf("latency p50:        %llu us\n", static_cast<unsigned long long>(total.percentile(0.50)));
+        std::printf("latency p99:        %llu us\n", static_cast<unsigned long long>(total.percentile(0.99)));
+        std::printf("latency p999:       %llu us\n", static_cast<unsigned long long>(total.percentile(0.999)));
+        std::printf("latency max:        %llu us\n", static_cast<unsigned long long>(total.max));
+    } else {
+        std::printf("latency p50:        %.0f us\n", percentile(latencies, 0.50));
+        std::printf("latency p99:        %.0f us\n", percentile(latencies, 0.99));
+        std::printf("latency p999:       %.0f us\n", percentile(latencies, 0.999));
+        std::printf("latency max:        %.0f us\n", latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+    }
+    std::printf("forwarder CPU:      %.3f cores\n", cpuSeconds / seconds);
+    std::printf("RSS:                %.1f MiB (peak %.1f MiB)\n", rssKb / 1024.0, peakRssKb / 1024.0);
+    if (AllocationAccounting::enabled() && delivered > 0) {
+        double events = static_cast<double>(delivered);
+        uint64_t pipelineAllocations = 0;
+        uint64_t pipelineBytes = 0;
+        std::printf("allocations/event:");
+        for (size_t i = AllocationAccounting::READ; i < AllocationAccounting::STAGE_COUNT; ++i) {
+            pipelineAllocations += allocations.allocations[i];
+            pipelineBytes += allocations.bytes[i];
+            std::printf(" %s %.2f", AllocationAccounting::stageName(static_cast<AllocationAccounting::Stage>(i)),
+                        allocations.allocations[i] / events);
+        }
+        std::printf(" (total %.2f, %.0f bytes)\n", pipelineAllocations / events, pipelineBytes / events);
+    } else {
+        std::printf("allocations/event:  n/a (build with -DSPARKY_ALLOC_ACCOUNTING)\n");
+    }
+    return delivered + dropped == written ? 0 : 2;
+}
@@ -0,0 +1,524 @@
+//
+// Synthetic SIEM log generator.
+//
+// Writes realistic log lines (syslog, sshd auth, firewall CEF, Apache access,
+// JSON application logs) to N files at a target rate, one writer thread per
+// file. The rate is steady, bursty (square wave around the mean) or replayed
+// from a recorded rate curve. Output is reproducible for a given --seed, and
+// with --start-time the timestamps are too. Files can be rotated mid-stream,
+// either logrotate-style (rename, then create) or copytruncate-style.
+//
+// Usage: rand_data_gen [options]
+//   --files N              number of files (default 1)
+//   --dir PATH             output directory (default .)
+//   --format F[,F...]      syslog, sshd, cef, apache, json or mix; assigned to files round robin (default mix)
+//   --rate N               lines per second across all files (default 1000)
+//   --duration S           seconds to run (default 10); --count wins if both given
+//   --count N              total lines to write across all files
+//   --mode M               steady, bursty or replay (default steady)
+//   --burst-factor F       bursty: rate multiplier during a burst (default 5)
+//   --burst-period S       bursty: seconds per burst cycle (default 10)
+//   --burst-duty D         bursty: fraction of each cycle spent bursting (default 0.1)
+//   --curve PATH           replay: file of "<offset seconds> <lines per second>" lines; the last one ends the run
+//   --rotate-bytes N       rotate each file after it reaches N bytes (default 0, never)
+//   --rotate-mode M        rename or truncate (default rename)
+//   --seed N               random seed (default 1)
+//   --start-time EPOCH     timestamp of the first line; lines then advance by 1/rate each
+//
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/// Interval at which writers append the lines that are due.
+const std::chrono::milliseconds WRITE_TICK(1);
+
+enum class Format { SYSLOG, SSHD, CEF, APACHE, JSON, MIX };
+
+enum class Mode { STEADY, BURSTY, REPLAY };
+
+struct Options {
+    size_t files = 1;
+    std::string dir = ".";
+    std::vector<Format> formats = {Format::MIX};
+    double rate = 1000;
+    double duration = 10;
+    uint64_t count = 0;
+    Mode mode = Mode::STEADY;
+    double burstFactor = 5;
+    double burstPeriod = 10;
+    double burstDuty = 0.1;
+    std::string curvePath;
+    uint64_t rotateBytes = 0;
+    bool rotateTruncate = false;
+    uint64_t seed = 1;
+    int64_t startTime = -1;
+};
+
+/// One point of a replayed rate curve.
+struct CurvePoint {
+    double offset; ///< Seconds since the start.
+    double rate;   ///< Lines per second from this offset on.
+};
+
+const char* const HOSTS[] = {"web01", "web02", "db01", "bastion", "fw-edge", "mail01"};
+const char* const USERS[] = {"root", "alice", "bob", "deploy", "admin", "carol", "backup", "oracle", "test", "ubuntu"};
+const char* const SERVICES[] = {"checkout", "auth", "search", "inventory", "payments"};
+const char* const PATHS[] = {"/", "/index.html", "/login", "/api/v1/orders", "/api/v1/search?q=shoes",
+                             "/static/app.js", "/static/logo.png", "/admin", "/wp-login.php", "/favicon.ico"};
+const char* const AGENTS[] = {"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36",
+                              "Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:121.0) Gecko/20100101 Firefox/121.0",
+                              "curl/8.4.0", "python-requests/2.31.0", "Googlebot/2.1 (+http://www.google.com/bot.html)"};
+const char* const MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+template <typename T, size_t N>
+const T& pick(const T (&items)[N], std::mt19937_64& rng) {
+    return items[rng() % N];
+}
+
+/**
+ * @brief Picks an index in [0, n) skewed towards low values, like real user and address popularity.
+ */
+size_t skewed(size_t n, std::mt19937_64& rng) {
+    double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    return static_cast<size_t>(u * u * u * n);
+}
+
+std::string ipv4(std::mt19937_64& rng, bool internal) {
+    if (internal) {
+        return "10.0." + std::to_string(skewed(4, rng)) + "." + std::to_string(1 + skewed(254, rng));
+    }
+    return std::to_string(1 + rng() % 223) + "." + std::to_string(rng() % 256) + "." +
+           std::to_string(rng() % 256) + "." + std::to_string(1 + rng() % 254);
+}
+
+/**
+ * @brief Formats a time as the RFC 3164 timestamp "Mmm dd hh:mm:ss".
+ */
+std::string syslogTime(const struct tm& t) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%s %2d %02d:%02d:%02d", MONTHS[t.tm_mon], t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    return buffer;
+}
+
+std::string syslogLine(const struct tm& t, std::mt19937_64& rng) {
+    std::string header = syslogTime(t) + " " + pick(HOSTS, rng) + " ";
+    switch (rng() % 4) {
+        case 0:
+            return header + "CRON[" + std::to_string(1000 + rng() % 60000) + "]: (" + USERS[skewed(10, rng)] + ") CMD (run-parts /etc/cron.hourly)";
+        case 1:
+            return header + "systemd[1]: Started Session " + std::to_string(rng() % 10000) + " of User " + USERS[skewed(10, rng)] + ".";
+        case 2:
+            return header + "kernel: [" + std::to_string(rng() % 1000000) + "." + std::to_string(100000 + rng() % 900000) +
+                   "] IPv4: martian source " + ipv4(rng, true) + " from " + ipv4(rng, false) + ", on dev eth0";
+        default:
+            return header + "sudo: " + USERS[skewed(10, rng)] + " : TTY=pts/" + std::to_string(rng() % 8) +
+                   " ; PWD=/home/" + USERS[skewed(10, rng)] + " ; USER=root ; COMMAND=/usr/bin/systemctl restart nginx";
+    }
+}
+
+std::string sshdLine(const struct tm& t, std::mt19937_64& rng) {
+    std::string header = syslogTime(t) + " " + pick(HOSTS, rng) + " sshd[" + std::to_string(1000 + rng() % 60000) + "]: ";
+    std::string user = USERS[skewed(10, rng)];
+    std::string from = " from " + ipv4(rng, rng() % 3 == 0) + " port " + std::to_string(1024 + rng() % 64000);
+    switch (rng() % 5) {
+        case 0: return header + "Accepted publickey for " + user + from + " ssh2: RSA SHA256:" + std::to_string(rng());
+        case 1: return header + "Failed password for " + user + from + " ssh2";
+        case 2: return header + "Failed password for invalid user " + user + from + " ssh2";
+        case 3: return header + "Invalid user " + user + from;
+        default: return header + "Disconnected from authenticating user " + user + from + " [preauth]";
+    }
+}
+
+std::string cefLine(const struct tm& t, std::mt19937_64& rng) {
+    static const char* const ACTIONS[] = {"allow", "deny", "drop"};
+    static const char* const PROTOCOLS[] = {"TCP", "UDP", "ICMP"};
+    static const int PORTS[] = {22, 53, 80, 443, 445, 3389, 8080};
+    const char* action = pick(ACTIONS, rng);
+    int severity = action[0] == 'a' ? 3 : 6 + static_cast<int>(rng() % 3);
+    return syslogTime(t) + " fw-edge CEF:0|Sparky|EdgeFirewall|2.1|" + std::to_string(100 + rng() % 5) +
+           "|Connection " + action + "|" + std::to_string(severity) +
+           "|src=" + ipv4(rng, false) + " spt=" + std::to_string(1024 + rng() % 64000) +
+           " dst=" + ipv4(rng, true) + " dpt=" + std::to_string(pick(PORTS, rng)) +
+           " proto=" + pick(PROTOCOLS, rng) + " act=" + action + " cnt=" + std::to_string(1 + skewed(50, rng));
+}
+
+std::string apacheLine(const struct tm& t, std::mt19937_64& rng) {
+    static const char* const METHODS[] = {"GET", "GET", "GET", "POST", "HEAD"};
+    static const int STATUSES[] = {200, 200, 200, 200, 304, 301, 404, 403, 500};
+    char stamp[64];
+    std::strftime(stamp, sizeof(stamp), "%d/%b/%Y:%H:%M:%S +0000", &t);
+    int status = pick(STATUSES, rng);
+    return ipv4(rng, false) + " - " + (rng() % 5 == 0 ? std::string(USERS[skewed(10, rng)]) : "-") + " [" + stamp + "] \"" +
+           pick(METHODS, rng) + " " + PATHS[skewed(10, rng)] + " HTTP/1.1\" " + std::to_string(status) + " " +
+           std::to_string(status == 304 ? 0 : 200 + skewed(50000, rng)) + " \"-\" \"" + pick(AGENTS, rng) + "\"";
+}
+
+std::string jsonLine(const struct tm& t, int millis, std::mt19937_64& rng) {
+    static const char* const LEVELS[] = {"info", "info", "info", "info", "warn", "error", "debug"};
+    static const char* const MESSAGES[] = {"request completed", "order placed", "cache miss", "retrying upstream call",
+                                           "token refreshed", "payment declined", "slow query"};
+    char stamp[64];
+    std::snprintf(stamp, sizeof(stamp), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                  t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec, millis);
+    char latency[32];
+    std::snprintf(latency, sizeof(latency), "%.1f", 0.5 + skewed(5000, rng) / 10.0);
+    return std::string("{\"ts\":\"") + stamp + "\",\"level\":\"" + pick(LEVELS, rng) + "\",\"service\":\"" +
+           pick(SERVICES, rng) + "\",\"msg\":\"" + pick(MESSAGES, rng) + "\",\"user\":\"" + USERS[skewed(10, rng)] +
+           "\",\"client_ip\":\"" + ipv4(rng, false) + "\",\"request_id\":\"" + std::to_string(rng()) +
+           "\",\"latency_ms\":" + latency + "}";
+}
+
+/**
+ * @brief Generates one line in the given format.
+ *
+ * @param format The format; MIX picks one at random per line.
+ * @param epochMillis Event time in milliseconds since the epoch.
+ * @param rng The writer's generator.
+ * @return The line, without a newline.
+ */
+std::string generateLine(Format format, int64_t epochMillis, std::mt19937_64& rng) {
+    if (format == Format::MIX) {
+        format = static_cast<Format>(rng() % 5);
+    }
+    time_t seconds = static_cast<time_t>(epochMillis / 1000);
+    struct tm t;
+    gmtime_r(&seconds, &t);
+    switch (format) {
+        case Format::SYSLOG: return syslogLine(t, rng);
+        case Format::SSHD:   return sshdLine(t, rng);
+        case Format::CEF:    return cefLine(t, rng);
+        case Format::APACHE: return apacheLine(t, rng);
+        default:             return jsonLine(t, static_cast<int>(epochMillis % 1000), rng);
+    }
+}
+
+/**
+ * @brief Gives the target rate at a point in the run.
+ */
+class RateSchedule {
+public:
+    RateSchedule(const Options& options, std::vector<CurvePoint> curve) : options(options), curve(std::move(curve)) {}
+
+    /**
+     * @brief The rate for one file.
+     * @param elapsed Seconds since the start.
+     * @return Lines per second.
+     */
+    double rate(double elapsed) const {
+        double total = options.rate;
+        if (options.mode == Mode::BURSTY) {
+            // Square wave with the configured mean: burstFactor x rate during the
+            // duty part of each period, and whatever keeps the mean the rest of it.
+            double phase = std::fmod(elapsed, options.burstPeriod) / options.burstPeriod;
+            double high = options.rate * options.burstFactor;
+            double low = options.burstDuty < 1 ? std::max(0.0, options.rate * (1 - options.burstDuty * options.burstFactor) / (1 - options.burstDuty)) : high;
+            total = phase < options.burstDuty ? high : low;
+        } else if (options.mode == Mode::REPLAY) {
+            total = 0;
+            for (const CurvePoint& point : curve) {
+                if (point.offset > elapsed) {
+                    break;
+                }
+                total = point.rate;
+            }
+        }
+        return total / options.files;
+    }
+
+    /**
+     * @brief Whether a replayed curve has reached its last point.
+     * @param elapsed Seconds since the start.
+     */
+    bool finished(double elapsed) const {
+        return options.mode == Mode::REPLAY && elapsed >= curve.back().offset;
+    }
+
+private:
+    const Options& options;
+    std::vector<CurvePoint> curve;
+};
+
+/**
+ * @brief Writes one file at its share of the target rate, rotating it as configured.
+ */
+class FileWriter {
+public:
+    FileWriter(const Options& options, const RateSchedule& schedule, size_t index)
+        : options(options), schedule(schedule), format(options.formats[index % options.formats.size()]),
+          path(options.dir + "/gen" + std::to_string(index) + ".log"), rng(options.seed * 1000003 + index),
+          fd(-1), fileBytes(0), written(0) {
+        limit = options.count > 0 ? options.count / options.files + (index < options.count % options.files ? 1 : 0) : 0;
+        openFile(O_TRUNC);
+    }
+
+    ~FileWriter() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /**
+     * @brief Writes until the duration or line count is reached.
+     */
+    void run() {
+        auto start = std::chrono::steady_clock::now();
+        int64_t wallStart = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        double due = 0;
+        double last = 0;
+        std::string batch;
+        while (true) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if ((limit == 0 && elapsed >= options.duration) || (limit > 0 && written >= limit) || schedule.finished(elapsed)) {
+                break;
+            }
+            due += schedule.rate(elapsed) * (elapsed - last);
+            last = elapsed;
+            for (; due >= 1 && (limit == 0 || written < limit); due -= 1) {
+                int64_t millis = options.startTime >= 0
+                    ? options.startTime * 1000 + static_cast<int64_t>(written * 1000 * options.files / options.rate)
+                    : wallStart + static_cast<int64_t>(elapsed * 1000);
+                batch += generateLine(format, millis, rng);
+                batch += '\n';
+                written++;
+            }
+            flush(batch);
+            std::this_thread::sleep_for(WRITE_TICK);
+        }
+        flush(batch);
+    }
+
+    uint64_t lines() const { return written; }
+
+private:
+    void openFile(int extraFlags) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | extraFlags, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + path + ": " + strerror(errno));
+        }
+        fileBytes = 0;
+    }
+
+    void flush(std::string& batch) {
+        if (batch.empty()) {
+            return;
+        }
+        if (write(fd, batch.data(), batch.size()) < 0) {
+            throw std::runtime_error("Failed to write " + path + ": " + strerror(errno));
+        }
+        fileBytes += batch.size();
+        batch.clear();
+        if (options.rotateBytes > 0 && fileBytes >= options.rotateBytes) {
+            rotate();
+        }
+    }
+
+    /**
+     * @brief Rotates the file: renamed to `.1` and recreated, or truncated in place.
+     */
+    void rotate() {
+        if (options.rotateTruncate) {
+            if (ftruncate(fd, 0) < 0) {
+                throw std::runtime_error("Failed to truncate " + path + ": " + strerror(errno));
+            }
+            fileBytes = 0;
+            return;
+        }
+        close(fd);
+        if (std::rename(path.c_str(), (path + ".1").c_str()) < 0) {
+            throw std::runtime_error("Failed to rotate " + path + ": " + strerror(errno));
+        }
+        openFile(0);
+    }
+
+    const Options& options;
+    const RateSchedule& schedule;
+    Format format;
+    std::string path;
+    std::mt19937_64 rng;
+    int fd;
+    uint64_t fileBytes;
+    uint64_t written;
+    uint64_t limit;
+};
+
+Format parseFormat(const std::string& name) {
+    if (name == "syslog") return Format::SYSLOG;
+    if (name == "sshd") return Format::SSHD;
+    if (name == "cef") return Format::CEF;
+    if (name == "apache") return Format::APACHE;
+    if (name == "json") return Format::JSON;
+    if (name == "mix") return Format::MIX;
+    throw std::runtime_error("Unknown format " + name);
+}
+
+/**
+ * @brief Parses the command line.
+ *
+ * @throws std::runtime_error On an unknown option or a missing or invalid value.
+ */
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string name = argv[i];
+        if (i + 1 >= argc) {
+            throw std::runtime_error("Missing value for " + name);
+        }
+        std::string value = argv[++i];
+        if (name == "--files") {
+            options.files = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--dir") {
+            options.dir = value;
+        } else if (name == "--format") {
+            options.formats.clear();
+            std::istringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                options.formats.push_back(parseFormat(item));
+            }
+        } else if (name == "--rate") {
+            options.rate = std::atof(value.c_str());
+        } else if (name == "--duration") {
+            options.duration = std::atof(value.c_str());
+        } else if (name == "--count") {
+            options.count = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--mode") {
+            if (value == "steady") options.mode = Mode::STEADY;
+            else if (value == "bursty") options.mode = Mode::BURSTY;
+            else if (value == "replay") options.mode = Mode::REPLAY;
+            else throw std::runtime_error("Unknown mode " + value);
+        } else if (name == "--burst-factor") {
+            options.burstFactor = std::atof(value.c_str());
+        } else if (name == "--burst-period") {
+            options.burstPeriod = std::atof(value.c_str());
+        } else if (name == "--burst-duty") {
+            options.burstDuty = std::atof(value.c_str());
+        } else if (name == "--curve") {
+            options.curvePath = value;
+        } else if (name == "--rotate-bytes") {
+            options.rotateBytes = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--rotate-mode") {
+            if (value != "rename" && value != "truncate") {
+                throw std::runtime_error("Unknown rotate mode " + value);
+            }
+            options.rotateTruncate = value == "truncate";
+        } else if (name == "--seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (name == "--start-time") {
+            options.startTime = std::atoll(value.c_str());
+        } else {
+            throw std::runtime_error("Unknown option " + name);
+        }
+    }
+    if (options.files == 0 || options.rate <= 0 || options.formats.empty()) {
+        throw std::runtime_error("--files, --rate and --format must be non-empty and positive");
+    }
+    if (options.mode == Mode::REPLAY && options.curvePath.empty()) {
+        throw std::runtime_error("--mode replay needs --curve");
+    }
+    if (options.mode == Mode::BURSTY && (options.burstPeriod <= 0 || options.burstDuty <= 0 || options.burstDuty > 1)) {
+        throw std::runtime_error("--burst-period must be positive and --burst-duty in (0, 1]");
+    }
+    return options;
+}
+
+/**
+ * @brief Loads a rate curve of "<offset seconds> <lines per second>" lines.
+ *
+ * Blank lines and lines starting with '#' are skipped. The last point marks
+ * the end of the run; its rate is not used.
+ *
+ * @throws std::runtime_error If the file cannot be read or has no points.
+ */
+std::vector<CurvePoint> loadCurve(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open curve " + path);
+    }
+    std::vector<CurvePoint> curve;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        CurvePoint point;
+        if (fields >> point.offset >> point.rate) {
+            curve.push_back(point);
+        }
+    }
+    if (curve.empty()) {
+        throw std::runtime_error("Curve " + path + " has no points");
+    }
+    std::sort(curve.begin(), curve.end(), [](const CurvePoint& a, const CurvePoint& b) { return a.offset < b.offset; });
+    return curve;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        Options options = parseOptions(argc, argv);
+        std::vector<CurvePoint> curve;
+        if (options.mode == Mode::REPLAY) {
+            curve = loadCurve(options.curvePath);
+            if (options.count == 0) {
+                options.duration = 1e18;
+            }
+        }
+        RateSchedule schedule(options, curve);
+
+        std::vector<std::unique_ptr<FileWriter>> writers;
+        for (size_t i = 0; i < options.files; ++i) {
+            writers.emplace_back(new FileWriter(options, schedule, i));
+        }
+        std::vector<std::thread> threads;
+        std::vector<std::string> errors(writers.size());
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < writers.size(); ++i) {
+            threads.emplace_back([&writers, &errors, i] {
+                try {
+                    writers[i]->run();
+                } catch (const std::exception& e) {
+                    errors[i] = e.what();
+                }
+            });
+        }
+        uint64_t total = 0;
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+            total += writers[i]->lines();
+            if (!errors[i].empty()) {
+                std::cerr << errors[i] << std::endl;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::fprintf(stderr, "wrote %llu lines to %zu file(s) in %.1f s (%.0f lines/s)\n",
+                     static_cast<unsigned long long>(total), options.files, seconds, total / seconds);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
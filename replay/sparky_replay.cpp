@@ -0,0 +1,144 @@
+//
+// Replays a capture trace recorded with FileMonitor::setCapture().
+//
+// Re-creates the traced writes, byte for byte and with their original
+// spacing (or scaled), in files under a test directory, so a forwarder or
+// the load test can tail genuine production shapes without the logs leaving
+// the host they were captured on. Each traced file is replayed to
+// DIR/<id>-<basename>.
+//
+// Usage: sparky_replay TRACE [--dir PATH] [--speed N|max]
+//        sparky_replay --info TRACE
+//   --dir PATH    directory to replay into (default .)
+//   --speed N     time scale: 1 is real time (default), 10 ten times faster; max skips all waits
+//   --info        print the trace's files, bytes, lines and duration and exit
+//
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdio>
+#include "TraceFile.h"
+
+namespace {
+
+struct Options {
+    std::string trace;    ///< Trace file.
+    std::string dir = "."; ///< Replay directory.
+    double speed = 1;     ///< Time scale; 0 for max.
+    bool info = false;    ///< Only describe the trace.
+};
+
+void usage(const char* program) {
+    std::cerr << "Usage: " << program << " TRACE [--dir PATH] [--speed N|max]" << std::endl
+              << "       " << program << " --info TRACE" << std::endl;
+}
+
+/**
+ * @brief Parses the command line.
+ *
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @return The options.
+ *
+ * @throws std::runtime_error On an unknown option or a missing or invalid value.
+ */
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--info") {
+            options.info = true;
+        } else if (arg == "--dir" || arg == "--speed") {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--dir") {
+                options.dir = value;
+            } else if (value == "max") {
+                options.speed = 0;
+            } else {
+                options.speed = std::atof(value.c_str());
+                if (options.speed <= 0) {
+                    throw std::runtime_error("--speed must be positive or max");
+                }
+            }
+        } else if (options.trace.empty() && arg.compare(0, 2, "--") != 0) {
+            options.trace = arg;
+        } else {
+            throw std::runtime_error("Unknown option " + arg);
+        }
+    }
+    if (options.trace.empty()) {
+        throw std::runtime_error("No trace file given");
+    }
+    return options;
+}
+
+/**
+ * @brief Prints per-file totals and the duration of a trace.
+ *
+ * @param path The trace file.
+ */
+void describe(const std::string& path) {
+    TraceReader reader(path);
+    TraceReader::Record record;
+    std::vector<uint64_t> bytes;
+    std::vector<uint64_t> lines;
+    std::vector<uint64_t> writes;
+    int64_t duration = 0;
+    while (reader.next(record)) {
+        if (record.fileId >= bytes.size()) {
+            bytes.resize(record.fileId + 1);
+            lines.resize(record.fileId + 1);
+            writes.resize(record.fileId + 1);
+        }
+        bytes[record.fileId] += record.data.size();
+        lines[record.fileId] += static_cast<uint64_t>(std::count(record.data.begin(), record.data.end(), '\n'));
+        writes[record.fileId]++;
+        duration = record.offsetNanos;
+    }
+    std::printf("%-50s %10s %12s %14s\n", "FILE", "WRITES", "LINES", "BYTES");
+    for (size_t i = 0; i < reader.files().size(); ++i) {
+        uint64_t fileWrites = i < writes.size() ? writes[i] : 0;
+        uint64_t fileLines = i < lines.size() ? lines[i] : 0;
+        uint64_t fileBytes = i < bytes.size() ? bytes[i] : 0;
+        std::printf("%-50s %10llu %12llu %14llu\n", reader.files()[i].c_str(), static_cast<unsigned long long>(fileWrites),
+                    static_cast<unsigned long long>(fileLines), static_cast<unsigned long long>(fileBytes));
+    }
+    std::printf("duration: %.3f s\n", duration / 1e9);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        if (options.info) {
+            describe(options.trace);
+            return 0;
+        }
+        TraceReplayer replayer(options.trace, options.dir, options.speed);
+        auto start = std::chrono::steady_clock::now();
+        replayer.run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Replayed " << replayer.linesWritten() << " lines (" << replayer.bytesWritten() << " bytes) to "
+                  << replayer.targets().size() << " file(s) in " << seconds << " s" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
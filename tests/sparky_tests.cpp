@@ -0,0 +1,184 @@
+/**
+ * @file sparky_tests.cpp
+ * @brief Unit tests for the parsing, templating, metrics and filtering components.
+ *
+ * Build with the `sparky_tests` line in cpp_compiler_commands.txt and run
+ * from the repository root.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "TemplateMiner.h"
+#include "Metrics.h"
+#include "PatternPrefilter.h"
+#include "LineFilter.h"
+#include "JsonEscape.h"
+#include "JsonLogParser.h"
+#include "SyslogParser.h"
+
+TEST(TemplateMiner, ReusesTemplateForLinesOfTheSameShape) {
+    TemplateMiner miner;
+    TemplateMiner::Match first = miner.add("login 42 43 44");
+    ASSERT_GE(first.templateId, 0);
+    EXPECT_TRUE(first.isNew);
+    for (const char* line : {"login 52 53 54", "login 62 63 64", "login 72 73 74"}) {
+        TemplateMiner::Match match = miner.add(line);
+        EXPECT_EQ(match.templateId, first.templateId) << line;
+        EXPECT_FALSE(match.isNew) << line;
+    }
+    EXPECT_EQ(miner.templateText(first.templateId), "login <*> <*> <*>");
+}
+
+TEST(TemplateMiner, ReconstructsLinesLosslessly) {
+    TemplateMiner miner;
+    TemplateDecoder decoder;
+    for (const char* line : {"user alice logged in from 10.0.0.1", "user bob logged in from 10.0.0.2", "user  carol logged out"}) {
+        TemplateMiner::Match match = miner.add(line);
+        ASSERT_GE(match.templateId, 0);
+        decoder.addTemplate(match.templateId, miner.templateText(match.templateId));
+        EXPECT_EQ(decoder.reconstruct(match.templateId, match.params), line);
+    }
+}
+
+TEST(Metrics, RendersEachFamilyUnderOneTypeLine) {
+    Metrics& metrics = Metrics::instance();
+    metrics.counter("test_family").add();
+    metrics.counter("test_family_y").add();
+    metrics.counter("test_family", Metrics::label("a", "1")).add(2);
+    std::string rendered = metrics.render();
+    size_t type = rendered.find("# TYPE test_family counter\n");
+    ASSERT_NE(type, std::string::npos);
+    EXPECT_EQ(rendered.find("# TYPE test_family counter\n", type + 1), std::string::npos);
+    EXPECT_NE(rendered.find("# TYPE test_family counter\ntest_family 1\ntest_family{a=\"1\"} 2\n"), std::string::npos);
+}
+
+TEST(Metrics, RendersGaugesWithFullPrecision) {
+    Metrics& metrics = Metrics::instance();
+    metrics.gauge("test_offset_bytes").set(1234567890123.0);
+    metrics.gauge("test_ratio").set(0.1);
+    std::string rendered = metrics.render();
+    EXPECT_NE(rendered.find("test_offset_bytes 1234567890123\n"), std::string::npos);
+    EXPECT_NE(rendered.find("test_ratio 0.10000000000000001\n"), std::string::npos);
+}
+
+namespace {
+
+/**
+ * @brief Tells whether a single-pattern prefilter matches a line.
+ */
+bool prefilterMatches(const std::string& pattern, const std::string& line) {
+    PatternPrefilter prefilter;
+    prefilter.add(pattern);
+    prefilter.compile();
+    PatternPrefilter::Scratch scratch;
+    std::vector<int> matches;
+    prefilter.matches(line, scratch, matches);
+    return matches.size() == 1;
+}
+
+} // namespace
+
+TEST(PatternPrefilter, MatchesAsciiAtomsInAnyCase) {
+    EXPECT_TRUE(prefilterMatches("(?i)disk error", "DISK ERROR on sda"));
+    EXPECT_FALSE(prefilterMatches("disk error", "all good"));
+}
+
+TEST(PatternPrefilter, MatchesPatternsWithNonAsciiAtoms) {
+    EXPECT_TRUE(prefilterMatches("ОШИБКА диска", "ОШИБКА диска sda"));
+    EXPECT_TRUE(prefilterMatches("(?i)ошибка", "Ошибка"));
+    EXPECT_TRUE(prefilterMatches("Äpfel (\\d+)", "Äpfel 12"));
+    EXPECT_FALSE(prefilterMatches("Äpfel (\\d+)", "Äpfel"));
+}
+
+TEST(LineFilter, FirstMatchingRegexRuleDecides) {
+    LineFilter filter;
+    filter.addRule("keep-errors: keep regex \\b(ERROR|FATAL)\\b");
+    filter.addRule("drop-debug: drop regex ^DEBUG\\s");
+    filter.addRule("drop-numbers: drop regex ^\\d+$");
+    filter.addRule("default: keep");
+    filter.compile();
+    LineFilter::Binding binding = filter.bind("/var/log/app.log");
+    EXPECT_TRUE(binding.keep("DEBUG ERROR in handler", nullptr));
+    EXPECT_FALSE(binding.keep("DEBUG cache miss", nullptr));
+    EXPECT_FALSE(binding.keep("12345", nullptr));
+    EXPECT_TRUE(binding.keep("INFO started", nullptr));
+    EXPECT_TRUE(binding.keep("debug lowercase is not dropped", nullptr));
+}
+
+namespace {
+
+/**
+ * @brief Parses a JSON line and returns its members as appended to an envelope.
+ */
+std::string envelopeMembers(const std::string& line) {
+    JsonLogParser parser;
+    EXPECT_TRUE(parser.parse(line));
+    std::string out;
+    parser.appendMembers(out);
+    return out;
+}
+
+} // namespace
+
+TEST(JsonEscape, EscapesQuotesBackslashesAndControlCharacters) {
+    std::string out = "\"";
+    appendEscapedJson(out, "a\"b\\c\nd\te\x01 \xc3\xa9");
+    EXPECT_EQ(out, "\"a\\\"b\\\\c\\nd\\te\\u0001 \xc3\xa9");
+}
+
+TEST(JsonLogParser, PrefixesEnvelopeKeysWrittenWithEscapes) {
+    EXPECT_EQ(envelopeMembers(R"({"time\u0073tamp": 1})"), R"(, "log_time\u0073tamp": 1)");
+    EXPECT_EQ(envelopeMembers(R"({"level": "info"})"), R"(, "level": "info")");
+}
+
+TEST(JsonLogParser, NumbersPrefixedKeysThatAreTaken) {
+    EXPECT_EQ(envelopeMembers(R"({"timestamp": 1, "log_timestamp": 2})"),
+              R"(, "log_timestamp_2": 1, "log_timestamp": 2)");
+    EXPECT_EQ(envelopeMembers(R"({"log_type": 1, "type": 2, "log_type_2": 3})"),
+              R"(, "log_type": 1, "log_type_3": 2, "log_type_2": 3)");
+}
+
+TEST(SyslogParser, AcceptsTheYearBeforeOrAfterTheTime) {
+    SyslogParser parser;
+    SyslogParser::Message after;
+    ASSERT_TRUE(parser.parse("Mar 14 09:26:53 2025 fw01 app[1]: hi", after));
+    EXPECT_EQ(after.hostname, "fw01");
+    EXPECT_EQ(after.appName, "app");
+    EXPECT_EQ(after.procId, "1");
+    EXPECT_EQ(after.message, "hi");
+
+    SyslogParser::Message before;
+    ASSERT_TRUE(parser.parse("Mar 14 2025 09:26:53 fw01 app[1]: hi", before));
+    EXPECT_EQ(before.hostname, "fw01");
+    EXPECT_EQ(before.timeUs, after.timeUs);
+}
+
+TEST(SyslogParser, KeepsANumericHostnameThatIsNotAYear) {
+    SyslogParser parser;
+    SyslogParser::Message message;
+    ASSERT_TRUE(parser.parse("Mar 14 09:26:53 4711 app: hi", message));
+    EXPECT_EQ(message.hostname, "4711");
+    EXPECT_EQ(message.appName, "app");
+}
+
+TEST(SyslogParser, RequiresStrictRfc3339TimestampsInRfc5424) {
+    SyslogParser parser;
+    SyslogParser::Message message;
+    ASSERT_TRUE(parser.parse("<34>1 2025-03-14T09:26:53.120Z host app 42 ID47 - hi", message));
+    EXPECT_EQ(message.timeUs, 1741944413120000);
+    ASSERT_TRUE(parser.parse("<34>1 2025-03-14T10:26:53+01:00 host app - - - hi", message));
+    EXPECT_EQ(message.timeUs, 1741944413000000);
+    EXPECT_FALSE(parser.parse("<34>1 2025-03-14 09:26 host app - - - hi", message));
+    EXPECT_FALSE(parser.parse("<34>1 2025-03-14T09:26:53 host app - - - hi", message));
+    EXPECT_FALSE(parser.parse("<34>1 2025-03-14T09:26Z host app - - - hi", message));
+    EXPECT_FALSE(parser.parse("<34>1 2025-03-14T09:26:53+0100 host app - - - hi", message));
+    EXPECT_FALSE(parser.parse("<34>1 2025-03-14T09:26:53,120Z host app - - - hi", message));
+}
+
+TEST(TimestampParser, KeepsLenientIso8601) {
+    TimestampParser parser;
+    int64_t timeUs = 0;
+    EXPECT_GT(parser.parse(TimestampParser::ISO8601, "2025-03-14 09:26:53,120+0100", timeUs), 0u);
+    EXPECT_EQ(parser.parse(TimestampParser::RFC3339, "2025-03-14 09:26:53,120+0100", timeUs), 0u);
+}
@@ -0,0 +1,161 @@
+//
+// sparky-top: live view of a running forwarder's stats segment.
+//
+// Attaches read-only to the shared memory segment published by StatsSegment
+// and redraws per-input rates, lag and queue occupancy 10 times a second.
+// Reading never blocks or signals the forwarder.
+//
+// Usage: sparky-top [--segment NAME] [--interval MS] [--once]
+//
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "StatsSegment.h"
+
+namespace {
+
+struct Options {
+    std::string segment = "/sparky-stats"; ///< Shared memory name.
+    int intervalMs = 100; ///< Redraw interval.
+    bool once = false; ///< Print one frame with rates over one interval, without clearing the screen, and exit.
+};
+
+int64_t monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Formats a count with a k/M/G suffix.
+ */
+std::string human(double value) {
+    const char* suffixes[] = {"", "k", "M", "G", "T"};
+    size_t i = 0;
+    while (value >= 1000 && i + 1 < sizeof(suffixes) / sizeof(suffixes[0])) {
+        value /= 1000;
+        i++;
+    }
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), i == 0 ? "%.0f%s" : "%.1f%s", value, suffixes[i]);
+    return buffer;
+}
+
+/**
+ * @brief Shortens a path from the left to fit a column.
+ */
+std::string fit(const std::string& text, size_t width) {
+    return text.size() <= width ? text : "..." + text.substr(text.size() - (width - 3));
+}
+
+/**
+ * @brief Draws one frame.
+ *
+ * Rates are computed against the previous payload; on the first frame they
+ * are left blank.
+ *
+ * @param pid Process ID of the forwarder.
+ * @param current The payload just read.
+ * @param previous The payload read for the previous frame, if any.
+ */
+void draw(int pid, const StatsPayload& current, const StatsPayload* previous) {
+    double seconds = previous ? (current.publishedNanos - previous->publishedNanos) / 1e9 : 0;
+    std::map<std::string, const StatsInputRecord*> before;
+    if (previous) {
+        for (uint32_t i = 0; i < previous->inputCount; ++i) {
+            before[previous->inputs[i].name] = &previous->inputs[i];
+        }
+    }
+    auto rate = [seconds](uint64_t now, uint64_t then) {
+        return seconds > 0 && now >= then ? human((now - then) / seconds) : std::string("-");
+    };
+
+    double age = (monotonicNanos() - current.publishedNanos) / 1e9;
+    std::printf("sparky-top  pid %d  update %llu (%.1fs ago)%s\n", pid, static_cast<unsigned long long>(current.updates),
+                age, age > 2 ? "  STALE" : "");
+    std::printf("delivered %s (%s/s)  failed %s  lanes critical %.0f normal %.0f bulk %.0f  cpu budget %.0f%%\n\n",
+                human(static_cast<double>(current.eventsDelivered)).c_str(),
+                previous ? rate(current.eventsDelivered, previous->eventsDelivered).c_str() : "-",
+                human(static_cast<double>(current.deliveryFailures)).c_str(),
+                current.laneDepth[0], current.laneDepth[1], current.laneDepth[2], current.cpuUtilization * 100);
+    std::printf("%-40s %9s %9s %9s %10s %10s %9s %7s\n", "INPUT", "LINES/s", "BYTES/s", "ACKED/s", "LAG", "UNSHIPPED", "INFLIGHT", "QUEUE");
+    for (uint32_t i = 0; i < current.inputCount; ++i) {
+        const StatsInputRecord& input = current.inputs[i];
+        auto it = before.find(input.name);
+        const StatsInputRecord* old = it == before.end() ? nullptr : it->second;
+        uint64_t lag = input.fileSize > input.readOffset ? input.fileSize - input.readOffset : 0;
+        std::printf("%-40s %9s %9s %9s %10s %10s %9s %7s\n", fit(input.name, 40).c_str(),
+                    old ? rate(input.linesRead, old->linesRead).c_str() : "-",
+                    old ? rate(input.bytesRead, old->bytesRead).c_str() : "-",
+                    old ? rate(input.eventsDelivered, old->eventsDelivered).c_str() : "-",
+                    human(static_cast<double>(lag)).c_str(), human(static_cast<double>(input.unshippedBytes)).c_str(),
+                    human(static_cast<double>(input.inFlight)).c_str(),
+                    human(static_cast<double>(input.queueDepth)).c_str());
+    }
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--once") {
+            options.once = true;
+        } else if (arg == "--segment" && i + 1 < argc) {
+            options.segment = argv[++i];
+        } else if (arg == "--interval" && i + 1 < argc) {
+            options.intervalMs = std::max(10, std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--segment NAME] [--interval MS] [--once]" << std::endl;
+            return 1;
+        }
+    }
+
+    int fd = shm_open(options.segment.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "Failed to open stats segment " << options.segment << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    void* mapped = mmap(nullptr, sizeof(StatsLayout), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map stats segment " << options.segment << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    const StatsLayout& layout = *static_cast<const StatsLayout*>(mapped);
+
+    // Two payloads are large; keep them off the stack and swap between them.
+    std::vector<StatsPayload> payloads(2);
+    bool havePrevious = false;
+    size_t current = 0;
+    while (true) {
+        if (!StatsSegment::read(layout, payloads[current])) {
+            std::cerr << "Stats segment " << options.segment << " is not readable (wrong version or busy)" << std::endl;
+            return 1;
+        }
+        if (!options.once) {
+            std::printf("\033[H\033[2J");
+            draw(layout.pid, payloads[current], havePrevious ? &payloads[1 - current] : nullptr);
+        } else if (havePrevious) {
+            draw(layout.pid, payloads[current], &payloads[1 - current]);
+            return 0;
+        }
+        havePrevious = true;
+        current = 1 - current;
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.intervalMs));
+    }
+}